@@ -0,0 +1,278 @@
+//***************************************************************************************
+// AsyncFileIO.cpp
+//***************************************************************************************
+
+#include "AsyncFileIO.h"
+#include "StringUtil.h"
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <new>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const AsyncFileIO::uint32 AsyncFileIO::DefaultQueueDepth;
+
+namespace
+{
+	// Largest single read call; bigger files are read in pieces.
+	const size_t MaxReadSize = size_t(1) << 30;
+
+	// Sizes data for the whole file; a file too big to hold fails the read instead of
+	// throwing out of an I/O thread.
+	HRESULT AllocateFileData(std::vector<AsyncFileIO::uint8>& data, std::uint64_t fileSize)
+	{
+		if (fileSize > data.max_size())
+			return E_OUTOFMEMORY;
+
+		try
+		{
+			data.resize((size_t)fileSize);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return E_OUTOFMEMORY;
+		}
+		catch (...)
+		{
+			return E_FAIL;
+		}
+
+		return S_OK;
+	}
+}
+
+AsyncFileIO::AsyncFileIO(uint32 queueDepth)
+{
+	queueDepth = std::max<uint32>(queueDepth, 1);
+	for (uint32 i = 0; i < queueDepth; ++i)
+		mWorkers.emplace_back(&AsyncFileIO::WorkerLoop, this);
+}
+
+AsyncFileIO::~AsyncFileIO()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeUp.notify_all();
+
+	for (std::thread& worker : mWorkers)
+		worker.join();
+}
+
+std::future<AsyncFileIO::Result> AsyncFileIO::Read(const std::wstring& filename, Priority priority)
+{
+	// std::function must be copyable, so the promise is shared.
+	auto promise = std::make_shared<std::promise<Result>>();
+	std::future<Result> future = promise->get_future();
+
+	Submit(priority, [filename, promise]() { promise->set_value(ReadWholeFile(filename)); });
+
+	return future;
+}
+
+void AsyncFileIO::Read(const std::wstring& filename, Priority priority, Callback onComplete)
+{
+	assert(onComplete);
+
+	Submit(priority, [filename, onComplete]()
+	{
+		Result result = ReadWholeFile(filename);
+		onComplete(result);
+	});
+}
+
+std::vector<std::future<AsyncFileIO::Result>> AsyncFileIO::ReadBatch(const std::vector<std::wstring>& filenames, Priority priority)
+{
+	std::vector<std::future<Result>> futures;
+	futures.reserve(filenames.size());
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (const std::wstring& filename : filenames)
+		{
+			auto promise = std::make_shared<std::promise<Result>>();
+			futures.push_back(promise->get_future());
+
+			mQueues[(uint32)priority].push_back([filename, promise]() { promise->set_value(ReadWholeFile(filename)); });
+		}
+	}
+	mWakeUp.notify_all();
+
+	return futures;
+}
+
+void AsyncFileIO::ReadBatch(const std::vector<std::wstring>& filenames, Priority priority, const Callback& onComplete)
+{
+	assert(onComplete);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (const std::wstring& filename : filenames)
+		{
+			mQueues[(uint32)priority].push_back([filename, onComplete]()
+			{
+				Result result = ReadWholeFile(filename);
+				onComplete(result);
+			});
+		}
+	}
+	mWakeUp.notify_all();
+}
+
+void AsyncFileIO::Submit(Priority priority, std::function<void()> task)
+{
+	assert(priority < Priority::Count);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQueues[(uint32)priority].push_back(std::move(task));
+	}
+	mWakeUp.notify_one();
+}
+
+void AsyncFileIO::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mIdle.wait(lock, [this]()
+	{
+		if (mRunning != 0)
+			return false;
+		for (const auto& queue : mQueues)
+		{
+			if (!queue.empty())
+				return false;
+		}
+		return true;
+	});
+}
+
+AsyncFileIO::Result AsyncFileIO::ReadWholeFile(const std::wstring& filename)
+{
+	Result result;
+	result.Filename = filename;
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		result.Status = HRESULT_FROM_WIN32(GetLastError());
+		return result;
+	}
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		result.Status = HRESULT_FROM_WIN32(GetLastError());
+		CloseHandle(file);
+		return result;
+	}
+
+	result.Status = AllocateFileData(result.Data, (std::uint64_t)fileSize.QuadPart);
+	if (FAILED(result.Status))
+	{
+		CloseHandle(file);
+		return result;
+	}
+
+	for (size_t offset = 0; offset < result.Data.size(); )
+	{
+		DWORD bytesRead = 0;
+		DWORD request = (DWORD)std::min(result.Data.size() - offset, MaxReadSize);
+		if (!::ReadFile(file, result.Data.data() + offset, request, &bytesRead, nullptr))
+		{
+			result.Status = HRESULT_FROM_WIN32(GetLastError());
+			break;
+		}
+		if (bytesRead == 0)
+		{
+			result.Status = E_FAIL; // Truncated while reading.
+			break;
+		}
+		offset += bytesRead;
+	}
+
+	CloseHandle(file);
+#else
+	int fd = open(StringUtil::ToNarrow(filename).c_str(), O_RDONLY);
+	if (fd < 0)
+		return result;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		close(fd);
+		return result;
+	}
+
+	result.Status = AllocateFileData(result.Data, (std::uint64_t)info.st_size);
+	if (FAILED(result.Status))
+	{
+		close(fd);
+		return result;
+	}
+
+	for (size_t offset = 0; offset < result.Data.size(); )
+	{
+		ssize_t bytesRead = read(fd, result.Data.data() + offset, std::min(result.Data.size() - offset, MaxReadSize));
+		if (bytesRead <= 0)
+		{
+			result.Status = E_FAIL;
+			break;
+		}
+		offset += (size_t)bytesRead;
+	}
+
+	close(fd);
+#endif
+
+	if (FAILED(result.Status))
+		result.Data.clear();
+
+	return result;
+}
+
+AsyncFileIO& AsyncFileIO::Default()
+{
+	static AsyncFileIO io;
+	return io;
+}
+
+void AsyncFileIO::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			auto next = [this]()
+			{
+				for (auto& queue : mQueues)
+				{
+					if (!queue.empty())
+						return &queue;
+				}
+				return (std::deque<std::function<void()>>*)nullptr;
+			};
+			mWakeUp.wait(lock, [this, &next]() { return mQuit || next() != nullptr; });
+
+			auto* queue = next();
+			if (queue == nullptr)
+				return; // Quitting and drained.
+
+			task = std::move(queue->front());
+			queue->pop_front();
+			++mRunning;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			--mRunning;
+		}
+		mIdle.notify_all();
+	}
+}
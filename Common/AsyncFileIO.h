@@ -0,0 +1,99 @@
+//***************************************************************************************
+// AsyncFileIO.h
+//
+// Background file reads. Requests go into one queue per priority class and are served
+// by dedicated I/O threads, highest class first and in submission order within a class.
+// Each thread has one blocking read in flight, so the thread count is the queue depth
+// the storage device sees; submitting a whole batch up front keeps it busy while the
+// caller does other work.
+//
+// The I/O threads are separate from ThreadPool: they spend their time blocked in the
+// OS and must not hold up CPU work.
+//***************************************************************************************
+
+#pragma once
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <wsl/winadapter.h>
+#endif
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class AsyncFileIO
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	static const uint32 DefaultQueueDepth = 8;
+
+	// Queued requests of a higher class always start before lower ones.
+	enum class Priority : uint32
+	{
+		High,   // Needed this frame.
+		Normal,
+		Low,    // Prefetch / streaming ahead.
+		Count
+	};
+
+	struct Result
+	{
+		std::wstring Filename;
+		HRESULT Status = E_FAIL;
+		std::vector<uint8> Data; // Whole file; empty on failure.
+	};
+
+	// Runs on an I/O thread; it may move the data out of result.
+	using Callback = std::function<void(Result& result)>;
+
+	explicit AsyncFileIO(uint32 queueDepth = DefaultQueueDepth);
+
+	// Finishes every queued request before returning.
+	~AsyncFileIO();
+
+	AsyncFileIO(const AsyncFileIO& rhs) = delete;
+	AsyncFileIO& operator=(const AsyncFileIO& rhs) = delete;
+
+	uint32 GetQueueDepth()const { return (uint32)mWorkers.size(); }
+
+	std::future<Result> Read(const std::wstring& filename, Priority priority = Priority::Normal);
+	void Read(const std::wstring& filename, Priority priority, Callback onComplete);
+
+	// Queues every file under one lock; futures are in filenames order.
+	std::vector<std::future<Result>> ReadBatch(const std::vector<std::wstring>& filenames, Priority priority = Priority::Normal);
+	void ReadBatch(const std::vector<std::wstring>& filenames, Priority priority, const Callback& onComplete);
+
+	// Queues other blocking file work (opening, mapping, writing) alongside the reads.
+	void Submit(Priority priority, std::function<void()> task);
+
+	// Blocks until the queues are empty and no request is running.
+	void WaitIdle();
+
+	// Reads filename on the calling thread.
+	static Result ReadWholeFile(const std::wstring& filename);
+
+	// Shared service used when callers do not supply their own.
+	static AsyncFileIO& Default();
+
+private:
+	void WorkerLoop();
+
+private:
+	std::vector<std::thread> mWorkers;
+	std::deque<std::function<void()>> mQueues[(uint32)Priority::Count];
+	std::mutex mMutex;
+	std::condition_variable mWakeUp;
+	std::condition_variable mIdle;
+	uint32 mRunning = 0;
+	bool mQuit = false;
+};
@@ -0,0 +1,145 @@
+//***************************************************************************************
+// CascadedShadows.cpp
+//***************************************************************************************
+
+#include "CascadedShadows.h"
+#include "FrustumCuller.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+const CascadedShadows::uint32 CascadedShadows::MaxCascades;
+
+namespace
+{
+	// Sphere radii are rounded up to this step so float noise in the fit does not
+	// change the projection (and the texel size) from frame to frame.
+	const float RadiusQuantum = 1.0f / 16.0f;
+}
+
+CascadedShadows::CascadedShadows(const Desc& desc)
+{
+	SetDesc(desc);
+}
+
+void CascadedShadows::SetDesc(const Desc& desc)
+{
+	assert(desc.CascadeCount >= 1 && desc.CascadeCount <= MaxCascades && desc.CascadeCount <= FrustumCuller::MaxMaskFrusta);
+	assert(desc.ShadowMapSize > 0);
+
+	mDesc = desc;
+}
+
+void CascadedShadows::ComputeSplits(float nearZ, float farZ, uint32 count, float lambda, float* splits)
+{
+	assert(nearZ > 0.0f && farZ > nearZ && count > 0);
+
+	splits[0] = nearZ;
+	for (uint32 i = 1; i < count; ++i)
+	{
+		float t = (float)i / count;
+		float logSplit = nearZ * powf(farZ / nearZ, t);
+		float uniformSplit = nearZ + (farZ - nearZ) * t;
+		splits[i] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+	}
+	splits[count] = farZ;
+}
+
+void CascadedShadows::Update(FXMMATRIX cameraView, float fovY, float aspect, float nearZ, float farZ,
+	const XMFLOAT3& lightDirection, const BoundingSphere& sceneBounds)
+{
+	XMVECTOR det = XMMatrixDeterminant(cameraView);
+	XMMATRIX invView = XMMatrixInverse(&det, cameraView);
+
+	// Light basis independent of the camera, so snapped centers stay put as it moves.
+	XMVECTOR lightDir = XMVector3Normalize(XMLoadFloat3(&lightDirection));
+	XMVECTOR up = fabsf(XMVectorGetY(lightDir)) < 0.99f ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+	XMMATRIX lightView = XMMatrixLookToLH(XMVectorZero(), lightDir, up);
+
+	XMFLOAT3 sceneCenter;
+	XMStoreFloat3(&sceneCenter, XMVector3TransformCoord(XMLoadFloat3(&sceneBounds.Center), lightView));
+
+	// Transform NDC space [-1,+1]^2 to texture space [0,1]^2.
+	XMMATRIX T(
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, -0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.5f, 0.5f, 0.0f, 1.0f);
+
+	float tanY = tanf(0.5f * fovY);
+	float tanX = tanY * aspect;
+	float diagonal2 = tanX * tanX + tanY * tanY; // (half diagonal / depth)^2 of a slice
+
+	float shadowFar = std::max(std::min(farZ, mDesc.ShadowDistance), nearZ * 1.001f);
+	float splits[MaxCascades + 1];
+	ComputeSplits(nearZ, shadowFar, mDesc.CascadeCount, mDesc.SplitLambda, splits);
+
+	for (uint32 i = 0; i < mDesc.CascadeCount; ++i)
+	{
+		Cascade& cascade = mCascades[i];
+		float n = splits[i], f = splits[i + 1];
+
+		// Smallest sphere through the slice's 8 corners: its center is on the view axis,
+		// equally far from the near and far corners (or at the far cap's center when
+		// the slice is wide). Depends only on n, f and the fov, not on the camera.
+		float centerZ = std::min(0.5f * (n + f) * (1.0f + diagonal2), f);
+		float radius = sqrtf((f - centerZ) * (f - centerZ) + f * f * diagonal2);
+		radius = ceilf(radius / RadiusQuantum) * RadiusQuantum;
+
+		XMVECTOR center = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, centerZ, 1.0f), invView);
+
+		// Snap the light space center to whole texels.
+		XMFLOAT3 lc;
+		XMStoreFloat3(&lc, XMVector3TransformCoord(center, lightView));
+
+		float texel = 2.0f * radius / mDesc.ShadowMapSize;
+		lc.x = floorf(lc.x / texel) * texel;
+		lc.y = floorf(lc.y / texel) * texel;
+
+		// Depth covers every caster in the scene, not just the slice.
+		float zNear = std::min(sceneCenter.z - sceneBounds.Radius, lc.z - radius);
+		float zFar = std::max(sceneCenter.z + sceneBounds.Radius, lc.z + radius);
+
+		XMMATRIX proj = XMMatrixOrthographicOffCenterLH(lc.x - radius, lc.x + radius, lc.y - radius, lc.y + radius, zNear, zFar);
+		XMMATRIX viewProj = lightView * proj;
+
+		cascade.SplitNear = n;
+		cascade.SplitFar = f;
+		XMStoreFloat3(&cascade.Bounds.Center, center);
+		cascade.Bounds.Radius = radius;
+
+		XMStoreFloat4x4(&cascade.View, lightView);
+		XMStoreFloat4x4(&cascade.Proj, proj);
+		XMStoreFloat4x4(&cascade.ViewProj, viewProj);
+		XMStoreFloat4x4(&cascade.ShadowTransform, viewProj * T);
+
+		// Plane 0 is the near plane: replace it with one every box passes, so casters
+		// between the light and the slice are kept.
+		FrustumCuller::GetPlanes(viewProj, cascade.CasterPlanes);
+		cascade.CasterPlanes[0] = XMFLOAT4(0.0f, 0.0f, 0.0f, -1.0f);
+	}
+}
+
+void CascadedShadows::CullCasters(const FrustumCuller& culler, std::vector<uint32>* casters, std::vector<uint8>& casterMasks,
+	ThreadPool* pool)const
+{
+	XMFLOAT4 planes[MaxCascades * 6];
+	for (uint32 c = 0; c < mDesc.CascadeCount; ++c)
+		std::copy(mCascades[c].CasterPlanes, mCascades[c].CasterPlanes + 6, planes + c * 6);
+
+	culler.CullMasks(planes, mDesc.CascadeCount, casterMasks, pool);
+
+	for (uint32 c = 0; c < mDesc.CascadeCount; ++c)
+		casters[c].clear();
+
+	for (size_t i = 0; i < casterMasks.size(); ++i)
+	{
+		for (uint32 mask = casterMasks[i], c = 0; mask != 0; mask >>= 1, ++c)
+		{
+			if (mask & 1)
+				casters[c].push_back((uint32)i);
+		}
+	}
+}
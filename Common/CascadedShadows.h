@@ -0,0 +1,90 @@
+//***************************************************************************************
+// CascadedShadows.h
+//
+// Cascaded shadow maps for a directional Light: splits the camera's depth range with
+// the practical split scheme (a blend of logarithmic and uniform splits), fits each
+// slice with a bounding sphere and builds an orthographic light projection around it.
+//
+// The projections are stable: a sphere's size does not change as the camera turns, the
+// light basis does not depend on the camera, and the sphere center is snapped to whole
+// shadow map texels, so static shadows do not shimmer as the camera moves.
+//
+// CullCasters() culls the casters' world boxes (FrustumCuller) against every cascade in
+// one pass, with each cascade's volume extended toward the light so casters outside
+// the slice that throw shadows into it are kept.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+class FrustumCuller;
+class ThreadPool;
+
+class CascadedShadows
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	static const uint32 MaxCascades = 8;
+
+	struct Desc
+	{
+		uint32 CascadeCount = 4;
+		uint32 ShadowMapSize = 2048;  // Per cascade, in texels.
+		float SplitLambda = 0.75f;    // 0 = uniform splits, 1 = logarithmic.
+		float ShadowDistance = 200.0f; // Shadows end here (or at the camera's far plane).
+	};
+
+	struct Cascade
+	{
+		float SplitNear = 0.0f; // Camera view depth range of the slice.
+		float SplitFar = 0.0f;
+		DirectX::BoundingSphere Bounds; // World space sphere around the slice.
+
+		DirectX::XMFLOAT4X4 View;      // Light view, the same for every cascade.
+		DirectX::XMFLOAT4X4 Proj;
+		DirectX::XMFLOAT4X4 ViewProj;
+		DirectX::XMFLOAT4X4 ShadowTransform; // World to shadow map texture space (u, v, depth).
+
+		// Outward culling planes (FrustumCuller convention) without the near plane.
+		DirectX::XMFLOAT4 CasterPlanes[6];
+	};
+
+	CascadedShadows() = default;
+	explicit CascadedShadows(const Desc& desc);
+
+	void SetDesc(const Desc& desc);
+	const Desc& GetDesc()const { return mDesc; }
+
+	// splits[0] = nearZ, splits[count] = farZ, practical split scheme in between.
+	static void ComputeSplits(float nearZ, float farZ, uint32 count, float lambda, float* splits);
+
+	///<summary>
+	/// Refits the cascades for a camera (view matrix and perspective parameters as given
+	/// to XMMatrixPerspectiveFovLH) and a light travelling along lightDirection.
+	/// sceneBounds bounds every caster; the light space depth range covers it.
+	///</summary>
+	void Update(DirectX::FXMMATRIX cameraView, float fovY, float aspect, float nearZ, float farZ,
+		const DirectX::XMFLOAT3& lightDirection, const DirectX::BoundingSphere& sceneBounds);
+
+	uint32 GetCascadeCount()const { return mDesc.CascadeCount; }
+	const Cascade& GetCascade(uint32 index)const { return mCascades[index]; }
+
+	///<summary>
+	/// Per cascade lists (ascending) of the culler's boxes that can cast into it.
+	/// casters must point to GetCascadeCount() vectors. casterMasks receives the
+	/// per box cascade bits (FrustumCuller::CullMasks).
+	///</summary>
+	void CullCasters(const FrustumCuller& culler, std::vector<uint32>* casters, std::vector<uint8>& casterMasks,
+		ThreadPool* pool = nullptr)const;
+
+private:
+	Desc mDesc;
+	Cascade mCascades[MaxCascades];
+};
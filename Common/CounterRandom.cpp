@@ -0,0 +1,400 @@
+//***************************************************************************************
+// CounterRandom.cpp
+//***************************************************************************************
+
+#include "CounterRandom.h"
+#include "ThreadPool.h"
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define COUNTER_RANDOM_AVX2
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define COUNTER_RANDOM_SSE2
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = CounterRandom::uint32;
+	using uint64 = CounterRandom::uint64;
+
+	const uint32 PhiloxM0 = 0xD2511F53;
+	const uint32 PhiloxM1 = 0xCD9E8D57;
+	const uint32 PhiloxW0 = 0x9E3779B9;
+	const uint32 PhiloxW1 = 0xBB67AE85;
+	const int PhiloxRounds = 10;
+
+	// Counters evaluated together by PhiloxLanes.
+	const size_t LaneCount = 8;
+
+	// Items per ParallelFor chunk.
+	const size_t FillGrainSize = 4096;
+
+	// 2^-24: the top 24 bits of a draw make a float in [0, 1).
+	const float FloatScale = 1.0f / 16777216.0f;
+
+	void Philox(const uint32 counter[4], const uint32 key[2], uint32 out[4])
+	{
+		uint32 c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+		uint32 k0 = key[0], k1 = key[1];
+
+		for (int r = 0; r < PhiloxRounds; ++r)
+		{
+			uint64 p0 = (uint64)PhiloxM0 * c0;
+			uint64 p1 = (uint64)PhiloxM1 * c2;
+
+			uint32 n0 = (uint32)(p1 >> 32) ^ c1 ^ k0;
+			uint32 n2 = (uint32)(p0 >> 32) ^ c3 ^ k1;
+			c1 = (uint32)p1;
+			c3 = (uint32)p0;
+			c0 = n0;
+			c2 = n2;
+
+			k0 += PhiloxW0;
+			k1 += PhiloxW1;
+		}
+
+		out[0] = c0;
+		out[1] = c1;
+		out[2] = c2;
+		out[3] = c3;
+	}
+
+	// 8 Philox blocks: word w of counter / result j is counters[w][j] / out[w][j].
+	void PhiloxLanes(const uint32 counters[4][LaneCount], const uint32 key[2], uint32 out[4][LaneCount])
+	{
+#if defined(COUNTER_RANDOM_AVX2)
+		__m256i c0 = _mm256_loadu_si256((const __m256i*)counters[0]);
+		__m256i c1 = _mm256_loadu_si256((const __m256i*)counters[1]);
+		__m256i c2 = _mm256_loadu_si256((const __m256i*)counters[2]);
+		__m256i c3 = _mm256_loadu_si256((const __m256i*)counters[3]);
+		const __m256i m0 = _mm256_set1_epi32((int)PhiloxM0);
+		const __m256i m1 = _mm256_set1_epi32((int)PhiloxM1);
+		uint32 k0 = key[0], k1 = key[1];
+
+		// 32 x 32 -> 64 bit products of the even and odd lanes, split into hi / lo words.
+		auto mulHiLo = [](__m256i a, __m256i m, __m256i& hi, __m256i& lo)
+		{
+			__m256i even = _mm256_mul_epu32(a, m);
+			__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+			lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+			hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+		};
+
+		for (int r = 0; r < PhiloxRounds; ++r)
+		{
+			__m256i hi0, lo0, hi1, lo1;
+			mulHiLo(c0, m0, hi0, lo0);
+			mulHiLo(c2, m1, hi1, lo1);
+
+			c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32((int)k0));
+			c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32((int)k1));
+			c1 = lo1;
+			c3 = lo0;
+
+			k0 += PhiloxW0;
+			k1 += PhiloxW1;
+		}
+
+		_mm256_storeu_si256((__m256i*)out[0], c0);
+		_mm256_storeu_si256((__m256i*)out[1], c1);
+		_mm256_storeu_si256((__m256i*)out[2], c2);
+		_mm256_storeu_si256((__m256i*)out[3], c3);
+#elif defined(COUNTER_RANDOM_SSE2)
+		const __m128i m0 = _mm_set1_epi32((int)PhiloxM0);
+		const __m128i m1 = _mm_set1_epi32((int)PhiloxM1);
+		const __m128i hiMask = _mm_set_epi32(-1, 0, -1, 0);
+
+		auto mulHiLo = [&](__m128i a, __m128i m, __m128i& hi, __m128i& lo)
+		{
+			__m128i even = _mm_mul_epu32(a, m);
+			__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+			lo = _mm_or_si128(_mm_andnot_si128(hiMask, even), _mm_slli_epi64(odd, 32));
+			hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_and_si128(hiMask, odd));
+		};
+
+		// Counters 0-3 and 4-7 as two independent groups.
+		for (int g = 0; g < 2; ++g)
+		{
+			__m128i c0 = _mm_loadu_si128((const __m128i*)(counters[0] + g * 4));
+			__m128i c1 = _mm_loadu_si128((const __m128i*)(counters[1] + g * 4));
+			__m128i c2 = _mm_loadu_si128((const __m128i*)(counters[2] + g * 4));
+			__m128i c3 = _mm_loadu_si128((const __m128i*)(counters[3] + g * 4));
+			uint32 k0 = key[0], k1 = key[1];
+
+			for (int r = 0; r < PhiloxRounds; ++r)
+			{
+				__m128i hi0, lo0, hi1, lo1;
+				mulHiLo(c0, m0, hi0, lo0);
+				mulHiLo(c2, m1, hi1, lo1);
+
+				c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32((int)k0));
+				c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32((int)k1));
+				c1 = lo1;
+				c3 = lo0;
+
+				k0 += PhiloxW0;
+				k1 += PhiloxW1;
+			}
+
+			_mm_storeu_si128((__m128i*)(out[0] + g * 4), c0);
+			_mm_storeu_si128((__m128i*)(out[1] + g * 4), c1);
+			_mm_storeu_si128((__m128i*)(out[2] + g * 4), c2);
+			_mm_storeu_si128((__m128i*)(out[3] + g * 4), c3);
+		}
+#else
+		for (size_t j = 0; j < LaneCount; ++j)
+		{
+			uint32 counter[4] = { counters[0][j], counters[1][j], counters[2][j], counters[3][j] };
+			uint32 result[4];
+			Philox(counter, key, result);
+			for (int w = 0; w < 4; ++w)
+				out[w][j] = result[w];
+		}
+#endif
+	}
+
+	float BitsToFloat(uint32 bits)
+	{
+		return (float)(bits >> 8) * FloatScale;
+	}
+
+	// In place: bits -> float in [a, b). Same arithmetic as RandomEngine.
+	void BitsToFloats(uint32* data, size_t count, float a, float b)
+	{
+		float scale = (b - a) * FloatScale;
+		size_t i = 0;
+
+#if defined(COUNTER_RANDOM_AVX2) || defined(COUNTER_RANDOM_SSE2)
+		__m128 vScale = _mm_set1_ps(scale);
+		__m128 vOffset = _mm_set1_ps(a);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i bits = _mm_loadu_si128((const __m128i*)(data + i));
+			__m128 f = _mm_cvtepi32_ps(_mm_srli_epi32(bits, 8));
+			f = _mm_add_ps(_mm_mul_ps(f, vScale), vOffset);
+			_mm_storeu_ps((float*)(data + i), f);
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			float f = (float)(data[i] >> 8) * scale + a;
+			std::memcpy(&data[i], &f, sizeof(float));
+		}
+	}
+
+	// out[i] = word (draw % 4) of block (draw / 4) of item firstIndex + i.
+	void FillItemRange(const uint32 key[2], uint64 firstIndex, uint32 draw, uint32* out, size_t count)
+	{
+		uint32 counters[4][LaneCount], result[4][LaneCount];
+		for (size_t j = 0; j < LaneCount; ++j)
+		{
+			counters[0][j] = draw / 4;
+			counters[1][j] = 0;
+		}
+
+		for (size_t first = 0; first < count; first += LaneCount)
+		{
+			for (size_t j = 0; j < LaneCount; ++j)
+			{
+				uint64 index = firstIndex + first + j;
+				counters[2][j] = (uint32)index;
+				counters[3][j] = (uint32)(index >> 32);
+			}
+
+			PhiloxLanes(counters, key, result);
+
+			size_t n = count - first < LaneCount ? count - first : LaneCount;
+			std::memcpy(out + first, result[draw % 4], n * sizeof(uint32));
+		}
+	}
+
+	template<typename Func>
+	void ForEachItemRange(size_t count, ThreadPool* pool, Func&& func)
+	{
+		if (pool == nullptr || count <= FillGrainSize)
+			func(0, count);
+		else
+			pool->ParallelFor(count, FillGrainSize, func);
+	}
+}
+
+CounterRandom::CounterRandom(uint64 seed)
+{
+	mKey[0] = (uint32)seed;
+	mKey[1] = (uint32)(seed >> 32);
+}
+
+void CounterRandom::GenerateBlock(uint64 index, uint64 block, uint32 out[4]) const
+{
+	uint32 counter[4] = { (uint32)block, (uint32)(block >> 32), (uint32)index, (uint32)(index >> 32) };
+	Philox(counter, mKey, out);
+}
+
+CounterRandom::uint32 CounterRandom::UInt(uint64 index, uint32 draw) const
+{
+	uint32 block[4];
+	GenerateBlock(index, draw / 4, block);
+	return block[draw % 4];
+}
+
+float CounterRandom::Float(uint64 index, uint32 draw) const
+{
+	return BitsToFloat(UInt(index, draw));
+}
+
+void CounterRandom::FillUInts(uint64 firstIndex, uint32 draw, uint32* out, size_t count, ThreadPool* pool) const
+{
+	ForEachItemRange(count, pool, [&](size_t begin, size_t end)
+	{
+		FillItemRange(mKey, firstIndex + begin, draw, out + begin, end - begin);
+	});
+}
+
+void CounterRandom::FillFloats(uint64 firstIndex, uint32 draw, float* out, size_t count, float a, float b,
+	ThreadPool* pool) const
+{
+	uint32* bits = reinterpret_cast<uint32*>(out);
+	ForEachItemRange(count, pool, [&](size_t begin, size_t end)
+	{
+		FillItemRange(mKey, firstIndex + begin, draw, bits + begin, end - begin);
+		BitsToFloats(bits + begin, end - begin, a, b);
+	});
+}
+
+void CounterRandom::FillDirections(MathHelper::DirectionDistribution distribution, FXMVECTOR n, uint64 firstIndex,
+	XMFLOAT3* out, size_t count, uint32 firstDraw, ThreadPool* pool) const
+{
+	const size_t chunkSize = 256;
+
+	XMFLOAT3 N;
+	XMStoreFloat3(&N, n);
+
+	ForEachItemRange(count, pool, [&](size_t begin, size_t end)
+	{
+		float u[chunkSize], v[chunkSize];
+		XMFLOAT2 uv[chunkSize];
+
+		for (size_t first = begin; first < end; first += chunkSize)
+		{
+			size_t chunk = end - first < chunkSize ? end - first : chunkSize;
+
+			FillItemRange(mKey, firstIndex + first, firstDraw, reinterpret_cast<uint32*>(u), chunk);
+			FillItemRange(mKey, firstIndex + first, firstDraw + 1, reinterpret_cast<uint32*>(v), chunk);
+			BitsToFloats(reinterpret_cast<uint32*>(u), chunk, 0.0f, 1.0f);
+			BitsToFloats(reinterpret_cast<uint32*>(v), chunk, 0.0f, 1.0f);
+
+			for (size_t i = 0; i < chunk; ++i)
+				uv[i] = XMFLOAT2(u[i], v[i]);
+
+			MathHelper::MapToDirections(distribution, XMLoadFloat3(&N), uv, out + first, chunk);
+		}
+	});
+}
+
+CounterRandom::Stream::Stream(const uint32 key[2], uint64 index)
+	: mIndex(index)
+{
+	mKey[0] = key[0];
+	mKey[1] = key[1];
+}
+
+CounterRandom::uint32 CounterRandom::Stream::NextUInt()
+{
+	if (mBufferPos == 4)
+	{
+		uint32 counter[4] = { (uint32)mNextBlock, (uint32)(mNextBlock >> 32), (uint32)mIndex, (uint32)(mIndex >> 32) };
+		Philox(counter, mKey, mBuffer);
+		++mNextBlock;
+		mBufferPos = 0;
+	}
+
+	return mBuffer[mBufferPos++];
+}
+
+float CounterRandom::Stream::NextFloat()
+{
+	return BitsToFloat(NextUInt());
+}
+
+int CounterRandom::Stream::NextInt(int a, int b)
+{
+	uint32 range = (uint32)b - (uint32)a + 1;
+
+	// [INT_MIN, INT_MAX] wraps to 0: every value is valid.
+	if (range == 0)
+		return (int)NextUInt();
+
+	return (int)((uint32)a + NextBounded(range));
+}
+
+CounterRandom::uint32 CounterRandom::Stream::NextBounded(uint32 range)
+{
+	// Lemire's multiply-shift with rejection of the short interval.
+	uint64 m = (uint64)NextUInt() * range;
+	uint32 low = (uint32)m;
+
+	if (low < range)
+	{
+		uint32 threshold = (0u - range) % range;
+		while (low < threshold)
+		{
+			m = (uint64)NextUInt() * range;
+			low = (uint32)m;
+		}
+	}
+
+	return (uint32)(m >> 32);
+}
+
+void CounterRandom::Stream::FillUInts(uint32* out, size_t count)
+{
+	size_t i = 0;
+
+	// Rest of the current block first, so the sequence matches NextUInt.
+	while (i < count && mBufferPos < 4)
+		out[i++] = mBuffer[mBufferPos++];
+
+	// Whole blocks, 8 counters at a time.
+	uint32 counters[4][LaneCount], result[4][LaneCount];
+	for (size_t j = 0; j < LaneCount; ++j)
+	{
+		counters[2][j] = (uint32)mIndex;
+		counters[3][j] = (uint32)(mIndex >> 32);
+	}
+
+	while (count - i >= 4)
+	{
+		for (size_t j = 0; j < LaneCount; ++j)
+		{
+			uint64 block = mNextBlock + j;
+			counters[0][j] = (uint32)block;
+			counters[1][j] = (uint32)(block >> 32);
+		}
+
+		PhiloxLanes(counters, mKey, result);
+
+		size_t blocks = (count - i) / 4 < LaneCount ? (count - i) / 4 : LaneCount;
+		for (size_t j = 0; j < blocks; ++j, i += 4)
+		{
+			out[i + 0] = result[0][j];
+			out[i + 1] = result[1][j];
+			out[i + 2] = result[2][j];
+			out[i + 3] = result[3][j];
+		}
+		mNextBlock += blocks;
+	}
+
+	while (i < count)
+		out[i++] = NextUInt();
+}
+
+void CounterRandom::Stream::FillFloats(float* out, size_t count, float a, float b)
+{
+	uint32* bits = reinterpret_cast<uint32*>(out);
+	FillUInts(bits, count);
+	BitsToFloats(bits, count, a, b);
+}
@@ -0,0 +1,102 @@
+//***************************************************************************************
+// CounterRandom.h
+//
+// Counter based random numbers (Philox4x32-10, Salmon et al. 2011) for procedural
+// generation that must not depend on thread count or scheduling. There is no hidden
+// state: draw d of work item i is a pure function of (seed, i, d), so work can be split
+// over any number of threads (or regenerated for a single item later) with identical
+// results. Bulk functions evaluate 8 counters per step with AVX2, 2 x 4 with SSE2; the
+// output never depends on the instruction set.
+//
+// Draw d of item i is word d % 4 of the Philox block with counter (d / 4, i).
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include "MathHelper.h"
+
+class ThreadPool;
+
+class CounterRandom
+{
+public:
+
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	///<summary>
+	/// Sequential view of one work item's draws, for code written against the
+	/// RandomEngine style Next functions. Draw k of GetStream(i) is UInt(i, k).
+	///</summary>
+	class Stream
+	{
+	public:
+		uint32 NextUInt();
+
+		// Returns a float in [0, 1) with 24 random bits.
+		float NextFloat();
+
+		// Returns a float in [a, b).
+		float NextFloat(float a, float b) { return a + NextFloat() * (b - a); }
+
+		// Returns an int in [a, b] without modulo bias.
+		int NextInt(int a, int b);
+
+		// Returns a uint in [0, range) without modulo bias.
+		uint32 NextBounded(uint32 range);
+
+		// Same values as count NextUInt / NextFloat calls, 8 blocks at a time.
+		void FillUInts(uint32* out, size_t count);
+		void FillFloats(float* out, size_t count, float a = 0.0f, float b = 1.0f);
+
+		uint64 GetIndex() const { return mIndex; }
+
+	private:
+		friend class CounterRandom;
+		Stream(const uint32 key[2], uint64 index);
+
+		uint32 mKey[2];
+		uint64 mIndex;
+		uint64 mNextBlock = 0;
+		uint32 mBuffer[4] = {};
+		uint32 mBufferPos = 4;
+	};
+
+	explicit CounterRandom(uint64 seed);
+
+	// Philox block for counter (block, index): draws 4 * block .. 4 * block + 3 of item index.
+	void GenerateBlock(uint64 index, uint64 block, uint32 out[4]) const;
+
+	uint32 UInt(uint64 index, uint32 draw = 0) const;
+
+	// Float in [0, 1) with 24 random bits.
+	float Float(uint64 index, uint32 draw = 0) const;
+
+	// Float in [a, b).
+	float Float(uint64 index, uint32 draw, float a, float b) const { return a + Float(index, draw) * (b - a); }
+
+	Stream GetStream(uint64 index) const { return Stream(mKey, index); }
+
+	///<summary>
+	/// out[i] = UInt(firstIndex + i, draw) / Float(firstIndex + i, draw, a, b), e.g. one
+	/// value per instance. Vectorized across items and split over pool; the result is
+	/// the same for any pool size.
+	///</summary>
+	void FillUInts(uint64 firstIndex, uint32 draw, uint32* out, size_t count, ThreadPool* pool = nullptr) const;
+	void FillFloats(uint64 firstIndex, uint32 draw, float* out, size_t count, float a = 0.0f, float b = 1.0f,
+		ThreadPool* pool = nullptr) const;
+
+	///<summary>
+	/// out[i] = direction of item firstIndex + i, mapped from draws (firstDraw, firstDraw + 1)
+	/// with MathHelper::MapToDirections. The deterministic counterpart of
+	/// MathHelper::RandUnitVectors and friends.
+	///</summary>
+	void FillDirections(MathHelper::DirectionDistribution distribution, DirectX::FXMVECTOR n, uint64 firstIndex,
+		DirectX::XMFLOAT3* out, size_t count, uint32 firstDraw = 0, ThreadPool* pool = nullptr) const;
+
+private:
+	uint32 mKey[2];
+};
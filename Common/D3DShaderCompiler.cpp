@@ -0,0 +1,144 @@
+//***************************************************************************************
+// D3DShaderCompiler.cpp
+//***************************************************************************************
+
+#include "D3DShaderCompiler.h"
+#include "AsyncFileIO.h"
+#include "d3dUtil.h"
+#include <algorithm>
+#include <list>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	std::wstring GetDirectory(const std::wstring& filename)
+	{
+		size_t slash = filename.find_last_of(L"/\\");
+		return slash == std::wstring::npos ? std::wstring() : filename.substr(0, slash + 1);
+	}
+
+	void AppendMessages(std::string& errors, ID3DBlob* messages)
+	{
+		if (messages != nullptr)
+			errors.append((const char*)messages->GetBufferPointer(), strnlen((const char*)messages->GetBufferPointer(), messages->GetBufferSize()));
+	}
+
+	// Serves #include files from disk and records them. The compiler identifies the
+	// includer by its data pointer, which maps back to the directory it was read from.
+	class RecordingInclude : public ID3DInclude
+	{
+	public:
+		explicit RecordingInclude(const std::wstring& rootFilename) :
+			mRootDirectory(GetDirectory(rootFilename))
+		{
+		}
+
+		HRESULT STDMETHODCALLTYPE Open(D3D_INCLUDE_TYPE includeType, LPCSTR fileName, LPCVOID parentData,
+			LPCVOID* data, UINT* bytes) override
+		{
+			std::wstring name = AnsiToWString(fileName);
+
+			std::wstring directory = mRootDirectory;
+			for (const File& parent : mFiles)
+			{
+				if (parent.Data.data() == parentData)
+					directory = parent.Directory;
+			}
+
+			AsyncFileIO::Result file = AsyncFileIO::ReadWholeFile(directory + name);
+			if (FAILED(file.Status) && !directory.empty())
+				file = AsyncFileIO::ReadWholeFile(name);
+			if (FAILED(file.Status))
+				return file.Status;
+
+			if (std::find(mIncludes.begin(), mIncludes.end(), file.Filename) == mIncludes.end())
+				mIncludes.push_back(file.Filename);
+
+			// A terminator keeps the data pointer of an empty file unique and non-null.
+			mFiles.emplace_back();
+			mFiles.back().Directory = GetDirectory(file.Filename);
+			mFiles.back().Data = std::move(file.Data);
+			mFiles.back().Data.push_back(0);
+
+			*data = mFiles.back().Data.data();
+			*bytes = (UINT)(mFiles.back().Data.size() - 1);
+			return S_OK;
+		}
+
+		// Files are kept until the handler is destroyed, since they identify includers.
+		HRESULT STDMETHODCALLTYPE Close(LPCVOID data) override
+		{
+			return S_OK;
+		}
+
+		const std::vector<std::wstring>& GetIncludes()const { return mIncludes; }
+
+	private:
+		struct File
+		{
+			std::wstring Directory;
+			std::vector<std::uint8_t> Data;
+		};
+
+		std::wstring mRootDirectory;
+		std::list<File> mFiles;
+		std::vector<std::wstring> mIncludes;
+	};
+}
+
+std::string D3DShaderCompiler::GetIdentity()const
+{
+	return "d3dcompiler_" + std::to_string(D3D_COMPILER_VERSION);
+}
+
+HRESULT D3DShaderCompiler::Preprocess(const Request& request, std::string& source, std::vector<std::wstring>& includes,
+	std::string& errors)
+{
+	AsyncFileIO::Result file = AsyncFileIO::ReadWholeFile(request.Filename);
+	if (FAILED(file.Status))
+	{
+		errors += StringUtil::ToNarrow(request.Filename) + ": error: cannot open file\n";
+		return file.Status;
+	}
+
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const Macro& macro : request.Defines)
+		macros.push_back({ macro.Name.c_str(), macro.Definition.c_str() });
+	macros.push_back({ nullptr, nullptr });
+
+	RecordingInclude include(request.Filename);
+	ComPtr<ID3DBlob> code;
+	ComPtr<ID3DBlob> messages;
+	HRESULT hr = D3DPreprocess(file.Data.data(), file.Data.size(), StringUtil::ToNarrow(request.Filename).c_str(),
+		macros.data(), &include, &code, &messages);
+
+	AppendMessages(errors, messages.Get());
+	includes = include.GetIncludes();
+
+	if (FAILED(hr))
+		return hr;
+
+	const char* text = (const char*)code->GetBufferPointer();
+	source.assign(text, strnlen(text, code->GetBufferSize()));
+	return S_OK;
+}
+
+HRESULT D3DShaderCompiler::Compile(const Request& request, const std::string& source, std::vector<uint8>& bytecode,
+	std::string& errors)
+{
+	// Macros and includes are already expanded in source.
+	ComPtr<ID3DBlob> code;
+	ComPtr<ID3DBlob> messages;
+	HRESULT hr = D3DCompile(source.data(), source.size(), StringUtil::ToNarrow(request.Filename).c_str(), nullptr, nullptr,
+		request.EntryPoint.c_str(), request.Target.c_str(), request.Flags, 0, &code, &messages);
+
+	AppendMessages(errors, messages.Get());
+
+	if (FAILED(hr))
+		return hr;
+
+	const uint8* data = (const uint8*)code->GetBufferPointer();
+	bytecode.assign(data, data + code->GetBufferSize());
+	return S_OK;
+}
@@ -0,0 +1,23 @@
+//***************************************************************************************
+// D3DShaderCompiler.h
+//
+// ShaderCompiler backend over d3dcompiler (D3DPreprocess / D3DCompile). Includes are
+// resolved like D3D_COMPILE_STANDARD_FILE_INCLUDE: relative to the including file's
+// directory, then to the working directory.
+//***************************************************************************************
+
+#pragma once
+
+#include "ShaderCache.h"
+
+class D3DShaderCompiler : public ShaderCompiler
+{
+public:
+	std::string GetIdentity()const override;
+
+	HRESULT Preprocess(const Request& request, std::string& source, std::vector<std::wstring>& includes,
+		std::string& errors) override;
+
+	HRESULT Compile(const Request& request, const std::string& source, std::vector<uint8>& bytecode,
+		std::string& errors) override;
+};
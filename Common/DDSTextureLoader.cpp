@@ -19,9 +19,14 @@
 //--------------------------------------------------------------------------------------
 
 #include <assert.h>
+#include <math.h>
+#include <string.h>
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <string>
 #include <wrl.h>
+#include <DirectXPackedVector.h>
 
 #include "DDSTextureLoader.h" 
 
@@ -73,6 +78,14 @@ struct DDS_PIXELFORMAT
 #define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
 #define DDS_WIDTH  0x00000004 // DDSD_WIDTH
 
+#define DDS_HEADER_FLAGS_TEXTURE        0x00001007  // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
+#define DDS_HEADER_FLAGS_MIPMAP         0x00020000  // DDSD_MIPMAPCOUNT
+#define DDS_HEADER_FLAGS_PITCH          0x00000008  // DDSD_PITCH
+
+#define DDS_SURFACE_FLAGS_TEXTURE 0x00001000 // DDSCAPS_TEXTURE
+#define DDS_SURFACE_FLAGS_MIPMAP  0x00400008 // DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+#define DDS_SURFACE_FLAGS_CUBEMAP 0x00000008 // DDSCAPS_COMPLEX
+
 #define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
 #define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
 #define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
@@ -1937,6 +1950,12 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 		return E_INVALIDARG;
 	}
 
+	// Validate DDS file in memory
+	if (ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
+	{
+		return E_FAIL;
+	}
+
 	uint32_t dwMagicNumber = *(const uint32_t*)(ddsData);
 	if (dwMagicNumber != DDS_MAGIC)
 	{
@@ -2364,4 +2383,392 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
     }
 
     return hr;
+}
+
+//--------------------------------------------------------------------------------------
+static float SRGBToLinear( _In_ float c )
+{
+    return (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+//--------------------------------------------------------------------------------------
+// One row of texels in 'format' to RGBA32F.
+//--------------------------------------------------------------------------------------
+static HRESULT DecodeRow(
+    _In_ DXGI_FORMAT format,
+    _In_reads_bytes_(width * bytesPerPixel) const uint8_t* src,
+    _In_ size_t width,
+    _In_ size_t bytesPerPixel,
+    _Out_writes_(width * 4) float* dst)
+{
+    assert(bytesPerPixel == BitsPerPixel(format) / 8);
+    UNREFERENCED_PARAMETER(bytesPerPixel);
+
+    using namespace DirectX::PackedVector;
+
+    bool srgb = false;
+    switch (format)
+    {
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        memcpy(dst, src, width * 4 * sizeof(float));
+        return S_OK;
+
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        XMConvertHalfToFloatStream(dst, sizeof(float), reinterpret_cast<const HALF*>(src), sizeof(HALF), width * 4);
+        return S_OK;
+
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+        for (size_t i = 0; i < width; ++i)
+        {
+            XMVECTOR c = XMLoadFloat3PK(reinterpret_cast<const XMFLOAT3PK*>(src) + i);
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dst) + i, XMVectorSetW(c, 1.0f));
+        }
+        return S_OK;
+
+    case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+        for (size_t i = 0; i < width; ++i)
+        {
+            XMVECTOR c = XMLoadFloat3SE(reinterpret_cast<const XMFLOAT3SE*>(src) + i);
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dst) + i, XMVectorSetW(c, 1.0f));
+        }
+        return S_OK;
+
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        srgb = true;
+        // fall through
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+        for (size_t i = 0; i < width * 4; ++i)
+            dst[i] = src[i] / 255.0f;
+        break;
+
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        srgb = true;
+        // fall through
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+        for (size_t i = 0; i < width; ++i)
+        {
+            dst[i * 4 + 0] = src[i * 4 + 2] / 255.0f;
+            dst[i * 4 + 1] = src[i * 4 + 1] / 255.0f;
+            dst[i * 4 + 2] = src[i * 4 + 0] / 255.0f;
+            dst[i * 4 + 3] = (format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB) ? src[i * 4 + 3] / 255.0f : 1.0f;
+        }
+        break;
+
+    default:
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    if (srgb)
+    {
+        for (size_t i = 0; i < width; ++i)
+        {
+            dst[i * 4 + 0] = SRGBToLinear(dst[i * 4 + 0]);
+            dst[i * 4 + 1] = SRGBToLinear(dst[i * 4 + 1]);
+            dst[i * 4 + 2] = SRGBToLinear(dst[i * 4 + 2]);
+        }
+    }
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::LoadDDSCubeMapFromFile(const wchar_t* szFileName,
+    std::vector<float>& texels,
+    size_t* faceSize)
+{
+    texels.clear();
+
+    if (!szFileName || !faceSize)
+    {
+        return E_INVALIDARG;
+    }
+    *faceSize = 0;
+
+    DDS_HEADER* header = nullptr;
+    uint8_t* bitData = nullptr;
+    size_t bitSize = 0;
+
+    std::unique_ptr<uint8_t[]> ddsData;
+    HRESULT hr = LoadTextureDataFromFile(szFileName, ddsData, &header, &bitData, &bitSize);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    if ((header->ddspf.flags & DDS_FOURCC) && (MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC))
+    {
+        auto d3d10ext = reinterpret_cast<const DDS_HEADER_DXT10*>((const char*)header + sizeof(DDS_HEADER));
+
+        if (d3d10ext->resourceDimension != D3D11_RESOURCE_DIMENSION_TEXTURE2D ||
+            !(d3d10ext->miscFlag & D3D11_RESOURCE_MISC_TEXTURECUBE) ||
+            d3d10ext->arraySize == 0)
+        {
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        format = d3d10ext->dxgiFormat;
+    }
+    else
+    {
+        if ((header->flags & DDS_HEADER_FLAGS_VOLUME) ||
+            (header->caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+        {
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        format = GetDXGIFormat(header->ddspf);
+    }
+
+    if (BitsPerPixel(format) == 0 || header->width != header->height || header->width == 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    size_t mipCount = header->mipMapCount;
+    if (0 == mipCount) mipCount = 1;
+    if (mipCount > D3D12_REQ_MIP_LEVELS)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    // Faces are stored one after another, each with its whole mip chain.
+    size_t size = header->width;
+    size_t faceBytes = 0;
+    size_t rowBytes = 0;
+    for (size_t mip = 0, w = size; mip < mipCount; ++mip, w = std::max<size_t>(w / 2, 1))
+    {
+        size_t numBytes = 0;
+        GetSurfaceInfo(w, w, format, &numBytes, mip == 0 ? &rowBytes : nullptr, nullptr);
+        faceBytes += numBytes;
+    }
+
+    if (faceBytes * 6 > bitSize || rowBytes < size * BitsPerPixel(format) / 8)
+    {
+        return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+    }
+
+    texels.resize(6 * size * size * 4);
+    for (size_t face = 0; face < 6; ++face)
+    {
+        for (size_t row = 0; row < size; ++row)
+        {
+            hr = DecodeRow(format, bitData + face * faceBytes + row * rowBytes, size, BitsPerPixel(format) / 8,
+                texels.data() + (face * size + row) * size * 4);
+            if (FAILED(hr))
+            {
+                texels.clear();
+                return hr;
+            }
+        }
+    }
+
+    *faceSize = size;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static size_t GetTextureDataSize(DXGI_FORMAT format, size_t width, size_t height, size_t mipCount, bool isCubeMap)
+{
+    size_t dataSize = 0;
+    for (size_t mip = 0, w = width, h = height; mip < mipCount; ++mip, w = std::max<size_t>(w / 2, 1), h = std::max<size_t>(h / 2, 1))
+    {
+        size_t numBytes = 0;
+        GetSurfaceInfo(w, h, format, &numBytes, nullptr, nullptr);
+        dataSize += numBytes;
+    }
+    return isCubeMap ? dataSize * 6 : dataSize;
+}
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::SaveDDSTextureToFile(const wchar_t* szFileName,
+    DXGI_FORMAT format,
+    size_t width,
+    size_t height,
+    size_t mipCount,
+    bool isCubeMap,
+    const uint8_t* data,
+    size_t dataSize)
+{
+    if (!szFileName || !data || width == 0 || height == 0 || mipCount == 0 || mipCount > D3D12_REQ_MIP_LEVELS)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (BitsPerPixel(format) == 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    size_t rowBytes = 0;
+    GetSurfaceInfo(width, height, format, nullptr, &rowBytes, nullptr);
+
+    if (dataSize != GetTextureDataSize(format, width, height, mipCount, isCubeMap))
+    {
+        return E_INVALIDARG;
+    }
+
+    // Single WriteFile below, like the single ReadFile of the loader.
+    if (dataSize > 0xffffffff)
+    {
+        return E_FAIL;
+    }
+
+    // Always a DX10 header: it carries the DXGI format directly.
+    uint8_t fileHeader[sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10)] = {};
+    *reinterpret_cast<uint32_t*>(fileHeader) = DDS_MAGIC;
+
+    auto header = reinterpret_cast<DDS_HEADER*>(fileHeader + sizeof(uint32_t));
+    header->size = sizeof(DDS_HEADER);
+    header->flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_PITCH | (mipCount > 1 ? DDS_HEADER_FLAGS_MIPMAP : 0);
+    header->width = static_cast<uint32_t>(width);
+    header->height = static_cast<uint32_t>(height);
+    header->pitchOrLinearSize = static_cast<uint32_t>(rowBytes);
+    header->mipMapCount = static_cast<uint32_t>(mipCount);
+    header->ddspf.size = sizeof(DDS_PIXELFORMAT);
+    header->ddspf.flags = DDS_FOURCC;
+    header->ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+    header->caps = DDS_SURFACE_FLAGS_TEXTURE | (mipCount > 1 ? DDS_SURFACE_FLAGS_MIPMAP : 0) | (isCubeMap ? DDS_SURFACE_FLAGS_CUBEMAP : 0);
+    header->caps2 = isCubeMap ? DDS_CUBEMAP_ALLFACES : 0;
+
+    auto ext = reinterpret_cast<DDS_HEADER_DXT10*>(fileHeader + sizeof(uint32_t) + sizeof(DDS_HEADER));
+    ext->dxgiFormat = format;
+    ext->resourceDimension = D3D11_RESOURCE_DIMENSION_TEXTURE2D;
+    ext->miscFlag = isCubeMap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+    ext->arraySize = 1;
+
+    // Write a private file and move it into place, so a failed or interrupted save
+    // never leaves a partial texture under szFileName.
+    // The counter keeps concurrent saves of one file within a process apart.
+    static std::atomic<uint32_t> tempCounter{ 0 };
+    std::wstring tempFileName = std::wstring(szFileName) + L"." + std::to_wstring(GetCurrentProcessId()) +
+        L"." + std::to_wstring(tempCounter++) + L".tmp";
+
+    {
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+        ScopedHandle hFile(safe_handle(CreateFile2(tempFileName.c_str(),
+            GENERIC_WRITE,
+            0,
+            CREATE_ALWAYS,
+            nullptr)));
+#else
+        ScopedHandle hFile(safe_handle(CreateFileW(tempFileName.c_str(),
+            GENERIC_WRITE,
+            0,
+            nullptr,
+            CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr)));
+#endif
+
+        if (!hFile)
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        DWORD bytesWritten = 0;
+        if (!WriteFile(hFile.get(), fileHeader, sizeof(fileHeader), &bytesWritten, nullptr) ||
+            bytesWritten != sizeof(fileHeader) ||
+            !WriteFile(hFile.get(), data, static_cast<DWORD>(dataSize), &bytesWritten, nullptr) ||
+            bytesWritten != dataSize)
+        {
+            HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+            hFile.reset();
+            DeleteFileW(tempFileName.c_str());
+            return FAILED(hr) ? hr : E_FAIL;
+        }
+    }
+
+    if (!MoveFileExW(tempFileName.c_str(), szFileName, MOVEFILE_REPLACE_EXISTING))
+    {
+        HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        DeleteFileW(tempFileName.c_str());
+        return hr;
+    }
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::CheckDDSTextureFile(const wchar_t* szFileName,
+    DXGI_FORMAT format,
+    size_t width,
+    size_t height,
+    size_t mipCount,
+    bool isCubeMap)
+{
+    if (!szFileName || width == 0 || height == 0 || mipCount == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (BitsPerPixel(format) == 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile(safe_handle(CreateFile2(szFileName,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        OPEN_EXISTING,
+        nullptr)));
+#else
+    ScopedHandle hFile(safe_handle(CreateFileW(szFileName,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr)));
+#endif
+
+    if (!hFile)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(hFile.get(), &fileSize))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    uint8_t fileHeader[sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10)] = {};
+    DWORD bytesRead = 0;
+    if (!ReadFile(hFile.get(), fileHeader, sizeof(fileHeader), &bytesRead, nullptr) ||
+        bytesRead != sizeof(fileHeader))
+    {
+        return E_FAIL;
+    }
+
+    auto header = reinterpret_cast<const DDS_HEADER*>(fileHeader + sizeof(uint32_t));
+    auto ext = reinterpret_cast<const DDS_HEADER_DXT10*>(fileHeader + sizeof(uint32_t) + sizeof(DDS_HEADER));
+
+    if (*reinterpret_cast<const uint32_t*>(fileHeader) != DDS_MAGIC ||
+        header->size != sizeof(DDS_HEADER) ||
+        !(header->ddspf.flags & DDS_FOURCC) ||
+        header->ddspf.fourCC != MAKEFOURCC('D', 'X', '1', '0') ||
+        header->width != width ||
+        header->height != height ||
+        std::max<uint32_t>(header->mipMapCount, 1) != mipCount ||
+        ext->dxgiFormat != format ||
+        ext->resourceDimension != D3D11_RESOURCE_DIMENSION_TEXTURE2D ||
+        ext->arraySize != 1 ||
+        ((ext->miscFlag & D3D11_RESOURCE_MISC_TEXTURECUBE) != 0) != isCubeMap)
+    {
+        return E_FAIL;
+    }
+
+    if (static_cast<uint64_t>(fileSize.QuadPart) != sizeof(fileHeader) + GetTextureDataSize(format, width, height, mipCount, isCubeMap))
+    {
+        return E_FAIL;
+    }
+
+    return S_OK;
 }
\ No newline at end of file
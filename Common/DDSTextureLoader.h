@@ -24,6 +24,7 @@
 
 #include <wrl.h>
 #include <d3d11_1.h>
+#include <vector>
 #include "d3dx12.h"
 
 #pragma warning(push)
@@ -169,4 +170,35 @@ namespace DirectX
                                         _Outptr_opt_ ID3D11ShaderResourceView** textureView,
                                         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
                                     );
+
+	// CPU side decode of a cubemap's top mip level (the first cube of an array) into
+	// linear RGBA32F texels, face by face in D3D order (+X, -X, +Y, -Y, +Z, -Z), rows top
+	// to bottom. Uncompressed float, half, packed float and 8 bit UNORM formats only;
+	// block compressed files return ERROR_NOT_SUPPORTED.
+	HRESULT LoadDDSCubeMapFromFile(_In_z_ const wchar_t* szFileName,
+		                           _Out_ std::vector<float>& texels,
+		                           _Out_ size_t* faceSize
+		                           );
+
+	// Writes a 2D texture or cubemap with a DX10 header. data holds the surfaces in DDS
+	// order (for each face, its mips from largest to smallest), rows tightly packed.
+	HRESULT SaveDDSTextureToFile(_In_z_ const wchar_t* szFileName,
+		                         _In_ DXGI_FORMAT format,
+		                         _In_ size_t width,
+		                         _In_ size_t height,
+		                         _In_ size_t mipCount,
+		                         _In_ bool isCubeMap,
+		                         _In_reads_bytes_(dataSize) const uint8_t* data,
+		                         _In_ size_t dataSize
+		                         );
+
+	// S_OK if the file is a complete texture as SaveDDSTextureToFile writes it with these
+	// parameters: DX10 header matches and the file holds exactly the expected data.
+	HRESULT CheckDDSTextureFile(_In_z_ const wchar_t* szFileName,
+		                        _In_ DXGI_FORMAT format,
+		                        _In_ size_t width,
+		                        _In_ size_t height,
+		                        _In_ size_t mipCount,
+		                        _In_ bool isCubeMap
+		                        );
 }
\ No newline at end of file
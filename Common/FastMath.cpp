@@ -0,0 +1,495 @@
+//***************************************************************************************
+// FastMath.cpp
+//***************************************************************************************
+
+#include "FastMath.h"
+#include "RandomEngine.h"
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <vector>
+// The AVX2 kernels use FMA too. GCC and clang enable it separately (-mfma);
+// MSVC's /arch:AVX2 implies it without defining __FMA__.
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define FAST_MATH_AVX2
+#endif
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FAST_MATH_SSE2
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	const float PiOver2 = 1.57079632679489661923f;
+	const float PiOver4 = 0.78539816339744830962f;
+	const float Pi = 3.14159265358979323846f;
+
+#if defined(FAST_MATH_SSE2)
+	// The kernels below are written once against this small set of overloads and
+	// instantiated for __m128 (4 lanes) and, with AVX2, __m256 (8 lanes).
+
+	template<typename V> struct LaneTraits;
+
+	template<> struct LaneTraits<__m128>
+	{
+		using Int = __m128i;
+		static const int Count = 4;
+	};
+
+	template<typename V> V Splat(float f);
+	template<typename V> typename LaneTraits<V>::Int SplatInt(int i);
+
+	template<> inline __m128 Splat<__m128>(float f) { return _mm_set1_ps(f); }
+	template<> inline __m128i SplatInt<__m128>(int i) { return _mm_set1_epi32(i); }
+
+	inline __m128 Add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+	inline __m128 Sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+	inline __m128 Mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+	inline __m128 Div(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+	inline __m128 MulAdd(__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	inline __m128 Sqrt(__m128 a) { return _mm_sqrt_ps(a); }
+	inline __m128 Min(__m128 a, __m128 b) { return _mm_min_ps(a, b); }
+	inline __m128 Max(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+	inline __m128 And(__m128 a, __m128 b) { return _mm_and_ps(a, b); }
+	inline __m128 Or(__m128 a, __m128 b) { return _mm_or_ps(a, b); }
+	inline __m128 Xor(__m128 a, __m128 b) { return _mm_xor_ps(a, b); }
+	inline __m128 Less(__m128 a, __m128 b) { return _mm_cmplt_ps(a, b); }
+	inline __m128 Greater(__m128 a, __m128 b) { return _mm_cmpgt_ps(a, b); }
+	inline __m128 Equal(__m128 a, __m128 b) { return _mm_cmpeq_ps(a, b); }
+	inline __m128 Unordered(__m128 a, __m128 b) { return _mm_cmpunord_ps(a, b); }
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+	inline __m128i RoundToInt(__m128 a) { return _mm_cvtps_epi32(a); }
+	inline __m128 ToFloat(__m128i a) { return _mm_cvtepi32_ps(a); }
+	inline __m128i AsInt(__m128 a) { return _mm_castps_si128(a); }
+	inline __m128 AsFloat(__m128i a) { return _mm_castsi128_ps(a); }
+	inline __m128i AddInt(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+	inline __m128i SubInt(__m128i a, __m128i b) { return _mm_sub_epi32(a, b); }
+	inline __m128i AndInt(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+	inline __m128i OrInt(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+	template<int N> inline __m128i ShiftLeft(__m128i a) { return _mm_slli_epi32(a, N); }
+	template<int N> inline __m128i ShiftRight(__m128i a) { return _mm_srli_epi32(a, N); }
+
+	inline __m128 Load(const float* p, __m128) { return _mm_loadu_ps(p); }
+	inline void Store(float* p, __m128 a) { _mm_storeu_ps(p, a); }
+
+#if defined(FAST_MATH_AVX2)
+	template<> struct LaneTraits<__m256>
+	{
+		using Int = __m256i;
+		static const int Count = 8;
+	};
+
+	template<> inline __m256 Splat<__m256>(float f) { return _mm256_set1_ps(f); }
+	template<> inline __m256i SplatInt<__m256>(int i) { return _mm256_set1_epi32(i); }
+
+	inline __m256 Add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+	inline __m256 Sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+	inline __m256 Mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+	inline __m256 Div(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+	inline __m256 MulAdd(__m256 a, __m256 b, __m256 c) { return _mm256_fmadd_ps(a, b, c); }
+	inline __m256 Sqrt(__m256 a) { return _mm256_sqrt_ps(a); }
+	inline __m256 Min(__m256 a, __m256 b) { return _mm256_min_ps(a, b); }
+	inline __m256 Max(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+	inline __m256 And(__m256 a, __m256 b) { return _mm256_and_ps(a, b); }
+	inline __m256 Or(__m256 a, __m256 b) { return _mm256_or_ps(a, b); }
+	inline __m256 Xor(__m256 a, __m256 b) { return _mm256_xor_ps(a, b); }
+	inline __m256 Less(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline __m256 Greater(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	inline __m256 Equal(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+	inline __m256 Unordered(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_UNORD_Q); }
+	inline __m256 Select(__m256 mask, __m256 a, __m256 b) { return _mm256_blendv_ps(b, a, mask); }
+
+	inline __m256i RoundToInt(__m256 a) { return _mm256_cvtps_epi32(a); }
+	inline __m256 ToFloat(__m256i a) { return _mm256_cvtepi32_ps(a); }
+	inline __m256i AsInt(__m256 a) { return _mm256_castps_si256(a); }
+	inline __m256 AsFloat(__m256i a) { return _mm256_castsi256_ps(a); }
+	inline __m256i AddInt(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+	inline __m256i SubInt(__m256i a, __m256i b) { return _mm256_sub_epi32(a, b); }
+	inline __m256i AndInt(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+	inline __m256i OrInt(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+	template<int N> inline __m256i ShiftLeft(__m256i a) { return _mm256_slli_epi32(a, N); }
+	template<int N> inline __m256i ShiftRight(__m256i a) { return _mm256_srli_epi32(a, N); }
+
+	inline __m256 Load(const float* p, __m256) { return _mm256_loadu_ps(p); }
+	inline void Store(float* p, __m256 a) { _mm256_storeu_ps(p, a); }
+
+	using Wide = __m256;
+#else
+	using Wide = __m128;
+#endif
+
+	template<typename V>
+	V Abs(V a)
+	{
+		return AsFloat(AndInt(AsInt(a), SplatInt<V>(0x7fffffff)));
+	}
+
+	template<typename V>
+	V SignBit(V a)
+	{
+		return AsFloat(AndInt(AsInt(a), SplatInt<V>((int)0x80000000)));
+	}
+
+	template<typename V>
+	void SinCosKernel(V x, V& sinOut, V& cosOut)
+	{
+		// x = q * pi/2 + r with |r| <= pi/4; pi/2 split in three parts so q * part is exact.
+		typename LaneTraits<V>::Int q = RoundToInt(Mul(x, Splat<V>(0.63661977236758134f)));
+		V qf = ToFloat(q);
+
+		V r = MulAdd(qf, Splat<V>(-1.5703125f), x);
+		r = MulAdd(qf, Splat<V>(-4.837512969970703125e-4f), r);
+		r = MulAdd(qf, Splat<V>(-7.54978995489188216e-8f), r);
+
+		V r2 = Mul(r, r);
+
+		V s = MulAdd(Splat<V>(-1.9515295891e-4f), r2, Splat<V>(8.3321608736e-3f));
+		s = MulAdd(s, r2, Splat<V>(-1.6666654611e-1f));
+		s = MulAdd(Mul(s, r2), r, r);
+
+		V c = MulAdd(Splat<V>(2.443315711809948e-5f), r2, Splat<V>(-1.388731625493765e-3f));
+		c = MulAdd(c, r2, Splat<V>(4.166664568298827e-2f));
+		c = MulAdd(Mul(c, r2), r2, MulAdd(Splat<V>(-0.5f), r2, Splat<V>(1.0f)));
+
+		// Odd quadrants swap sin and cos; quadrants 2, 3 negate sin and 1, 2 negate cos.
+		V swap = AsFloat(SubInt(SplatInt<V>(0), AndInt(q, SplatInt<V>(1))));
+		V sinSign = AsFloat(ShiftLeft<30>(AndInt(q, SplatInt<V>(2))));
+		V cosSign = AsFloat(ShiftLeft<30>(AndInt(AddInt(q, SplatInt<V>(1)), SplatInt<V>(2))));
+
+		sinOut = Xor(Select(swap, c, s), sinSign);
+		cosOut = Xor(Select(swap, s, c), cosSign);
+	}
+
+	template<typename V>
+	V Atan2Kernel(V y, V x)
+	{
+		V ax = Abs(x);
+		V ay = Abs(y);
+
+		// atan of min / max in [0, 1], then fold back.
+		V swap = Greater(ay, ax);
+		V num = Min(ax, ay);
+		V den = Max(ax, ay);
+		V t = Div(num, den);
+		t = Select(Equal(den, Splat<V>(0.0f)), Splat<V>(0.0f), t);
+
+		// Above tan(pi/8) use atan(t) = pi/4 + atan((t - 1) / (t + 1)).
+		V big = Greater(t, Splat<V>(0.41421356237309504880f));
+		t = Select(big, Div(Sub(t, Splat<V>(1.0f)), Add(t, Splat<V>(1.0f))), t);
+		V base = And(big, Splat<V>(PiOver4));
+
+		V z = Mul(t, t);
+		V p = MulAdd(Splat<V>(8.05374449538e-2f), z, Splat<V>(-1.38776856032e-1f));
+		p = MulAdd(p, z, Splat<V>(1.99777106478e-1f));
+		p = MulAdd(p, z, Splat<V>(-3.33329491539e-1f));
+		V a = Add(base, MulAdd(Mul(p, z), t, t));
+
+		// The sign of x, not x < 0, picks the left half plane, so atan2(+-0, -0) = +-pi.
+		V negativeX = Less(Or(SignBit(x), Splat<V>(1.0f)), Splat<V>(0.0f));
+		a = Select(swap, Sub(Splat<V>(PiOver2), a), a);
+		a = Select(negativeX, Sub(Splat<V>(Pi), a), a);
+		return Xor(a, SignBit(y));
+	}
+
+	template<typename V>
+	V ACosKernel(V x)
+	{
+		V a = Abs(x);
+
+		// asin(s) = s + s * z * P(z); above 0.5 use acos(a) = 2 asin(sqrt((1 - a) / 2)).
+		V big = Greater(a, Splat<V>(0.5f));
+		V z = Select(big, Mul(Splat<V>(0.5f), Sub(Splat<V>(1.0f), a)), Mul(a, a));
+		V s = Select(big, Sqrt(z), a);
+
+		V p = MulAdd(Splat<V>(4.2163199048e-2f), z, Splat<V>(2.4181311049e-2f));
+		p = MulAdd(p, z, Splat<V>(4.5470025998e-2f));
+		p = MulAdd(p, z, Splat<V>(7.4953002686e-2f));
+		p = MulAdd(p, z, Splat<V>(1.6666752422e-1f));
+		V asinS = MulAdd(Mul(p, z), s, s);
+
+		V result = Select(big, Add(asinS, asinS), Sub(Splat<V>(PiOver2), asinS));
+		return Select(Less(x, Splat<V>(0.0f)), Sub(Splat<V>(Pi), result), result);
+	}
+
+	template<typename V>
+	V ExpKernel(V x)
+	{
+		// The upper clamp keeps 2^n a normal float (n <= 127).
+		x = Min(Max(x, Splat<V>(-87.33654f)), Splat<V>(88.37626f));
+
+		// x = n ln2 + r
+		typename LaneTraits<V>::Int n = RoundToInt(Mul(x, Splat<V>(1.44269504088896341f)));
+		V nf = ToFloat(n);
+		V r = MulAdd(nf, Splat<V>(-0.693359375f), x);
+		r = MulAdd(nf, Splat<V>(2.12194440e-4f), r);
+
+		V p = MulAdd(Splat<V>(1.9875691500e-4f), r, Splat<V>(1.3981999507e-3f));
+		p = MulAdd(p, r, Splat<V>(8.3334519073e-3f));
+		p = MulAdd(p, r, Splat<V>(4.1665795894e-2f));
+		p = MulAdd(p, r, Splat<V>(1.6666665459e-1f));
+		p = MulAdd(p, r, Splat<V>(5.0000001201e-1f));
+		p = MulAdd(Mul(p, r), r, Add(r, Splat<V>(1.0f)));
+
+		V scale = AsFloat(ShiftLeft<23>(AddInt(n, SplatInt<V>(127))));
+		return Mul(p, scale);
+	}
+
+	template<typename V>
+	V LogKernel(V x)
+	{
+		V invalid = Or(Less(x, Splat<V>(0.0f)), Unordered(x, x));
+		V zero = Equal(x, Splat<V>(0.0f));
+		V infinite = Equal(x, Splat<V>(std::numeric_limits<float>::infinity()));
+
+		// x = m 2^e with m in [sqrt(1/2), sqrt(2)); denormals are treated as the smallest normal.
+		typename LaneTraits<V>::Int bits = AsInt(Max(x, Splat<V>(FLT_MIN)));
+		V e = ToFloat(SubInt(ShiftRight<23>(bits), SplatInt<V>(126)));
+		V m = AsFloat(OrInt(AndInt(bits, SplatInt<V>(0x007fffff)), SplatInt<V>(0x3f000000)));
+
+		V small = Less(m, Splat<V>(0.707106781186547524f));
+		e = Sub(e, And(small, Splat<V>(1.0f)));
+		m = Sub(Add(m, And(small, m)), Splat<V>(1.0f));
+
+		V z = Mul(m, m);
+		V p = MulAdd(Splat<V>(7.0376836292e-2f), m, Splat<V>(-1.1514610310e-1f));
+		p = MulAdd(p, m, Splat<V>(1.1676998740e-1f));
+		p = MulAdd(p, m, Splat<V>(-1.2420140846e-1f));
+		p = MulAdd(p, m, Splat<V>(1.4249322787e-1f));
+		p = MulAdd(p, m, Splat<V>(-1.6668057665e-1f));
+		p = MulAdd(p, m, Splat<V>(2.0000714765e-1f));
+		p = MulAdd(p, m, Splat<V>(-2.4999993993e-1f));
+		p = MulAdd(p, m, Splat<V>(3.3333331174e-1f));
+
+		V y = Mul(Mul(p, m), z);
+		y = MulAdd(e, Splat<V>(-2.12194440e-4f), y);
+		y = MulAdd(z, Splat<V>(-0.5f), y);
+		V result = MulAdd(e, Splat<V>(0.693359375f), Add(m, y));
+
+		result = Select(infinite, x, result);
+		result = Select(zero, Splat<V>(-std::numeric_limits<float>::infinity()), result);
+		return Or(result, invalid); // NaN
+	}
+
+	// Runs kernel over [0, count): full Wide steps, then the tail padded with pad.
+	template<typename Kernel>
+	void ForEachUnary(const float* in, float* out, size_t count, float pad, Kernel kernel)
+	{
+		const int lanes = LaneTraits<Wide>::Count;
+		size_t i = 0;
+		for (; i + lanes <= count; i += lanes)
+			Store(out + i, kernel(Load(in + i, Wide())));
+
+		if (i < count)
+		{
+			float tmp[lanes];
+			for (int k = 0; k < lanes; ++k)
+				tmp[k] = i + k < count ? in[i + k] : pad;
+
+			Store(tmp, kernel(Load(tmp, Wide())));
+			for (size_t k = 0; i + k < count; ++k)
+				out[i + k] = tmp[k];
+		}
+	}
+#endif
+}
+
+void FastMath::SinCos(FXMVECTOR x, XMVECTOR* sin, XMVECTOR* cos)
+{
+#if defined(FAST_MATH_SSE2)
+	__m128 s, c;
+	SinCosKernel<__m128>(x, s, c);
+	*sin = s;
+	*cos = c;
+#else
+	XMVectorSinCos(sin, cos, x);
+#endif
+}
+
+XMVECTOR FastMath::Atan2(FXMVECTOR y, FXMVECTOR x)
+{
+#if defined(FAST_MATH_SSE2)
+	return Atan2Kernel<__m128>(y, x);
+#else
+	return XMVectorATan2(y, x);
+#endif
+}
+
+XMVECTOR FastMath::ACos(FXMVECTOR x)
+{
+#if defined(FAST_MATH_SSE2)
+	return ACosKernel<__m128>(x);
+#else
+	return XMVectorACos(x);
+#endif
+}
+
+XMVECTOR FastMath::Exp(FXMVECTOR x)
+{
+#if defined(FAST_MATH_SSE2)
+	return ExpKernel<__m128>(x);
+#else
+	return XMVectorExpE(x);
+#endif
+}
+
+XMVECTOR FastMath::Log(FXMVECTOR x)
+{
+#if defined(FAST_MATH_SSE2)
+	return LogKernel<__m128>(x);
+#else
+	return XMVectorLogE(x);
+#endif
+}
+
+void FastMath::SinCos(const float* x, float* sin, float* cos, size_t count)
+{
+#if defined(FAST_MATH_SSE2)
+	const int lanes = LaneTraits<Wide>::Count;
+	float tmpX[lanes], tmpS[lanes], tmpC[lanes];
+
+	for (size_t i = 0; i < count; i += lanes)
+	{
+		size_t n = count - i < (size_t)lanes ? count - i : lanes;
+		const float* src = x + i;
+		if (n < (size_t)lanes)
+		{
+			for (int k = 0; k < lanes; ++k)
+				tmpX[k] = (size_t)k < n ? x[i + k] : 0.0f;
+			src = tmpX;
+		}
+
+		Wide s, c;
+		SinCosKernel<Wide>(Load(src, Wide()), s, c);
+		Store(tmpS, s);
+		Store(tmpC, c);
+
+		for (size_t k = 0; k < n; ++k)
+		{
+			if (sin)
+				sin[i + k] = tmpS[k];
+			if (cos)
+				cos[i + k] = tmpC[k];
+		}
+	}
+#else
+	for (size_t i = 0; i < count; ++i)
+	{
+		float s = sinf(x[i]), c = cosf(x[i]);
+		if (sin)
+			sin[i] = s;
+		if (cos)
+			cos[i] = c;
+	}
+#endif
+}
+
+void FastMath::Atan2(const float* y, const float* x, float* out, size_t count)
+{
+#if defined(FAST_MATH_SSE2)
+	const int lanes = LaneTraits<Wide>::Count;
+	size_t i = 0;
+	for (; i + lanes <= count; i += lanes)
+		Store(out + i, Atan2Kernel<Wide>(Load(y + i, Wide()), Load(x + i, Wide())));
+
+	for (; i < count; i += 4)
+	{
+		float ty[4] = {}, tx[4] = {}, to[4];
+		size_t n = count - i < 4 ? count - i : 4;
+		for (size_t k = 0; k < n; ++k)
+		{
+			ty[k] = y[i + k];
+			tx[k] = x[i + k];
+		}
+
+		_mm_storeu_ps(to, Atan2Kernel<__m128>(_mm_loadu_ps(ty), _mm_loadu_ps(tx)));
+		for (size_t k = 0; k < n; ++k)
+			out[i + k] = to[k];
+	}
+#else
+	for (size_t i = 0; i < count; ++i)
+		out[i] = atan2f(y[i], x[i]);
+#endif
+}
+
+void FastMath::ACos(const float* x, float* out, size_t count)
+{
+#if defined(FAST_MATH_SSE2)
+	ForEachUnary(x, out, count, 0.0f, [](Wide v) { return ACosKernel<Wide>(v); });
+#else
+	for (size_t i = 0; i < count; ++i)
+		out[i] = acosf(x[i]);
+#endif
+}
+
+void FastMath::Exp(const float* x, float* out, size_t count)
+{
+#if defined(FAST_MATH_SSE2)
+	ForEachUnary(x, out, count, 0.0f, [](Wide v) { return ExpKernel<Wide>(v); });
+#else
+	for (size_t i = 0; i < count; ++i)
+		out[i] = expf(x[i]);
+#endif
+}
+
+void FastMath::Log(const float* x, float* out, size_t count)
+{
+#if defined(FAST_MATH_SSE2)
+	ForEachUnary(x, out, count, 1.0f, [](Wide v) { return LogKernel<Wide>(v); });
+#else
+	for (size_t i = 0; i < count; ++i)
+		out[i] = logf(x[i]);
+#endif
+}
+
+FastMath::ErrorReport FastMath::MeasureMaxError(size_t sampleCount)
+{
+	RandomEngine engine(1);
+	std::vector<float> a(sampleCount), b(sampleCount), r0(sampleCount), r1(sampleCount);
+
+	ErrorReport report;
+
+	engine.FillFloats(a.data(), sampleCount, -1000.0f, 1000.0f);
+	SinCos(a.data(), r0.data(), r1.data(), sampleCount);
+	for (size_t i = 0; i < sampleCount; ++i)
+	{
+		report.SinCos = fmax(report.SinCos, fabs(r0[i] - sin((double)a[i])));
+		report.SinCos = fmax(report.SinCos, fabs(r1[i] - cos((double)a[i])));
+	}
+
+	engine.FillFloats(a.data(), sampleCount, -10.0f, 10.0f);
+	engine.FillFloats(b.data(), sampleCount, -10.0f, 10.0f);
+	Atan2(a.data(), b.data(), r0.data(), sampleCount);
+	for (size_t i = 0; i < sampleCount; ++i)
+		report.Atan2 = fmax(report.Atan2, fabs(r0[i] - atan2((double)a[i], (double)b[i])));
+
+	engine.FillFloats(a.data(), sampleCount, -1.0f, 1.0f);
+	ACos(a.data(), r0.data(), sampleCount);
+	for (size_t i = 0; i < sampleCount; ++i)
+		report.ACos = fmax(report.ACos, fabs(r0[i] - acos((double)a[i])));
+
+	engine.FillFloats(a.data(), sampleCount, -87.3f, 88.3f);
+	Exp(a.data(), r0.data(), sampleCount);
+	for (size_t i = 0; i < sampleCount; ++i)
+	{
+		double exact = exp((double)a[i]);
+		report.ExpRelative = fmax(report.ExpRelative, fabs(r0[i] - exact) / exact);
+	}
+
+	// Log over the whole positive float range: exponents spread uniformly.
+	engine.FillFloats(b.data(), sampleCount, -87.0f, 88.0f);
+	for (size_t i = 0; i < sampleCount; ++i)
+		a[i] = expf(b[i]);
+	Log(a.data(), r0.data(), sampleCount);
+	for (size_t i = 0; i < sampleCount; ++i)
+	{
+		double exact = log((double)a[i]);
+		double error = fabs(r0[i] - exact);
+		report.Log = fmax(report.Log, fabs(exact) > 1.0 ? error / fabs(exact) : error);
+	}
+
+	return report;
+}
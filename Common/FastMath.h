@@ -0,0 +1,52 @@
+//***************************************************************************************
+// FastMath.h
+//
+// Vectorized approximations of sincos, atan2, acos, exp and log for bulk work (mesh
+// generation, sampling, baking). The XMVECTOR versions evaluate 4 lanes; the array
+// versions evaluate 8 lanes per step with AVX2 and two 4 lane groups otherwise.
+// All are branch free (Cephes style range reduction + minimax polynomial).
+//
+// Max error measured with MeasureMaxError() against double precision libm:
+//   SinCos  |x| <= 1000       abs 9.2e-8 (grows with |x| after the reduction)
+//   Atan2   all finite        abs 2.8e-7 rad, result in [-pi, pi]; signed zeros as in
+//                             atan2 (atan2(+-0, -0) = +-pi)
+//   ACos    [-1, 1]           abs 3.0e-7 rad
+//   Exp     [-87.3, 88.37]    rel 1.2e-7; inputs are clamped to that range
+//   Log     (0, FLT_MAX]      abs 7.9e-8 (relative for |log x| > 1); 0 -> -inf, < 0 and
+//                             NaN -> NaN, denormals are treated as FLT_MIN
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+
+class FastMath
+{
+public:
+
+	struct ErrorReport
+	{
+		double SinCos = 0.0;
+		double Atan2 = 0.0;
+		double ACos = 0.0;
+		double ExpRelative = 0.0;
+		double Log = 0.0;
+	};
+
+	static void SinCos(DirectX::FXMVECTOR x, DirectX::XMVECTOR* sin, DirectX::XMVECTOR* cos);
+	static DirectX::XMVECTOR Atan2(DirectX::FXMVECTOR y, DirectX::FXMVECTOR x);
+	static DirectX::XMVECTOR ACos(DirectX::FXMVECTOR x);
+	static DirectX::XMVECTOR Exp(DirectX::FXMVECTOR x);
+	static DirectX::XMVECTOR Log(DirectX::FXMVECTOR x);
+
+	// sin / cos may be null if only one is wanted. In and out arrays may alias.
+	static void SinCos(const float* x, float* sin, float* cos, size_t count);
+	static void Atan2(const float* y, const float* x, float* out, size_t count);
+	static void ACos(const float* x, float* out, size_t count);
+	static void Exp(const float* x, float* out, size_t count);
+	static void Log(const float* x, float* out, size_t count);
+
+	// Compares sampleCount random inputs per function with the double precision library.
+	static ErrorReport MeasureMaxError(size_t sampleCount = 1 << 20);
+};
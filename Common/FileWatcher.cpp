@@ -0,0 +1,358 @@
+//***************************************************************************************
+// FileWatcher.cpp
+//***************************************************************************************
+
+#include "FileWatcher.h"
+#include "StringUtil.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <ctime>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+#endif
+
+namespace
+{
+	// Editors often write a file in several steps; wait this long after a notification
+	// so one save is reported once.
+	const std::uint32_t DebounceMilliseconds = 50;
+
+	// File systems round write times (FAT to 2 seconds) and take them from a coarse
+	// clock, so a write may look up to this much older than Now() at the time.
+#if defined(_WIN32)
+	const std::uint64_t WriteTimeSlack = 2 * 10000000ull;   // 100 ns units
+#elif defined(__linux__)
+	const std::uint64_t WriteTimeSlack = 2 * 1000000000ull; // ns
+#else
+	const std::uint64_t WriteTimeSlack = 2;                 // s
+#endif
+
+	std::wstring GetDirectory(const std::wstring& filename)
+	{
+		size_t slash = filename.find_last_of(L"/\\");
+		return slash == std::wstring::npos ? std::wstring(L".") : filename.substr(0, slash + 1);
+	}
+}
+
+bool FileWatcher::Stamp::operator!=(const Stamp& rhs)const
+{
+	return WriteTime != rhs.WriteTime || Size != rhs.Size || Exists != rhs.Exists;
+}
+
+FileWatcher::FileWatcher(uint32 pollMilliseconds) :
+	mPollMilliseconds(std::max<uint32>(pollMilliseconds, 1))
+{
+#if defined(_WIN32)
+	mWakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+#elif defined(__linux__)
+	// Without inotify the watcher still polls.
+	mNotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+
+#if defined(_WIN32)
+	for (void* notification : mNotifications)
+		FindCloseChangeNotification(notification);
+	if (mWakeEvent != nullptr)
+		CloseHandle(mWakeEvent);
+#elif defined(__linux__)
+	if (mNotifyFd >= 0)
+		close(mNotifyFd);
+	if (mWakeFd >= 0)
+		close(mWakeFd);
+#endif
+}
+
+void FileWatcher::Watch(const std::wstring& filename)
+{
+	AddFile(filename, ReadStamp(filename));
+}
+
+void FileWatcher::Watch(const std::wstring& filename, uint64 readStart)
+{
+	Stamp stamp = ReadStamp(filename);
+
+	// An empty stamp differs from any existing file's.
+	if (stamp.Exists && stamp.WriteTime + WriteTimeSlack >= readStart)
+		stamp = Stamp();
+
+	AddFile(filename, stamp);
+}
+
+void FileWatcher::Unwatch(const std::wstring& filename)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mFiles.erase(filename) != 0)
+		ReleaseDirectory(GetDirectory(filename));
+}
+
+size_t FileWatcher::GetDirectoryCount()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mDirectories.size();
+}
+
+std::vector<std::wstring> FileWatcher::CheckForChanges()
+{
+	std::vector<std::wstring> filenames;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (const auto& file : mFiles)
+			filenames.push_back(file.first);
+	}
+
+	// Read the stamps without holding the lock; it is only needed to publish them.
+	std::vector<Stamp> stamps;
+	for (const std::wstring& filename : filenames)
+		stamps.push_back(ReadStamp(filename));
+
+	std::vector<std::wstring> changed;
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (size_t i = 0; i < filenames.size(); ++i)
+	{
+		auto it = mFiles.find(filenames[i]);
+		if (it != mFiles.end() && it->second != stamps[i])
+		{
+			it->second = stamps[i];
+			changed.push_back(filenames[i]);
+		}
+	}
+
+	std::sort(changed.begin(), changed.end());
+	return changed;
+}
+
+void FileWatcher::Start(Callback onChange)
+{
+	assert(!mThread.joinable());
+
+	mOnChange = std::move(onChange);
+	mQuit = false;
+	mThread = std::thread(&FileWatcher::ThreadLoop, this);
+}
+
+void FileWatcher::Stop()
+{
+	if (!mThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	Wake();
+
+	mThread.join();
+}
+
+FileWatcher::Stamp FileWatcher::ReadStamp(const std::wstring& filename)
+{
+	Stamp stamp;
+
+#if defined(_WIN32)
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &data))
+	{
+		stamp.WriteTime = ((uint64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+		stamp.Size = ((uint64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+		stamp.Exists = true;
+	}
+#else
+	struct stat info;
+	if (stat(StringUtil::ToNarrow(filename).c_str(), &info) == 0)
+	{
+#if defined(__linux__)
+		stamp.WriteTime = (uint64)info.st_mtim.tv_sec * 1000000000ull + (uint64)info.st_mtim.tv_nsec;
+#else
+		stamp.WriteTime = (uint64)info.st_mtime;
+#endif
+		stamp.Size = (uint64)info.st_size;
+		stamp.Exists = true;
+	}
+#endif
+
+	return stamp;
+}
+
+FileWatcher::uint64 FileWatcher::Now()
+{
+#if defined(_WIN32)
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	return ((uint64)now.dwHighDateTime << 32) | now.dwLowDateTime;
+#elif defined(__linux__)
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (uint64)now.tv_sec * 1000000000ull + (uint64)now.tv_nsec;
+#else
+	return (uint64)std::time(nullptr);
+#endif
+}
+
+void FileWatcher::AddFile(const std::wstring& filename, const Stamp& stamp)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mFiles.emplace(filename, stamp).second)
+		AddDirectory(GetDirectory(filename));
+}
+
+void FileWatcher::AddDirectory(const std::wstring& directory)
+{
+	Directory& entry = mDirectories[directory];
+	if (entry.FileCount++ != 0)
+		return;
+
+#if defined(_WIN32)
+	mDirectoriesChanged = true;
+	if (mThread.joinable())
+		SetEvent(mWakeEvent);
+#elif defined(__linux__)
+	if (mNotifyFd >= 0)
+	{
+		entry.WatchDescriptor = inotify_add_watch(mNotifyFd, StringUtil::ToNarrow(directory).c_str(),
+			IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB);
+	}
+#endif
+}
+
+void FileWatcher::ReleaseDirectory(const std::wstring& directory)
+{
+	auto it = mDirectories.find(directory);
+	assert(it != mDirectories.end() && it->second.FileCount > 0);
+	if (--it->second.FileCount != 0)
+		return;
+
+#if defined(__linux__)
+	// Two spellings of one directory (e.g. "a/" and "a/./") share the same watch.
+	int watchDescriptor = it->second.WatchDescriptor;
+	mDirectories.erase(it);
+
+	bool shared = false;
+	for (const auto& other : mDirectories)
+		shared = shared || other.second.WatchDescriptor == watchDescriptor;
+
+	if (watchDescriptor >= 0 && !shared)
+		inotify_rm_watch(mNotifyFd, watchDescriptor);
+#else
+	mDirectories.erase(it);
+#endif
+
+#if defined(_WIN32)
+	mDirectoriesChanged = true;
+	if (mThread.joinable())
+		SetEvent(mWakeEvent);
+#endif
+}
+
+void FileWatcher::ThreadLoop()
+{
+	while (true)
+	{
+		bool notified = WaitForNotification(mPollMilliseconds);
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mQuit)
+				return;
+		}
+
+		if (notified)
+			std::this_thread::sleep_for(std::chrono::milliseconds(DebounceMilliseconds));
+
+		std::vector<std::wstring> changed = CheckForChanges();
+		if (!changed.empty())
+			mOnChange(changed);
+	}
+}
+
+bool FileWatcher::WaitForNotification(uint32 milliseconds)
+{
+#if defined(_WIN32)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mDirectoriesChanged)
+		{
+			for (void* notification : mNotifications)
+				FindCloseChangeNotification(notification);
+			mNotifications.clear();
+
+			// One slot is the wake event; directories past the limit are only polled.
+			for (const auto& directory : mDirectories)
+			{
+				if (mNotifications.size() + 1 >= MAXIMUM_WAIT_OBJECTS)
+					break;
+
+				HANDLE notification = FindFirstChangeNotificationW(directory.first.c_str(), FALSE,
+					FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE);
+				if (notification != INVALID_HANDLE_VALUE)
+					mNotifications.push_back(notification);
+			}
+			mDirectoriesChanged = false;
+		}
+	}
+
+	std::vector<HANDLE> handles;
+	handles.push_back(mWakeEvent);
+	handles.insert(handles.end(), mNotifications.begin(), mNotifications.end());
+
+	DWORD signaled = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, milliseconds);
+	if (signaled == WAIT_TIMEOUT || signaled == WAIT_FAILED)
+		return false;
+
+	DWORD index = signaled - WAIT_OBJECT_0;
+	if (index > 0 && index < handles.size())
+		FindNextChangeNotification(handles[index]);
+	return true;
+#elif defined(__linux__)
+	pollfd fds[2] = {};
+	fds[0].fd = mNotifyFd;
+	fds[0].events = POLLIN;
+	fds[1].fd = mWakeFd;
+	fds[1].events = POLLIN;
+
+	if (poll(fds, 2, (int)milliseconds) <= 0)
+		return false;
+
+	// Only the wakeup matters, not which events arrived.
+	char buffer[4096];
+	while (mNotifyFd >= 0 && read(mNotifyFd, buffer, sizeof(buffer)) > 0)
+	{
+	}
+	std::uint64_t count = 0;
+	while (mWakeFd >= 0 && read(mWakeFd, &count, sizeof(count)) > 0)
+	{
+	}
+	return true;
+#else
+	std::unique_lock<std::mutex> lock(mMutex);
+	return mWakeUp.wait_for(lock, std::chrono::milliseconds(milliseconds), [this]() { return mQuit; });
+#endif
+}
+
+void FileWatcher::Wake()
+{
+#if defined(_WIN32)
+	SetEvent(mWakeEvent);
+#elif defined(__linux__)
+	std::uint64_t one = 1;
+	if (mWakeFd >= 0 && write(mWakeFd, &one, sizeof(one)) < 0)
+	{
+		// The counter is already non-zero, so the watcher is waking anyway.
+	}
+#else
+	mWakeUp.notify_all();
+#endif
+}
@@ -0,0 +1,114 @@
+//***************************************************************************************
+// FileWatcher.h
+//
+// Reports changes to a set of files. Each file's modification time and size are
+// remembered; CheckForChanges() compares them with the disk. Start() runs that check
+// on a background thread whenever the OS signals a change in one of the watched
+// directories (inotify on Linux, change notifications on Windows), and every
+// pollMilliseconds regardless, which covers file systems without notifications.
+//
+// Comparing stamps instead of trusting the events makes editors that save through a
+// temporary file and rename, or write a file several times, report one change.
+//***************************************************************************************
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class FileWatcher
+{
+public:
+
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Runs on the watcher thread with every file changed since the last call.
+	using Callback = std::function<void(const std::vector<std::wstring>& changedFiles)>;
+
+	explicit FileWatcher(uint32 pollMilliseconds = 500);
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher& rhs) = delete;
+	FileWatcher& operator=(const FileWatcher& rhs) = delete;
+
+	// Starts tracking filename from its current state. Thread safe.
+	void Watch(const std::wstring& filename);
+
+	// Stops tracking filename; its directory is no longer watched once no file in it is.
+	void Unwatch(const std::wstring& filename);
+
+	// Directories with at least one watched file.
+	size_t GetDirectoryCount();
+
+	///<summary>
+	/// Watch() for a file the caller read some time after readStart (a Now() value). If
+	/// it was written around or after readStart, its current stamp may be newer than
+	/// what was read, so the next check reports it even if it is not written again.
+	/// Files already watched keep their stamps.
+	///</summary>
+	void Watch(const std::wstring& filename, uint64 readStart);
+
+	// Current time in the units of the file write times Watch() compares against.
+	static uint64 Now();
+
+	// Files whose stamp differs from the last check (deleted files included). Thread safe.
+	std::vector<std::wstring> CheckForChanges();
+
+	void Start(Callback onChange);
+	void Stop();
+
+private:
+	struct Stamp
+	{
+		uint64 WriteTime = 0;
+		uint64 Size = 0;
+		bool Exists = false;
+
+		bool operator!=(const Stamp& rhs)const;
+	};
+
+	static Stamp ReadStamp(const std::wstring& filename);
+
+	// Number of watched files in a directory and, on Linux, its inotify watch.
+	struct Directory
+	{
+		uint32 FileCount = 0;
+		int WatchDescriptor = -1;
+	};
+
+	void AddFile(const std::wstring& filename, const Stamp& stamp);
+	void AddDirectory(const std::wstring& directory);
+	void ReleaseDirectory(const std::wstring& directory);
+	void ThreadLoop();
+	bool WaitForNotification(uint32 milliseconds);
+	void Wake();
+
+private:
+	uint32 mPollMilliseconds;
+	Callback mOnChange;
+
+	std::mutex mMutex;
+	std::unordered_map<std::wstring, Stamp> mFiles;
+	std::unordered_map<std::wstring, Directory> mDirectories;
+
+	std::thread mThread;
+	bool mQuit = false;
+
+#if defined(_WIN32)
+	void* mWakeEvent = nullptr;
+	bool mDirectoriesChanged = false;
+	std::vector<void*> mNotifications; // Watcher thread only.
+#elif defined(__linux__)
+	int mNotifyFd = -1;
+	int mWakeFd = -1;
+#else
+	std::condition_variable mWakeUp;
+#endif
+};
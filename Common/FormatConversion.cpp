@@ -0,0 +1,303 @@
+//***************************************************************************************
+// FormatConversion.cpp
+//***************************************************************************************
+
+#include "FormatConversion.h"
+#include "ThreadPool.h"
+#include <DirectXPackedVector.h>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#if defined(__F16C__) || defined(__AVX2__)
+#include <immintrin.h>
+#define FORMAT_CONVERSION_F16C
+#endif
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FORMAT_CONVERSION_SSE2
+#endif
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	using uint8 = FormatConversion::uint8;
+	using int16 = FormatConversion::int16;
+	using uint16 = FormatConversion::uint16;
+
+	// Vertices per ParallelFor chunk.
+	const size_t PackGrainSize = 4096;
+
+	// Vertices staged together by PackRange / UnpackRange.
+	const size_t PackBlockSize = 256;
+
+	// The layout the input layouts of PackedVertex vertex buffers rely on.
+	static_assert(offsetof(FormatConversion::PackedVertex, Normal) == 12, "PackedVertex layout changed");
+	static_assert(offsetof(FormatConversion::PackedVertex, TangentU) == 20, "PackedVertex layout changed");
+	static_assert(offsetof(FormatConversion::PackedVertex, TexC) == 28, "PackedVertex layout changed");
+	static_assert(sizeof(FormatConversion::PackedVertex) == 32, "PackedVertex layout changed");
+
+	// Runs kernel(src, dst, n) over full groups of groupSize, then once more over the tail
+	// padded with zeros, so the kernels need no scalar tail loop.
+	template<size_t groupSize, typename Src, typename Dst, typename Kernel>
+	void ForEachGroup(const Src* src, Dst* dst, size_t count, Kernel kernel)
+	{
+		size_t full = count / groupSize * groupSize;
+		if (full > 0)
+			kernel(src, dst, full);
+
+		if (full < count)
+		{
+			Src srcTail[groupSize] = {};
+			Dst dstTail[groupSize];
+			std::memcpy(srcTail, src + full, (count - full) * sizeof(Src));
+			kernel(srcTail, dstTail, groupSize);
+			std::memcpy(dst + full, dstTail, (count - full) * sizeof(Dst));
+		}
+	}
+
+	void PackRange(const GeometryGenerator::Vertex* src, FormatConversion::PackedVertex* dst, size_t count)
+	{
+		// Normal and TangentU are converted together: 8 snorm values per vertex.
+		float frame[PackBlockSize][8];
+		float texC[PackBlockSize][2];
+		int16 frameBits[PackBlockSize][8];
+		uint16 texCBits[PackBlockSize][2];
+
+		for (size_t first = 0; first < count; first += PackBlockSize)
+		{
+			size_t n = count - first < PackBlockSize ? count - first : PackBlockSize;
+			const GeometryGenerator::Vertex* v = src + first;
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				frame[i][0] = v[i].Normal.x;
+				frame[i][1] = v[i].Normal.y;
+				frame[i][2] = v[i].Normal.z;
+				frame[i][3] = 0.0f;
+				frame[i][4] = v[i].TangentU.x;
+				frame[i][5] = v[i].TangentU.y;
+				frame[i][6] = v[i].TangentU.z;
+				frame[i][7] = 0.0f;
+				texC[i][0] = v[i].TexC.x;
+				texC[i][1] = v[i].TexC.y;
+			}
+
+			FormatConversion::FloatToSnorm16(&frame[0][0], &frameBits[0][0], n * 8);
+			FormatConversion::FloatToHalf(&texC[0][0], &texCBits[0][0], n * 2);
+
+			FormatConversion::PackedVertex* p = dst + first;
+			for (size_t i = 0; i < n; ++i)
+			{
+				p[i].Position = v[i].Position;
+				std::memcpy(p[i].Normal, &frameBits[i][0], sizeof(p[i].Normal));
+				std::memcpy(p[i].TangentU, &frameBits[i][4], sizeof(p[i].TangentU));
+				std::memcpy(p[i].TexC, texCBits[i], sizeof(texCBits[i]));
+			}
+		}
+	}
+
+	void UnpackRange(const FormatConversion::PackedVertex* src, GeometryGenerator::Vertex* dst, size_t count)
+	{
+		int16 frameBits[PackBlockSize][8];
+		uint16 texCBits[PackBlockSize][2];
+		float frame[PackBlockSize][8];
+		float texC[PackBlockSize][2];
+
+		for (size_t first = 0; first < count; first += PackBlockSize)
+		{
+			size_t n = count - first < PackBlockSize ? count - first : PackBlockSize;
+			const FormatConversion::PackedVertex* p = src + first;
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				std::memcpy(&frameBits[i][0], p[i].Normal, sizeof(p[i].Normal));
+				std::memcpy(&frameBits[i][4], p[i].TangentU, sizeof(p[i].TangentU));
+				std::memcpy(texCBits[i], p[i].TexC, sizeof(texCBits[i]));
+			}
+
+			FormatConversion::Snorm16ToFloat(&frameBits[0][0], &frame[0][0], n * 8);
+			FormatConversion::HalfToFloat(&texCBits[0][0], &texC[0][0], n * 2);
+
+			GeometryGenerator::Vertex* v = dst + first;
+			for (size_t i = 0; i < n; ++i)
+			{
+				v[i].Position = p[i].Position;
+				v[i].Normal = XMFLOAT3(frame[i][0], frame[i][1], frame[i][2]);
+				v[i].TangentU = XMFLOAT3(frame[i][4], frame[i][5], frame[i][6]);
+				v[i].TexC = XMFLOAT2(texC[i][0], texC[i][1]);
+			}
+		}
+	}
+}
+
+void FormatConversion::FloatToHalf(const float* src, uint16* dst, size_t count)
+{
+#if defined(FORMAT_CONVERSION_F16C)
+	ForEachGroup<8>(src, dst, count, [](const float* s, uint16* d, size_t n)
+	{
+		for (size_t i = 0; i < n; i += 8)
+			_mm_storeu_si128((__m128i*)(d + i), _mm256_cvtps_ph(_mm256_loadu_ps(s + i), _MM_FROUND_TO_NEAREST_INT));
+	});
+#else
+	XMConvertFloatToHalfStream(dst, sizeof(uint16), src, sizeof(float), count);
+#endif
+}
+
+void FormatConversion::HalfToFloat(const uint16* src, float* dst, size_t count)
+{
+#if defined(FORMAT_CONVERSION_F16C)
+	ForEachGroup<8>(src, dst, count, [](const uint16* s, float* d, size_t n)
+	{
+		for (size_t i = 0; i < n; i += 8)
+			_mm256_storeu_ps(d + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(s + i))));
+	});
+#else
+	XMConvertHalfToFloatStream(dst, sizeof(float), src, sizeof(uint16), count);
+#endif
+}
+
+void FormatConversion::FloatToSnorm16(const float* src, int16* dst, size_t count)
+{
+#if defined(FORMAT_CONVERSION_SSE2)
+	ForEachGroup<8>(src, dst, count, [](const float* s, int16* d, size_t n)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 negativeOne = _mm_set1_ps(-1.0f);
+		const __m128 scale = _mm_set1_ps(32767.0f);
+
+		for (size_t i = 0; i < n; i += 8)
+		{
+			__m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(s + i), negativeOne), one), scale);
+			__m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(s + i + 4), negativeOne), one), scale);
+			_mm_storeu_si128((__m128i*)(d + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+		}
+	});
+#else
+	for (size_t i = 0; i < count; ++i)
+	{
+		float x = src[i] < -1.0f ? -1.0f : (src[i] > 1.0f ? 1.0f : src[i]);
+		dst[i] = (int16)std::nearbyint(x * 32767.0f);
+	}
+#endif
+}
+
+void FormatConversion::Snorm16ToFloat(const int16* src, float* dst, size_t count)
+{
+#if defined(FORMAT_CONVERSION_SSE2)
+	ForEachGroup<8>(src, dst, count, [](const int16* s, float* d, size_t n)
+	{
+		const __m128 negativeOne = _mm_set1_ps(-1.0f);
+		const __m128 scale = _mm_set1_ps(1.0f / 32767.0f);
+
+		for (size_t i = 0; i < n; i += 8)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+
+			// Sign extend: the value in the high half of each 32 bit lane, shifted down.
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+			_mm_storeu_ps(d + i, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), scale), negativeOne));
+			_mm_storeu_ps(d + i + 4, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), scale), negativeOne));
+		}
+	});
+#else
+	for (size_t i = 0; i < count; ++i)
+	{
+		float x = (float)src[i] * (1.0f / 32767.0f);
+		dst[i] = x < -1.0f ? -1.0f : x;
+	}
+#endif
+}
+
+void FormatConversion::FloatToUnorm8(const float* src, uint8* dst, size_t count)
+{
+#if defined(FORMAT_CONVERSION_SSE2)
+	ForEachGroup<16>(src, dst, count, [](const float* s, uint8* d, size_t n)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(255.0f);
+
+		auto convert = [&](const float* p)
+		{
+			return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(p), zero), one), scale));
+		};
+
+		for (size_t i = 0; i < n; i += 16)
+		{
+			__m128i a = _mm_packs_epi32(convert(s + i), convert(s + i + 4));
+			__m128i b = _mm_packs_epi32(convert(s + i + 8), convert(s + i + 12));
+			_mm_storeu_si128((__m128i*)(d + i), _mm_packus_epi16(a, b));
+		}
+	});
+#else
+	for (size_t i = 0; i < count; ++i)
+	{
+		float x = src[i] < 0.0f ? 0.0f : (src[i] > 1.0f ? 1.0f : src[i]);
+		dst[i] = (uint8)std::nearbyint(x * 255.0f);
+	}
+#endif
+}
+
+void FormatConversion::Unorm8ToFloat(const uint8* src, float* dst, size_t count)
+{
+#if defined(FORMAT_CONVERSION_SSE2)
+	ForEachGroup<16>(src, dst, count, [](const uint8* s, float* d, size_t n)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+		for (size_t i = 0; i < n; i += 16)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+			__m128i lo = _mm_unpacklo_epi8(x, zero);
+			__m128i hi = _mm_unpackhi_epi8(x, zero);
+
+			_mm_storeu_ps(d + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+			_mm_storeu_ps(d + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+			_mm_storeu_ps(d + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+			_mm_storeu_ps(d + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+		}
+	});
+#else
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = (float)src[i] * (1.0f / 255.0f);
+#endif
+}
+
+void FormatConversion::PackVertices(const GeometryGenerator::Vertex* src, PackedVertex* dst, size_t count, ThreadPool* pool)
+{
+	if (pool == nullptr || count <= PackGrainSize)
+	{
+		PackRange(src, dst, count);
+		return;
+	}
+
+	pool->ParallelFor(count, PackGrainSize, [&](size_t begin, size_t end)
+	{
+		PackRange(src + begin, dst + begin, end - begin);
+	});
+}
+
+void FormatConversion::UnpackVertices(const PackedVertex* src, GeometryGenerator::Vertex* dst, size_t count, ThreadPool* pool)
+{
+	if (pool == nullptr || count <= PackGrainSize)
+	{
+		UnpackRange(src, dst, count);
+		return;
+	}
+
+	pool->ParallelFor(count, PackGrainSize, [&](size_t begin, size_t end)
+	{
+		UnpackRange(src + begin, dst + begin, end - begin);
+	});
+}
+
+std::vector<FormatConversion::PackedVertex> FormatConversion::PackVertices(const GeometryGenerator::MeshData& meshData, ThreadPool* pool)
+{
+	std::vector<PackedVertex> packed(meshData.Vertices.size());
+	PackVertices(meshData.Vertices.data(), packed.data(), packed.size(), pool);
+	return packed;
+}
@@ -0,0 +1,62 @@
+//***************************************************************************************
+// FormatConversion.h
+//
+// Bulk conversions between float and the compact formats used for vertex and texture
+// data (DXGI_FORMAT_*_FLOAT 16 bit, *_SNORM 16 bit, *_UNORM 8 bit), over whole arrays
+// instead of one DirectXPackedVector call per element. Results match the
+// DirectXPackedVector functions (XMStoreShortN4, XMStoreUByteN4, XMConvertFloatToHalf):
+// round to nearest even, inputs clamped to the format's range.
+//
+// Float <-> half uses F16C when the build targets it (/arch:AVX2) and
+// XMConvertFloatToHalfStream otherwise; the normalized formats use SSE2.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#include "GeometryGenerator.h"
+
+class ThreadPool;
+
+class FormatConversion
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using int16 = std::int16_t;
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+	///<summary>
+	/// 32 byte version of GeometryGenerator::Vertex (44 bytes):
+	///   Position  DXGI_FORMAT_R32G32B32_FLOAT
+	///   Normal    DXGI_FORMAT_R16G16B16A16_SNORM (w = 0)
+	///   TangentU  DXGI_FORMAT_R16G16B16A16_SNORM (w = 0)
+	///   TexC      DXGI_FORMAT_R16G16_FLOAT
+	///</summary>
+	struct PackedVertex
+	{
+		DirectX::XMFLOAT3 Position;
+		int16 Normal[4];
+		int16 TangentU[4];
+		uint16 TexC[2];
+	};
+
+	static void FloatToHalf(const float* src, uint16* dst, size_t count);
+	static void HalfToFloat(const uint16* src, float* dst, size_t count);
+
+	// [-1, 1] <-> [-32767, 32767]; -32768 reads back as -1.
+	static void FloatToSnorm16(const float* src, int16* dst, size_t count);
+	static void Snorm16ToFloat(const int16* src, float* dst, size_t count);
+
+	// [0, 1] <-> [0, 255].
+	static void FloatToUnorm8(const float* src, uint8* dst, size_t count);
+	static void Unorm8ToFloat(const uint8* src, float* dst, size_t count);
+
+	static void PackVertices(const GeometryGenerator::Vertex* src, PackedVertex* dst, size_t count, ThreadPool* pool = nullptr);
+	static void UnpackVertices(const PackedVertex* src, GeometryGenerator::Vertex* dst, size_t count, ThreadPool* pool = nullptr);
+
+	static std::vector<PackedVertex> PackVertices(const GeometryGenerator::MeshData& meshData, ThreadPool* pool = nullptr);
+};
@@ -0,0 +1,366 @@
+//***************************************************************************************
+// FrustumCuller.cpp
+//***************************************************************************************
+
+#include "FrustumCuller.h"
+#include "ThreadPool.h"
+#include <cassert>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+const FrustumCuller::uint32 FrustumCuller::MaxMaskFrusta;
+
+namespace
+{
+	// Boxes per ParallelFor chunk.
+	const size_t CullGrainSize = 4096;
+}
+
+void FrustumCuller::Clear()
+{
+	for (std::vector<float>* a : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+		a->clear();
+}
+
+void FrustumCuller::Reserve(size_t count)
+{
+	for (std::vector<float>* a : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+		a->reserve(count);
+}
+
+FrustumCuller::uint32 FrustumCuller::Add(const BoundingBox& bounds)
+{
+	mCenterX.push_back(bounds.Center.x);
+	mCenterY.push_back(bounds.Center.y);
+	mCenterZ.push_back(bounds.Center.z);
+	mExtentX.push_back(bounds.Extents.x);
+	mExtentY.push_back(bounds.Extents.y);
+	mExtentZ.push_back(bounds.Extents.z);
+
+	return GetCount() - 1;
+}
+
+void FrustumCuller::Set(uint32 index, const BoundingBox& bounds)
+{
+	mCenterX[index] = bounds.Center.x;
+	mCenterY[index] = bounds.Center.y;
+	mCenterZ[index] = bounds.Center.z;
+	mExtentX[index] = bounds.Extents.x;
+	mExtentY[index] = bounds.Extents.y;
+	mExtentZ[index] = bounds.Extents.z;
+}
+
+void FrustumCuller::Cull(const BoundingFrustum& frustum, std::vector<uint32>& visibleIndices, ThreadPool* pool)const
+{
+	XMFLOAT4 planes[6];
+	GetPlanes(frustum, planes);
+
+	Cull(planes, visibleIndices, pool);
+}
+
+void FrustumCuller::Cull(const XMFLOAT4 planes[6], std::vector<uint32>& visibleIndices, ThreadPool* pool)const
+{
+	size_t count = GetCount();
+	visibleIndices.resize(count);
+
+	if (pool == nullptr || count <= CullGrainSize)
+	{
+		uint32* end = CullRange(planes, 0, count, visibleIndices.data());
+		visibleIndices.resize(end - visibleIndices.data());
+		return;
+	}
+
+	// Every chunk writes its visible indices into its own [begin, end) slot of the
+	// output, then the slots are packed in order so the result stays sorted.
+	size_t chunkCount = (count + CullGrainSize - 1) / CullGrainSize;
+	std::vector<uint32> chunkVisible(chunkCount);
+
+	pool->ParallelFor(count, CullGrainSize, [&](size_t begin, size_t end)
+	{
+		uint32* out = visibleIndices.data() + begin;
+		chunkVisible[begin / CullGrainSize] = (uint32)(CullRange(planes, begin, end, out) - out);
+	});
+
+	size_t visibleCount = chunkVisible[0];
+	for (size_t chunk = 1; chunk < chunkCount; ++chunk)
+	{
+		std::memmove(visibleIndices.data() + visibleCount, visibleIndices.data() + chunk * CullGrainSize, chunkVisible[chunk] * sizeof(uint32));
+		visibleCount += chunkVisible[chunk];
+	}
+
+	visibleIndices.resize(visibleCount);
+}
+
+FrustumCuller::uint32* FrustumCuller::CullRange(const XMFLOAT4 planes[6], size_t begin, size_t end, uint32* out)const
+{
+	size_t i = begin;
+
+#if defined(__AVX2__)
+	__m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+	__m256 nx[6], ny[6], nz[6], nd[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		nx[p] = _mm256_set1_ps(planes[p].x);
+		ny[p] = _mm256_set1_ps(planes[p].y);
+		nz[p] = _mm256_set1_ps(planes[p].z);
+		nd[p] = _mm256_set1_ps(planes[p].w);
+		ax[p] = _mm256_and_ps(nx[p], absMask);
+		ay[p] = _mm256_and_ps(ny[p], absMask);
+		az[p] = _mm256_and_ps(nz[p], absMask);
+	}
+
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&mCenterX[i]);
+		__m256 cy = _mm256_loadu_ps(&mCenterY[i]);
+		__m256 cz = _mm256_loadu_ps(&mCenterZ[i]);
+		__m256 ex = _mm256_loadu_ps(&mExtentX[i]);
+		__m256 ey = _mm256_loadu_ps(&mExtentY[i]);
+		__m256 ez = _mm256_loadu_ps(&mExtentZ[i]);
+
+		// A box is outside when its center is farther in front of a plane than
+		// the box's projected radius onto that plane's normal.
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < 6; ++p)
+		{
+			__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+				_mm256_add_ps(_mm256_mul_ps(nz[p], cz), nd[p]));
+			__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez));
+
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, radius, _CMP_GT_OQ));
+		}
+
+		// Branch-free compaction of the visible lanes.
+		int visibleMask = ~_mm256_movemask_ps(outside) & 0xff;
+		for (uint32 lane = 0; lane < 8; ++lane)
+		{
+			*out = (uint32)i + lane;
+			out += (visibleMask >> lane) & 1;
+		}
+	}
+#else
+	XMVECTOR nx[6], ny[6], nz[6], nd[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		nx[p] = XMVectorReplicate(planes[p].x);
+		ny[p] = XMVectorReplicate(planes[p].y);
+		nz[p] = XMVectorReplicate(planes[p].z);
+		nd[p] = XMVectorReplicate(planes[p].w);
+		ax[p] = XMVectorAbs(nx[p]);
+		ay[p] = XMVectorAbs(ny[p]);
+		az[p] = XMVectorAbs(nz[p]);
+	}
+
+	// 8 boxes per step as two groups of XMVECTOR lanes.
+	for (; i + 8 <= end; i += 8)
+	{
+		XMVECTOR outside[2];
+		for (int half = 0; half < 2; ++half)
+		{
+			size_t j = i + half * 4;
+			XMVECTOR cx = XMLoadFloat4((const XMFLOAT4*)&mCenterX[j]);
+			XMVECTOR cy = XMLoadFloat4((const XMFLOAT4*)&mCenterY[j]);
+			XMVECTOR cz = XMLoadFloat4((const XMFLOAT4*)&mCenterZ[j]);
+			XMVECTOR ex = XMLoadFloat4((const XMFLOAT4*)&mExtentX[j]);
+			XMVECTOR ey = XMLoadFloat4((const XMFLOAT4*)&mExtentY[j]);
+			XMVECTOR ez = XMLoadFloat4((const XMFLOAT4*)&mExtentZ[j]);
+
+			outside[half] = XMVectorFalseInt();
+			for (int p = 0; p < 6; ++p)
+			{
+				XMVECTOR dist = XMVectorMultiplyAdd(nx[p], cx, XMVectorMultiplyAdd(ny[p], cy, XMVectorMultiplyAdd(nz[p], cz, nd[p])));
+				XMVECTOR radius = XMVectorMultiplyAdd(ax[p], ex, XMVectorMultiplyAdd(ay[p], ey, az[p] * ez));
+
+				outside[half] = XMVectorOrInt(outside[half], XMVectorGreater(dist, radius));
+			}
+		}
+
+		uint32 lanes[8];
+		XMStoreInt4(&lanes[0], outside[0]);
+		XMStoreInt4(&lanes[4], outside[1]);
+
+		for (uint32 lane = 0; lane < 8; ++lane)
+		{
+			*out = (uint32)i + lane;
+			out += lanes[lane] == 0;
+		}
+	}
+#endif
+
+	// Remaining boxes one at a time.
+	for (; i < end; ++i)
+	{
+		bool outside = false;
+		for (int p = 0; p < 6; ++p)
+		{
+			float dist = planes[p].x * mCenterX[i] + planes[p].y * mCenterY[i] + planes[p].z * mCenterZ[i] + planes[p].w;
+			float radius = fabsf(planes[p].x) * mExtentX[i] + fabsf(planes[p].y) * mExtentY[i] + fabsf(planes[p].z) * mExtentZ[i];
+
+			outside |= dist > radius;
+		}
+
+		if (!outside)
+			*out++ = (uint32)i;
+	}
+
+	return out;
+}
+
+void FrustumCuller::CullMasks(const XMFLOAT4* planes, uint32 frustumCount, std::vector<uint8>& masks, ThreadPool* pool)const
+{
+	assert(frustumCount <= MaxMaskFrusta);
+
+	size_t count = GetCount();
+	masks.resize(count);
+
+	// Chunks write disjoint ranges of masks, so no packing step is needed.
+	if (pool == nullptr || count <= CullGrainSize)
+		CullMaskRange(planes, frustumCount, 0, count, masks.data());
+	else
+		pool->ParallelFor(count, CullGrainSize, [&](size_t begin, size_t end) { CullMaskRange(planes, frustumCount, begin, end, masks.data()); });
+}
+
+void FrustumCuller::CullMaskRange(const XMFLOAT4* planes, uint32 frustumCount, size_t begin, size_t end, uint8* masks)const
+{
+	size_t i = begin;
+
+#if defined(__AVX2__)
+	__m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&mCenterX[i]);
+		__m256 cy = _mm256_loadu_ps(&mCenterY[i]);
+		__m256 cz = _mm256_loadu_ps(&mCenterZ[i]);
+		__m256 ex = _mm256_loadu_ps(&mExtentX[i]);
+		__m256 ey = _mm256_loadu_ps(&mExtentY[i]);
+		__m256 ez = _mm256_loadu_ps(&mExtentZ[i]);
+
+		uint8 laneMasks[8] = {};
+		for (uint32 f = 0; f < frustumCount; ++f)
+		{
+			__m256 outside = _mm256_setzero_ps();
+			for (int p = 0; p < 6; ++p)
+			{
+				const XMFLOAT4& plane = planes[f * 6 + p];
+				__m256 nx = _mm256_set1_ps(plane.x), ny = _mm256_set1_ps(plane.y), nz = _mm256_set1_ps(plane.z);
+
+				__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+					_mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(plane.w)));
+				__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_and_ps(nx, absMask), ex), _mm256_mul_ps(_mm256_and_ps(ny, absMask), ey)),
+					_mm256_mul_ps(_mm256_and_ps(nz, absMask), ez));
+
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, radius, _CMP_GT_OQ));
+			}
+
+			int visibleMask = ~_mm256_movemask_ps(outside) & 0xff;
+			for (uint32 lane = 0; lane < 8; ++lane)
+				laneMasks[lane] |= (uint8)(((visibleMask >> lane) & 1) << f);
+		}
+
+		std::memcpy(masks + i, laneMasks, 8);
+	}
+#else
+	// 8 boxes per step as two groups of XMVECTOR lanes.
+	for (; i + 8 <= end; i += 8)
+	{
+		XMVECTOR cx[2], cy[2], cz[2], ex[2], ey[2], ez[2];
+		for (int half = 0; half < 2; ++half)
+		{
+			size_t j = i + half * 4;
+			cx[half] = XMLoadFloat4((const XMFLOAT4*)&mCenterX[j]);
+			cy[half] = XMLoadFloat4((const XMFLOAT4*)&mCenterY[j]);
+			cz[half] = XMLoadFloat4((const XMFLOAT4*)&mCenterZ[j]);
+			ex[half] = XMLoadFloat4((const XMFLOAT4*)&mExtentX[j]);
+			ey[half] = XMLoadFloat4((const XMFLOAT4*)&mExtentY[j]);
+			ez[half] = XMLoadFloat4((const XMFLOAT4*)&mExtentZ[j]);
+		}
+
+		uint8 laneMasks[8] = {};
+		for (uint32 f = 0; f < frustumCount; ++f)
+		{
+			XMVECTOR outside[2] = { XMVectorFalseInt(), XMVectorFalseInt() };
+			for (int p = 0; p < 6; ++p)
+			{
+				const XMFLOAT4& plane = planes[f * 6 + p];
+				XMVECTOR nx = XMVectorReplicate(plane.x), ny = XMVectorReplicate(plane.y), nz = XMVectorReplicate(plane.z);
+				XMVECTOR nd = XMVectorReplicate(plane.w);
+				XMVECTOR ax = XMVectorAbs(nx), ay = XMVectorAbs(ny), az = XMVectorAbs(nz);
+
+				for (int half = 0; half < 2; ++half)
+				{
+					XMVECTOR dist = XMVectorMultiplyAdd(nx, cx[half], XMVectorMultiplyAdd(ny, cy[half], XMVectorMultiplyAdd(nz, cz[half], nd)));
+					XMVECTOR radius = XMVectorMultiplyAdd(ax, ex[half], XMVectorMultiplyAdd(ay, ey[half], az * ez[half]));
+
+					outside[half] = XMVectorOrInt(outside[half], XMVectorGreater(dist, radius));
+				}
+			}
+
+			uint32 lanes[8];
+			XMStoreInt4(&lanes[0], outside[0]);
+			XMStoreInt4(&lanes[4], outside[1]);
+
+			for (uint32 lane = 0; lane < 8; ++lane)
+				laneMasks[lane] |= (uint8)((lanes[lane] == 0) << f);
+		}
+
+		std::memcpy(masks + i, laneMasks, 8);
+	}
+#endif
+
+	// Remaining boxes one at a time.
+	for (; i < end; ++i)
+	{
+		uint8 mask = 0;
+		for (uint32 f = 0; f < frustumCount; ++f)
+		{
+			bool outside = false;
+			for (int p = 0; p < 6; ++p)
+			{
+				const XMFLOAT4& plane = planes[f * 6 + p];
+				float dist = plane.x * mCenterX[i] + plane.y * mCenterY[i] + plane.z * mCenterZ[i] + plane.w;
+				float radius = fabsf(plane.x) * mExtentX[i] + fabsf(plane.y) * mExtentY[i] + fabsf(plane.z) * mExtentZ[i];
+
+				outside |= dist > radius;
+			}
+
+			mask |= (uint8)(!outside << f);
+		}
+
+		masks[i] = mask;
+	}
+}
+
+void FrustumCuller::GetPlanes(const BoundingFrustum& frustum, XMFLOAT4 planes[6])
+{
+	XMVECTOR p[6];
+	frustum.GetPlanes(&p[0], &p[1], &p[2], &p[3], &p[4], &p[5]);
+
+	for (int i = 0; i < 6; ++i)
+		XMStoreFloat4(&planes[i], p[i]);
+}
+
+void FrustumCuller::GetPlanes(FXMMATRIX viewProj, XMFLOAT4 planes[6])
+{
+	// Rows of the transpose are the columns of viewProj (clip = v * viewProj).
+	// Clip volume: -w <= x <= w, -w <= y <= w, 0 <= z <= w.
+	XMMATRIX T = XMMatrixTranspose(viewProj);
+
+	XMVECTOR inward[6] =
+	{
+		T.r[2],          // near
+		T.r[3] - T.r[2], // far
+		T.r[3] - T.r[0], // right
+		T.r[3] + T.r[0], // left
+		T.r[3] - T.r[1], // top
+		T.r[3] + T.r[1]  // bottom
+	};
+
+	for (int i = 0; i < 6; ++i)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(-inward[i]));
+}
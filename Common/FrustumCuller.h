@@ -0,0 +1,69 @@
+//***************************************************************************************
+// FrustumCuller.h
+//
+// Batched frustum culling of draw item bounds. The world space boxes of all draw items
+// (e.g. SubmeshGeometry::Bounds transformed by the item's world matrix) are kept in SoA
+// form and tested 8 at a time against the 6 frustum planes.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+class FrustumCuller
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	// Frusta CullMasks() tests in one pass (one bit each).
+	static const uint32 MaxMaskFrusta = 8;
+
+	void Clear();
+	void Reserve(size_t count);
+
+	// Returns the index the box is reported with by Cull().
+	uint32 Add(const DirectX::BoundingBox& bounds);
+	void Set(uint32 index, const DirectX::BoundingBox& bounds);
+
+	uint32 GetCount()const { return (uint32)mCenterX.size(); }
+
+	///<summary>
+	/// Writes the indices of the boxes that intersect or are inside the frustum to
+	/// visibleIndices in ascending order. The frustum must be in the same (world) space
+	/// as the boxes. With a pool the list is split into chunks processed in parallel.
+	///</summary>
+	void Cull(const DirectX::BoundingFrustum& frustum, std::vector<uint32>& visibleIndices, ThreadPool* pool = nullptr)const;
+
+	// Planes are (n, d) with n pointing out of the frustum; a point p is inside when dot(n, p) + d <= 0.
+	void Cull(const DirectX::XMFLOAT4 planes[6], std::vector<uint32>& visibleIndices, ThreadPool* pool = nullptr)const;
+
+	///<summary>
+	/// Tests every box against frustumCount (<= MaxMaskFrusta) plane sets in one pass over
+	/// the boxes, e.g. the cascades of a shadow map: bit f of masks[i] is set when box i
+	/// intersects or is inside the volume of planes[6 * f .. 6 * f + 5].
+	///</summary>
+	void CullMasks(const DirectX::XMFLOAT4* planes, uint32 frustumCount, std::vector<uint8>& masks, ThreadPool* pool = nullptr)const;
+
+	// Outward planes of a BoundingFrustum in the convention above.
+	static void GetPlanes(const DirectX::BoundingFrustum& frustum, DirectX::XMFLOAT4 planes[6]);
+
+	// Outward planes of the clip volume of a (row vector) view-projection matrix.
+	static void GetPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 planes[6]);
+
+private:
+	// Tests boxes [begin, end) and appends the visible ones to out. Returns the new end of out.
+	uint32* CullRange(const DirectX::XMFLOAT4 planes[6], size_t begin, size_t end, uint32* out)const;
+
+	void CullMaskRange(const DirectX::XMFLOAT4* planes, uint32 frustumCount, size_t begin, size_t end, uint8* masks)const;
+
+private:
+	std::vector<float> mCenterX, mCenterY, mCenterZ;
+	std::vector<float> mExtentX, mExtentY, mExtentZ;
+};
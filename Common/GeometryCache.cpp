@@ -0,0 +1,276 @@
+//***************************************************************************************
+// GeometryCache.cpp
+//***************************************************************************************
+
+#include "GeometryCache.h"
+
+using Microsoft::WRL::ComPtr;
+using namespace DirectX;
+
+bool GeometryCache::Key::operator==(const Key& rhs)const
+{
+	if (Type != rhs.Type)
+		return false;
+
+	for (int i = 0; i < 5; ++i)
+	{
+		if (Params[i] != rhs.Params[i])
+			return false;
+	}
+
+	return Counts[0] == rhs.Counts[0] && Counts[1] == rhs.Counts[1];
+}
+
+size_t GeometryCache::KeyHash::operator()(const Key& key)const
+{
+	// FNV-1a over the shape type, parameter bits and counts.
+	std::uint32_t type = (std::uint32_t)key.Type;
+	std::uint64_t hash = StringUtil::Fnv1a(StringUtil::Fnv1aSeed, &type, sizeof(type));
+	for (int i = 0; i < 5; ++i)
+	{
+		// -0.0f == 0.0f, so both must hash the same.
+		float p = key.Params[i] == 0.0f ? 0.0f : key.Params[i];
+		hash = StringUtil::Fnv1a(hash, &p, sizeof(p));
+	}
+	hash = StringUtil::Fnv1a(hash, key.Counts, sizeof(key.Counts));
+
+	return (size_t)hash;
+}
+
+GeometryCache::Key GeometryCache::BoxKey(float width, float height, float depth, uint32 numSubdivisions)
+{
+	return Key{ Shape::Box, { width, height, depth }, { numSubdivisions } };
+}
+
+GeometryCache::Key GeometryCache::SphereKey(float radius, uint32 sliceCount, uint32 stackCount)
+{
+	return Key{ Shape::Sphere, { radius }, { sliceCount, stackCount } };
+}
+
+GeometryCache::Key GeometryCache::GeosphereKey(float radius, uint32 numSubdivisions)
+{
+	return Key{ Shape::Geosphere, { radius }, { numSubdivisions } };
+}
+
+GeometryCache::Key GeometryCache::CylinderKey(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
+{
+	return Key{ Shape::Cylinder, { bottomRadius, topRadius, height }, { sliceCount, stackCount } };
+}
+
+GeometryCache::Key GeometryCache::GridKey(float width, float depth, uint32 m, uint32 n)
+{
+	return Key{ Shape::Grid, { width, depth }, { m, n } };
+}
+
+GeometryCache::Key GeometryCache::QuadKey(float x, float y, float w, float h, float depth)
+{
+	return Key{ Shape::Quad, { x, y, w, h, depth } };
+}
+
+std::shared_ptr<const GeometryGenerator::MeshData> GeometryCache::Get(const Key& key)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto it = mMeshes.find(key);
+		if (it != mMeshes.end())
+			return it->second;
+	}
+
+	// Generate outside the lock so other shapes can be looked up meanwhile.
+	auto meshData = std::make_shared<const GeometryGenerator::MeshData>(Generate(key));
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// If another thread generated the same shape first, keep its copy.
+	return mMeshes.emplace(key, std::move(meshData)).first->second;
+}
+
+std::shared_ptr<const GeometryGenerator::MeshData> GeometryCache::GetBox(float width, float height, float depth, uint32 numSubdivisions)
+{
+	return Get(BoxKey(width, height, depth, numSubdivisions));
+}
+
+std::shared_ptr<const GeometryGenerator::MeshData> GeometryCache::GetSphere(float radius, uint32 sliceCount, uint32 stackCount)
+{
+	return Get(SphereKey(radius, sliceCount, stackCount));
+}
+
+std::shared_ptr<const GeometryGenerator::MeshData> GeometryCache::GetGeosphere(float radius, uint32 numSubdivisions)
+{
+	return Get(GeosphereKey(radius, numSubdivisions));
+}
+
+std::shared_ptr<const GeometryGenerator::MeshData> GeometryCache::GetCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
+{
+	return Get(CylinderKey(bottomRadius, topRadius, height, sliceCount, stackCount));
+}
+
+std::shared_ptr<const GeometryGenerator::MeshData> GeometryCache::GetGrid(float width, float depth, uint32 m, uint32 n)
+{
+	return Get(GridKey(width, depth, m, n));
+}
+
+std::shared_ptr<const GeometryGenerator::MeshData> GeometryCache::GetQuad(float x, float y, float w, float h, float depth)
+{
+	return Get(QuadKey(x, y, w, h, depth));
+}
+
+GeometryCache::GpuMesh GeometryCache::GetGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const Key& key)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto it = mGeometries.find(key);
+		if (it != mGeometries.end())
+			return GpuMesh{ it->second.Geometry, it->second.Submesh };
+	}
+
+	std::shared_ptr<const GeometryGenerator::MeshData> meshData = Get(key);
+
+	// The command list is not free threaded, so uploads are recorded under the lock.
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto it = mGeometries.find(key);
+	if (it != mGeometries.end())
+		return GpuMesh{ it->second.Geometry, it->second.Submesh };
+
+	const std::vector<GeometryGenerator::Vertex>& vertices = meshData->Vertices;
+	const std::vector<uint32>& indices32 = meshData->Indices32;
+
+	// 16 bit indices whenever every vertex is addressable with them.
+	bool index16 = vertices.size() <= 0x10000;
+
+	std::vector<std::uint16_t> indices16;
+	if (index16)
+		indices16.assign(indices32.begin(), indices32.end());
+
+	const UINT vbByteSize = (UINT)vertices.size() * sizeof(GeometryGenerator::Vertex);
+	const UINT ibByteSize = (UINT)indices32.size() * (index16 ? sizeof(std::uint16_t) : sizeof(uint32));
+	const void* indexData = index16 ? (const void*)indices16.data() : (const void*)indices32.data();
+
+	auto geo = std::make_shared<MeshGeometry>();
+	geo->Name = GetShapeName(key.Type);
+
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBuferCPU));
+	CopyMemory(geo->VertexBuferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBuferCPU));
+	CopyMemory(geo->IndexBuferCPU->GetBufferPointer(), indexData, ibByteSize);
+
+	geo->VertexBuferGPU = d3dUtil::CreateDefalutBuffer(device, cmdList,
+		vertices.data(), vbByteSize, geo->VertexBuferUploader);
+
+	geo->IndexBuferGPU = d3dUtil::CreateDefalutBuffer(device, cmdList,
+		indexData, ibByteSize, geo->IndexBuferUploader);
+
+	geo->VertexBufferByteStride = sizeof(GeometryGenerator::Vertex);
+	geo->VertexBuffserByteSize = vbByteSize;
+	geo->IndexFormat = index16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	geo->IndexBufferByteSize = ibByteSize;
+
+	SubmeshGeometry submesh;
+	submesh.IndexCount = (UINT)indices32.size();
+	submesh.StartIndexLocation = 0;
+	submesh.BaseVertexLocation = 0;
+
+	if (!vertices.empty())
+	{
+		BoundingBox::CreateFromPoints(submesh.Bounds, vertices.size(),
+			&vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+	}
+
+	geo->DrawArgs[geo->Name] = submesh;
+
+	mGeometries[key] = GeometryEntry{ geo, submesh };
+	return GpuMesh{ std::move(geo), submesh };
+}
+
+void GeometryCache::DisposeUploaders()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	for (auto& e : mGeometries)
+		e.second.Geometry->DisposeUploaders();
+}
+
+void GeometryCache::Trim()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	for (auto it = mMeshes.begin(); it != mMeshes.end();)
+	{
+		if (it->second.use_count() == 1)
+			it = mMeshes.erase(it);
+		else
+			++it;
+	}
+
+	for (auto it = mGeometries.begin(); it != mGeometries.end();)
+	{
+		if (it->second.Geometry.use_count() == 1)
+			it = mGeometries.erase(it);
+		else
+			++it;
+	}
+}
+
+void GeometryCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	mMeshes.clear();
+	mGeometries.clear();
+}
+
+size_t GeometryCache::GetMeshCount()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mMeshes.size();
+}
+
+size_t GeometryCache::GetGeometryCount()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mGeometries.size();
+}
+
+GeometryGenerator::MeshData GeometryCache::Generate(const Key& key)
+{
+	GeometryGenerator geoGen;
+	const float* p = key.Params;
+	const uint32* n = key.Counts;
+
+	switch (key.Type)
+	{
+	case Shape::Box:
+		return geoGen.CreateBox(p[0], p[1], p[2], n[0]);
+	case Shape::Sphere:
+		return geoGen.CreateSphere(p[0], n[0], n[1]);
+	case Shape::Geosphere:
+		return geoGen.CreateGeosphere(p[0], n[0]);
+	case Shape::Cylinder:
+		return geoGen.CreateCylinder(p[0], p[1], p[2], n[0], n[1]);
+	case Shape::Grid:
+		return geoGen.CreateGrid(p[0], p[1], n[0], n[1]);
+	case Shape::Quad:
+		return geoGen.CreateQuad(p[0], p[1], p[2], p[3], p[4]);
+	}
+
+	return GeometryGenerator::MeshData();
+}
+
+const char* GeometryCache::GetShapeName(Shape shape)
+{
+	switch (shape)
+	{
+	case Shape::Box:       return "box";
+	case Shape::Sphere:    return "sphere";
+	case Shape::Geosphere: return "geosphere";
+	case Shape::Cylinder:  return "cylinder";
+	case Shape::Grid:      return "grid";
+	case Shape::Quad:      return "quad";
+	}
+
+	return "";
+}
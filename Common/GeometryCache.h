@@ -0,0 +1,110 @@
+//***************************************************************************************
+// GeometryCache.h
+//
+// Memoizes GeometryGenerator output by shape type and parameters. Identical requests
+// return the same immutable, reference-counted MeshData, and the uploaded MeshGeometry
+// for a shape is shared in the same way, so duplicate shapes cost one hash lookup and
+// occupy GPU memory once.
+//***************************************************************************************
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "d3dUtil.h"
+#include "GeometryGenerator.h"
+
+class GeometryCache
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	enum class Shape : uint32
+	{
+		Box,
+		Sphere,
+		Geosphere,
+		Cylinder,
+		Grid,
+		Quad
+	};
+
+	// Dimensions go in Params and slice / stack / subdivision counts in Counts, so
+	// counts compare exactly whatever their size.
+	struct Key
+	{
+		Shape Type = Shape::Box;
+		float Params[5] = {};
+		uint32 Counts[2] = {};
+
+		bool operator==(const Key& rhs)const;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key)const;
+	};
+
+	// A shape uploaded into its own vertex / index buffer. The geometry is shared with
+	// every other user of the shape, so it is read-only.
+	struct GpuMesh
+	{
+		std::shared_ptr<const MeshGeometry> Geometry;
+		SubmeshGeometry Submesh;
+	};
+
+	// Argument order matches the GeometryGenerator functions.
+	static Key BoxKey(float width, float height, float depth, uint32 numSubdivisions);
+	static Key SphereKey(float radius, uint32 sliceCount, uint32 stackCount);
+	static Key GeosphereKey(float radius, uint32 numSubdivisions);
+	static Key CylinderKey(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+	static Key GridKey(float width, float depth, uint32 m, uint32 n);
+	static Key QuadKey(float x, float y, float w, float h, float depth);
+
+	std::shared_ptr<const GeometryGenerator::MeshData> Get(const Key& key);
+
+	std::shared_ptr<const GeometryGenerator::MeshData> GetBox(float width, float height, float depth, uint32 numSubdivisions);
+	std::shared_ptr<const GeometryGenerator::MeshData> GetSphere(float radius, uint32 sliceCount, uint32 stackCount);
+	std::shared_ptr<const GeometryGenerator::MeshData> GetGeosphere(float radius, uint32 numSubdivisions);
+	std::shared_ptr<const GeometryGenerator::MeshData> GetCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+	std::shared_ptr<const GeometryGenerator::MeshData> GetGrid(float width, float depth, uint32 m, uint32 n);
+	std::shared_ptr<const GeometryGenerator::MeshData> GetQuad(float x, float y, float w, float h, float depth);
+
+	///<summary>
+	/// Returns the uploaded geometry for key, recording the upload on cmdList the first
+	/// time the shape is requested. Call DisposeUploaders once that command list has
+	/// finished executing.
+	/// Later calls return the geometry at once, even with another command list: the
+	/// buffers only hold the data once the recording list has executed, so a list that
+	/// draws with a shape must not run before the list that uploaded it (submit them
+	/// in order on one queue, or wait on the uploading list's fence).
+	///</summary>
+	GpuMesh GetGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const Key& key);
+
+	void DisposeUploaders();
+
+	// Drops meshes and geometry that are no longer referenced outside the cache.
+	void Trim();
+	void Clear();
+
+	size_t GetMeshCount();
+	size_t GetGeometryCount();
+
+private:
+	static GeometryGenerator::MeshData Generate(const Key& key);
+	static const char* GetShapeName(Shape shape);
+
+private:
+	struct GeometryEntry
+	{
+		std::shared_ptr<MeshGeometry> Geometry; // Writable for DisposeUploaders.
+		SubmeshGeometry Submesh;
+	};
+
+	std::mutex mMutex;
+
+	std::unordered_map<Key, std::shared_ptr<const GeometryGenerator::MeshData>, KeyHash> mMeshes;
+	std::unordered_map<Key, GeometryEntry, KeyHash> mGeometries;
+};
@@ -3,6 +3,9 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "MeshStreamWriter.h"
+#include "MathHelper.h"
+#include "FastMath.h"
 #include <algorithm>
 
 using namespace DirectX;
@@ -109,117 +112,159 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 	return meshData;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
+namespace
 {
-	MeshData meshData;
+	// Geometry is written through a sink (MeshData vectors or a MeshStreamWriter).
+	// Indices are relative to the first vertex the generator writes.
+	struct MeshDataSink
+	{
+		GeometryGenerator::MeshData& Mesh;
 
-	//
-	// Compute the vertices stating at the top pole and moving down the stacks.
-	//
+		void PushVertex(const GeometryGenerator::Vertex& v) { Mesh.Vertices.push_back(v); }
+		void PushIndex(GeometryGenerator::uint32 index) { Mesh.Indices32.push_back(index); }
+		GeometryGenerator::uint32 GetVertexCount()const { return (GeometryGenerator::uint32)Mesh.Vertices.size(); }
+	};
 
-	// Poles: note that there will be texture coordinate distortion as there is
-	// not a unique point on the texture map to assign to the pole when mapping
-	// a rectangular texture onto a sphere.
-	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	template<typename Sink>
+	void GenerateSphere(float radius, GeometryGenerator::uint32 sliceCount, GeometryGenerator::uint32 stackCount, Sink& sink)
+	{
+		using Vertex = GeometryGenerator::Vertex;
+		using uint32 = GeometryGenerator::uint32;
 
-	meshData.Vertices.push_back(topVertex);
+		uint32 baseVertex = sink.GetVertexCount();
 
-	float phiStep = XM_PI / stackCount;
-	float thetaStep = 2.0f*XM_PI / sliceCount;
+		//
+		// Compute the vertices stating at the top pole and moving down the stacks.
+		//
 
-	// Compute vertices for each stack ring (do not count the poles as rings).
-	for (uint32 i = 1; i <= stackCount - 1; ++i)
-	{
-		float phi = i * phiStep;
+		// Poles: note that there will be texture coordinate distortion as there is
+		// not a unique point on the texture map to assign to the pole when mapping
+		// a rectangular texture onto a sphere.
+		Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+		Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+
+		sink.PushVertex(topVertex);
 
-		// Vertices of ring.
-		for (uint32 j = 0; j <= sliceCount; ++j)
+		float phiStep = XM_PI / stackCount;
+		float thetaStep = 2.0f*XM_PI / sliceCount;
+
+		// Compute vertices for each stack ring (do not count the poles as rings).
+		for (uint32 i = 1; i <= stackCount - 1; ++i)
 		{
-			float theta = j * thetaStep;
+			float phi = i * phiStep;
+
+			// Vertices of ring.
+			for (uint32 j = 0; j <= sliceCount; ++j)
+			{
+				float theta = j * thetaStep;
 
-			Vertex v;
+				Vertex v;
 
-			// spherical to cartesian
-			v.Position.x = radius * sinf(phi)*cosf(theta);
-			v.Position.y = radius * cosf(phi);
-			v.Position.z = radius * sinf(phi)*sinf(theta);
+				// spherical to cartesian
+				v.Position.x = radius * sinf(phi)*cosf(theta);
+				v.Position.y = radius * cosf(phi);
+				v.Position.z = radius * sinf(phi)*sinf(theta);
 
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius * sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius * sinf(phi)*cosf(theta);
+				// Partial derivative of P with respect to theta
+				v.TangentU.x = -radius * sinf(phi)*sinf(theta);
+				v.TangentU.y = 0.0f;
+				v.TangentU.z = +radius * sinf(phi)*cosf(theta);
 
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+				XMVECTOR T = XMLoadFloat3(&v.TangentU);
+				XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
 
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+				XMVECTOR p = XMLoadFloat3(&v.Position);
+				XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
 
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
+				v.TexC.x = theta / XM_2PI;
+				v.TexC.y = phi / XM_PI;
 
-			meshData.Vertices.push_back(v);
+				sink.PushVertex(v);
+			}
 		}
-	}
 
-	meshData.Vertices.push_back(bottomVertex);
+		sink.PushVertex(bottomVertex);
 
-	//
-	// Compute indices for top stack.  The top stack was written first to the vertex buffer
-	// and connects the top pole to the first ring.
-	//
+		//
+		// Compute indices for top stack.  The top stack was written first to the vertex buffer
+		// and connects the top pole to the first ring.
+		//
 
-	for (uint32 i = 1; i <= sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i + 1);
-		meshData.Indices32.push_back(i);
-	}
+		for (uint32 i = 1; i <= sliceCount; ++i)
+		{
+			sink.PushIndex(0);
+			sink.PushIndex(i + 1);
+			sink.PushIndex(i);
+		}
 
-	//
-	// Compute indices for inner stacks (not connected to poles).
-	//
+		//
+		// Compute indices for inner stacks (not connected to poles).
+		//
 
-	// Offset the indices to the index of the first vertex in the first ring.
-	// This is just skipping the top pole vertex.
-	uint32 baseIndex = 1;
-	uint32 ringVertexCount = sliceCount + 1;
-	for (uint32 i = 0; i < stackCount - 2; ++i)
-	{
-		for (uint32 j = 0; j < sliceCount; ++j)
+		// Offset the indices to the index of the first vertex in the first ring.
+		// This is just skipping the top pole vertex.
+		uint32 baseIndex = 1;
+		uint32 ringVertexCount = sliceCount + 1;
+		for (uint32 i = 0; i < stackCount - 2; ++i)
 		{
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(baseIndex + (i + 1)*ringVertexCount + j);
-
-			meshData.Indices32.push_back(baseIndex + (i + 1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(baseIndex + (i + 1)*ringVertexCount + j + 1);
+			for (uint32 j = 0; j < sliceCount; ++j)
+			{
+				sink.PushIndex(baseIndex + i * ringVertexCount + j);
+				sink.PushIndex(baseIndex + i * ringVertexCount + j + 1);
+				sink.PushIndex(baseIndex + (i + 1)*ringVertexCount + j);
+
+				sink.PushIndex(baseIndex + (i + 1)*ringVertexCount + j);
+				sink.PushIndex(baseIndex + i * ringVertexCount + j + 1);
+				sink.PushIndex(baseIndex + (i + 1)*ringVertexCount + j + 1);
+			}
 		}
-	}
 
-	//
-	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
-	// and connects the bottom pole to the bottom ring.
-	//
+		//
+		// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
+		// and connects the bottom pole to the bottom ring.
+		//
 
-	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size() - 1;
+		// South pole vertex was added last.
+		uint32 southPoleIndex = sink.GetVertexCount() - baseVertex - 1;
 
-	// Offset the indices to the index of the first vertex in the last ring.
-	baseIndex = southPoleIndex - ringVertexCount;
+		// Offset the indices to the index of the first vertex in the last ring.
+		baseIndex = southPoleIndex - ringVertexCount;
 
-	for (uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i + 1);
+		for (uint32 i = 0; i < sliceCount; ++i)
+		{
+			sink.PushIndex(southPoleIndex);
+			sink.PushIndex(baseIndex + i);
+			sink.PushIndex(baseIndex + i + 1);
+		}
 	}
+}
+
+GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
+{
+	MeshData meshData;
+
+	uint32 vertexCount, indexCount;
+	GetSphereCounts(sliceCount, stackCount, vertexCount, indexCount);
+	meshData.Vertices.reserve(vertexCount);
+	meshData.Indices32.reserve(indexCount);
+
+	MeshDataSink sink{ meshData };
+	GenerateSphere(radius, sliceCount, stackCount, sink);
 
 	return meshData;
 }
 
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, MeshStreamWriter& writer)
+{
+	GenerateSphere(radius, sliceCount, stackCount, writer);
+}
+
+void GeometryGenerator::GetSphereCounts(uint32 sliceCount, uint32 stackCount, uint32& vertexCount, uint32& indexCount)
+{
+	vertexCount = 2 + (stackCount - 1) * (sliceCount + 1);
+	indexCount = 6 * sliceCount + 6 * sliceCount * (stackCount - 2);
+}
+
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
 	MeshData inputCopy = meshData;
@@ -357,7 +402,9 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 		Subdivide(meshData);
 
 	// Project vertices onto sphere and scale.
-	for (uint32 i = 0; i < meshData.Vertices.size(); ++i)
+	size_t vertexCount = meshData.Vertices.size();
+	std::vector<float> x(vertexCount), y(vertexCount), z(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i)
 	{
 		// Project onto unit sphere.
 		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
@@ -368,22 +415,31 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 		XMStoreFloat3(&meshData.Vertices[i].Position, p);
 		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
 
-		// Derive texture coordinates from spherical coordinates.
-		float theta = atan2f(meshData.Vertices[i].Position.z, meshData.Vertices[i].Position.x);
+		x[i] = meshData.Vertices[i].Normal.x;
+		y[i] = meshData.Vertices[i].Normal.y;
+		z[i] = meshData.Vertices[i].Normal.z;
+	}
 
-		// Put in [0, 2pi].
-		if (theta < 0.0f)
-			theta += XM_2PI;
+	// Derive texture coordinates from spherical coordinates, all vertices at once.
+	// x holds theta in [0, 2pi] and then cos(theta), z sin(theta), y phi.
+	MathHelper::AngleFromXY(x.data(), z.data(), x.data(), vertexCount);
+	FastMath::ACos(y.data(), y.data(), vertexCount);
 
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		meshData.Vertices[i].TexC.x = x[i] / XM_2PI;
+		meshData.Vertices[i].TexC.y = y[i] / XM_PI;
+	}
 
-		meshData.Vertices[i].TexC.x = theta / XM_2PI;
-		meshData.Vertices[i].TexC.y = phi / XM_PI;
+	FastMath::SinCos(x.data(), z.data(), x.data(), vertexCount);
 
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
 		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius * sinf(phi)*sinf(theta);
+		float sinPhi = sqrtf(std::max(0.0f, 1.0f - meshData.Vertices[i].Normal.y*meshData.Vertices[i].Normal.y));
+		meshData.Vertices[i].TangentU.x = -radius * sinPhi*z[i];
 		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius * sinf(phi)*cosf(theta);
+		meshData.Vertices[i].TangentU.z = +radius * sinPhi*x[i];
 
 		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
 		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
@@ -392,279 +448,309 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 	return meshData;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
+namespace
 {
-	MeshData meshData;
-
-	//
-	// Build Stacks.
-	// 
-
-	float stackHeight = height / stackCount;
-
-	// Amount to increment radius as we move up each stack level from bottom to top.
-	float radiusStep = (topRadius - bottomRadius) / stackCount;
-
-	uint32 ringCount = stackCount + 1;
-
-	// Compute vertices for each stack ring starting at the bottom and moving up.
-	for (uint32 i = 0; i < ringCount; ++i)
+	template<typename Sink>
+	void GenerateCylinderCap(float radius, float height, float y, float normalY, bool topCap,
+		GeometryGenerator::uint32 sliceCount, GeometryGenerator::uint32 baseVertex, Sink& sink)
 	{
-		float y = -0.5f*height + i * stackHeight;
-		float r = bottomRadius + i * radiusStep;
+		using Vertex = GeometryGenerator::Vertex;
+		using uint32 = GeometryGenerator::uint32;
+
+		uint32 baseIndex = sink.GetVertexCount() - baseVertex;
 
-		// vertices of ring
+		// Duplicate cap ring vertices because the texture coordinates and normals differ.
 		float dTheta = 2.0f*XM_PI / sliceCount;
-		for (uint32 j = 0; j <= sliceCount; ++j)
+		for (uint32 i = 0; i <= sliceCount; ++i)
 		{
-			Vertex vertex;
-
-			float c = cosf(j*dTheta);
-			float s = sinf(j*dTheta);
-
-			vertex.Position = XMFLOAT3(r*c, y, r*s);
-
-			vertex.TexC.x = (float)j / sliceCount;
-			vertex.TexC.y = 1.0f - (float)i / stackCount;
-
-			// Cylinder can be parameterized as follows, where we introduce v
-			// parameter that goes in the same direction as the v tex-coord
-			// so that the bitangent goes in the same direction as the v tex-coord.
-			//   Let r0 be the bottom radius and let r1 be the top radius.
-			//   y(v) = h - hv for v in [0,1].
-			//   r(v) = r1 + (r0-r1)v
-			//
-			//   x(t, v) = r(v)*cos(t)
-			//   y(t, v) = h - hv
-			//   z(t, v) = r(v)*sin(t)
-			// 
-			//  dx/dt = -r(v)*sin(t)
-			//  dy/dt = 0
-			//  dz/dt = +r(v)*cos(t)
-			//
-			//  dx/dv = (r0-r1)*cos(t)
-			//  dy/dv = -h
-			//  dz/dv = (r0-r1)*sin(t)
-
-			// This is unit length.
-			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
-
-			float dr = bottomRadius - topRadius;
-			XMFLOAT3 bitangent(dr*c, -height, dr*s);
-
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
-
-			meshData.Vertices.push_back(vertex);
+			float x = radius * cosf(i*dTheta);
+			float z = radius * sinf(i*dTheta);
+
+			// Scale down by the height to try and make top cap texture coord area
+			// proportional to base.
+			float u = x / height + 0.5f;
+			float v = z / height + 0.5f;
+
+			sink.PushVertex(Vertex(x, y, z, 0.0f, normalY, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
 		}
-	}
 
-	// Add one because we duplicate the first and last vertex per ring
-	// since the texture coordinates are different.
-	uint32 ringVertexCount = sliceCount + 1;
+		// Cap center vertex.
+		sink.PushVertex(Vertex(0.0f, y, 0.0f, 0.0f, normalY, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
 
-	// Compute indices for each stack.
-	for (uint32 i = 0; i < stackCount; ++i)
-	{
-		for (uint32 j = 0; j < sliceCount; ++j)
-		{
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1)*ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1)*ringVertexCount + j + 1);
+		// Index of center vertex.
+		uint32 centerIndex = sink.GetVertexCount() - baseVertex - 1;
 
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1)*ringVertexCount + j + 1);
-			meshData.Indices32.push_back(i*ringVertexCount + j + 1);
+		// The top cap is wound the other way around so both caps face outward.
+		for (uint32 i = 0; i < sliceCount; ++i)
+		{
+			sink.PushIndex(centerIndex);
+			sink.PushIndex(topCap ? baseIndex + i + 1 : baseIndex + i);
+			sink.PushIndex(topCap ? baseIndex + i : baseIndex + i + 1);
 		}
 	}
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	template<typename Sink>
+	void GenerateCylinder(float bottomRadius, float topRadius, float height,
+		GeometryGenerator::uint32 sliceCount, GeometryGenerator::uint32 stackCount, Sink& sink)
+	{
+		using Vertex = GeometryGenerator::Vertex;
+		using uint32 = GeometryGenerator::uint32;
 
-	return meshData;
-}
+		uint32 baseVertex = sink.GetVertexCount();
 
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-	uint32 sliceCount, uint32 stackCount, MeshData& meshData)
-{
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
+		//
+		// Build Stacks.
+		// 
 
-	float y = 0.5f*height;
-	float dTheta = 2.0f*XM_PI / sliceCount;
+		float stackHeight = height / stackCount;
 
-	// Duplicate cap ring vertices because the texture coordinates and normals differ.
-	for (uint32 i = 0; i <= sliceCount; ++i)
-	{
-		float x = topRadius * cosf(i*dTheta);
-		float z = topRadius * sinf(i*dTheta);
+		// Amount to increment radius as we move up each stack level from bottom to top.
+		float radiusStep = (topRadius - bottomRadius) / stackCount;
 
-		// Scale down by the height to try and make top cap texture coord area
-		// proportional to base.
-		float u = x / height + 0.5f;
-		float v = z / height + 0.5f;
+		uint32 ringCount = stackCount + 1;
 
-		meshData.Vertices.push_back(Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
-	}
+		// Compute vertices for each stack ring starting at the bottom and moving up.
+		for (uint32 i = 0; i < ringCount; ++i)
+		{
+			float y = -0.5f*height + i * stackHeight;
+			float r = bottomRadius + i * radiusStep;
+
+			// vertices of ring
+			float dTheta = 2.0f*XM_PI / sliceCount;
+			for (uint32 j = 0; j <= sliceCount; ++j)
+			{
+				Vertex vertex;
+
+				float c = cosf(j*dTheta);
+				float s = sinf(j*dTheta);
+
+				vertex.Position = XMFLOAT3(r*c, y, r*s);
+
+				vertex.TexC.x = (float)j / sliceCount;
+				vertex.TexC.y = 1.0f - (float)i / stackCount;
+
+				// Cylinder can be parameterized as follows, where we introduce v
+				// parameter that goes in the same direction as the v tex-coord
+				// so that the bitangent goes in the same direction as the v tex-coord.
+				//   Let r0 be the bottom radius and let r1 be the top radius.
+				//   y(v) = h - hv for v in [0,1].
+				//   r(v) = r1 + (r0-r1)v
+				//
+				//   x(t, v) = r(v)*cos(t)
+				//   y(t, v) = h - hv
+				//   z(t, v) = r(v)*sin(t)
+				// 
+				//  dx/dt = -r(v)*sin(t)
+				//  dy/dt = 0
+				//  dz/dt = +r(v)*cos(t)
+				//
+				//  dx/dv = (r0-r1)*cos(t)
+				//  dy/dv = -h
+				//  dz/dv = (r0-r1)*sin(t)
+
+				// This is unit length.
+				vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
+
+				float dr = bottomRadius - topRadius;
+				XMFLOAT3 bitangent(dr*c, -height, dr*s);
+
+				XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
+				XMVECTOR B = XMLoadFloat3(&bitangent);
+				XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
+				XMStoreFloat3(&vertex.Normal, N);
+
+				sink.PushVertex(vertex);
+			}
+		}
 
-	// Cap center vertex.
-	meshData.Vertices.push_back(Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+		// Add one because we duplicate the first and last vertex per ring
+		// since the texture coordinates are different.
+		uint32 ringVertexCount = sliceCount + 1;
 
-	// Index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size() - 1;
+		// Compute indices for each stack.
+		for (uint32 i = 0; i < stackCount; ++i)
+		{
+			for (uint32 j = 0; j < sliceCount; ++j)
+			{
+				sink.PushIndex(i*ringVertexCount + j);
+				sink.PushIndex((i + 1)*ringVertexCount + j);
+				sink.PushIndex((i + 1)*ringVertexCount + j + 1);
+
+				sink.PushIndex(i*ringVertexCount + j);
+				sink.PushIndex((i + 1)*ringVertexCount + j + 1);
+				sink.PushIndex(i*ringVertexCount + j + 1);
+			}
+		}
 
-	for (uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i + 1);
-		meshData.Indices32.push_back(baseIndex + i);
+		GenerateCylinderCap(topRadius, height, 0.5f*height, 1.0f, true, sliceCount, baseVertex, sink);
+		GenerateCylinderCap(bottomRadius, height, -0.5f*height, -1.0f, false, sliceCount, baseVertex, sink);
 	}
 }
 
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-	uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
-	// 
-	// Build bottom cap.
-	//
-
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
-	float y = -0.5f*height;
-
-	// vertices of ring
-	float dTheta = 2.0f*XM_PI / sliceCount;
-	for (uint32 i = 0; i <= sliceCount; ++i)
-	{
-		float x = bottomRadius * cosf(i*dTheta);
-		float z = bottomRadius * sinf(i*dTheta);
-
-		// Scale down by the height to try and make top cap texture coord area
-		// proportional to base.
-		float u = x / height + 0.5f;
-		float v = z / height + 0.5f;
+	MeshData meshData;
 
-		meshData.Vertices.push_back(Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
-	}
+	uint32 vertexCount, indexCount;
+	GetCylinderCounts(sliceCount, stackCount, vertexCount, indexCount);
+	meshData.Vertices.reserve(vertexCount);
+	meshData.Indices32.reserve(indexCount);
 
-	// Cap center vertex.
-	meshData.Vertices.push_back(Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+	MeshDataSink sink{ meshData };
+	GenerateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, sink);
 
-	// Cache the index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size() - 1;
+	return meshData;
+}
 
-	for (uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i + 1);
-	}
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshStreamWriter& writer)
+{
+	GenerateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, writer);
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
+void GeometryGenerator::GetCylinderCounts(uint32 sliceCount, uint32 stackCount, uint32& vertexCount, uint32& indexCount)
 {
-	MeshData meshData;
+	// Side rings plus two caps of (ring + center).
+	vertexCount = (stackCount + 1) * (sliceCount + 1) + 2 * (sliceCount + 2);
+	indexCount = 6 * sliceCount * stackCount + 2 * 3 * sliceCount;
+}
 
-	uint32 vertexCount = m * n;
-	uint32 faceCount = (m - 1)*(n - 1) * 2;
+namespace
+{
+	template<typename Sink>
+	void GenerateGrid(float width, float depth, GeometryGenerator::uint32 m, GeometryGenerator::uint32 n, Sink& sink)
+	{
+		using Vertex = GeometryGenerator::Vertex;
+		using uint32 = GeometryGenerator::uint32;
 
-	//
-	// Create the vertices.
-	//
+		//
+		// Create the vertices.
+		//
 
-	float halfWidth = 0.5f*width;
-	float halfDepth = 0.5f*depth;
+		float halfWidth = 0.5f*width;
+		float halfDepth = 0.5f*depth;
 
-	float dx = width / (n - 1);
-	float dz = depth / (m - 1);
+		float dx = width / (n - 1);
+		float dz = depth / (m - 1);
 
-	float du = 1.0f / (n - 1);
-	float dv = 1.0f / (m - 1);
+		float du = 1.0f / (n - 1);
+		float dv = 1.0f / (m - 1);
 
-	meshData.Vertices.resize(vertexCount);
-	for (uint32 i = 0; i < m; ++i)
-	{
-		float z = halfDepth - i * dz;
-		for (uint32 j = 0; j < n; ++j)
+		for (uint32 i = 0; i < m; ++i)
 		{
-			float x = -halfWidth + j * dx;
+			float z = halfDepth - i * dz;
+			for (uint32 j = 0; j < n; ++j)
+			{
+				float x = -halfWidth + j * dx;
+
+				// Stretch texture over grid.
+				sink.PushVertex(Vertex(
+					x, 0.0f, z,
+					0.0f, 1.0f, 0.0f,
+					1.0f, 0.0f, 0.0f,
+					j * du, i * dv));
+			}
+		}
 
-			meshData.Vertices[i*n + j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n + j].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n + j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		//
+		// Create the indices.
+		//
 
-			// Stretch texture over grid.
-			meshData.Vertices[i*n + j].TexC.x = j * du;
-			meshData.Vertices[i*n + j].TexC.y = i * dv;
+		// Iterate over each quad and compute indices.
+		for (uint32 i = 0; i < m - 1; ++i)
+		{
+			for (uint32 j = 0; j < n - 1; ++j)
+			{
+				sink.PushIndex(i * n + j);
+				sink.PushIndex(i * n + j + 1);
+				sink.PushIndex((i + 1)*n + j);
+
+				sink.PushIndex((i + 1)*n + j);
+				sink.PushIndex(i * n + j + 1);
+				sink.PushIndex((i + 1)*n + j + 1);
+			}
 		}
 	}
 
-	//
-	// Create the indices.
-	//
-
-	meshData.Indices32.resize(faceCount * 3); // 3 indices per face
-
-	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for (uint32 i = 0; i < m - 1; ++i)
+	template<typename Sink>
+	void GenerateQuad(float x, float y, float w, float h, float depth, Sink& sink)
 	{
-		for (uint32 j = 0; j < n - 1; ++j)
-		{
-			meshData.Indices32[k] = i * n + j;
-			meshData.Indices32[k + 1] = i * n + j + 1;
-			meshData.Indices32[k + 2] = (i + 1)*n + j;
+		using Vertex = GeometryGenerator::Vertex;
+
+		// Position coordinates specified in NDC space.
+		sink.PushVertex(Vertex(
+			x, y - h, depth,
+			0.0f, 0.0f, -1.0f,
+			1.0f, 0.0f, 0.0f,
+			0.0f, 1.0f));
+
+		sink.PushVertex(Vertex(
+			x, y, depth,
+			0.0f, 0.0f, -1.0f,
+			1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f));
+
+		sink.PushVertex(Vertex(
+			x + w, y, depth,
+			0.0f, 0.0f, -1.0f,
+			1.0f, 0.0f, 0.0f,
+			1.0f, 0.0f));
+
+		sink.PushVertex(Vertex(
+			x + w, y - h, depth,
+			0.0f, 0.0f, -1.0f,
+			1.0f, 0.0f, 0.0f,
+			1.0f, 1.0f));
+
+		sink.PushIndex(0);
+		sink.PushIndex(1);
+		sink.PushIndex(2);
+
+		sink.PushIndex(0);
+		sink.PushIndex(2);
+		sink.PushIndex(3);
+	}
+}
 
-			meshData.Indices32[k + 3] = (i + 1)*n + j;
-			meshData.Indices32[k + 4] = i * n + j + 1;
-			meshData.Indices32[k + 5] = (i + 1)*n + j + 1;
+GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
+{
+	MeshData meshData;
 
-			k += 6; // next quad
-		}
-	}
+	uint32 vertexCount, indexCount;
+	GetGridCounts(m, n, vertexCount, indexCount);
+	meshData.Vertices.reserve(vertexCount);
+	meshData.Indices32.reserve(indexCount);
+
+	MeshDataSink sink{ meshData };
+	GenerateGrid(width, depth, m, n, sink);
 
 	return meshData;
 }
 
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n, MeshStreamWriter& writer)
+{
+	GenerateGrid(width, depth, m, n, writer);
+}
+
+void GeometryGenerator::GetGridCounts(uint32 m, uint32 n, uint32& vertexCount, uint32& indexCount)
+{
+	vertexCount = m * n;
+	indexCount = (m - 1)*(n - 1) * 2 * 3; // 3 indices per face
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
 {
 	MeshData meshData;
 
-	meshData.Vertices.resize(4);
-	meshData.Indices32.resize(6);
-
-	// Position coordinates specified in NDC space.
-	meshData.Vertices[0] = Vertex(
-		x, y - h, depth,
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		0.0f, 1.0f);
-
-	meshData.Vertices[1] = Vertex(
-		x, y, depth,
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		0.0f, 0.0f);
-
-	meshData.Vertices[2] = Vertex(
-		x + w, y, depth,
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f);
-
-	meshData.Vertices[3] = Vertex(
-		x + w, y - h, depth,
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 1.0f);
-
-	meshData.Indices32[0] = 0;
-	meshData.Indices32[1] = 1;
-	meshData.Indices32[2] = 2;
-
-	meshData.Indices32[3] = 0;
-	meshData.Indices32[4] = 2;
-	meshData.Indices32[5] = 3;
+	meshData.Vertices.reserve(4);
+	meshData.Indices32.reserve(6);
+
+	MeshDataSink sink{ meshData };
+	GenerateQuad(x, y, w, h, depth, sink);
 
 	return meshData;
 }
+
+void GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth, MeshStreamWriter& writer)
+{
+	GenerateQuad(x, y, w, h, depth, writer);
+}
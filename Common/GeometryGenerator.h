@@ -18,6 +18,8 @@
 #include <DirectXMath.h>
 #include <vector>
 
+class MeshStreamWriter;
+
 class GeometryGenerator
 {
 public:
@@ -85,12 +87,14 @@ public:
 	/// slices and stacks parameters control the degree of tessellation.
 	///</summary>
 	MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
+	void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, MeshStreamWriter& writer);
+	static void GetSphereCounts(uint32 sliceCount, uint32 stackCount, uint32& vertexCount, uint32& indexCount);
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
 	/// depth controls the level of tessellation.
 	///</summary>
-	MeshData CreateGeoSphere(float radius, uint32 sliceCount, uint32 stackCount);
+	MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -98,22 +102,30 @@ public:
 	/// cylinders.  The slices and stacks parameters control the degree of tessellation.
 	///</summary>
 	MeshData CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+	void CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshStreamWriter& writer);
+	static void GetCylinderCounts(uint32 sliceCount, uint32 stackCount, uint32& vertexCount, uint32& indexCount);
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
 	/// at the origin with the specified width and depth.
 	///</summary>
 	MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
+	void CreateGrid(float width, float depth, uint32 m, uint32 n, MeshStreamWriter& writer);
+	static void GetGridCounts(uint32 m, uint32 n, uint32& vertexCount, uint32& indexCount);
 
 	///<summary>
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
 	MeshData CreateQuad(float x, float y, float w, float h, float depth);
+	void CreateQuad(float x, float y, float w, float h, float depth, MeshStreamWriter& writer);
+
+	// The MeshStreamWriter overloads write the same vertices and indices as the MeshData
+	// versions straight into (mapped upload) memory. Use the Get*Counts functions to size
+	// the destination first. Indices start at 0 for each mesh, so draw them with
+	// SubmeshGeometry::BaseVertexLocation set to the writer's vertex count before the call.
 
 private:
 	void Subdivide(MeshData& meshData);
 	Vertex MidPoint(const Vertex& v0, const Vertex& v1);
-	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
-	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
 };
 
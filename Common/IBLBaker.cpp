@@ -0,0 +1,378 @@
+//***************************************************************************************
+// IBLBaker.cpp
+//***************************************************************************************
+
+#include "IBLBaker.h"
+#include "DDSTextureLoader.h"
+#include "FormatConversion.h"
+#include "LowDiscrepancy.h"
+#include "MathHelper.h"
+#include "ThreadPool.h"
+#include "d3dUtil.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace
+{
+	// Texels per ParallelFor chunk (whole rows).
+	const size_t GrainTexels = 4096;
+
+	// Bump when the baked output changes so stale cache files are not picked up.
+	const std::uint64_t BakeVersion = 1;
+
+	struct Level
+	{
+		std::uint32_t Size;
+		const float* Texels;
+	};
+
+	// Prefilter sample in the tangent frame of N = V = R.
+	struct GgxSample
+	{
+		XMFLOAT3 L;
+		float NdotL;
+		float Lod;
+	};
+
+	// Box filtered mip chain of the source, down to 1x1.
+	std::vector<std::vector<float>> BuildSourceChain(const float* texels, std::uint32_t faceSize)
+	{
+		std::vector<std::vector<float>> chain;
+		chain.emplace_back(texels, texels + 6 * (size_t)faceSize * faceSize * 4);
+
+		for (std::uint32_t srcSize = faceSize, size = faceSize / 2; size >= 1; srcSize = size, size /= 2)
+		{
+			const std::vector<float>& src = chain.back();
+			std::vector<float> dst(6 * (size_t)size * size * 4);
+
+			for (size_t face = 0; face < 6; ++face)
+			{
+				for (size_t y = 0; y < size; ++y)
+				{
+					for (size_t x = 0; x < size; ++x)
+					{
+						const float* s00 = &src[((face * srcSize + 2 * y) * srcSize + 2 * x) * 4];
+						const float* s10 = s00 + srcSize * 4;
+						float* d = &dst[((face * size + y) * size + x) * 4];
+						for (int c = 0; c < 4; ++c)
+							d[c] = 0.25f * (s00[c] + s00[c + 4] + s10[c] + s10[c + 4]);
+					}
+				}
+			}
+
+			chain.push_back(std::move(dst));
+		}
+
+		return chain;
+	}
+
+	XMVECTOR SampleBilinear(const Level& level, int face, float u, float v)
+	{
+		float size = (float)level.Size;
+		float fx = MathHelper::Clamp((u + 1.0f) * 0.5f * size - 0.5f, 0.0f, size - 1.0f);
+		float fy = MathHelper::Clamp((v + 1.0f) * 0.5f * size - 0.5f, 0.0f, size - 1.0f);
+
+		std::uint32_t x0 = (std::uint32_t)fx, y0 = (std::uint32_t)fy;
+		std::uint32_t x1 = std::min(x0 + 1, level.Size - 1), y1 = std::min(y0 + 1, level.Size - 1);
+		float tx = fx - x0, ty = fy - y0;
+
+		const float* faceTexels = level.Texels + (size_t)face * level.Size * level.Size * 4;
+		auto texel = [&](std::uint32_t x, std::uint32_t y)
+		{
+			return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(faceTexels + ((size_t)y * level.Size + x) * 4));
+		};
+
+		XMVECTOR top = XMVectorLerp(texel(x0, y0), texel(x1, y0), tx);
+		XMVECTOR bottom = XMVectorLerp(texel(x0, y1), texel(x1, y1), tx);
+		return XMVectorLerp(top, bottom, ty);
+	}
+
+	// Trilinear lookup; faces are filtered separately (no seam blending).
+	XMVECTOR SampleCube(const std::vector<Level>& levels, FXMVECTOR dir, float lod)
+	{
+		float u, v;
+		int face = MathHelper::CubeFaceFromDirection(dir, &u, &v);
+
+		lod = MathHelper::Clamp(lod, 0.0f, (float)(levels.size() - 1));
+		size_t l0 = (size_t)lod;
+		size_t l1 = std::min(l0 + 1, levels.size() - 1);
+
+		XMVECTOR c0 = SampleBilinear(levels[l0], face, u, v);
+		if (l1 == l0)
+			return c0;
+
+		return XMVectorLerp(c0, SampleBilinear(levels[l1], face, u, v), lod - l0);
+	}
+
+	// GGX half vector around +z for a point of [0,1)^2 (alpha = roughness^2).
+	XMFLOAT3 ImportanceSampleGgx(const XMFLOAT2& xi, float alpha)
+	{
+		float phi = 2.0f * MathHelper::Pi * xi.x;
+		float cosTheta = sqrtf((1.0f - xi.y) / (1.0f + (alpha * alpha - 1.0f) * xi.y));
+		float sinTheta = sqrtf(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+
+		return XMFLOAT3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+	}
+
+	std::vector<GgxSample> BuildGgxSamples(float roughness, std::uint32_t sampleCount, std::uint32_t sourceSize)
+	{
+		std::vector<XMFLOAT2> xi(sampleCount);
+		LowDiscrepancy::Fill2D(LowDiscrepancy::Sequence::Sobol, xi.data(), xi.size());
+
+		float alpha = roughness * roughness;
+		float a2 = alpha * alpha;
+		float texelSolidAngle = 4.0f * MathHelper::Pi / (6.0f * sourceSize * sourceSize);
+
+		std::vector<GgxSample> samples;
+		for (const XMFLOAT2& p : xi)
+		{
+			XMFLOAT3 h = ImportanceSampleGgx(p, alpha);
+
+			// L = reflect(-V, H) with V = N = +z.
+			GgxSample s;
+			s.L = XMFLOAT3(2.0f * h.z * h.x, 2.0f * h.z * h.y, 2.0f * h.z * h.z - 1.0f);
+			s.NdotL = s.L.z;
+			if (s.NdotL <= 0.0f)
+				continue;
+
+			// pdf(L) = D * NdotH / (4 * VdotH) = D / 4 here; read the source mip whose
+			// texels cover the sample's share of the sphere (+1 for smoother results).
+			float d = (h.z * h.z * (a2 - 1.0f) + 1.0f);
+			float pdf = a2 / (MathHelper::Pi * d * d) * 0.25f;
+			float sampleSolidAngle = 1.0f / (sampleCount * pdf + 1e-6f);
+			s.Lod = std::max(0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f, 0.0f);
+
+			samples.push_back(s);
+		}
+
+		return samples;
+	}
+
+	float SmithGgxIbl(float NdotV, float NdotL, float roughness)
+	{
+		// Schlick-GGX with k = alpha / 2, as for image based lighting in Karis 2013.
+		float k = roughness * roughness * 0.5f;
+		float gv = NdotV / (NdotV * (1.0f - k) + k);
+		float gl = NdotL / (NdotL * (1.0f - k) + k);
+		return gv * gl;
+	}
+
+	// desc.MipCount clamped to the full chain of desc.FaceSize.
+	std::uint32_t GetPrefilteredMipCount(const IBLBaker::Desc& desc)
+	{
+		std::uint32_t fullChain = 1;
+		while ((desc.FaceSize >> fullChain) > 0)
+			++fullChain;
+		return MathHelper::Clamp<std::uint32_t>(desc.MipCount, 1, fullChain);
+	}
+
+	std::wstring JoinPath(const std::wstring& directory, const std::wstring& name)
+	{
+		if (directory.empty() || directory.back() == L'/' || directory.back() == L'\\')
+			return directory + name;
+		return directory + L"/" + name;
+	}
+
+	template<typename Func>
+	void ForEachRow(size_t rowCount, size_t rowSize, ThreadPool* pool, Func&& func)
+	{
+		size_t grain = std::max<size_t>(1, GrainTexels / std::max<size_t>(rowSize, 1));
+		if (pool == nullptr || rowCount <= grain)
+			func(0, rowCount);
+		else
+			pool->ParallelFor(rowCount, grain, func);
+	}
+}
+
+float IBLBaker::MipRoughness(uint32 mip, uint32 mipCount)
+{
+	return mipCount > 1 ? (float)mip / (mipCount - 1) : 0.0f;
+}
+
+IBLBaker::CubeMap IBLBaker::PrefilterGGX(const float* texels, uint32 faceSize, const Desc& desc, ThreadPool* pool)
+{
+	assert(texels != nullptr && faceSize > 0 && desc.FaceSize > 0);
+
+	std::vector<std::vector<float>> chain = BuildSourceChain(texels, faceSize);
+	std::vector<Level> levels;
+	for (size_t i = 0; i < chain.size(); ++i)
+		levels.push_back(Level{ std::max<uint32>(faceSize >> i, 1), chain[i].data() });
+
+	uint32 mipCount = GetPrefilteredMipCount(desc);
+
+	CubeMap result;
+	result.FaceSize = desc.FaceSize;
+	result.Mips.resize(mipCount);
+
+	for (uint32 mip = 0; mip < mipCount; ++mip)
+	{
+		const uint32 size = std::max<uint32>(desc.FaceSize >> mip, 1);
+		const float roughness = MipRoughness(mip, mipCount);
+		std::vector<float>& out = result.Mips[mip];
+		out.resize(6 * (size_t)size * size * 4);
+
+		// Mirror reflection: just resample the source at this mip's footprint.
+		std::vector<GgxSample> samples;
+		float mirrorLod = std::max(0.0f, log2f((float)faceSize / size));
+		if (roughness > 0.0f)
+			samples = BuildGgxSamples(roughness, std::max<uint32>(desc.SampleCount, 1), faceSize);
+
+		ForEachRow(6 * (size_t)size, size, pool, [&](size_t begin, size_t end)
+		{
+			for (size_t r = begin; r < end; ++r)
+			{
+				int face = (int)(r / size);
+				float v = 2.0f * ((r % size) + 0.5f) / size - 1.0f;
+
+				for (uint32 x = 0; x < size; ++x)
+				{
+					float u = 2.0f * (x + 0.5f) / size - 1.0f;
+					XMVECTOR n = XMVector3Normalize(MathHelper::CubeFaceDirection(face, u, v));
+
+					XMVECTOR color;
+					if (samples.empty())
+					{
+						color = SampleCube(levels, n, mirrorLod);
+					}
+					else
+					{
+						XMVECTOR up = fabsf(XMVectorGetZ(n)) < 0.999f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+						XMVECTOR t = XMVector3Normalize(XMVector3Cross(up, n));
+						XMVECTOR b = XMVector3Cross(n, t);
+
+						color = XMVectorZero();
+						float weight = 0.0f;
+						for (const GgxSample& s : samples)
+						{
+							XMVECTOR l = XMVectorMultiplyAdd(t, XMVectorReplicate(s.L.x),
+								XMVectorMultiplyAdd(b, XMVectorReplicate(s.L.y), XMVectorScale(n, s.L.z)));
+							color = XMVectorMultiplyAdd(SampleCube(levels, l, s.Lod), XMVectorReplicate(s.NdotL), color);
+							weight += s.NdotL;
+						}
+						color = XMVectorScale(color, 1.0f / weight);
+					}
+
+					XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&out[(r * size + x) * 4]), color);
+				}
+			}
+		});
+	}
+
+	return result;
+}
+
+std::vector<XMFLOAT2> IBLBaker::IntegrateBrdf(uint32 size, uint32 sampleCount, ThreadPool* pool)
+{
+	assert(size > 0 && sampleCount > 0);
+
+	std::vector<XMFLOAT2> xi(sampleCount);
+	LowDiscrepancy::Fill2D(LowDiscrepancy::Sequence::Sobol, xi.data(), xi.size());
+
+	std::vector<XMFLOAT2> lut((size_t)size * size);
+	ForEachRow(size, size, pool, [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; ++row)
+		{
+			float roughness = (row + 0.5f) / size;
+			float alpha = roughness * roughness;
+
+			for (uint32 column = 0; column < size; ++column)
+			{
+				float NdotV = (column + 0.5f) / size;
+				XMFLOAT3 v(sqrtf(1.0f - NdotV * NdotV), 0.0f, NdotV);
+
+				float a = 0.0f, b = 0.0f;
+				for (const XMFLOAT2& p : xi)
+				{
+					XMFLOAT3 h = ImportanceSampleGgx(p, alpha);
+					float VdotH = v.x * h.x + v.z * h.z;
+					float NdotL = 2.0f * VdotH * h.z - v.z;
+					if (NdotL <= 0.0f || VdotH <= 0.0f)
+						continue;
+
+					// G * VdotH / (NdotH * NdotV): the BRDF * NdotL / pdf of the sample.
+					float gVis = SmithGgxIbl(NdotV, NdotL, roughness) * VdotH / (h.z * NdotV);
+					float fc = powf(1.0f - VdotH, 5.0f);
+					a += (1.0f - fc) * gVis;
+					b += fc * gVis;
+				}
+
+				lut[row * size + column] = XMFLOAT2(a / sampleCount, b / sampleCount);
+			}
+		}
+	});
+
+	return lut;
+}
+
+void IBLBaker::SaveCubeMap(const std::wstring& filename, const CubeMap& cubeMap)
+{
+	// DDS order: each face with its whole mip chain.
+	std::vector<FormatConversion::uint16> halves;
+	for (size_t face = 0; face < 6; ++face)
+	{
+		for (size_t mip = 0; mip < cubeMap.Mips.size(); ++mip)
+		{
+			size_t faceFloats = cubeMap.Mips[mip].size() / 6;
+			size_t first = halves.size();
+			halves.resize(first + faceFloats);
+			FormatConversion::FloatToHalf(cubeMap.Mips[mip].data() + face * faceFloats, halves.data() + first, faceFloats);
+		}
+	}
+
+	ThrowIfFailed(DirectX::SaveDDSTextureToFile(filename.c_str(), DXGI_FORMAT_R16G16B16A16_FLOAT,
+		cubeMap.FaceSize, cubeMap.FaceSize, cubeMap.Mips.size(), true,
+		reinterpret_cast<const uint8_t*>(halves.data()), halves.size() * sizeof(halves[0])));
+}
+
+void IBLBaker::SaveBrdfLut(const std::wstring& filename, const std::vector<XMFLOAT2>& lut, uint32 size)
+{
+	assert(lut.size() == (size_t)size * size);
+
+	std::vector<FormatConversion::uint16> halves(lut.size() * 2);
+	FormatConversion::FloatToHalf(&lut[0].x, halves.data(), halves.size());
+
+	ThrowIfFailed(DirectX::SaveDDSTextureToFile(filename.c_str(), DXGI_FORMAT_R16G16_FLOAT, size, size, 1, false,
+		reinterpret_cast<const uint8_t*>(halves.data()), halves.size() * sizeof(halves[0])));
+}
+
+IBLBaker::BakeResult IBLBaker::Bake(const std::wstring& sourceFilename, const std::wstring& cacheDirectory,
+	const Desc& desc, ThreadPool* pool)
+{
+	// The source is decoded once: its texels are both hashed and, on a miss, prefiltered.
+	std::vector<float> texels;
+	size_t faceSize = 0;
+	ThrowIfFailed(DirectX::LoadDDSCubeMapFromFile(sourceFilename.c_str(), texels, &faceSize));
+
+	// Key: source texels, the settings that change the output and the baker version.
+	std::uint64_t key = StringUtil::Fnv1a(StringUtil::Fnv1aSeed, texels.data(), texels.size() * sizeof(float));
+	const std::uint32_t settings[] = { (std::uint32_t)faceSize, desc.FaceSize, desc.MipCount, desc.SampleCount };
+	key = StringUtil::Fnv1a(key, settings, sizeof(settings));
+	key = StringUtil::Fnv1a(key, &BakeVersion, sizeof(BakeVersion));
+
+	std::wostringstream name;
+	name << std::hex << std::setw(16) << std::setfill(L'0') << key << L"_ggx.dds";
+
+	BakeResult result;
+	result.PrefilteredFilename = JoinPath(cacheDirectory, name.str());
+	result.BrdfLutFilename = JoinPath(cacheDirectory,
+		L"brdf_lut_" + std::to_wstring(desc.LutSize) + L"_" + std::to_wstring(desc.LutSampleCount) + L"_v" + std::to_wstring(BakeVersion) + L".dds");
+
+	// Only trust a cached file that is complete; anything else is baked again and replaced.
+	result.PrefilteredFromCache = SUCCEEDED(DirectX::CheckDDSTextureFile(result.PrefilteredFilename.c_str(),
+		DXGI_FORMAT_R16G16B16A16_FLOAT, desc.FaceSize, desc.FaceSize, GetPrefilteredMipCount(desc), true));
+	if (!result.PrefilteredFromCache)
+		SaveCubeMap(result.PrefilteredFilename, PrefilterGGX(texels.data(), (uint32)faceSize, desc, pool));
+
+	result.BrdfLutFromCache = SUCCEEDED(DirectX::CheckDDSTextureFile(result.BrdfLutFilename.c_str(),
+		DXGI_FORMAT_R16G16_FLOAT, desc.LutSize, desc.LutSize, 1, false));
+	if (!result.BrdfLutFromCache)
+		SaveBrdfLut(result.BrdfLutFilename, IntegrateBrdf(desc.LutSize, desc.LutSampleCount, pool), desc.LutSize);
+
+	return result;
+}
@@ -0,0 +1,83 @@
+//***************************************************************************************
+// IBLBaker.h
+//
+// Offline image based specular for MaterialConstants (FresnelR0, Roughness) with the
+// split sum approximation (Karis, "Real Shading in Unreal Engine 4"):
+//
+//   specular = prefiltered.SampleLevel(s, r, Roughness * (MipCount - 1)).rgb
+//            * (FresnelR0 * lut.x + lut.y),   lut = brdfLut.Sample(s, float2(NdotV, Roughness)).rg
+//
+// The prefiltered cubemap's mip m is the environment convolved with GGX at roughness
+// m / (MipCount - 1), importance sampled with a Sobol set and filtered importance
+// sampling (each sample reads the source mip matching its solid angle), so a few
+// hundred samples per texel are enough without fireflies. Rows of every mip, and of
+// the LUT, are split over ThreadPool.
+//
+// Bake() reads a cubemap through the DDS loader, writes both results as DDS files
+// (R16G16B16A16_FLOAT / R16G16_FLOAT) and skips the work when a file for the same
+// source contents and settings is already in the cache directory.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+class IBLBaker
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	struct Desc
+	{
+		uint32 FaceSize = 128;      // Mip 0 of the prefiltered cubemap.
+		uint32 MipCount = 6;        // Clamped to the full chain of FaceSize.
+		uint32 SampleCount = 256;   // GGX samples per prefiltered texel.
+		uint32 LutSize = 128;
+		uint32 LutSampleCount = 512;
+	};
+
+	// RGBA32F; Mips[m] holds the 6 faces (D3D order) of (FaceSize >> m)^2 texels each.
+	struct CubeMap
+	{
+		uint32 FaceSize = 0;
+		std::vector<std::vector<float>> Mips;
+	};
+
+	struct BakeResult
+	{
+		std::wstring PrefilteredFilename;
+		std::wstring BrdfLutFilename;
+		bool PrefilteredFromCache = false;
+		bool BrdfLutFromCache = false;
+	};
+
+	// Roughness that mip of a mipCount chain is filtered for.
+	static float MipRoughness(uint32 mip, uint32 mipCount);
+
+	///<summary>
+	/// GGX prefiltered mip chain of a cubemap given as 6 * faceSize * faceSize RGBA32F
+	/// texels (DirectX::LoadDDSCubeMapFromFile layout).
+	///</summary>
+	static CubeMap PrefilterGGX(const float* texels, uint32 faceSize, const Desc& desc, ThreadPool* pool = nullptr);
+
+	// size x size split sum scale (x) and bias (y) for F0; row = roughness, column = NdotV.
+	static std::vector<DirectX::XMFLOAT2> IntegrateBrdf(uint32 size, uint32 sampleCount, ThreadPool* pool = nullptr);
+
+	// Both throw DxException on failure.
+	static void SaveCubeMap(const std::wstring& filename, const CubeMap& cubeMap);
+	static void SaveBrdfLut(const std::wstring& filename, const std::vector<DirectX::XMFLOAT2>& lut, uint32 size);
+
+	///<summary>
+	/// Prefiltered cubemap of sourceFilename and the BRDF LUT as DDS files in
+	/// cacheDirectory (which must exist), baked only when missing. The prefiltered file
+	/// is named after a hash of the source's decoded texels and desc.
+	///</summary>
+	static BakeResult Bake(const std::wstring& sourceFilename, const std::wstring& cacheDirectory, const Desc& desc,
+		ThreadPool* pool = nullptr);
+};
@@ -0,0 +1,462 @@
+//***************************************************************************************
+// LowDiscrepancy.cpp
+//***************************************************************************************
+
+#include "LowDiscrepancy.h"
+#include "RandomEngine.h"
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = LowDiscrepancy::uint32;
+
+	// Points generated per chunk by FillDirections.
+	const size_t DirectionChunkSize = 256;
+
+	const uint32 HaltonBases[4] = { 2, 3, 5, 7 };
+
+	// 2^32 / g and 2^32 / g^2 for the plastic constant g = 1.3247...
+	const uint32 R2Alpha1 = 0xC13FA9A9u;
+	const uint32 R2Alpha2 = 0x91E10DA6u;
+
+	const float BlueNoiseSigma = 1.5f;
+
+	float BitsToFloat(uint32 bits)
+	{
+		return (float)(bits >> 8) * (1.0f / 16777216.0f);
+	}
+
+	uint32 ReverseBits(uint32 x)
+	{
+		x = (x << 16) | (x >> 16);
+		x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+		x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+		x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+		x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+		return x;
+	}
+
+	uint32 HashCombine(uint32 seed, uint32 v)
+	{
+		return seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+	}
+
+	// Owen scrambling as a hash based nested uniform permutation of the bits
+	// (Burley, "Practical Hash-based Owen Scrambling", 2020).
+	uint32 NestedUniformScramble(uint32 x, uint32 seed)
+	{
+		x = ReverseBits(x);
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return ReverseBits(x);
+	}
+
+	// Direction numbers for 4 dimensions (Joe and Kuo); dimension 0 is the van der Corput
+	// sequence.
+	struct SobolTable
+	{
+		uint32 V[4][32];
+
+		SobolTable()
+		{
+			const uint32 s[4] = { 0, 1, 2, 3 };
+			const uint32 a[4] = { 0, 0, 1, 1 };
+			const uint32 m[4][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 3, 0 }, { 1, 3, 1 } };
+
+			for (int i = 0; i < 32; ++i)
+				V[0][i] = 1u << (31 - i);
+
+			for (int d = 1; d < 4; ++d)
+			{
+				for (uint32 i = 0; i < 32; ++i)
+				{
+					if (i < s[d])
+					{
+						V[d][i] = m[d][i] << (31 - i);
+						continue;
+					}
+
+					uint32 v = V[d][i - s[d]] ^ (V[d][i - s[d]] >> s[d]);
+					for (uint32 k = 1; k < s[d]; ++k)
+					{
+						if ((a[d] >> (s[d] - 1 - k)) & 1)
+							v ^= V[d][i - k];
+					}
+					V[d][i] = v;
+				}
+			}
+		}
+	};
+
+	const SobolTable& GetSobolTable()
+	{
+		static const SobolTable table;
+		return table;
+	}
+
+	uint32 SobolBits(uint32 index, uint32 dimension)
+	{
+		const uint32* V = GetSobolTable().V[dimension];
+
+		uint32 result = 0;
+		for (int bit = 0; index != 0; ++bit, index >>= 1)
+		{
+			if (index & 1)
+				result ^= V[bit];
+		}
+		return result;
+	}
+
+	// Random offsets per dimension for Cranley-Patterson rotation.
+	void GetRotation(uint32 seed, float offsets[4])
+	{
+		RandomEngine engine(seed);
+		for (int d = 0; d < 4; ++d)
+			offsets[d] = seed != 0 ? engine.NextFloat() : 0.0f;
+	}
+
+	float Rotate(float x, float offset)
+	{
+		x += offset;
+		return x >= 1.0f ? x - 1.0f : x;
+	}
+}
+
+float LowDiscrepancy::Halton(uint32 index, uint32 base)
+{
+	if (base == 2)
+		return BitsToFloat(ReverseBits(index));
+
+	float invBase = 1.0f / base;
+	float f = invBase;
+	float result = 0.0f;
+
+	while (index > 0)
+	{
+		result += f * (index % base);
+		index /= base;
+		f *= invBase;
+	}
+
+	return result < 1.0f ? result : 0.99999994f;
+}
+
+float LowDiscrepancy::Sobol(uint32 index, uint32 dimension, uint32 seed)
+{
+	if (seed == 0)
+		return BitsToFloat(SobolBits(index, dimension));
+
+	index = NestedUniformScramble(index, seed);
+	return BitsToFloat(NestedUniformScramble(SobolBits(index, dimension), HashCombine(seed, dimension)));
+}
+
+XMFLOAT2 LowDiscrepancy::R2(uint32 index)
+{
+	return XMFLOAT2(
+		BitsToFloat(0x80000000u + index * R2Alpha1),
+		BitsToFloat(0x80000000u + index * R2Alpha2));
+}
+
+void LowDiscrepancy::Fill(Sequence sequence, float* out, size_t count, uint32 dimensions, uint32 firstIndex, uint32 seed)
+{
+	dimensions = dimensions < 4 ? dimensions : 4;
+	if (sequence == Sequence::R2)
+		dimensions = dimensions < 2 ? dimensions : 2;
+
+	float offsets[4];
+	GetRotation(seed, offsets);
+
+	switch (sequence)
+	{
+	case Sequence::WhiteNoise:
+	{
+		RandomEngine engine(seed, firstIndex);
+		engine.FillFloats(out, count * dimensions);
+		break;
+	}
+	case Sequence::Halton:
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (uint32 d = 0; d < dimensions; ++d)
+				out[i * dimensions + d] = Rotate(Halton(firstIndex + (uint32)i, HaltonBases[d]), offsets[d]);
+		}
+		break;
+	case Sequence::Sobol:
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (uint32 d = 0; d < dimensions; ++d)
+				out[i * dimensions + d] = Sobol(firstIndex + (uint32)i, d, seed);
+		}
+		break;
+	case Sequence::R2:
+	{
+		// The rotation is folded into the fixed point start value.
+		uint32 start[2] = { 0x80000000u + (uint32)(offsets[0] * 4294967296.0), 0x80000000u + (uint32)(offsets[1] * 4294967296.0) };
+		const uint32 alpha[2] = { R2Alpha1, R2Alpha2 };
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32 index = firstIndex + (uint32)i;
+			for (uint32 d = 0; d < dimensions; ++d)
+				out[i * dimensions + d] = BitsToFloat(start[d] + index * alpha[d]);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void LowDiscrepancy::Fill2D(Sequence sequence, XMFLOAT2* out, size_t count, uint32 firstIndex, uint32 seed)
+{
+	Fill(sequence, &out[0].x, count, 2, firstIndex, seed);
+}
+
+void LowDiscrepancy::FillDirections(Sequence sequence, MathHelper::DirectionDistribution distribution, FXMVECTOR n,
+	XMFLOAT3* out, size_t count, uint32 firstIndex, uint32 seed)
+{
+	XMFLOAT2 uv[DirectionChunkSize];
+	for (size_t first = 0; first < count; first += DirectionChunkSize)
+	{
+		size_t chunk = count - first < DirectionChunkSize ? count - first : DirectionChunkSize;
+		Fill2D(sequence, uv, chunk, firstIndex + (uint32)first, seed);
+		MathHelper::MapToDirections(distribution, n, uv, out + first, chunk);
+	}
+}
+
+const std::vector<float>& LowDiscrepancy::GetBlueNoiseTile(uint32 size)
+{
+	assert(size != 0 && (size & (size - 1)) == 0);
+
+	static std::mutex mutex;
+	static std::map<uint32, std::vector<float>> tiles;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = tiles.find(size);
+	if (it == tiles.end())
+		it = tiles.emplace(size, GenerateBlueNoise(size)).first;
+
+	return it->second;
+}
+
+float LowDiscrepancy::BlueNoise(uint32 x, uint32 y, uint32 frame, uint32 size)
+{
+	const std::vector<float>& tile = GetBlueNoiseTile(size);
+	float value = tile[(y & (size - 1)) * size + (x & (size - 1))];
+
+	// Golden ratio offset per frame.
+	value += (float)(frame * 0x9E3779B9u >> 8) * (1.0f / 16777216.0f);
+	return value >= 1.0f ? value - 1.0f : value;
+}
+
+std::vector<float> LowDiscrepancy::GenerateBlueNoise(uint32 size)
+{
+	// Void-and-cluster (Ulichney 1993) on a torus. Energy is the sum of a Gaussian
+	// around every set pixel; the tightest cluster is the set pixel with the highest
+	// energy and the largest void the empty pixel with the lowest.
+	const uint32 mask = size - 1;
+	const uint32 pixelCount = size * size;
+
+	std::vector<float> kernel(pixelCount);
+	for (uint32 y = 0; y < size; ++y)
+	{
+		for (uint32 x = 0; x < size; ++x)
+		{
+			float dx = (float)(x < size - x ? x : size - x);
+			float dy = (float)(y < size - y ? y : size - y);
+			kernel[y * size + x] = expf(-(dx * dx + dy * dy) / (2.0f * BlueNoiseSigma * BlueNoiseSigma));
+		}
+	}
+
+	std::vector<std::uint8_t> pattern(pixelCount, 0);
+	std::vector<float> energy(pixelCount, 0.0f);
+
+	auto splat = [&](std::vector<float>& e, uint32 p, float sign)
+	{
+		uint32 px = p & mask;
+		uint32 py = p / size;
+		for (uint32 y = 0; y < size; ++y)
+		{
+			const float* row = &kernel[((y - py) & mask) * size];
+			float* dst = &e[y * size];
+			for (uint32 x = 0; x < size; ++x)
+				dst[x] += sign * row[(x - px) & mask];
+		}
+	};
+
+	auto tightestCluster = [&](const std::vector<std::uint8_t>& pat, const std::vector<float>& e)
+	{
+		uint32 best = 0;
+		float bestEnergy = -1.0f;
+		for (uint32 p = 0; p < pixelCount; ++p)
+		{
+			if (pat[p] && e[p] > bestEnergy)
+			{
+				bestEnergy = e[p];
+				best = p;
+			}
+		}
+		return best;
+	};
+
+	auto largestVoid = [&](const std::vector<std::uint8_t>& pat, const std::vector<float>& e)
+	{
+		uint32 best = 0;
+		float bestEnergy = 3.4e38f;
+		for (uint32 p = 0; p < pixelCount; ++p)
+		{
+			if (!pat[p] && e[p] < bestEnergy)
+			{
+				bestEnergy = e[p];
+				best = p;
+			}
+		}
+		return best;
+	};
+
+	// Initial binary pattern: 10% of the pixels, then relaxed until swapping the tightest
+	// cluster into the largest void changes nothing.
+	RandomEngine engine(size);
+	uint32 onesCount = pixelCount / 10 > 0 ? pixelCount / 10 : 1;
+	for (uint32 placed = 0; placed < onesCount;)
+	{
+		uint32 p = engine.NextBounded(pixelCount);
+		if (!pattern[p])
+		{
+			pattern[p] = 1;
+			splat(energy, p, 1.0f);
+			++placed;
+		}
+	}
+
+	for (uint32 iteration = 0; iteration < pixelCount; ++iteration)
+	{
+		uint32 cluster = tightestCluster(pattern, energy);
+		pattern[cluster] = 0;
+		splat(energy, cluster, -1.0f);
+
+		uint32 hole = largestVoid(pattern, energy);
+		pattern[hole] = 1;
+		splat(energy, hole, 1.0f);
+
+		if (hole == cluster)
+			break;
+	}
+
+	std::vector<uint32> rank(pixelCount, 0);
+
+	// Phase 1: rank the initial pattern by removing tightest clusters.
+	{
+		std::vector<std::uint8_t> pat = pattern;
+		std::vector<float> e = energy;
+		for (uint32 r = onesCount; r > 0; --r)
+		{
+			uint32 cluster = tightestCluster(pat, e);
+			pat[cluster] = 0;
+			splat(e, cluster, -1.0f);
+			rank[cluster] = r - 1;
+		}
+	}
+
+	// Phases 2 and 3: fill the largest voids. Past half full this is the same as
+	// removing the tightest cluster of the inverted pattern, since the energies of a
+	// pattern and its inverse sum to a constant.
+	for (uint32 r = onesCount; r < pixelCount; ++r)
+	{
+		uint32 hole = largestVoid(pattern, energy);
+		pattern[hole] = 1;
+		splat(energy, hole, 1.0f);
+		rank[hole] = r;
+	}
+
+	std::vector<float> tile(pixelCount);
+	for (uint32 p = 0; p < pixelCount; ++p)
+		tile[p] = (rank[p] + 0.5f) / pixelCount;
+
+	return tile;
+}
+
+LowDiscrepancy::ConvergenceResult LowDiscrepancy::ConvergenceBenchmark(uint32 targetSampleCount, uint32 trials)
+{
+	assert(targetSampleCount > 0 && trials > 0);
+	if (targetSampleCount == 0 || trials == 0)
+		return ConvergenceResult();
+
+	const double pi = 3.14159265358979323846;
+
+	// Smooth: sin(pi x) sin(pi y), integral 4 / pi^2.
+	// Discontinuous: quarter disk x^2 + y^2 < 1, integral pi / 4.
+	auto smooth = [pi](double x, double y) { return sin(pi * x) * sin(pi * y); };
+	auto disk = [](double x, double y) { return x * x + y * y < 1.0 ? 1.0 : 0.0; };
+	const double smoothExact = 4.0 / (pi * pi);
+	const double diskExact = pi / 4.0;
+
+	// Power of two sample counts up to 16x the target (at most 2^31, so they fit in uint32).
+	std::vector<uint32> counts;
+	for (std::uint64_t n = 1; n <= (std::uint64_t)targetSampleCount * 16 && n <= (1ull << 31); n *= 2)
+		counts.push_back((uint32)n);
+	uint32 maxCount = counts.back();
+
+	const int sequenceCount = (int)Sequence::Count;
+	std::vector<double> squaredError(sequenceCount * counts.size(), 0.0);
+	std::vector<XMFLOAT2> points(maxCount);
+
+	for (int s = 0; s < sequenceCount; ++s)
+	{
+		for (uint32 t = 0; t < trials; ++t)
+		{
+			Fill2D((Sequence)s, points.data(), maxCount, 0, t + 1);
+
+			double smoothSum = 0.0;
+			double diskSum = 0.0;
+			size_t next = 0;
+			for (uint32 i = 0; i < maxCount; ++i)
+			{
+				smoothSum += smooth(points[i].x, points[i].y);
+				diskSum += disk(points[i].x, points[i].y);
+
+				if (i + 1 == counts[next])
+				{
+					double e0 = smoothSum / (i + 1) - smoothExact;
+					double e1 = diskSum / (i + 1) - diskExact;
+					squaredError[s * counts.size() + next] += 0.5 * (e0 * e0 + e1 * e1);
+					++next;
+				}
+			}
+		}
+	}
+
+	auto rmsError = [&](int s, size_t c) { return sqrt(squaredError[s * counts.size() + c] / trials); };
+
+	size_t targetSlot = 0;
+	while (targetSlot + 1 < counts.size() && counts[targetSlot] < targetSampleCount)
+		++targetSlot;
+
+	ConvergenceResult result;
+	result.TargetSampleCount = counts[targetSlot];
+	result.TargetError = rmsError((int)Sequence::WhiteNoise, targetSlot);
+
+	for (int s = 0; s < sequenceCount; ++s)
+	{
+		result.ErrorAtTarget[s] = rmsError(s, targetSlot);
+		for (size_t c = 0; c < counts.size(); ++c)
+		{
+			if (rmsError(s, c) <= result.TargetError)
+			{
+				result.SamplesNeeded[s] = counts[c];
+				break;
+			}
+		}
+	}
+
+	return result;
+}
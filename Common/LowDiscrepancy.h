@@ -0,0 +1,91 @@
+//***************************************************************************************
+// LowDiscrepancy.h
+//
+// Low-discrepancy sample sequences for sampling kernels (AO, soft shadows, TAA jitter,
+// instance scattering). They cover [0,1)^d far more evenly than MathHelper::RandF, so a
+// given error is reached with fewer samples; see ConvergenceBenchmark().
+//
+//   Halton  radical inverse in bases 2, 3 (and 5, 7 for more dimensions).
+//   Sobol   4 dimensions, randomized with hash based Owen scrambling (Burley 2020).
+//   R2      additive recurrence on the plastic constant (Roberts 2018), 2 dimensions.
+// Seeds randomize a sequence (Cranley-Patterson rotation for Halton / R2, scrambling
+// for Sobol); seed 0 gives the plain, unscrambled sequence for all three.
+//
+// Blue noise tiles are generated with void-and-cluster on first use and cached.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#include "MathHelper.h"
+
+class LowDiscrepancy
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	enum class Sequence
+	{
+		WhiteNoise, // RandomEngine, for comparison.
+		Halton,
+		Sobol,
+		R2,
+		Count
+	};
+
+	struct ConvergenceResult
+	{
+		// RMS error of the white noise estimate with TargetSampleCount samples.
+		uint32 TargetSampleCount = 0;
+		double TargetError = 0.0;
+
+		// Per sequence: smallest power of two sample count that reaches TargetError
+		// (0 if none up to the largest count tried) and the error at TargetSampleCount.
+		uint32 SamplesNeeded[(int)Sequence::Count] = {};
+		double ErrorAtTarget[(int)Sequence::Count] = {};
+	};
+
+	static float Halton(uint32 index, uint32 base);
+
+	// Sobol point index, dimension 0-3. seed != 0 applies Owen scrambling.
+	static float Sobol(uint32 index, uint32 dimension, uint32 seed = 0);
+
+	static DirectX::XMFLOAT2 R2(uint32 index);
+
+	///<summary>
+	/// Writes points firstIndex .. firstIndex + count - 1 of the sequence, dimensions
+	/// interleaved (out[i * dimensions + d]). dimensions is at most 4 (2 for R2).
+	///</summary>
+	static void Fill(Sequence sequence, float* out, size_t count, uint32 dimensions, uint32 firstIndex = 0, uint32 seed = 0);
+
+	static void Fill2D(Sequence sequence, DirectX::XMFLOAT2* out, size_t count, uint32 firstIndex = 0, uint32 seed = 0);
+
+	// Sequence points mapped onto directions (see MathHelper::MapToDirections).
+	static void FillDirections(Sequence sequence, MathHelper::DirectionDistribution distribution, DirectX::FXMVECTOR n,
+		DirectX::XMFLOAT3* out, size_t count, uint32 firstIndex = 0, uint32 seed = 0);
+
+	///<summary>
+	/// size x size tile of blue noise dither values in [0, 1), row major. size must be
+	/// a power of two; generated on first use. The cost grows with size^4: 64x64 takes
+	/// a fraction of a second and every doubling is 16 times slower, so larger tiles
+	/// are better shipped as data.
+	///</summary>
+	static const std::vector<float>& GetBlueNoiseTile(uint32 size = 64);
+
+	// Tiled blue noise at pixel (x, y); frame shifts the values by the golden ratio so a
+	// pixel's values over time are well spread too (TAA).
+	static float BlueNoise(uint32 x, uint32 y, uint32 frame = 0, uint32 size = 64);
+
+	///<summary>
+	/// Estimates a smooth and a discontinuous (soft shadow like) integral over [0,1)^2 with
+	/// every sequence, trials times with different seeds, and reports how many samples
+	/// each needs to match white noise with targetSampleCount samples.
+	///</summary>
+	static ConvergenceResult ConvergenceBenchmark(uint32 targetSampleCount = 1024, uint32 trials = 32);
+
+private:
+	static std::vector<float> GenerateBlueNoise(uint32 size);
+};
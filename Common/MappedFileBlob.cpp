@@ -0,0 +1,210 @@
+//***************************************************************************************
+// MappedFileBlob.cpp
+//***************************************************************************************
+
+#include "MappedFileBlob.h"
+#include "StringUtil.h"
+#include <new>
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// GetBufferPointer() of an empty file: nothing can be mapped, but callers expect a
+	// valid pointer.
+	char EmptyBuffer[1] = {};
+
+	// Smallest page size of the supported platforms; touching one byte per page faults
+	// every page in.
+	const size_t PageSize = 4096;
+
+	void TouchPages(const void* data, size_t size)
+	{
+		const volatile char* bytes = (const volatile char*)data;
+		char sum = 0;
+		for (size_t offset = 0; offset < size; offset += PageSize)
+			sum += bytes[offset];
+		(void)sum;
+	}
+
+#if !defined(_WIN32)
+	// What HRESULT_FROM_WIN32 gives for the matching Win32 error, so callers can tell a
+	// missing file from a denied one on every platform.
+	HRESULT HResultFromErrno(int error)
+	{
+		switch (error)
+		{
+		case ENOENT:
+			return (HRESULT)0x80070002; // ERROR_FILE_NOT_FOUND
+		case ENOTDIR:
+			return (HRESULT)0x80070003; // ERROR_PATH_NOT_FOUND
+		case EMFILE:
+		case ENFILE:
+			return (HRESULT)0x80070004; // ERROR_TOO_MANY_OPEN_FILES
+		case EACCES:
+		case EPERM:
+			return (HRESULT)0x80070005; // ERROR_ACCESS_DENIED
+		case ENOMEM:
+			return (HRESULT)0x8007000E; // E_OUTOFMEMORY
+		default:
+			return E_FAIL;
+		}
+	}
+#endif
+}
+
+HRESULT MappedFileBlob::Create(const std::wstring& filename, ID3DBlob** blob, bool prefetch)
+{
+	if (blob == nullptr)
+		return E_POINTER;
+	*blob = nullptr;
+
+	MappedFileBlob* mapped = new (std::nothrow) MappedFileBlob();
+	if (mapped == nullptr)
+		return E_OUTOFMEMORY;
+
+#if defined(_WIN32)
+	mapped->mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mapped->mFile == INVALID_HANDLE_VALUE)
+	{
+		HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+		mapped->Release();
+		return hr;
+	}
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(mapped->mFile, &fileSize))
+	{
+		HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+		mapped->Release();
+		return hr;
+	}
+
+	mapped->mSize = (size_t)fileSize.QuadPart;
+	if (mapped->mSize > 0)
+	{
+		// Copy on write: a caller that patches the buffer gets private pages, and the
+		// file is never modified.
+		mapped->mMapping = CreateFileMappingW(mapped->mFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		mapped->mData = mapped->mMapping ? MapViewOfFile(mapped->mMapping, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+		if (mapped->mData == nullptr)
+		{
+			HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+			mapped->Release();
+			return hr;
+		}
+	}
+#else
+	int fd = open(StringUtil::ToNarrow(filename).c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		HRESULT hr = HResultFromErrno(errno);
+		mapped->Release();
+		return hr;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		HRESULT hr = HResultFromErrno(errno);
+		close(fd);
+		mapped->Release();
+		return hr;
+	}
+
+	mapped->mSize = (size_t)info.st_size;
+	if (mapped->mSize > 0)
+	{
+		// Private and writable, as on Windows: writes copy the page and never reach the file.
+		void* data = mmap(nullptr, mapped->mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			HRESULT hr = HResultFromErrno(errno);
+			close(fd);
+			mapped->Release();
+			return hr;
+		}
+		mapped->mData = data;
+	}
+
+	// The mapping keeps the file referenced.
+	close(fd);
+#endif
+
+	if (prefetch && mapped->mSize > 0)
+	{
+		// Hint the whole range first so the OS issues large reads instead of one per fault.
+#if defined(_WIN32)
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+		WIN32_MEMORY_RANGE_ENTRY range = { mapped->mData, mapped->mSize };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+		madvise(mapped->mData, mapped->mSize, MADV_WILLNEED);
+#endif
+		TouchPages(mapped->mData, mapped->mSize);
+	}
+
+	*blob = mapped;
+	return S_OK;
+}
+
+MappedFileBlob::~MappedFileBlob()
+{
+#if defined(_WIN32)
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+		CloseHandle(mMapping);
+	if (mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+#else
+	if (mData != nullptr)
+		munmap(mData, mSize);
+#endif
+}
+
+HRESULT MappedFileBlob::QueryInterface(REFIID riid, void** object)
+{
+	if (object == nullptr)
+		return E_POINTER;
+
+	if (riid == __uuidof(ID3DBlob) || riid == __uuidof(IUnknown))
+	{
+		*object = static_cast<ID3DBlob*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*object = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG MappedFileBlob::AddRef()
+{
+	return ++mRefCount;
+}
+
+ULONG MappedFileBlob::Release()
+{
+	ULONG count = --mRefCount;
+	if (count == 0)
+		delete this;
+	return count;
+}
+
+LPVOID MappedFileBlob::GetBufferPointer()
+{
+	return mData != nullptr ? mData : EmptyBuffer;
+}
+
+SIZE_T MappedFileBlob::GetBufferSize()
+{
+	return mSize;
+}
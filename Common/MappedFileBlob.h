@@ -0,0 +1,58 @@
+//***************************************************************************************
+// MappedFileBlob.h
+//
+// ID3DBlob over a copy-on-write memory mapped file (file mapping on Windows, mmap
+// elsewhere). Opening costs the same for any file size and GetBufferPointer() is the
+// mapped view itself, so precompiled shaders and other binaries go straight to PSO
+// creation or an upload buffer without being copied through a stream first. Pages are
+// read from disk when first touched.
+//
+// Like a blob from D3DReadFileToBlob, the buffer may be written to: touched pages are
+// copied privately and the file itself never changes. The file stays open (and locked
+// against writes on Windows) until the last reference is released.
+//***************************************************************************************
+
+#pragma once
+
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+#include <d3dcommon.h>
+#include <atomic>
+#include <string>
+
+class MappedFileBlob final : public ID3DBlob
+{
+public:
+
+	// Maps filename into a new blob (reference count 1) returned through blob. With
+	// prefetch the whole file is paged in before returning (for use off the main thread).
+	static HRESULT Create(const std::wstring& filename, ID3DBlob** blob, bool prefetch = false);
+
+	// IUnknown
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override;
+	ULONG STDMETHODCALLTYPE AddRef() override;
+	ULONG STDMETHODCALLTYPE Release() override;
+
+	// ID3DBlob
+	LPVOID STDMETHODCALLTYPE GetBufferPointer() override;
+	SIZE_T STDMETHODCALLTYPE GetBufferSize() override;
+
+private:
+	MappedFileBlob() = default;
+	~MappedFileBlob();
+
+	MappedFileBlob(const MappedFileBlob&) = delete;
+	MappedFileBlob& operator=(const MappedFileBlob&) = delete;
+
+private:
+	std::atomic<ULONG> mRefCount{ 1 };
+
+	void* mData = nullptr;
+	size_t mSize = 0;
+
+#if defined(_WIN32)
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+#endif
+};
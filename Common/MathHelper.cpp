@@ -3,9 +3,9 @@
 //***************************************************************************************
 
 #include "MathHelper.h"
+#include "FastMath.h"
 #include <float.h>
 #include <cmath>
-#include <random>
 
 using namespace DirectX;
 
@@ -14,9 +14,7 @@ const float MathHelper::Pi = 3.1415926535f;
 
 float MathHelper::RandF_Ex()
 {
-	static std::default_random_engine dre;
-	static std::uniform_real_distribution<> urd; // range [0,1]
-	return urd(dre);
+	return RandomEngine::ThreadLocal().NextFloat();
 }
 
 float MathHelper::AngleFromXY(float x, float y)
@@ -40,47 +38,230 @@ float MathHelper::AngleFromXY(float x, float y)
 	return theta;
 }
 
+void MathHelper::AngleFromXY(const float* x, const float* y, float* theta, size_t count)
+{
+	FastMath::Atan2(y, x, theta, count); // in [-pi, pi]
+
+	for (size_t i = 0; i < count; ++i)
+		theta[i] += theta[i] < 0.0f ? 2.0f*Pi : 0.0f;
+}
+
+void MathHelper::SphericalToCartesian(const float* radius, const float* theta, const float* phi,
+	XMFLOAT3* out, size_t count)
+{
+	const size_t chunkSize = 256;
+	float sinTheta[chunkSize], cosTheta[chunkSize], sinPhi[chunkSize], cosPhi[chunkSize];
+
+	for (size_t first = 0; first < count; first += chunkSize)
+	{
+		size_t n = count - first < chunkSize ? count - first : chunkSize;
+		FastMath::SinCos(theta + first, sinTheta, cosTheta, n);
+		FastMath::SinCos(phi + first, sinPhi, cosPhi, n);
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			float r = radius[first + i];
+			out[first + i] = XMFLOAT3(
+				r*sinPhi[i]*cosTheta[i],
+				r*cosPhi[i],
+				r*sinPhi[i]*sinTheta[i]);
+		}
+	}
+}
+
 XMVECTOR MathHelper::RandUnitVector()
 {
-	XMVECTOR One = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
+	XMFLOAT3 v;
+	RandUnitVectors(&v, 1);
+	return XMLoadFloat3(&v);
+}
+
+XMVECTOR MathHelper::RandHemisphereUnitVector(XMVECTOR n)
+{
+	XMFLOAT3 v;
+	RandHemisphereUnitVectors(n, &v, 1);
+	return XMLoadFloat3(&v);
+}
+
+namespace
+{
+	// Directions generated per RandomEngine::FillFloats call.
+	const size_t DirectionChunkSize = 256;
+
+	// Four uniform pairs -> local frame directions (x, y, z) with z along the pole.
+	void MapGroup(MathHelper::DirectionDistribution distribution, FXMVECTOR uv01, FXMVECTOR uv23,
+		XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
+	{
+		XMVECTOR u = XMVectorPermute<0, 2, 4, 6>(uv01, uv23);
+		XMVECTOR v = XMVectorPermute<1, 3, 5, 7>(uv01, uv23);
+
+		XMVECTOR one = XMVectorSplatOne();
+		switch (distribution)
+		{
+		case MathHelper::DirectionDistribution::UnitSphere:
+			z = XMVectorNegativeMultiplySubtract(XMVectorReplicate(2.0f), u, one); // 1 - 2u
+			break;
+		case MathHelper::DirectionDistribution::Hemisphere:
+			z = u;
+			break;
+		default:
+			z = XMVectorSqrt(XMVectorMax(XMVectorZero(), one - u));
+			break;
+		}
+
+		XMVECTOR r = XMVectorSqrt(XMVectorMax(XMVectorZero(), XMVectorNegativeMultiplySubtract(z, z, one)));
+
+		XMVECTOR sinPhi, cosPhi;
+		XMVectorSinCos(&sinPhi, &cosPhi, XMVectorScale(v, XM_2PI));
+
+		x = r * cosPhi;
+		y = r * sinPhi;
+	}
 
-	// Keep trying untill get a point on/in the hemisphere
-	while (true)
+	// Writes 4 directions given as x / y / z lanes to out[0..3].
+	void StoreGroup(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, XMFLOAT3* out)
 	{
-		// Generate random point in the cube[-1,1]^3
-		XMVECTOR v = XMVectorSet(RandF(-1.0f, 1.0f), RandF(-1.0f, 1.0f), RandF(-1.0f, 1.0f), 0.0f);
+		XMVECTOR xy01 = XMVectorMergeXY(x, y);
+		XMVECTOR xy23 = XMVectorMergeZW(x, y);
+
+		XMVECTOR v0 = XMVectorPermute<0, 1, 4, 2>(xy01, z);                                  // x0 y0 z0 x1
+		XMVECTOR v1 = XMVectorPermute<0, 1, 4, 5>(XMVectorPermute<3, 5, 0, 0>(xy01, z), xy23); // y1 z1 x2 y2
+		XMVECTOR v2 = XMVectorSwizzle<2, 0, 1, 3>(XMVectorPermute<2, 3, 6, 7>(xy23, z));      // z2 x3 y3 z3
+
+		XMFLOAT4* dst = reinterpret_cast<XMFLOAT4*>(out);
+		XMStoreFloat4(dst + 0, v0);
+		XMStoreFloat4(dst + 1, v1);
+		XMStoreFloat4(dst + 2, v2);
+	}
 
-		// Ignore points outside the unit sphere in order to get an even distribution 
-		// over the unit sphere.  Otherwise points will clump more on the sphere near 
-		// the corners of the cube.
-		if (XMVector3Greater(XMVector3LengthSq(v), One)) // x^2 + y^2 + z^2 > 1
-			continue;
+	void RandDirections(MathHelper::DirectionDistribution distribution, FXMVECTOR n, XMFLOAT3* out, size_t count)
+	{
+		XMFLOAT2 uv[DirectionChunkSize];
+		RandomEngine& engine = RandomEngine::ThreadLocal();
 
-		return XMVector3Normalize(v);
+		for (size_t first = 0; first < count; first += DirectionChunkSize)
+		{
+			size_t chunk = count - first < DirectionChunkSize ? count - first : DirectionChunkSize;
+			engine.FillFloats(&uv[0].x, chunk * 2);
+			MathHelper::MapToDirections(distribution, n, uv, out + first, chunk);
+		}
 	}
 }
 
-XMVECTOR MathHelper::RandHemisphereUnitVector(XMVECTOR n)
+void MathHelper::MapToDirections(DirectionDistribution distribution, FXMVECTOR n,
+	const XMFLOAT2* uv, XMFLOAT3* out, size_t count)
 {
-	XMVECTOR One   = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
-	XMVECTOR Zero = XMVectorZero();
+	// Tangent frame around n without branches (Duff et al., "Building an Orthonormal
+	// Basis, Revisited"). The sphere needs no frame.
+	XMFLOAT3 N(0.0f, 0.0f, 1.0f);
+	if (distribution != DirectionDistribution::UnitSphere)
+		XMStoreFloat3(&N, XMVector3Normalize(n));
+
+	float sign = copysignf(1.0f, N.z);
+	float a = -1.0f / (sign + N.z);
+	float b = N.x * N.y * a;
+	XMFLOAT3 T(1.0f + sign * N.x * N.x * a, sign * b, -sign * N.x);
+	XMFLOAT3 B(b, sign + N.y * N.y * a, -N.y);
+
+	XMVECTOR Tx = XMVectorReplicate(T.x), Ty = XMVectorReplicate(T.y), Tz = XMVectorReplicate(T.z);
+	XMVECTOR Bx = XMVectorReplicate(B.x), By = XMVectorReplicate(B.y), Bz = XMVectorReplicate(B.z);
+	XMVECTOR Nx = XMVectorReplicate(N.x), Ny = XMVectorReplicate(N.y), Nz = XMVectorReplicate(N.z);
 
-	// Keep trying untill get a point on/in the hemisphere
-	while (true)
+	// x * T + y * B + z * N for the 4 lanes of a group.
+	auto toWorld = [&](XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
 	{
-		// Generate random point in the cube[-1,1]^3
-		XMVECTOR v = XMVectorSet(RandF(-1.0f, 1.0f), RandF(-1.0f, 1.0f), RandF(-1.0f, 1.0f), 0.0f);
+		XMVECTOR wx = XMVectorMultiplyAdd(z, Nx, XMVectorMultiplyAdd(y, Bx, x * Tx));
+		XMVECTOR wy = XMVectorMultiplyAdd(z, Ny, XMVectorMultiplyAdd(y, By, x * Ty));
+		XMVECTOR wz = XMVectorMultiplyAdd(z, Nz, XMVectorMultiplyAdd(y, Bz, x * Tz));
+		x = wx;
+		y = wy;
+		z = wz;
+	};
 
-		// Ignore points outside the unit sphere in order to get an even distribution 
-		// over the unit sphere.  Otherwise points will clump more on the sphere near 
-		// the corners of the cube.
-		if (XMVector3Greater(XMVector3LengthSq(v), One)) // x^2 + y^2 + z^2 > 1
-			continue;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const XMFLOAT4* src = reinterpret_cast<const XMFLOAT4*>(uv + i);
+
+		XMVECTOR x0, y0, z0, x1, y1, z1;
+		MapGroup(distribution, XMLoadFloat4(src + 0), XMLoadFloat4(src + 1), x0, y0, z0);
+		MapGroup(distribution, XMLoadFloat4(src + 2), XMLoadFloat4(src + 3), x1, y1, z1);
+		toWorld(x0, y0, z0);
+		toWorld(x1, y1, z1);
+
+		StoreGroup(x0, y0, z0, out + i);
+		StoreGroup(x1, y1, z1, out + i + 4);
+	}
 
-		// Igonre points in the bottom hemisphere.
-		if (XMVector3Less(XMVector3Dot(n, v), Zero))
-			continue;
+	// Tail: pad to a group of 4.
+	for (; i < count; i += 4)
+	{
+		size_t remaining = count - i < 4 ? count - i : 4;
+
+		XMFLOAT2 pad[4] = {};
+		XMFLOAT3 dst[4];
+		for (size_t k = 0; k < remaining; ++k)
+			pad[k] = uv[i + k];
 
-		return XMVector3Normalize(v);
+		XMVECTOR x, y, z;
+		MapGroup(distribution, XMLoadFloat4((const XMFLOAT4*)&pad[0]), XMLoadFloat4((const XMFLOAT4*)&pad[2]), x, y, z);
+		toWorld(x, y, z);
+		StoreGroup(x, y, z, dst);
+
+		for (size_t k = 0; k < remaining; ++k)
+			out[i + k] = dst[k];
 	}
 }
+
+void MathHelper::RandUnitVectors(XMFLOAT3* out, size_t count)
+{
+	RandDirections(DirectionDistribution::UnitSphere, XMVectorZero(), out, count);
+}
+
+void MathHelper::RandHemisphereUnitVectors(FXMVECTOR n, XMFLOAT3* out, size_t count)
+{
+	RandDirections(DirectionDistribution::Hemisphere, n, out, count);
+}
+
+void MathHelper::RandCosineHemisphereUnitVectors(FXMVECTOR n, XMFLOAT3* out, size_t count)
+{
+	RandDirections(DirectionDistribution::CosineHemisphere, n, out, count);
+}
+
+XMVECTOR MathHelper::CubeFaceDirection(int face, float u, float v)
+{
+	switch (face)
+	{
+	case 0: return XMVectorSet(1.0f, -v, -u, 0.0f);
+	case 1: return XMVectorSet(-1.0f, -v, u, 0.0f);
+	case 2: return XMVectorSet(u, 1.0f, v, 0.0f);
+	case 3: return XMVectorSet(u, -1.0f, -v, 0.0f);
+	case 4: return XMVectorSet(u, -v, 1.0f, 0.0f);
+	default: return XMVectorSet(-u, -v, -1.0f, 0.0f);
+	}
+}
+
+int MathHelper::CubeFaceFromDirection(FXMVECTOR dir, float* u, float* v)
+{
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, dir);
+	float ax = fabsf(d.x), ay = fabsf(d.y), az = fabsf(d.z);
+
+	if (ax >= ay && ax >= az)
+	{
+		*u = (d.x > 0.0f ? -d.z : d.z) / ax;
+		*v = -d.y / ax;
+		return d.x > 0.0f ? 0 : 1;
+	}
+
+	if (ay >= az)
+	{
+		*u = d.x / ay;
+		*v = (d.y > 0.0f ? d.z : -d.z) / ay;
+		return d.y > 0.0f ? 2 : 3;
+	}
+
+	*u = (d.z > 0.0f ? d.x : -d.x) / az;
+	*v = -d.y / az;
+	return d.z > 0.0f ? 4 : 5;
+}
@@ -9,17 +9,25 @@
 #include <Windows.h>
 #include <DirectXMath.h>
 #include <cstdint>
+#include "RandomEngine.h"
 
 class MathHelper
 {
 public:
-	// Returns random float in [0, 1].
+	enum class DirectionDistribution
+	{
+		UnitSphere,       // Uniform over the whole sphere.
+		Hemisphere,       // Uniform over the hemisphere around n.
+		CosineHemisphere  // Hemisphere around n with density cos(angle to n) / pi.
+	};
+
+	// Returns random float in [0, 1) from the calling thread's RandomEngine.
 	static float RandF()
 	{
-		return rand() / static_cast<float>(RAND_MAX);
+		return RandomEngine::ThreadLocal().NextFloat();
 	}
 
-	// Returns random float in [0, 1] with mersenne_twister_engine
+	// Same generator as RandF (kept for the Ex flag of RandF(a, b, Ex)).
 	static float RandF_Ex();
 
 	// Returns random float in [a, b].
@@ -28,10 +36,16 @@ public:
 		return a + (Ex ? RandF_Ex() : RandF())*(b - a);
 	}
 
-	// Returns random int in [a, b].
+	// Returns random int in [a, b] without modulo bias.
 	static int Rand(int a, int b)
 	{
-		return a + rand() % (b - a + 1);
+		return RandomEngine::ThreadLocal().NextInt(a, b);
+	}
+
+	// Seeds the calling thread's generator so its RandF / Rand sequence repeats.
+	static void SeedRandom(std::uint64_t seed)
+	{
+		RandomEngine::ThreadLocal().Seed(seed);
 	}
 
 	// Returns Minimum item between a and b.
@@ -77,6 +91,11 @@ public:
 		);
 	}
 
+	// Batch versions of AngleFromXY / SphericalToCartesian on FastMath, for mesh generation.
+	static void AngleFromXY(const float* x, const float* y, float* theta, size_t count);
+	static void SphericalToCartesian(const float* radius, const float* theta, const float* phi,
+		DirectX::XMFLOAT3* out, size_t count);
+
 	// Returns Inverse(Transpose(Matrix))
 	// ǥ迡 ǥ ȯ    Ȯϰ  ֱ  δ.
 	static DirectX::XMMATRIX InverseTranspose(DirectX::XMMATRIX M)
@@ -111,6 +130,26 @@ public:
 	// Vector n is plane of Hemisphere.
 	static DirectX::XMVECTOR RandHemisphereUnitVector(DirectX::XMVECTOR n);
 
+	///<summary>
+	/// Maps uniform pairs in [0,1)^2 straight onto unit directions, 8 per step with no
+	/// rejection or branches. n is the pole of the hemispheres (ignored for UnitSphere).
+	/// Low-discrepancy points stay well distributed through this mapping.
+	///</summary>
+	static void MapToDirections(DirectionDistribution distribution, DirectX::FXMVECTOR n,
+		const DirectX::XMFLOAT2* uv, DirectX::XMFLOAT3* out, size_t count);
+
+	// Batch versions of RandUnitVector / RandHemisphereUnitVector (e.g. SSAO kernels).
+	static void RandUnitVectors(DirectX::XMFLOAT3* out, size_t count);
+	static void RandHemisphereUnitVectors(DirectX::FXMVECTOR n, DirectX::XMFLOAT3* out, size_t count);
+	static void RandCosineHemisphereUnitVectors(DirectX::FXMVECTOR n, DirectX::XMFLOAT3* out, size_t count);
+
+	// Direction (not normalized) through (u, v) in [-1, 1]^2 on D3D cube face 0-5
+	// (+X, -X, +Y, -Y, +Z, -Z); v runs down the face like texture rows.
+	static DirectX::XMVECTOR CubeFaceDirection(int face, float u, float v);
+
+	// Inverse of CubeFaceDirection: the face dir points into and (u, v) on it.
+	static int CubeFaceFromDirection(DirectX::FXMVECTOR dir, float* u, float* v);
+
 	static const float Infinity;
 	static const float Pi;
 };
@@ -0,0 +1,428 @@
+//***************************************************************************************
+// MatrixBatch.cpp
+//***************************************************************************************
+
+#include "MatrixBatch.h"
+#include "ThreadPool.h"
+#include <cassert>
+#include <cstring>
+// MulAdd below is _mm256_fmadd_ps; MSVC does not define __FMA__ for /arch:AVX2.
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define MATRIX_BATCH_AVX2
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	// 8 matrices per block; blocks per ParallelFor chunk.
+	const size_t GrainBlocks = 128;
+
+#if defined(MATRIX_BATCH_AVX2)
+	using Lanes = __m256;
+
+	inline Lanes LoadLanes(const float* p) { return _mm256_loadu_ps(p); }
+	inline void StoreLanes(float* p, Lanes a) { _mm256_storeu_ps(p, a); }
+	inline Lanes SplatLanes(float f) { return _mm256_set1_ps(f); }
+	inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+	inline Lanes Sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+	inline Lanes Mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+	inline Lanes MulAdd(Lanes a, Lanes b, Lanes c) { return _mm256_fmadd_ps(a, b, c); }
+	inline Lanes Reciprocal(Lanes a) { return _mm256_div_ps(_mm256_set1_ps(1.0f), a); }
+#else
+	// Two XMVECTOR groups of 4.
+	struct Lanes
+	{
+		XMVECTOR Lo;
+		XMVECTOR Hi;
+	};
+
+	inline Lanes LoadLanes(const float* p)
+	{
+		return { XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p)), XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p + 4)) };
+	}
+	inline void StoreLanes(float* p, const Lanes& a)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), a.Lo);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p + 4), a.Hi);
+	}
+	inline Lanes SplatLanes(float f) { return { XMVectorReplicate(f), XMVectorReplicate(f) }; }
+	inline Lanes Add(const Lanes& a, const Lanes& b) { return { XMVectorAdd(a.Lo, b.Lo), XMVectorAdd(a.Hi, b.Hi) }; }
+	inline Lanes Sub(const Lanes& a, const Lanes& b) { return { XMVectorSubtract(a.Lo, b.Lo), XMVectorSubtract(a.Hi, b.Hi) }; }
+	inline Lanes Mul(const Lanes& a, const Lanes& b) { return { XMVectorMultiply(a.Lo, b.Lo), XMVectorMultiply(a.Hi, b.Hi) }; }
+	inline Lanes MulAdd(const Lanes& a, const Lanes& b, const Lanes& c)
+	{
+		return { XMVectorMultiplyAdd(a.Lo, b.Lo, c.Lo), XMVectorMultiplyAdd(a.Hi, b.Hi, c.Hi) };
+	}
+	inline Lanes Reciprocal(const Lanes& a) { return { XMVectorReciprocal(a.Lo), XMVectorReciprocal(a.Hi) }; }
+#endif
+
+	// Matrices blockIndex * 8 .. + 7, element (r, c) in M[r][c].
+	struct Block
+	{
+		Lanes M[4][4];
+	};
+
+	void LoadBlock(const MatrixSoA& m, size_t blockIndex, Block& b)
+	{
+		size_t i = blockIndex * MatrixSoA::LaneCount;
+		for (int r = 0; r < 4; ++r)
+			for (int c = 0; c < 4; ++c)
+				b.M[r][c] = LoadLanes(m.GetElements(r, c) + i);
+	}
+
+	void StoreBlock(const Block& b, size_t blockIndex, MatrixSoA& m)
+	{
+		size_t i = blockIndex * MatrixSoA::LaneCount;
+		for (int r = 0; r < 4; ++r)
+			for (int c = 0; c < 4; ++c)
+				StoreLanes(m.GetElements(r, c) + i, b.M[r][c]);
+	}
+
+	// in[0 .. count - 1] (count <= 8) into the lanes of b; the other lanes are identity.
+	void LoadBlock(const XMFLOAT4X4* in, size_t count, Block& b)
+	{
+		alignas(32) float elements[16][MatrixSoA::LaneCount];
+		for (int e = 0; e < 16; ++e)
+		{
+			for (size_t j = 0; j < MatrixSoA::LaneCount; ++j)
+				elements[e][j] = j < count ? in[j].m[e / 4][e % 4] : (e % 5 == 0 ? 1.0f : 0.0f);
+		}
+
+		for (int r = 0; r < 4; ++r)
+			for (int c = 0; c < 4; ++c)
+				b.M[r][c] = LoadLanes(elements[r * 4 + c]);
+	}
+
+	// The first count (<= 8) lanes of b to out[0 .. count - 1].
+	void StoreBlock(const Block& b, size_t count, XMFLOAT4X4* out)
+	{
+		alignas(32) float elements[16][MatrixSoA::LaneCount];
+		for (int r = 0; r < 4; ++r)
+			for (int c = 0; c < 4; ++c)
+				StoreLanes(elements[r * 4 + c], b.M[r][c]);
+
+		for (size_t j = 0; j < count; ++j)
+		{
+			for (int e = 0; e < 16; ++e)
+				out[j].m[e / 4][e % 4] = elements[e][j];
+		}
+	}
+
+	void SplatBlock(CXMMATRIX M, Block& b)
+	{
+		XMFLOAT4X4 m;
+		XMStoreFloat4x4(&m, M);
+		for (int r = 0; r < 4; ++r)
+			for (int c = 0; c < 4; ++c)
+				b.M[r][c] = SplatLanes(m.m[r][c]);
+	}
+
+	// out = a * b; out may be a or b.
+	void MultiplyBlock(const Block& a, const Block& b, Block& out)
+	{
+		Block result;
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				Lanes sum = Mul(a.M[r][0], b.M[0][c]);
+				sum = MulAdd(a.M[r][1], b.M[1][c], sum);
+				sum = MulAdd(a.M[r][2], b.M[2][c], sum);
+				result.M[r][c] = MulAdd(a.M[r][3], b.M[3][c], sum);
+			}
+		}
+		out = result;
+	}
+
+	// Inverse-transpose of the upper 3x3 a: row i is (a_j x a_k) / det for the rows
+	// (i, j, k) cyclic, det = a_0 . (a_1 x a_2).
+	void InverseTransposeAffineBlock(const Block& a, Block& out)
+	{
+		auto cross = [&](int j, int k, int axis) -> Lanes
+		{
+			int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			return Sub(Mul(a.M[j][u], a.M[k][v]), Mul(a.M[j][v], a.M[k][u]));
+		};
+
+		Block result;
+		for (int i = 0; i < 3; ++i)
+		{
+			int j = (i + 1) % 3, k = (i + 2) % 3;
+			for (int axis = 0; axis < 3; ++axis)
+				result.M[i][axis] = cross(j, k, axis);
+		}
+
+		Lanes det = Mul(a.M[0][0], result.M[0][0]);
+		det = MulAdd(a.M[0][1], result.M[0][1], det);
+		det = MulAdd(a.M[0][2], result.M[0][2], det);
+		Lanes invDet = Reciprocal(det);
+
+		Lanes zero = SplatLanes(0.0f);
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+				result.M[i][axis] = Mul(result.M[i][axis], invDet);
+			result.M[i][3] = zero;
+		}
+		result.M[3][0] = zero;
+		result.M[3][1] = zero;
+		result.M[3][2] = zero;
+		result.M[3][3] = SplatLanes(1.0f);
+
+		out = result;
+	}
+
+	// Writes lanes [laneBegin, laneEnd) of b transposed, lane j at dst + (j - laneBegin) * stride.
+	void StoreTransposed(const Block& b, size_t laneBegin, size_t laneEnd, std::uint8_t* dst, size_t stride)
+	{
+		alignas(32) float elements[16][MatrixSoA::LaneCount];
+		for (int r = 0; r < 4; ++r)
+			for (int c = 0; c < 4; ++c)
+				StoreLanes(elements[r * 4 + c], b.M[r][c]);
+
+		for (size_t j = laneBegin; j < laneEnd; ++j)
+		{
+			float m[16];
+			for (int r = 0; r < 4; ++r)
+				for (int c = 0; c < 4; ++c)
+					m[r * 4 + c] = elements[c * 4 + r][j];
+
+			std::memcpy(dst + (j - laneBegin) * stride, m, sizeof(m));
+		}
+	}
+
+	// Calls func(blockBegin, blockEnd) over blockCount blocks, on pool if it is worth it.
+	template<typename Func>
+	void ForEachBlockRange(size_t blockCount, ThreadPool* pool, Func&& func)
+	{
+		if (pool == nullptr || blockCount <= GrainBlocks)
+			func(0, blockCount);
+		else
+			pool->ParallelFor(blockCount, GrainBlocks, func);
+	}
+}
+
+void MatrixSoA::Resize(size_t count)
+{
+	if (count == mCount && !mData.empty())
+		return;
+
+	size_t paddedCount = (count + LaneCount - 1) / LaneCount * LaneCount;
+	if (paddedCount == 0)
+		paddedCount = LaneCount;
+
+	std::vector<float> data(16 * paddedCount, 0.0f);
+	size_t kept = count < mCount ? count : mCount;
+	for (int e = 0; e < 16; ++e)
+	{
+		float* stream = data.data() + e * paddedCount;
+		if (kept > 0)
+			std::memcpy(stream, mData.data() + e * mPaddedCount, kept * sizeof(float));
+
+		// Identity for the new matrices and the padding.
+		if (e % 5 == 0)
+		{
+			for (size_t i = kept; i < paddedCount; ++i)
+				stream[i] = 1.0f;
+		}
+	}
+
+	mCount = count;
+	mPaddedCount = paddedCount;
+	mData.swap(data);
+}
+
+void MatrixSoA::Set(size_t index, FXMMATRIX M)
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, M);
+	Set(index, m);
+}
+
+void MatrixSoA::Set(size_t index, const XMFLOAT4X4& M)
+{
+	assert(index < mCount);
+	for (int r = 0; r < 4; ++r)
+		for (int c = 0; c < 4; ++c)
+			GetElements(r, c)[index] = M.m[r][c];
+}
+
+XMMATRIX MatrixSoA::Get(size_t index) const
+{
+	XMFLOAT4X4 m;
+	Get(index, m);
+	return XMLoadFloat4x4(&m);
+}
+
+void MatrixSoA::Get(size_t index, XMFLOAT4X4& M) const
+{
+	assert(index < mCount);
+	for (int r = 0; r < 4; ++r)
+		for (int c = 0; c < 4; ++c)
+			M.m[r][c] = GetElements(r, c)[index];
+}
+
+void MatrixSoA::Load(const XMFLOAT4X4* src, size_t count, size_t first)
+{
+	assert(first + count <= mCount);
+	for (int r = 0; r < 4; ++r)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			float* stream = GetElements(r, c) + first;
+			for (size_t i = 0; i < count; ++i)
+				stream[i] = src[i].m[r][c];
+		}
+	}
+}
+
+void MatrixSoA::Store(XMFLOAT4X4* dst, size_t count, size_t first) const
+{
+	assert(first + count <= mCount);
+	for (int r = 0; r < 4; ++r)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			const float* stream = GetElements(r, c) + first;
+			for (size_t i = 0; i < count; ++i)
+				dst[i].m[r][c] = stream[i];
+		}
+	}
+}
+
+void MatrixBatch::Multiply(const MatrixSoA& a, const MatrixSoA& b, MatrixSoA& out, ThreadPool* pool)
+{
+	assert(a.GetCount() == b.GetCount());
+	out.Resize(a.GetCount());
+
+	ForEachBlockRange(a.GetPaddedCount() / MatrixSoA::LaneCount, pool, [&](size_t begin, size_t end)
+	{
+		Block A, B;
+		for (size_t i = begin; i < end; ++i)
+		{
+			LoadBlock(a, i, A);
+			LoadBlock(b, i, B);
+			MultiplyBlock(A, B, A);
+			StoreBlock(A, i, out);
+		}
+	});
+}
+
+void MatrixBatch::Multiply(const MatrixSoA& a, CXMMATRIX b, MatrixSoA& out, ThreadPool* pool)
+{
+	out.Resize(a.GetCount());
+
+	Block B;
+	SplatBlock(b, B);
+
+	ForEachBlockRange(a.GetPaddedCount() / MatrixSoA::LaneCount, pool, [&](size_t begin, size_t end)
+	{
+		Block A;
+		for (size_t i = begin; i < end; ++i)
+		{
+			LoadBlock(a, i, A);
+			MultiplyBlock(A, B, A);
+			StoreBlock(A, i, out);
+		}
+	});
+}
+
+void MatrixBatch::MultiplyChain(const MatrixSoA* const* factors, size_t factorCount, MatrixSoA& out, ThreadPool* pool)
+{
+	assert(factorCount > 0);
+	for (size_t k = 1; k < factorCount; ++k)
+		assert(factors[k]->GetCount() == factors[0]->GetCount());
+
+	out.Resize(factors[0]->GetCount());
+
+	ForEachBlockRange(out.GetPaddedCount() / MatrixSoA::LaneCount, pool, [&](size_t begin, size_t end)
+	{
+		Block product, factor;
+		for (size_t i = begin; i < end; ++i)
+		{
+			LoadBlock(*factors[0], i, product);
+			for (size_t k = 1; k < factorCount; ++k)
+			{
+				LoadBlock(*factors[k], i, factor);
+				MultiplyBlock(product, factor, product);
+			}
+			StoreBlock(product, i, out);
+		}
+	});
+}
+
+void MatrixBatch::InverseTransposeAffine(const MatrixSoA& in, MatrixSoA& out, ThreadPool* pool)
+{
+	out.Resize(in.GetCount());
+
+	ForEachBlockRange(in.GetPaddedCount() / MatrixSoA::LaneCount, pool, [&](size_t begin, size_t end)
+	{
+		Block M;
+		for (size_t i = begin; i < end; ++i)
+		{
+			LoadBlock(in, i, M);
+			InverseTransposeAffineBlock(M, M);
+			StoreBlock(M, i, out);
+		}
+	});
+}
+
+void MatrixBatch::InverseTransposeAffine(const XMFLOAT4X4* in, XMFLOAT4X4* out, size_t count)
+{
+	// 8 at a time through a block on the stack; each block is loaded before it is
+	// stored, so in may be out.
+	Block M;
+	for (size_t first = 0; first < count; first += MatrixSoA::LaneCount)
+	{
+		size_t n = count - first < MatrixSoA::LaneCount ? count - first : MatrixSoA::LaneCount;
+		LoadBlock(in + first, n, M);
+		InverseTransposeAffineBlock(M, M);
+		StoreBlock(M, n, out + first);
+	}
+}
+
+void MatrixBatch::WriteObjectConstants(const MatrixSoA& world, CXMMATRIX viewProj,
+	const ObjectConstantsLayout& layout, void* dst, size_t first, size_t count, ThreadPool* pool)
+{
+	assert(first + count <= world.GetCount());
+	if (count == 0)
+		return;
+
+	Block VP;
+	SplatBlock(viewProj, VP);
+
+	const size_t lanes = MatrixSoA::LaneCount;
+	size_t firstBlock = first / lanes;
+	size_t endBlock = (first + count + lanes - 1) / lanes;
+
+	ForEachBlockRange(endBlock - firstBlock, pool, [&](size_t begin, size_t end)
+	{
+		Block W, M;
+		for (size_t i = firstBlock + begin; i < firstBlock + end; ++i)
+		{
+			size_t laneBegin = i == firstBlock ? first - i * lanes : 0;
+			size_t laneEnd = first + count - i * lanes < lanes ? first + count - i * lanes : lanes;
+			// Object first goes to dst, so lane j of block i goes to (i * 8 + j - first) * Stride.
+			std::uint8_t* blockDst = static_cast<std::uint8_t*>(dst) + (i * lanes + laneBegin - first) * layout.Stride;
+
+			LoadBlock(world, i, W);
+
+			if (layout.WorldOffset != NotWritten)
+				StoreTransposed(W, laneBegin, laneEnd, blockDst + layout.WorldOffset, layout.Stride);
+
+			if (layout.WorldInvTransposeOffset != NotWritten)
+			{
+				InverseTransposeAffineBlock(W, M);
+				StoreTransposed(M, laneBegin, laneEnd, blockDst + layout.WorldInvTransposeOffset, layout.Stride);
+			}
+
+			if (layout.WorldViewProjOffset != NotWritten)
+			{
+				MultiplyBlock(W, VP, M);
+				StoreTransposed(M, laneBegin, laneEnd, blockDst + layout.WorldViewProjOffset, layout.Stride);
+			}
+		}
+	});
+}
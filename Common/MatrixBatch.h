@@ -0,0 +1,113 @@
+//***************************************************************************************
+// MatrixBatch.h
+//
+// Per-object matrix work (world * viewProj, normal matrices) for many objects at once.
+// Matrices are kept in SoA form (MatrixSoA: one float stream per element), so 8 matrices
+// are processed per step with AVX2 and 2 x 4 otherwise, and the results are written
+// straight into constant buffer staging memory (e.g. a mapped UploadBuffer).
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+///<summary>
+/// count matrices stored as 16 float streams, element (r, c) of matrix i at
+/// GetElements(r, c)[i]. Streams are padded to a multiple of 8 with identity matrices
+/// so kernels never need a tail loop.
+///</summary>
+class MatrixSoA
+{
+public:
+	static const size_t LaneCount = 8;
+
+	MatrixSoA() = default;
+	explicit MatrixSoA(size_t count) { Resize(count); }
+
+	// New matrices are identity.
+	void Resize(size_t count);
+
+	size_t GetCount() const { return mCount; }
+	size_t GetPaddedCount() const { return mPaddedCount; }
+
+	float* GetElements(int row, int column) { return mData.data() + (row * 4 + column) * mPaddedCount; }
+	const float* GetElements(int row, int column) const { return mData.data() + (row * 4 + column) * mPaddedCount; }
+
+	void Set(size_t index, DirectX::FXMMATRIX M);
+	void Set(size_t index, const DirectX::XMFLOAT4X4& M);
+	DirectX::XMMATRIX Get(size_t index) const;
+	void Get(size_t index, DirectX::XMFLOAT4X4& M) const;
+
+	// Copies count AoS matrices in / out starting at first.
+	void Load(const DirectX::XMFLOAT4X4* src, size_t count, size_t first = 0);
+	void Store(DirectX::XMFLOAT4X4* dst, size_t count, size_t first = 0) const;
+
+private:
+	size_t mCount = 0;
+	size_t mPaddedCount = 0;
+	std::vector<float> mData;
+};
+
+class MatrixBatch
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	static const size_t NotWritten = ~size_t(0);
+
+	///<summary>
+	/// Where WriteObjectConstants puts each matrix of object i: at
+	/// dst + i * Stride + offset, as a transposed XMFLOAT4X4 (HLSL column_major, like
+	/// XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world))). NotWritten skips it.
+	///</summary>
+	struct ObjectConstantsLayout
+	{
+		size_t Stride = 256; // Constant buffer views are 256 byte aligned.
+		size_t WorldOffset = 0;
+		size_t WorldInvTransposeOffset = NotWritten;
+		size_t WorldViewProjOffset = NotWritten;
+	};
+
+	// out[i] = a[i] * b[i]. out may be a or b.
+	static void Multiply(const MatrixSoA& a, const MatrixSoA& b, MatrixSoA& out, ThreadPool* pool = nullptr);
+
+	// out[i] = a[i] * b, e.g. world * viewProj. out may be a.
+	static void Multiply(const MatrixSoA& a, DirectX::CXMMATRIX b, MatrixSoA& out, ThreadPool* pool = nullptr);
+
+	///<summary>
+	/// out[i] = factors[0][i] * factors[1][i] * ... * factors[factorCount - 1][i], with the
+	/// partial products kept in registers (scale * rotation * translation * parent, ...).
+	/// out may be one of the factors.
+	///</summary>
+	static void MultiplyChain(const MatrixSoA* const* factors, size_t factorCount, MatrixSoA& out, ThreadPool* pool = nullptr);
+
+	///<summary>
+	/// Same result as MathHelper::InverseTranspose for affine matrices (last column
+	/// 0, 0, 0, 1): the translation row is ignored, so only the upper 3x3 is inverted,
+	/// as cross products over the determinant. out may be in.
+	///</summary>
+	static void InverseTransposeAffine(const MatrixSoA& in, MatrixSoA& out, ThreadPool* pool = nullptr);
+
+	// AoS convenience version of the above; in and out may be the same array.
+	static void InverseTransposeAffine(const DirectX::XMFLOAT4X4* in, DirectX::XMFLOAT4X4* out, size_t count);
+
+	///<summary>
+	/// Writes world[i], its inverse-transpose and world[i] * viewProj for objects
+	/// first .. first + count - 1 into dst (object i at dst + (i - first) * layout.Stride).
+	/// Each destination matrix is written once with plain stores, which suits write
+	/// combined upload heaps.
+	///</summary>
+	static void WriteObjectConstants(const MatrixSoA& world, DirectX::CXMMATRIX viewProj,
+		const ObjectConstantsLayout& layout, void* dst, size_t first, size_t count, ThreadPool* pool = nullptr);
+
+	static void WriteObjectConstants(const MatrixSoA& world, DirectX::CXMMATRIX viewProj,
+		const ObjectConstantsLayout& layout, void* dst, ThreadPool* pool = nullptr)
+	{
+		WriteObjectConstants(world, viewProj, layout, dst, 0, world.GetCount(), pool);
+	}
+};
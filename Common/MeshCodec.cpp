@@ -0,0 +1,354 @@
+//***************************************************************************************
+// MeshCodec.cpp
+//***************************************************************************************
+
+#include "MeshCodec.h"
+#include <cstdint>
+#include <cstring>
+#include <new>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#define MESH_CODEC_SSE2
+#endif
+
+namespace
+{
+	const MeshCodec::uint32 CodecMagic = 0x3148534D; // "MSH1"
+
+	const size_t WordsPerVertex = sizeof(GeometryGenerator::Vertex) / sizeof(MeshCodec::uint32);
+	const size_t PlaneCount = sizeof(GeometryGenerator::Vertex);
+
+	// Zero runs shorter than this are cheaper to keep as literals.
+	const size_t MinZeroRun = 3;
+
+	void WriteU32(std::vector<MeshCodec::uint8>& out, MeshCodec::uint32 v)
+	{
+		for (int i = 0; i < 4; ++i)
+			out.push_back((MeshCodec::uint8)(v >> (8 * i)));
+	}
+
+	bool ReadU32(const MeshCodec::uint8*& data, const MeshCodec::uint8* end, MeshCodec::uint32& v)
+	{
+		if (end - data < 4)
+			return false;
+
+		v = data[0] | (data[1] << 8) | (data[2] << 16) | ((MeshCodec::uint32)data[3] << 24);
+		data += 4;
+		return true;
+	}
+
+	void WriteVarint(std::vector<MeshCodec::uint8>& out, size_t v)
+	{
+		while (v >= 0x80)
+		{
+			out.push_back((MeshCodec::uint8)(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back((MeshCodec::uint8)v);
+	}
+
+	bool ReadVarint(const MeshCodec::uint8*& data, const MeshCodec::uint8* end, size_t& v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (data == end)
+				return false;
+
+			MeshCodec::uint8 b = *data++;
+			v |= (size_t)(b & 0x7f) << shift;
+
+			if ((b & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	MeshCodec::uint32 ZigZag(std::int32_t v)
+	{
+		return ((MeshCodec::uint32)v << 1) ^ (MeshCodec::uint32)(v >> 31);
+	}
+
+	std::int32_t UnZigZag(MeshCodec::uint32 v)
+	{
+		return (std::int32_t)(v >> 1) ^ -(std::int32_t)(v & 1);
+	}
+}
+
+std::vector<MeshCodec::uint8> MeshCodec::Encode(const GeometryGenerator::MeshData& meshData)
+{
+	std::vector<uint8> out;
+	out.reserve(16 + meshData.Indices32.size() + meshData.Vertices.size() * sizeof(GeometryGenerator::Vertex) / 2);
+
+	WriteU32(out, CodecMagic);
+	WriteU32(out, (uint32)meshData.Vertices.size());
+	WriteU32(out, (uint32)meshData.Indices32.size());
+
+	EncodeIndices(meshData.Indices32, out);
+	EncodeVertices(meshData.Vertices, out);
+
+	return out;
+}
+
+bool MeshCodec::Decode(const uint8* data, size_t byteSize, GeometryGenerator::MeshData& meshData)
+{
+	const uint8* end = data + byteSize;
+
+	uint32 magic, vertexCount, indexCount;
+	if (!ReadU32(data, end, magic) || magic != CodecMagic ||
+		!ReadU32(data, end, vertexCount) || !ReadU32(data, end, indexCount))
+		return false;
+
+	// Every index takes at least one byte, and the vertex planes must be addressable.
+	if (indexCount > (size_t)(end - data) || vertexCount > SIZE_MAX / PlaneCount)
+		return false;
+
+	// Zero runs let a few bytes stand for many vertices, so a corrupt vertex count can
+	// still ask for more memory than there is.
+	try
+	{
+		meshData.Indices32.resize(indexCount);
+		meshData.Vertices.resize(vertexCount);
+
+		return DecodeIndices(data, end, meshData.Indices32) &&
+			DecodeVertices(data, end, meshData.Vertices) &&
+			data == end;
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+}
+
+void MeshCodec::EncodeIndices(const std::vector<uint32>& indices, std::vector<uint8>& out)
+{
+	uint32 prevFirst = 0;
+
+	size_t i = 0;
+	for (; i + 3 <= indices.size(); i += 3)
+	{
+		uint32 a = indices[i + 0];
+		uint32 b = indices[i + 1];
+		uint32 c = indices[i + 2];
+
+		WriteVarint(out, ZigZag((std::int32_t)(a - prevFirst)));
+		WriteVarint(out, ZigZag((std::int32_t)(b - a)));
+		WriteVarint(out, ZigZag((std::int32_t)(c - a)));
+
+		prevFirst = a;
+	}
+
+	// Incomplete trailing triangle.
+	for (; i < indices.size(); ++i)
+		WriteVarint(out, indices[i]);
+}
+
+bool MeshCodec::DecodeIndices(const uint8*& data, const uint8* end, std::vector<uint32>& indices)
+{
+	uint32 prevFirst = 0;
+	size_t d0, d1, d2;
+
+	size_t i = 0;
+	for (; i + 3 <= indices.size(); i += 3)
+	{
+		if (!ReadVarint(data, end, d0) || !ReadVarint(data, end, d1) || !ReadVarint(data, end, d2))
+			return false;
+
+		uint32 a = prevFirst + UnZigZag((uint32)d0);
+		indices[i + 0] = a;
+		indices[i + 1] = a + UnZigZag((uint32)d1);
+		indices[i + 2] = a + UnZigZag((uint32)d2);
+
+		prevFirst = a;
+	}
+
+	for (; i < indices.size(); ++i)
+	{
+		if (!ReadVarint(data, end, d0))
+			return false;
+		indices[i] = (uint32)d0;
+	}
+
+	return true;
+}
+
+void MeshCodec::EncodeVertices(const std::vector<GeometryGenerator::Vertex>& vertices, std::vector<uint8>& out)
+{
+	size_t vertexCount = vertices.size();
+	if (vertexCount == 0)
+		return;
+
+	// XOR each word with the previous vertex and scatter its bytes into planes.
+	std::vector<uint8> planes(vertexCount * PlaneCount);
+
+	uint32 prev[WordsPerVertex] = {};
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		uint32 words[WordsPerVertex];
+		std::memcpy(words, &vertices[v], sizeof(words));
+
+		for (size_t w = 0; w < WordsPerVertex; ++w)
+		{
+			uint32 delta = words[w] ^ prev[w];
+			prev[w] = words[w];
+
+			for (size_t b = 0; b < 4; ++b)
+				planes[(w * 4 + b) * vertexCount + v] = (uint8)(delta >> (8 * b));
+		}
+	}
+
+	// Zero-run-length code the planes as (literal count, literals, zero count) groups.
+	size_t i = 0;
+	size_t size = planes.size();
+	while (i < size)
+	{
+		size_t literalStart = i;
+		size_t zeroStart = size;
+
+		while (i < size)
+		{
+			if (planes[i] == 0)
+			{
+				size_t run = i;
+				while (run < size && planes[run] == 0 && run - i < MinZeroRun)
+					++run;
+
+				if (run - i == MinZeroRun || run == size)
+				{
+					zeroStart = i;
+					break;
+				}
+				i = run;
+			}
+			else
+				++i;
+		}
+
+		size_t zeroEnd = zeroStart;
+		while (zeroEnd < size && planes[zeroEnd] == 0)
+			++zeroEnd;
+
+		WriteVarint(out, zeroStart - literalStart);
+		out.insert(out.end(), planes.begin() + literalStart, planes.begin() + zeroStart);
+		WriteVarint(out, zeroEnd - zeroStart);
+
+		i = zeroEnd;
+	}
+}
+
+bool MeshCodec::DecodeVertices(const uint8*& data, const uint8* end, std::vector<GeometryGenerator::Vertex>& vertices)
+{
+	size_t vertexCount = vertices.size();
+	if (vertexCount == 0)
+		return true;
+
+	std::vector<uint8> planes(vertexCount * PlaneCount);
+
+	// Undo the zero-run-length coding.
+	size_t size = planes.size();
+	size_t i = 0;
+	while (i < size)
+	{
+		size_t literals, zeros;
+		if (!ReadVarint(data, end, literals) || literals > size - i || (size_t)(end - data) < literals)
+			return false;
+
+		std::memcpy(&planes[i], data, literals);
+		data += literals;
+		i += literals;
+
+		if (!ReadVarint(data, end, zeros) || zeros > size - i)
+			return false;
+
+		std::memset(&planes[i], 0, zeros);
+		i += zeros;
+	}
+
+	uint32* out = reinterpret_cast<uint32*>(vertices.data());
+	size_t v = 0;
+
+#if defined(MESH_CODEC_SSE2)
+	// 16 vertices per step: rebuild each word from its 4 byte planes, undo the XOR
+	// with a prefix scan, then transpose 4 words x 4 vertices back to AoS.
+	// Word groups are written last to first because the padding lane of the last
+	// group spills into the next vertex's first word, which a later group rewrites;
+	// the strict bound keeps that spill inside the buffer.
+	__m128i carry[WordsPerVertex + 1] = {};
+	alignas(16) uint32 words[WordsPerVertex + 1][16] = {};
+
+	for (; v + 16 < vertexCount; v += 16)
+	{
+		for (size_t w = 0; w < WordsPerVertex; ++w)
+		{
+			const uint8* plane = &planes[w * 4 * vertexCount + v];
+			__m128i b0 = _mm_loadu_si128((const __m128i*)(plane));
+			__m128i b1 = _mm_loadu_si128((const __m128i*)(plane + vertexCount));
+			__m128i b2 = _mm_loadu_si128((const __m128i*)(plane + 2 * vertexCount));
+			__m128i b3 = _mm_loadu_si128((const __m128i*)(plane + 3 * vertexCount));
+
+			__m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+			__m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+			__m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+			__m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+
+			__m128i x[4] =
+			{
+				_mm_unpacklo_epi16(lo01, lo23),
+				_mm_unpackhi_epi16(lo01, lo23),
+				_mm_unpacklo_epi16(hi01, hi23),
+				_mm_unpackhi_epi16(hi01, hi23)
+			};
+
+			for (int k = 0; k < 4; ++k)
+			{
+				x[k] = _mm_xor_si128(x[k], _mm_slli_si128(x[k], 4));
+				x[k] = _mm_xor_si128(x[k], _mm_slli_si128(x[k], 8));
+				x[k] = _mm_xor_si128(x[k], carry[w]);
+				carry[w] = _mm_shuffle_epi32(x[k], _MM_SHUFFLE(3, 3, 3, 3));
+
+				_mm_store_si128((__m128i*)&words[w][k * 4], x[k]);
+			}
+		}
+
+		for (int group = 2; group >= 0; --group)
+		{
+			size_t w0 = group * 4;
+			for (size_t j = 0; j < 16; j += 4)
+			{
+				__m128 r0 = _mm_load_ps((const float*)&words[w0 + 0][j]);
+				__m128 r1 = _mm_load_ps((const float*)&words[w0 + 1][j]);
+				__m128 r2 = _mm_load_ps((const float*)&words[w0 + 2][j]);
+				__m128 r3 = _mm_load_ps((const float*)&words[w0 + 3][j]);
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+				_mm_storeu_ps((float*)&out[(v + j + 0) * WordsPerVertex + w0], r0);
+				_mm_storeu_ps((float*)&out[(v + j + 1) * WordsPerVertex + w0], r1);
+				_mm_storeu_ps((float*)&out[(v + j + 2) * WordsPerVertex + w0], r2);
+				_mm_storeu_ps((float*)&out[(v + j + 3) * WordsPerVertex + w0], r3);
+			}
+		}
+	}
+
+	uint32 prev[WordsPerVertex];
+	for (size_t w = 0; w < WordsPerVertex; ++w)
+		prev[w] = (uint32)_mm_cvtsi128_si32(carry[w]);
+#else
+	uint32 prev[WordsPerVertex] = {};
+#endif
+
+	for (; v < vertexCount; ++v)
+	{
+		for (size_t w = 0; w < WordsPerVertex; ++w)
+		{
+			uint32 delta = 0;
+			for (size_t b = 0; b < 4; ++b)
+				delta |= (uint32)planes[(w * 4 + b) * vertexCount + v] << (8 * b);
+
+			prev[w] ^= delta;
+			out[v * WordsPerVertex + w] = prev[w];
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,39 @@
+//***************************************************************************************
+// MeshCodec.h
+//
+// Lossless compression of MeshData vertex / index streams for storage on disk.
+//
+// Indices: each triangle is coded relative to the previous one (first index minus the
+//          previous first index, the other two minus the first), zigzag + varint.
+// Vertices: every 32 bit word is XORed with the same word of the previous vertex,
+//          then the bytes are transposed into 44 byte planes so the mostly-zero
+//          high bytes line up, and the planes are zero-run-length coded.
+// Decoding undoes the transpose and the XOR 16 vertices at a time with SSE2.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "GeometryGenerator.h"
+
+class MeshCodec
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	static std::vector<uint8> Encode(const GeometryGenerator::MeshData& meshData);
+
+	// Returns false if the data is not a valid encoded mesh (or does not fit in memory);
+	// never throws.
+	static bool Decode(const uint8* data, size_t byteSize, GeometryGenerator::MeshData& meshData);
+
+private:
+	static void EncodeIndices(const std::vector<uint32>& indices, std::vector<uint8>& out);
+	static bool DecodeIndices(const uint8*& data, const uint8* end, std::vector<uint32>& indices);
+
+	static void EncodeVertices(const std::vector<GeometryGenerator::Vertex>& vertices, std::vector<uint8>& out);
+	static bool DecodeVertices(const uint8*& data, const uint8* end, std::vector<GeometryGenerator::Vertex>& vertices);
+};
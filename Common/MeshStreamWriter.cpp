@@ -0,0 +1,156 @@
+//***************************************************************************************
+// MeshStreamWriter.cpp
+//***************************************************************************************
+
+#include "MeshStreamWriter.h"
+#include <cassert>
+#include <cstring>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define NT_STREAM_SSE2
+#endif
+
+NonTemporalStream::NonTemporalStream(void* dst, size_t capacity) :
+	mDst(static_cast<std::uint8_t*>(dst)),
+	mCapacity(capacity)
+{
+	assert((reinterpret_cast<std::uintptr_t>(dst) & 15) == 0);
+}
+
+void NonTemporalStream::Write(const void* data, size_t byteSize)
+{
+	assert(GetByteSize() + byteSize <= mCapacity);
+
+	const std::uint8_t* src = static_cast<const std::uint8_t*>(data);
+	while (byteSize > 0)
+	{
+		size_t n = LineSize - mPendingSize;
+		n = n < byteSize ? n : byteSize;
+
+		std::memcpy(mPending + mPendingSize, src, n);
+		mPendingSize += n;
+		src += n;
+		byteSize -= n;
+
+		if (mPendingSize == LineSize)
+			WriteLine();
+	}
+}
+
+void NonTemporalStream::WriteLine()
+{
+	std::uint8_t* dst = mDst + mWritten;
+
+#if defined(NT_STREAM_SSE2)
+	const __m128i* src = reinterpret_cast<const __m128i*>(mPending);
+	_mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 0, _mm_load_si128(src + 0));
+	_mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 1, _mm_load_si128(src + 1));
+	_mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 2, _mm_load_si128(src + 2));
+	_mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 3, _mm_load_si128(src + 3));
+#else
+	std::memcpy(dst, mPending, LineSize);
+#endif
+
+	mWritten += LineSize;
+	mPendingSize = 0;
+}
+
+void NonTemporalStream::Flush()
+{
+	std::uint8_t* dst = mDst + mWritten;
+
+	// Whole 16 byte chunks still go out non-temporal; only the tail is a normal store.
+	size_t chunkBytes = mPendingSize & ~size_t(15);
+
+#if defined(NT_STREAM_SSE2)
+	for (size_t i = 0; i < chunkBytes; i += 16)
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), _mm_load_si128(reinterpret_cast<const __m128i*>(mPending + i)));
+#else
+	std::memcpy(dst, mPending, chunkBytes);
+#endif
+
+	std::memcpy(dst + chunkBytes, mPending + chunkBytes, mPendingSize - chunkBytes);
+
+	// The tail stays pending, so later writes continue right after it and the next
+	// streamed chunk (which rewrites the tail) still starts on a 16 byte boundary.
+	mWritten += chunkBytes;
+	mPendingSize -= chunkBytes;
+	std::memmove(mPending, mPending + chunkBytes, mPendingSize);
+
+#if defined(NT_STREAM_SSE2)
+	_mm_sfence();
+#endif
+}
+
+MeshStreamWriter::MeshStreamWriter(void* vertexDst, size_t vertexCapacity, void* indexDst, size_t indexCapacity, bool index16) :
+	mVertices(vertexDst, vertexCapacity * sizeof(GeometryGenerator::Vertex)),
+	mIndices(indexDst, indexCapacity * (index16 ? sizeof(uint16) : sizeof(uint32))),
+	mVertexCapacity(vertexCapacity),
+	mIndexCapacity(indexCapacity),
+	mIndex16(index16)
+{
+}
+
+void MeshStreamWriter::PushVertex(const GeometryGenerator::Vertex& v)
+{
+	assert(mVertexCount < mVertexCapacity);
+
+	mVertices.Write(&v, sizeof(GeometryGenerator::Vertex));
+	++mVertexCount;
+}
+
+void MeshStreamWriter::PushIndex(uint32 index)
+{
+	assert(mIndexCount < mIndexCapacity);
+
+	if (mIndex16)
+	{
+		assert(index <= 0xffff);
+		uint16 index16 = static_cast<uint16>(index);
+		mIndices.Write(&index16, sizeof(uint16));
+	}
+	else
+		mIndices.Write(&index, sizeof(uint32));
+
+	++mIndexCount;
+}
+
+bool MeshStreamWriter::PushMesh(const GeometryGenerator::MeshData& meshData)
+{
+	assert(mVertexCount + meshData.Vertices.size() <= mVertexCapacity);
+
+	if (mIndex16)
+	{
+		for (uint32 index : meshData.Indices32)
+		{
+			if (index > 0xffff)
+				return false;
+		}
+	}
+
+	if (!meshData.Vertices.empty())
+		mVertices.Write(meshData.Vertices.data(), meshData.Vertices.size() * sizeof(GeometryGenerator::Vertex));
+	mVertexCount += (uint32)meshData.Vertices.size();
+
+	if (mIndex16)
+	{
+		for (uint32 index : meshData.Indices32)
+			PushIndex(index);
+	}
+	else
+	{
+		assert(mIndexCount + meshData.Indices32.size() <= mIndexCapacity);
+
+		if (!meshData.Indices32.empty())
+			mIndices.Write(meshData.Indices32.data(), meshData.Indices32.size() * sizeof(uint32));
+		mIndexCount += (uint32)meshData.Indices32.size();
+	}
+
+	return true;
+}
+
+void MeshStreamWriter::Finish()
+{
+	mVertices.Flush();
+	mIndices.Flush();
+}
@@ -0,0 +1,97 @@
+//***************************************************************************************
+// MeshStreamWriter.h
+//
+// Sequential writer for generated vertices / indices into mapped upload memory.
+// Data goes out in whole 16 byte non-temporal stores so write-combined upload heap
+// pages are filled front to back and never read back by the CPU.
+// Any 16 byte aligned CPU memory works as a destination, which is how the path
+// is exercised without a GPU.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "GeometryGenerator.h"
+
+// Appends bytes to a destination with 16 byte non-temporal stores.
+class NonTemporalStream
+{
+public:
+	NonTemporalStream() = default;
+
+	// dst must be 16 byte aligned.
+	NonTemporalStream(void* dst, size_t capacity);
+
+	void Write(const void* data, size_t byteSize);
+
+	///<summary>
+	/// Writes out pending bytes and fences the non-temporal stores. Writing may go on
+	/// afterwards: the bytes after the last 16 byte boundary stay pending and are
+	/// streamed again with the data that follows them.
+	///</summary>
+	void Flush();
+
+	size_t GetByteSize()const { return mWritten + mPendingSize; }
+	size_t GetCapacity()const { return mCapacity; }
+
+private:
+	void WriteLine();
+
+private:
+	static const size_t LineSize = 64;
+
+	std::uint8_t* mDst = nullptr;
+	size_t mCapacity = 0;
+	size_t mWritten = 0;
+
+	// One cache line is gathered before it is streamed out.
+	alignas(16) std::uint8_t mPending[LineSize];
+	size_t mPendingSize = 0;
+};
+
+class MeshStreamWriter
+{
+public:
+
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+	///<summary>
+	/// vertexDst / indexDst must be 16 byte aligned (upload heap allocations are 64KB
+	/// aligned). Capacities are in elements. With index16 indices are written as uint16,
+	/// matching MeshGeometry::IndexFormat = DXGI_FORMAT_R16_UINT.
+	///</summary>
+	MeshStreamWriter(void* vertexDst, size_t vertexCapacity, void* indexDst, size_t indexCapacity, bool index16 = true);
+
+	void PushVertex(const GeometryGenerator::Vertex& v);
+
+	// With index16 the index must fit in 16 bits.
+	void PushIndex(uint32 index);
+
+	///<summary>
+	/// Copies already generated geometry (e.g. CreateBox / CreateGeosphere output).
+	/// With index16, returns false and writes nothing when an index does not fit in
+	/// 16 bits; use a 32 bit writer for such meshes.
+	///</summary>
+	bool PushMesh(const GeometryGenerator::MeshData& meshData);
+
+	// Must be called before the GPU reads the destination.
+	void Finish();
+
+	uint32 GetVertexCount()const { return mVertexCount; }
+	uint32 GetIndexCount()const { return mIndexCount; }
+
+	size_t GetVertexByteSize()const { return mVertexCount * sizeof(GeometryGenerator::Vertex); }
+	size_t GetIndexByteSize()const { return mIndexCount * (mIndex16 ? sizeof(uint16) : sizeof(uint32)); }
+
+private:
+	NonTemporalStream mVertices;
+	NonTemporalStream mIndices;
+
+	size_t mVertexCapacity = 0;
+	size_t mIndexCapacity = 0;
+	uint32 mVertexCount = 0;
+	uint32 mIndexCount = 0;
+	bool mIndex16 = true;
+};
@@ -0,0 +1,677 @@
+//***************************************************************************************
+// Noise.cpp
+//***************************************************************************************
+
+#include "Noise.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+// The 8 wide kernels need FMA as well, which MSVC's /arch:AVX2 implies.
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define NOISE_AVX2
+#endif
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define NOISE_SSE2
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = Noise::uint32;
+
+	// Samples per ParallelFor chunk (whole rows for the fills).
+	const size_t FillGrainSamples = 16384;
+
+	// Samples per Sample() batch for DisplaceGrid.
+	const size_t DisplaceBlockSize = 1024;
+
+	// Bring each basis to roughly [-1, 1] (measured maxima of the raw sums).
+	const float Perlin2Scale = 0.66f;
+	const float Perlin3Scale = 0.97f;
+	const float Simplex2Scale = 45.0f;
+	const float Simplex3Scale = 76.0f;
+
+	// The kernels below are written once against these overloads and instantiated for
+	// float (single sample), __m128 (SSE2) and __m256 (AVX2). Masks are bool / __m128 /
+	// __m256.
+
+	template<typename F> struct Lane;
+
+	template<> struct Lane<float>
+	{
+		using Int = uint32;
+		using Mask = bool;
+		static const size_t Count = 1;
+	};
+
+	template<typename F> F Splat(float f);
+	template<typename F> typename Lane<F>::Int SplatI(uint32 i);
+
+	template<> inline float Splat<float>(float f) { return f; }
+	template<> inline uint32 SplatI<float>(uint32 i) { return i; }
+
+	inline float Load(const float* p, float) { return *p; }
+	inline void Store(float* p, float a) { *p = a; }
+	inline float Add(float a, float b) { return a + b; }
+	inline float Sub(float a, float b) { return a - b; }
+	inline float Mul(float a, float b) { return a * b; }
+#if defined(NOISE_AVX2)
+	// Fused like _mm256_fmadd_ps, so single samples match the AVX2 batches bit for bit.
+	inline float MulAdd(float a, float b, float c) { return std::fma(a, b, c); }
+#else
+	inline float MulAdd(float a, float b, float c) { return a * b + c; }
+#endif
+	inline float Max(float a, float b) { return a > b ? a : b; }
+	inline float Abs(float a) { return fabsf(a); }
+	inline float Floor(float a) { return floorf(a); }
+	inline bool Greater(float a, float b) { return a > b; }
+	inline bool MaskAnd(bool a, bool b) { return a && b; }
+	inline bool MaskOr(bool a, bool b) { return a || b; }
+	inline bool MaskNot(bool a) { return !a; }
+	inline float Select(bool mask, float a, float b) { return mask ? a : b; }
+
+	inline uint32 ToInt(float a) { return (uint32)(std::int32_t)a; }
+	inline float ToFloat(uint32 a) { return (float)(std::int32_t)a; }
+	inline uint32 AddI(uint32 a, uint32 b) { return a + b; }
+	inline uint32 MulI(uint32 a, uint32 b) { return a * b; }
+	inline uint32 XorI(uint32 a, uint32 b) { return a ^ b; }
+	inline uint32 AndI(uint32 a, uint32 b) { return a & b; }
+	inline bool EqualI(uint32 a, uint32 b) { return a == b; }
+	template<int N> inline uint32 ShlI(uint32 a) { return a << N; }
+	template<int N> inline uint32 ShrI(uint32 a) { return a >> N; }
+
+	inline float FlipSign(float a, uint32 signBit)
+	{
+		uint32 bits;
+		std::memcpy(&bits, &a, sizeof(bits));
+		bits ^= signBit;
+		std::memcpy(&a, &bits, sizeof(bits));
+		return a;
+	}
+
+#if defined(NOISE_SSE2)
+	template<> struct Lane<__m128>
+	{
+		using Int = __m128i;
+		using Mask = __m128;
+		static const size_t Count = 4;
+	};
+
+	template<> inline __m128 Splat<__m128>(float f) { return _mm_set1_ps(f); }
+	template<> inline __m128i SplatI<__m128>(uint32 i) { return _mm_set1_epi32((int)i); }
+
+	inline __m128 Load(const float* p, __m128) { return _mm_loadu_ps(p); }
+	inline void Store(float* p, __m128 a) { _mm_storeu_ps(p, a); }
+	inline __m128 Add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+	inline __m128 Sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+	inline __m128 Mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+	inline __m128 MulAdd(__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	inline __m128 Max(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+	inline __m128 Abs(__m128 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+	inline __m128 Greater(__m128 a, __m128 b) { return _mm_cmpgt_ps(a, b); }
+	inline __m128 MaskAnd(__m128 a, __m128 b) { return _mm_and_ps(a, b); }
+	inline __m128 MaskOr(__m128 a, __m128 b) { return _mm_or_ps(a, b); }
+	inline __m128 MaskNot(__m128 a) { return _mm_xor_ps(a, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+	// SSE2 has no floor: truncate, then step down where that rounded up (negative x).
+	inline __m128 Floor(__m128 a)
+	{
+		__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+		return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+	}
+
+	inline __m128i ToInt(__m128 a) { return _mm_cvttps_epi32(a); }
+	inline __m128 ToFloat(__m128i a) { return _mm_cvtepi32_ps(a); }
+	inline __m128i AddI(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+	inline __m128i XorI(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+	inline __m128i AndI(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+	inline __m128 EqualI(__m128i a, __m128i b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+	template<int N> inline __m128i ShlI(__m128i a) { return _mm_slli_epi32(a, N); }
+	template<int N> inline __m128i ShrI(__m128i a) { return _mm_srli_epi32(a, N); }
+
+	// Low 32 bits of the products with SSE2 only (no pmulld): even and odd lanes apart.
+	inline __m128i MulI(__m128i a, __m128i b)
+	{
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	inline __m128 FlipSign(__m128 a, __m128i signBit) { return _mm_xor_ps(a, _mm_castsi128_ps(signBit)); }
+#endif
+
+#if defined(NOISE_AVX2)
+	template<> struct Lane<__m256>
+	{
+		using Int = __m256i;
+		using Mask = __m256;
+		static const size_t Count = 8;
+	};
+
+	template<> inline __m256 Splat<__m256>(float f) { return _mm256_set1_ps(f); }
+	template<> inline __m256i SplatI<__m256>(uint32 i) { return _mm256_set1_epi32((int)i); }
+
+	inline __m256 Load(const float* p, __m256) { return _mm256_loadu_ps(p); }
+	inline void Store(float* p, __m256 a) { _mm256_storeu_ps(p, a); }
+	inline __m256 Add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+	inline __m256 Sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+	inline __m256 Mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+	inline __m256 MulAdd(__m256 a, __m256 b, __m256 c) { return _mm256_fmadd_ps(a, b, c); }
+	inline __m256 Max(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+	inline __m256 Abs(__m256 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	inline __m256 Floor(__m256 a) { return _mm256_floor_ps(a); }
+	inline __m256 Greater(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	inline __m256 MaskAnd(__m256 a, __m256 b) { return _mm256_and_ps(a, b); }
+	inline __m256 MaskOr(__m256 a, __m256 b) { return _mm256_or_ps(a, b); }
+	inline __m256 MaskNot(__m256 a) { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+	inline __m256 Select(__m256 mask, __m256 a, __m256 b) { return _mm256_blendv_ps(b, a, mask); }
+
+	inline __m256i ToInt(__m256 a) { return _mm256_cvttps_epi32(a); }
+	inline __m256 ToFloat(__m256i a) { return _mm256_cvtepi32_ps(a); }
+	inline __m256i AddI(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+	inline __m256i MulI(__m256i a, __m256i b) { return _mm256_mullo_epi32(a, b); }
+	inline __m256i XorI(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+	inline __m256i AndI(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+	inline __m256 EqualI(__m256i a, __m256i b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+	template<int N> inline __m256i ShlI(__m256i a) { return _mm256_slli_epi32(a, N); }
+	template<int N> inline __m256i ShrI(__m256i a) { return _mm256_srli_epi32(a, N); }
+
+	inline __m256 FlipSign(__m256 a, __m256i signBit) { return _mm256_xor_ps(a, _mm256_castsi256_ps(signBit)); }
+
+	using Wide = __m256;
+#elif defined(NOISE_SSE2)
+	using Wide = __m128;
+#else
+	using Wide = float;
+#endif
+
+	template<typename F> using IntOf = typename Lane<F>::Int;
+
+	template<typename F>
+	IntOf<F> Mix(IntOf<F> h)
+	{
+		h = XorI(h, ShrI<16>(h));
+		h = MulI(h, SplatI<F>(0x7feb352d));
+		h = XorI(h, ShrI<15>(h));
+		h = MulI(h, SplatI<F>(0x846ca68b));
+		return XorI(h, ShrI<16>(h));
+	}
+
+	template<typename F>
+	IntOf<F> Hash(IntOf<F> x, IntOf<F> y, uint32 seed)
+	{
+		IntOf<F> h = XorI(MulI(x, SplatI<F>(0x8da6b343)), MulI(y, SplatI<F>(0xd8163841)));
+		return Mix<F>(XorI(h, SplatI<F>(seed)));
+	}
+
+	template<typename F>
+	IntOf<F> Hash(IntOf<F> x, IntOf<F> y, IntOf<F> z, uint32 seed)
+	{
+		IntOf<F> h = XorI(MulI(x, SplatI<F>(0x8da6b343)), MulI(y, SplatI<F>(0xd8163841)));
+		h = XorI(h, MulI(z, SplatI<F>(0xcb1ab31f)));
+		return Mix<F>(XorI(h, SplatI<F>(seed)));
+	}
+
+	// Hash -> value in [-1, 1).
+	template<typename F>
+	F HashToSigned(IntOf<F> h)
+	{
+		return MulAdd(ToFloat(ShrI<8>(h)), Splat<F>(2.0f / 16777216.0f), Splat<F>(-1.0f));
+	}
+
+	template<typename F>
+	F Lerp(F a, F b, F t)
+	{
+		return MulAdd(t, Sub(b, a), a);
+	}
+
+	// 6t^5 - 15t^4 + 10t^3
+	template<typename F>
+	F Fade(F t)
+	{
+		F p = MulAdd(t, Splat<F>(6.0f), Splat<F>(-15.0f));
+		p = MulAdd(t, p, Splat<F>(10.0f));
+		return Mul(Mul(Mul(t, t), t), p);
+	}
+
+	// Dot with one of 8 gradients (+-1, +-2) / (+-2, +-1) picked by the low 3 bits.
+	template<typename F>
+	F Grad(IntOf<F> h, F x, F y)
+	{
+		auto swap = EqualI(AndI(h, SplatI<F>(4)), SplatI<F>(4));
+		F u = Select(swap, y, x);
+		F v = Select(swap, x, y);
+		u = FlipSign(u, ShlI<31>(h));
+		v = FlipSign(v, AndI(ShlI<30>(h), SplatI<F>(0x80000000)));
+		return MulAdd(v, Splat<F>(2.0f), u);
+	}
+
+	// Dot with one of Perlin's 12 cube edge gradients (16 entries) picked by the low 4 bits.
+	template<typename F>
+	F Grad(IntOf<F> h, F x, F y, F z)
+	{
+		auto below8 = EqualI(AndI(h, SplatI<F>(8)), SplatI<F>(0));
+		auto below4 = EqualI(AndI(h, SplatI<F>(12)), SplatI<F>(0));
+		auto is12or14 = EqualI(AndI(h, SplatI<F>(13)), SplatI<F>(12));
+
+		F u = Select(below8, x, y);
+		F v = Select(below4, y, Select(is12or14, x, z));
+		u = FlipSign(u, ShlI<31>(h));
+		v = FlipSign(v, AndI(ShlI<30>(h), SplatI<F>(0x80000000)));
+		return Add(u, v);
+	}
+
+	template<typename F>
+	F Value2(F x, F y, uint32 seed)
+	{
+		F x0 = Floor(x), y0 = Floor(y);
+		F u = Fade(Sub(x, x0)), v = Fade(Sub(y, y0));
+
+		IntOf<F> ix = ToInt(x0), iy = ToInt(y0);
+		IntOf<F> ix1 = AddI(ix, SplatI<F>(1)), iy1 = AddI(iy, SplatI<F>(1));
+
+		F n0 = Lerp(HashToSigned<F>(Hash<F>(ix, iy, seed)), HashToSigned<F>(Hash<F>(ix1, iy, seed)), u);
+		F n1 = Lerp(HashToSigned<F>(Hash<F>(ix, iy1, seed)), HashToSigned<F>(Hash<F>(ix1, iy1, seed)), u);
+		return Lerp(n0, n1, v);
+	}
+
+	template<typename F>
+	F Value3(F x, F y, F z, uint32 seed)
+	{
+		F x0 = Floor(x), y0 = Floor(y), z0 = Floor(z);
+		F u = Fade(Sub(x, x0)), v = Fade(Sub(y, y0)), w = Fade(Sub(z, z0));
+
+		IntOf<F> one = SplatI<F>(1);
+		IntOf<F> ix = ToInt(x0), iy = ToInt(y0), iz = ToInt(z0);
+		IntOf<F> ix1 = AddI(ix, one), iy1 = AddI(iy, one), iz1 = AddI(iz, one);
+
+		F n00 = Lerp(HashToSigned<F>(Hash<F>(ix, iy, iz, seed)), HashToSigned<F>(Hash<F>(ix1, iy, iz, seed)), u);
+		F n10 = Lerp(HashToSigned<F>(Hash<F>(ix, iy1, iz, seed)), HashToSigned<F>(Hash<F>(ix1, iy1, iz, seed)), u);
+		F n01 = Lerp(HashToSigned<F>(Hash<F>(ix, iy, iz1, seed)), HashToSigned<F>(Hash<F>(ix1, iy, iz1, seed)), u);
+		F n11 = Lerp(HashToSigned<F>(Hash<F>(ix, iy1, iz1, seed)), HashToSigned<F>(Hash<F>(ix1, iy1, iz1, seed)), u);
+		return Lerp(Lerp(n00, n10, v), Lerp(n01, n11, v), w);
+	}
+
+	template<typename F>
+	F Perlin2(F x, F y, uint32 seed)
+	{
+		F x0 = Floor(x), y0 = Floor(y);
+		F fx = Sub(x, x0), fy = Sub(y, y0);
+		F fx1 = Sub(fx, Splat<F>(1.0f)), fy1 = Sub(fy, Splat<F>(1.0f));
+
+		IntOf<F> ix = ToInt(x0), iy = ToInt(y0);
+		IntOf<F> ix1 = AddI(ix, SplatI<F>(1)), iy1 = AddI(iy, SplatI<F>(1));
+
+		F u = Fade(fx), v = Fade(fy);
+		F n0 = Lerp(Grad<F>(Hash<F>(ix, iy, seed), fx, fy), Grad<F>(Hash<F>(ix1, iy, seed), fx1, fy), u);
+		F n1 = Lerp(Grad<F>(Hash<F>(ix, iy1, seed), fx, fy1), Grad<F>(Hash<F>(ix1, iy1, seed), fx1, fy1), u);
+		return Mul(Lerp(n0, n1, v), Splat<F>(Perlin2Scale));
+	}
+
+	template<typename F>
+	F Perlin3(F x, F y, F z, uint32 seed)
+	{
+		F x0 = Floor(x), y0 = Floor(y), z0 = Floor(z);
+		F fx = Sub(x, x0), fy = Sub(y, y0), fz = Sub(z, z0);
+		F fx1 = Sub(fx, Splat<F>(1.0f)), fy1 = Sub(fy, Splat<F>(1.0f)), fz1 = Sub(fz, Splat<F>(1.0f));
+
+		IntOf<F> one = SplatI<F>(1);
+		IntOf<F> ix = ToInt(x0), iy = ToInt(y0), iz = ToInt(z0);
+		IntOf<F> ix1 = AddI(ix, one), iy1 = AddI(iy, one), iz1 = AddI(iz, one);
+
+		F u = Fade(fx), v = Fade(fy), w = Fade(fz);
+		F n00 = Lerp(Grad<F>(Hash<F>(ix, iy, iz, seed), fx, fy, fz), Grad<F>(Hash<F>(ix1, iy, iz, seed), fx1, fy, fz), u);
+		F n10 = Lerp(Grad<F>(Hash<F>(ix, iy1, iz, seed), fx, fy1, fz), Grad<F>(Hash<F>(ix1, iy1, iz, seed), fx1, fy1, fz), u);
+		F n01 = Lerp(Grad<F>(Hash<F>(ix, iy, iz1, seed), fx, fy, fz1), Grad<F>(Hash<F>(ix1, iy, iz1, seed), fx1, fy, fz1), u);
+		F n11 = Lerp(Grad<F>(Hash<F>(ix, iy1, iz1, seed), fx, fy1, fz1), Grad<F>(Hash<F>(ix1, iy1, iz1, seed), fx1, fy1, fz1), u);
+		return Mul(Lerp(Lerp(n00, n10, v), Lerp(n01, n11, v), w), Splat<F>(Perlin3Scale));
+	}
+
+	// max(0, r2 - |d|^2)^4
+	template<typename F>
+	F Falloff(F r2, F x, F y)
+	{
+		F t = Max(Sub(Sub(r2, Mul(x, x)), Mul(y, y)), Splat<F>(0.0f));
+		t = Mul(t, t);
+		return Mul(t, t);
+	}
+
+	template<typename F>
+	F Falloff(F r2, F x, F y, F z)
+	{
+		F t = Max(Sub(Sub(Sub(r2, Mul(x, x)), Mul(y, y)), Mul(z, z)), Splat<F>(0.0f));
+		t = Mul(t, t);
+		return Mul(t, t);
+	}
+
+	// Gustavson, "Simplex noise demystified", without the permutation table.
+	template<typename F>
+	F Simplex2(F x, F y, uint32 seed)
+	{
+		const float F2 = 0.36602540378f; // (sqrt(3) - 1) / 2
+		const float G2 = 0.21132486540f; // (3 - sqrt(3)) / 6
+
+		F s = Mul(Add(x, y), Splat<F>(F2));
+		F i = Floor(Add(x, s)), j = Floor(Add(y, s));
+		F t = Mul(Add(i, j), Splat<F>(G2));
+		F x0 = Sub(x, Sub(i, t)), y0 = Sub(y, Sub(j, t));
+
+		// Middle corner: +x first in the lower triangle, +y first in the upper one.
+		F one = Splat<F>(1.0f);
+		F i1 = Select(Greater(x0, y0), one, Splat<F>(0.0f));
+		F j1 = Sub(one, i1);
+
+		F x1 = Add(Sub(x0, i1), Splat<F>(G2)), y1 = Add(Sub(y0, j1), Splat<F>(G2));
+		F x2 = Add(x0, Splat<F>(2.0f * G2 - 1.0f)), y2 = Add(y0, Splat<F>(2.0f * G2 - 1.0f));
+
+		IntOf<F> ii = ToInt(i), jj = ToInt(j);
+		IntOf<F> h0 = Hash<F>(ii, jj, seed);
+		IntOf<F> h1 = Hash<F>(ToInt(Add(i, i1)), ToInt(Add(j, j1)), seed);
+		IntOf<F> h2 = Hash<F>(AddI(ii, SplatI<F>(1)), AddI(jj, SplatI<F>(1)), seed);
+
+		F r2 = Splat<F>(0.5f);
+		F n = Mul(Falloff(r2, x0, y0), Grad<F>(h0, x0, y0));
+		n = MulAdd(Falloff(r2, x1, y1), Grad<F>(h1, x1, y1), n);
+		n = MulAdd(Falloff(r2, x2, y2), Grad<F>(h2, x2, y2), n);
+		return Mul(n, Splat<F>(Simplex2Scale));
+	}
+
+	template<typename F>
+	F Simplex3(F x, F y, F z, uint32 seed)
+	{
+		const float F3 = 1.0f / 3.0f;
+		const float G3 = 1.0f / 6.0f;
+
+		F s = Mul(Add(Add(x, y), z), Splat<F>(F3));
+		F i = Floor(Add(x, s)), j = Floor(Add(y, s)), k = Floor(Add(z, s));
+		F t = Mul(Add(Add(i, j), k), Splat<F>(G3));
+		F x0 = Sub(x, Sub(i, t)), y0 = Sub(y, Sub(j, t)), z0 = Sub(z, Sub(k, t));
+
+		// Corner offsets from the ordering of x0, y0, z0, without branches.
+		auto xy = MaskNot(Greater(y0, x0));
+		auto xz = MaskNot(Greater(z0, x0));
+		auto yz = MaskNot(Greater(z0, y0));
+
+		F one = Splat<F>(1.0f), zero = Splat<F>(0.0f);
+		F i1 = Select(MaskAnd(xy, xz), one, zero);
+		F j1 = Select(MaskAnd(MaskNot(xy), yz), one, zero);
+		F k1 = Select(MaskAnd(MaskNot(xz), MaskNot(yz)), one, zero);
+		F i2 = Select(MaskOr(xy, xz), one, zero);
+		F j2 = Select(MaskOr(MaskNot(xy), yz), one, zero);
+		F k2 = Select(MaskNot(MaskAnd(xz, yz)), one, zero);
+
+		F x1 = Add(Sub(x0, i1), Splat<F>(G3)), y1 = Add(Sub(y0, j1), Splat<F>(G3)), z1 = Add(Sub(z0, k1), Splat<F>(G3));
+		F x2 = Add(Sub(x0, i2), Splat<F>(2.0f * G3)), y2 = Add(Sub(y0, j2), Splat<F>(2.0f * G3)), z2 = Add(Sub(z0, k2), Splat<F>(2.0f * G3));
+		F x3 = Add(x0, Splat<F>(3.0f * G3 - 1.0f)), y3 = Add(y0, Splat<F>(3.0f * G3 - 1.0f)), z3 = Add(z0, Splat<F>(3.0f * G3 - 1.0f));
+
+		IntOf<F> ii = ToInt(i), jj = ToInt(j), kk = ToInt(k);
+		IntOf<F> h0 = Hash<F>(ii, jj, kk, seed);
+		IntOf<F> h1 = Hash<F>(ToInt(Add(i, i1)), ToInt(Add(j, j1)), ToInt(Add(k, k1)), seed);
+		IntOf<F> h2 = Hash<F>(ToInt(Add(i, i2)), ToInt(Add(j, j2)), ToInt(Add(k, k2)), seed);
+		IntOf<F> h3 = Hash<F>(AddI(ii, SplatI<F>(1)), AddI(jj, SplatI<F>(1)), AddI(kk, SplatI<F>(1)), seed);
+
+		// r^2 = 0.5 keeps every corner's contribution inside its simplices (no seams).
+		F r2 = Splat<F>(0.5f);
+		F n = Mul(Falloff(r2, x0, y0, z0), Grad<F>(h0, x0, y0, z0));
+		n = MulAdd(Falloff(r2, x1, y1, z1), Grad<F>(h1, x1, y1, z1), n);
+		n = MulAdd(Falloff(r2, x2, y2, z2), Grad<F>(h2, x2, y2, z2), n);
+		n = MulAdd(Falloff(r2, x3, y3, z3), Grad<F>(h3, x3, y3, z3), n);
+		return Mul(n, Splat<F>(Simplex3Scale));
+	}
+
+	template<typename F>
+	F Basis2(Noise::Basis basis, F x, F y, uint32 seed)
+	{
+		switch (basis)
+		{
+		case Noise::Basis::Value:
+			return Value2(x, y, seed);
+		case Noise::Basis::Perlin:
+			return Perlin2(x, y, seed);
+		default:
+			return Simplex2(x, y, seed);
+		}
+	}
+
+	template<typename F>
+	F Basis3(Noise::Basis basis, F x, F y, F z, uint32 seed)
+	{
+		switch (basis)
+		{
+		case Noise::Basis::Value:
+			return Value3(x, y, z, seed);
+		case Noise::Basis::Perlin:
+			return Perlin3(x, y, z, seed);
+		default:
+			return Simplex3(x, y, z, seed);
+		}
+	}
+
+	// Octave seeds differ so the octaves are uncorrelated at the origin.
+	inline uint32 OctaveSeed(uint32 seed, uint32 octave)
+	{
+		return seed + octave * 0x9e3779b9u;
+	}
+
+	// basis(x, y [, z], seed) over the desc's fractal sum.
+	template<typename F, typename BasisFunc>
+	F FractalSum(const Noise::Desc& desc, uint32 seed, BasisFunc basis)
+	{
+		if (desc.Sum == Noise::Fractal::None || desc.Octaves <= 1)
+		{
+			F n = basis(desc.Frequency, seed);
+			return desc.Sum == Noise::Fractal::Ridged ? Mul(Sub(Splat<F>(1.0f), Abs(n)), Sub(Splat<F>(1.0f), Abs(n))) : n;
+		}
+
+		F sum = Splat<F>(0.0f);
+		float frequency = desc.Frequency;
+		float amplitude = 1.0f;
+		float amplitudeSum = 0.0f;
+
+		for (uint32 octave = 0; octave < desc.Octaves; ++octave)
+		{
+			F n = basis(frequency, OctaveSeed(seed, octave));
+			if (desc.Sum == Noise::Fractal::Ridged)
+			{
+				n = Sub(Splat<F>(1.0f), Abs(n));
+				n = Mul(n, n);
+			}
+
+			sum = MulAdd(n, Splat<F>(amplitude), sum);
+			amplitudeSum += amplitude;
+			frequency *= desc.Lacunarity;
+			amplitude *= desc.Gain;
+		}
+
+		return Mul(sum, Splat<F>(1.0f / amplitudeSum));
+	}
+
+	template<typename F>
+	F Evaluate(const Noise::Desc& desc, uint32 seed, F x, F y)
+	{
+		return FractalSum<F>(desc, seed, [&](float frequency, uint32 octaveSeed)
+		{
+			F f = Splat<F>(frequency);
+			return Basis2(desc.Type, Mul(x, f), Mul(y, f), octaveSeed);
+		});
+	}
+
+	template<typename F>
+	F Evaluate(const Noise::Desc& desc, uint32 seed, F x, F y, F z)
+	{
+		return FractalSum<F>(desc, seed, [&](float frequency, uint32 octaveSeed)
+		{
+			F f = Splat<F>(frequency);
+			return Basis3(desc.Type, Mul(x, f), Mul(y, f), Mul(z, f), octaveSeed);
+		});
+	}
+
+	const size_t WideCount = Lane<Wide>::Count;
+
+	template<typename Func>
+	void ForEachRange(size_t count, size_t grain, ThreadPool* pool, Func&& func)
+	{
+		if (pool == nullptr || count <= grain)
+			func(0, count);
+		else
+			pool->ParallelFor(count, grain, func);
+	}
+}
+
+Noise::Noise(uint32 seed)
+	: mSeed(seed)
+{
+}
+
+Noise::Noise(uint32 seed, const Desc& desc)
+	: mSeed(seed), mDesc(desc)
+{
+}
+
+float Noise::Sample(float x, float y) const
+{
+	return Evaluate<float>(mDesc, mSeed, x, y);
+}
+
+float Noise::Sample(float x, float y, float z) const
+{
+	return Evaluate<float>(mDesc, mSeed, x, y, z);
+}
+
+void Noise::Sample(const float* x, const float* y, float* out, size_t count) const
+{
+	size_t i = 0;
+	for (; i + WideCount <= count; i += WideCount)
+		Store(out + i, Evaluate<Wide>(mDesc, mSeed, Load(x + i, Wide()), Load(y + i, Wide())));
+
+	if (i < count)
+	{
+		float tx[WideCount] = {}, ty[WideCount] = {}, to[WideCount];
+		std::memcpy(tx, x + i, (count - i) * sizeof(float));
+		std::memcpy(ty, y + i, (count - i) * sizeof(float));
+		Store(to, Evaluate<Wide>(mDesc, mSeed, Load(tx, Wide()), Load(ty, Wide())));
+		std::memcpy(out + i, to, (count - i) * sizeof(float));
+	}
+}
+
+void Noise::Sample(const float* x, const float* y, const float* z, float* out, size_t count) const
+{
+	size_t i = 0;
+	for (; i + WideCount <= count; i += WideCount)
+		Store(out + i, Evaluate<Wide>(mDesc, mSeed, Load(x + i, Wide()), Load(y + i, Wide()), Load(z + i, Wide())));
+
+	if (i < count)
+	{
+		float tx[WideCount] = {}, ty[WideCount] = {}, tz[WideCount] = {}, to[WideCount];
+		std::memcpy(tx, x + i, (count - i) * sizeof(float));
+		std::memcpy(ty, y + i, (count - i) * sizeof(float));
+		std::memcpy(tz, z + i, (count - i) * sizeof(float));
+		Store(to, Evaluate<Wide>(mDesc, mSeed, Load(tx, Wide()), Load(ty, Wide()), Load(tz, Wide())));
+		std::memcpy(out + i, to, (count - i) * sizeof(float));
+	}
+}
+
+void Noise::Fill2D(float* out, uint32 width, uint32 height, XMFLOAT2 origin, XMFLOAT2 spacing, ThreadPool* pool) const
+{
+	std::vector<float> xs(width);
+	for (uint32 column = 0; column < width; ++column)
+		xs[column] = origin.x + column * spacing.x;
+
+	size_t rowGrain = width > 0 ? (FillGrainSamples + width - 1) / width : 1;
+	ForEachRange(height, rowGrain, pool, [&](size_t begin, size_t end)
+	{
+		std::vector<float> ys(width);
+		for (size_t row = begin; row < end; ++row)
+		{
+			std::fill(ys.begin(), ys.end(), origin.y + row * spacing.y);
+			Sample(xs.data(), ys.data(), out + row * width, width);
+		}
+	});
+}
+
+void Noise::Fill3D(float* out, uint32 width, uint32 height, uint32 depth, XMFLOAT3 origin, XMFLOAT3 spacing,
+	ThreadPool* pool) const
+{
+	std::vector<float> xs(width);
+	for (uint32 column = 0; column < width; ++column)
+		xs[column] = origin.x + column * spacing.x;
+
+	size_t rowGrain = width > 0 ? (FillGrainSamples + width - 1) / width : 1;
+	ForEachRange((size_t)height * depth, rowGrain, pool, [&](size_t begin, size_t end)
+	{
+		std::vector<float> ys(width), zs(width);
+		for (size_t r = begin; r < end; ++r)
+		{
+			size_t row = r % height, slice = r / height;
+			std::fill(ys.begin(), ys.end(), origin.y + row * spacing.y);
+			std::fill(zs.begin(), zs.end(), origin.z + slice * spacing.z);
+			Sample(xs.data(), ys.data(), zs.data(), out + r * width, width);
+		}
+	});
+}
+
+void Noise::DisplaceGrid(GeometryGenerator::MeshData& grid, float heightScale, ThreadPool* pool) const
+{
+	// Central difference step: a tenth of the finest octave's period.
+	float finestFrequency = mDesc.Frequency;
+	if (mDesc.Sum != Fractal::None)
+	{
+		for (uint32 octave = 1; octave < mDesc.Octaves; ++octave)
+			finestFrequency *= mDesc.Lacunarity;
+	}
+	const float h = 0.1f / finestFrequency;
+
+	std::vector<GeometryGenerator::Vertex>& vertices = grid.Vertices;
+	ForEachRange(vertices.size(), FillGrainSamples, pool, [&](size_t begin, size_t end)
+	{
+		float x[DisplaceBlockSize], z[DisplaceBlockSize], shifted[DisplaceBlockSize];
+		float height[DisplaceBlockSize], dx[DisplaceBlockSize], dz[DisplaceBlockSize];
+
+		for (size_t first = begin; first < end; first += DisplaceBlockSize)
+		{
+			size_t n = end - first < DisplaceBlockSize ? end - first : DisplaceBlockSize;
+			GeometryGenerator::Vertex* v = vertices.data() + first;
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				x[i] = v[i].Position.x;
+				z[i] = v[i].Position.z;
+			}
+
+			Sample(x, z, height, n);
+
+			// d/dx
+			for (size_t i = 0; i < n; ++i)
+				shifted[i] = x[i] + h;
+			Sample(shifted, z, dx, n);
+			for (size_t i = 0; i < n; ++i)
+				shifted[i] = x[i] - h;
+			Sample(shifted, z, shifted, n);
+			for (size_t i = 0; i < n; ++i)
+				dx[i] = (dx[i] - shifted[i]) * heightScale / (2.0f * h);
+
+			// d/dz
+			for (size_t i = 0; i < n; ++i)
+				shifted[i] = z[i] + h;
+			Sample(x, shifted, dz, n);
+			for (size_t i = 0; i < n; ++i)
+				shifted[i] = z[i] - h;
+			Sample(x, shifted, shifted, n);
+			for (size_t i = 0; i < n; ++i)
+				dz[i] = (dz[i] - shifted[i]) * heightScale / (2.0f * h);
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				v[i].Position.y = heightScale * height[i];
+				XMStoreFloat3(&v[i].Normal, XMVector3Normalize(XMVectorSet(-dx[i], 1.0f, -dz[i], 0.0f)));
+				XMStoreFloat3(&v[i].TangentU, XMVector3Normalize(XMVectorSet(1.0f, dx[i], 0.0f, 0.0f)));
+			}
+		}
+	});
+}
@@ -0,0 +1,89 @@
+//***************************************************************************************
+// Noise.h
+//
+// Gradient (Perlin), simplex and value noise in 2D / 3D with fBm and ridged fractal
+// sums, for terrain heightfields (CreateGrid) and other procedural content.
+//
+// Lattice points are hashed from (seed, cell) with an integer mix instead of a
+// permutation table, so nothing needs to be shuffled with MathHelper::RandF and the
+// kernels vectorize without gathers: 8 samples per step with AVX2, 4 with SSE2. The
+// single sample functions run the same kernel on one lane (fusing multiply-adds
+// exactly where the AVX2 kernel does), so they return the same bits as the batches.
+//
+// Basis noise is roughly in [-1, 1]; fBm stays in [-1, 1] and ridged in [0, 1].
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include "GeometryGenerator.h"
+
+class ThreadPool;
+
+class Noise
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	enum class Basis
+	{
+		Value,
+		Perlin,
+		Simplex
+	};
+
+	enum class Fractal
+	{
+		None,   // One octave of the basis.
+		FBm,    // Sum of octaves with amplitude Gain^i, divided by the amplitude sum.
+		Ridged  // Same with (1 - |noise|)^2 per octave: sharp crests, for mountains.
+	};
+
+	struct Desc
+	{
+		Basis Type = Basis::Simplex;
+		Fractal Sum = Fractal::FBm;
+		uint32 Octaves = 6;
+		float Frequency = 1.0f;
+		float Lacunarity = 2.0f; // Frequency multiplier per octave.
+		float Gain = 0.5f;       // Amplitude multiplier per octave.
+	};
+
+	explicit Noise(uint32 seed = 0);
+	Noise(uint32 seed, const Desc& desc);
+
+	const Desc& GetDesc() const { return mDesc; }
+	uint32 GetSeed() const { return mSeed; }
+
+	float Sample(float x, float y) const;
+	float Sample(float x, float y, float z) const;
+
+	// out[i] = Sample(x[i], y[i] [, z[i]]).
+	void Sample(const float* x, const float* y, float* out, size_t count) const;
+	void Sample(const float* x, const float* y, const float* z, float* out, size_t count) const;
+
+	///<summary>
+	/// out[row * width + column] = Sample(origin + (column, row) * spacing). Rows are
+	/// split over pool.
+	///</summary>
+	void Fill2D(float* out, uint32 width, uint32 height, DirectX::XMFLOAT2 origin, DirectX::XMFLOAT2 spacing,
+		ThreadPool* pool = nullptr) const;
+
+	// out[(slice * height + row) * width + column] = Sample(origin + (column, row, slice) * spacing).
+	void Fill3D(float* out, uint32 width, uint32 height, uint32 depth, DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 spacing,
+		ThreadPool* pool = nullptr) const;
+
+	///<summary>
+	/// Terrain from a CreateGrid mesh: y = heightScale * Sample(x, z). Normals and
+	/// tangents come from central differences of the height, four extra Sample() calls
+	/// per vertex a tenth of the finest octave's period apart, not from an analytic
+	/// gradient (ridged sums have creases where none exists).
+	///</summary>
+	void DisplaceGrid(GeometryGenerator::MeshData& grid, float heightScale, ThreadPool* pool = nullptr) const;
+
+private:
+	uint32 mSeed;
+	Desc mDesc;
+};
@@ -0,0 +1,353 @@
+//***************************************************************************************
+// OcclusionCuller.cpp
+//***************************************************************************************
+
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	// Boxes tested per ParallelFor chunk in FilterVisible.
+	const size_t FilterGrainSize = 256;
+}
+
+OcclusionCuller::OcclusionCuller(uint32 width, uint32 height)
+{
+	SetResolution(width, height);
+	XMStoreFloat4x4(&mViewProj, XMMatrixIdentity());
+}
+
+void OcclusionCuller::SetResolution(uint32 width, uint32 height)
+{
+	mTilesX = std::max<uint32>((width + TileWidth - 1) / TileWidth, 1);
+	mTilesY = std::max<uint32>((height + TileHeight - 1) / TileHeight, 1);
+	mWidth = mTilesX * TileWidth;
+	mHeight = mTilesY * TileHeight;
+
+	mDepth.assign(mWidth * mHeight, 1.0f);
+	mTileMaxDepth.assign(mTilesX * mTilesY, 1.0f);
+	mTileBins.assign(mTilesX * mTilesY, std::vector<uint32>());
+
+	// Queued triangles are in pixels of the old resolution.
+	mTriangles.clear();
+}
+
+void OcclusionCuller::BeginFrame(FXMMATRIX viewProj)
+{
+	XMStoreFloat4x4(&mViewProj, viewProj);
+
+	std::fill(mDepth.begin(), mDepth.end(), 1.0f);
+	std::fill(mTileMaxDepth.begin(), mTileMaxDepth.end(), 1.0f);
+	mTriangles.clear();
+}
+
+void OcclusionCuller::AddOccluder(const GeometryGenerator::MeshData& meshData, FXMMATRIX world)
+{
+	// Without vertices no index can be resolved, so there is nothing to queue.
+	if (meshData.Vertices.empty() || meshData.Indices32.empty())
+		return;
+
+	AddOccluder(&meshData.Vertices[0].Position, sizeof(GeometryGenerator::Vertex),
+		meshData.Indices32.data(), meshData.Indices32.size(), world);
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3* positions, size_t positionStride,
+	const uint32* indices, size_t indexCount, FXMMATRIX world)
+{
+	XMMATRIX worldViewProj = XMMatrixMultiply(world, XMLoadFloat4x4(&mViewProj));
+
+	float halfWidth = 0.5f * mWidth;
+	float halfHeight = 0.5f * mHeight;
+
+	const char* base = reinterpret_cast<const char*>(positions);
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		ScreenTriangle tri;
+		bool clipped = false;
+
+		for (int k = 0; k < 3; ++k)
+		{
+			const XMFLOAT3* p = reinterpret_cast<const XMFLOAT3*>(base + indices[i + k] * positionStride);
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(p), worldViewProj));
+
+			// No near plane clipping: drop the whole triangle instead.
+			if (clip.z < 0.0f || clip.w <= 0.0f)
+			{
+				clipped = true;
+				break;
+			}
+
+			float invW = 1.0f / clip.w;
+			tri.X[k] = (clip.x * invW + 1.0f) * halfWidth;
+			tri.Y[k] = (1.0f - clip.y * invW) * halfHeight;
+			tri.Z[k] = clip.z * invW;
+		}
+
+		if (clipped)
+			continue;
+
+		// Front faces are clockwise on screen (y down) and have positive area.
+		float area = (tri.X[1] - tri.X[0]) * (tri.Y[2] - tri.Y[0]) - (tri.X[2] - tri.X[0]) * (tri.Y[1] - tri.Y[0]);
+		if (area <= 0.0f)
+			continue;
+
+		tri.MinX = std::max((int)floorf(std::min({ tri.X[0], tri.X[1], tri.X[2] })), 0);
+		tri.MinY = std::max((int)floorf(std::min({ tri.Y[0], tri.Y[1], tri.Y[2] })), 0);
+		tri.MaxX = std::min((int)ceilf(std::max({ tri.X[0], tri.X[1], tri.X[2] })), (int)mWidth - 1);
+		tri.MaxY = std::min((int)ceilf(std::max({ tri.Y[0], tri.Y[1], tri.Y[2] })), (int)mHeight - 1);
+
+		if (tri.MinX > tri.MaxX || tri.MinY > tri.MaxY)
+			continue;
+
+		mTriangles.push_back(tri);
+	}
+}
+
+void OcclusionCuller::RasterizeOccluders(ThreadPool* pool)
+{
+	// Bin triangles into the tiles their screen bounds overlap.
+	for (std::vector<uint32>& bin : mTileBins)
+		bin.clear();
+
+	for (uint32 i = 0; i < (uint32)mTriangles.size(); ++i)
+	{
+		const ScreenTriangle& tri = mTriangles[i];
+		for (uint32 ty = tri.MinY / TileHeight; ty <= (uint32)tri.MaxY / TileHeight; ++ty)
+		{
+			for (uint32 tx = tri.MinX / TileWidth; tx <= (uint32)tri.MaxX / TileWidth; ++tx)
+				mTileBins[ty * mTilesX + tx].push_back(i);
+		}
+	}
+
+	uint32 tileCount = mTilesX * mTilesY;
+	if (pool == nullptr)
+	{
+		for (uint32 tile = 0; tile < tileCount; ++tile)
+			RasterizeTile(tile);
+	}
+	else
+	{
+		pool->ParallelFor(tileCount, 1, [this](size_t begin, size_t end)
+		{
+			for (size_t tile = begin; tile < end; ++tile)
+				RasterizeTile((uint32)tile);
+		});
+	}
+}
+
+void OcclusionCuller::RasterizeTile(uint32 tile)
+{
+	for (uint32 i : mTileBins[tile])
+		RasterizeTriangle(mTriangles[i], tile);
+
+	// Keep the farthest depth of the tile for the hierarchical test.
+	const float* depth = GetTileDepth(tile);
+
+	XMVECTOR maxDepth = XMVectorZero();
+	for (uint32 i = 0; i < TileWidth * TileHeight; i += 4)
+		maxDepth = XMVectorMax(maxDepth, XMLoadFloat4((const XMFLOAT4*)&depth[i]));
+
+	XMFLOAT4 m;
+	XMStoreFloat4(&m, maxDepth);
+	mTileMaxDepth[tile] = std::max(std::max(m.x, m.y), std::max(m.z, m.w));
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& tri, uint32 tile)
+{
+	int tileX0 = (tile % mTilesX) * TileWidth;
+	int tileY0 = (tile / mTilesX) * TileHeight;
+
+	int minX = std::max(tri.MinX, tileX0) & ~3;
+	int maxX = std::min(tri.MaxX, tileX0 + (int)TileWidth - 1);
+	int minY = std::max(tri.MinY, tileY0);
+	int maxY = std::min(tri.MaxY, tileY0 + (int)TileHeight - 1);
+
+	// Edge functions E_ab(p) = (b.x - a.x)(p.y - a.y) - (b.y - a.y)(p.x - a.x),
+	// written as A*x + B*y + C. All three are >= 0 inside a front facing triangle.
+	float A[3], B[3], C[3];
+	for (int e = 0; e < 3; ++e)
+	{
+		int a = e;
+		int b = (e + 1) % 3;
+		A[e] = -(tri.Y[b] - tri.Y[a]);
+		B[e] = tri.X[b] - tri.X[a];
+		C[e] = -A[e] * tri.X[a] - B[e] * tri.Y[a];
+	}
+
+	// Depth is affine in screen space: z = Zx*x + Zy*y + Zc. The weight of a
+	// vertex is the edge function of the opposite edge divided by the area.
+	float invArea = 1.0f / (A[0] * tri.X[2] + B[0] * tri.Y[2] + C[0]);
+	float w0 = tri.Z[0] * invArea; // Opposite edge 1->2.
+	float w1 = tri.Z[1] * invArea; // Opposite edge 2->0.
+	float w2 = tri.Z[2] * invArea; // Opposite edge 0->1.
+	float Zx = A[1] * w0 + A[2] * w1 + A[0] * w2;
+	float Zy = B[1] * w0 + B[2] * w1 + B[0] * w2;
+	float Zc = C[1] * w0 + C[2] * w1 + C[0] * w2;
+
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR laneOffset = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	XMVECTOR vA0 = XMVectorReplicate(A[0]), vA1 = XMVectorReplicate(A[1]), vA2 = XMVectorReplicate(A[2]);
+	XMVECTOR vZx = XMVectorReplicate(Zx);
+
+	float* depth = GetTileDepth(tile);
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		float py = y + 0.5f;
+		XMVECTOR row0 = XMVectorReplicate(B[0] * py + C[0]);
+		XMVECTOR row1 = XMVectorReplicate(B[1] * py + C[1]);
+		XMVECTOR row2 = XMVectorReplicate(B[2] * py + C[2]);
+		XMVECTOR rowZ = XMVectorReplicate(Zy * py + Zc);
+
+		float* depthRow = depth + (y - tileY0) * TileWidth - tileX0;
+
+		// 4 pixels per step.
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			XMVECTOR px = XMVectorAdd(XMVectorReplicate((float)x), laneOffset);
+
+			XMVECTOR inside = XMVectorGreaterOrEqual(XMVectorMultiplyAdd(vA0, px, row0), zero);
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(vA1, px, row1), zero));
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(vA2, px, row2), zero));
+
+			XMVECTOR z = XMVectorMultiplyAdd(vZx, px, rowZ);
+			XMVECTOR d = XMLoadFloat4((const XMFLOAT4*)&depthRow[x]);
+
+			XMStoreFloat4((XMFLOAT4*)&depthRow[x], XMVectorSelect(d, XMVectorMin(d, z), inside));
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const BoundingBox& worldBounds)const
+{
+	XMMATRIX viewProj = XMLoadFloat4x4(&mViewProj);
+
+	XMFLOAT3 corners[8];
+	worldBounds.GetCorners(corners);
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float minZ = FLT_MAX;
+
+	for (const XMFLOAT3& corner : corners)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corner), viewProj));
+
+		// Crossing the near plane: the box may surround the camera.
+		if (clip.z < 0.0f || clip.w <= 0.0f)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW + 1.0f) * 0.5f * mWidth;
+		float y = (1.0f - clip.y * invW) * 0.5f * mHeight;
+
+		minX = std::min(minX, x); maxX = std::max(maxX, x);
+		minY = std::min(minY, y); maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * invW);
+	}
+
+	int x0 = std::max((int)floorf(minX), 0);
+	int y0 = std::max((int)floorf(minY), 0);
+	int x1 = std::min((int)ceilf(maxX), (int)mWidth - 1);
+	int y1 = std::min((int)ceilf(maxY), (int)mHeight - 1);
+
+	// Off screen; leave that decision to frustum culling.
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	XMVECTOR boxDepth = XMVectorReplicate(minZ);
+	XMVECTOR laneOffset = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+	XMVECTOR rectMin = XMVectorReplicate((float)x0);
+	XMVECTOR rectMax = XMVectorReplicate((float)x1);
+
+	for (uint32 ty = y0 / TileHeight; ty <= (uint32)y1 / TileHeight; ++ty)
+	{
+		for (uint32 tx = x0 / TileWidth; tx <= (uint32)x1 / TileWidth; ++tx)
+		{
+			uint32 tile = ty * mTilesX + tx;
+
+			// The whole tile is nearer than the box.
+			if (mTileMaxDepth[tile] < minZ)
+				continue;
+
+			int tileX0 = tx * TileWidth;
+			int tileY0 = ty * TileHeight;
+
+			int sx0 = std::max(x0, tileX0) & ~3;
+			int sx1 = std::min(x1, tileX0 + (int)TileWidth - 1);
+			int sy0 = std::max(y0, tileY0);
+			int sy1 = std::min(y1, tileY0 + (int)TileHeight - 1);
+
+			const float* depth = GetTileDepth(tile);
+			for (int y = sy0; y <= sy1; ++y)
+			{
+				const float* depthRow = depth + (y - tileY0) * TileWidth - tileX0;
+				for (int x = sx0; x <= sx1; x += 4)
+				{
+					XMVECTOR px = XMVectorAdd(XMVectorReplicate((float)x), laneOffset);
+					XMVECTOR inRect = XMVectorAndInt(XMVectorGreaterOrEqual(px, rectMin), XMVectorLessOrEqual(px, rectMax));
+
+					// Any pixel at or behind the box's nearest depth lets it show through.
+					XMVECTOR behind = XMVectorGreaterOrEqual(XMLoadFloat4((const XMFLOAT4*)&depthRow[x]), boxDepth);
+					if (XMVector4NotEqualInt(XMVectorAndInt(behind, inRect), XMVectorFalseInt()))
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+void OcclusionCuller::FilterVisible(const BoundingBox* worldBounds, std::vector<uint32>& indices, ThreadPool* pool)const
+{
+	std::vector<uint8_t> visible(indices.size());
+
+	auto test = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			visible[i] = IsVisible(worldBounds[indices[i]]);
+	};
+
+	if (pool == nullptr)
+		test(0, indices.size());
+	else
+		pool->ParallelFor(indices.size(), FilterGrainSize, test);
+
+	size_t visibleCount = 0;
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		indices[visibleCount] = indices[i];
+		visibleCount += visible[i];
+	}
+
+	indices.resize(visibleCount);
+}
+
+GeometryGenerator::MeshData OcclusionCuller::CreateBoxOccluder(const BoundingBox& bounds)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData box = geoGen.CreateBox(
+		2.0f * bounds.Extents.x, 2.0f * bounds.Extents.y, 2.0f * bounds.Extents.z, 0);
+
+	for (GeometryGenerator::Vertex& v : box.Vertices)
+	{
+		v.Position.x += bounds.Center.x;
+		v.Position.y += bounds.Center.y;
+		v.Position.z += bounds.Center.z;
+	}
+
+	return box;
+}
+
+float OcclusionCuller::GetDepth(uint32 x, uint32 y)const
+{
+	uint32 tile = (y / TileHeight) * mTilesX + x / TileWidth;
+	return GetTileDepth(tile)[(y % TileHeight) * TileWidth + x % TileWidth];
+}
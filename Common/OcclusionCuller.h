@@ -0,0 +1,95 @@
+//***************************************************************************************
+// OcclusionCuller.h
+//
+// CPU software occlusion culling. Low-poly occluders (box hulls made with
+// GeometryGenerator::CreateBox or simplified MeshData) are rasterized into a small
+// tiled depth buffer, and world space bounds (SubmeshGeometry::Bounds) are tested
+// against it. Needs no GPU, so it runs headless.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+#include "GeometryGenerator.h"
+
+class ThreadPool;
+
+class OcclusionCuller
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	// Pixels per tile. Each tile is a contiguous block of the depth buffer, so tiles
+	// can be rasterized by different threads without sharing cache lines.
+	static const uint32 TileWidth = 32;
+	static const uint32 TileHeight = 8;
+
+	// width and height are rounded up to whole tiles.
+	OcclusionCuller(uint32 width = 320, uint32 height = 192);
+
+	// Also drops the queued occluders, like BeginFrame; the view is kept.
+	void SetResolution(uint32 width, uint32 height);
+
+	uint32 GetWidth()const { return mWidth; }
+	uint32 GetHeight()const { return mHeight; }
+
+	// Clears the depth buffer and the occluder list for a new view.
+	void BeginFrame(DirectX::FXMMATRIX viewProj);
+
+	// Queues occluder triangles. Triangles that face away from the camera or cross
+	// the near plane are skipped, which only ever makes culling less aggressive.
+	void AddOccluder(const GeometryGenerator::MeshData& meshData, DirectX::FXMMATRIX world);
+	void AddOccluder(const DirectX::XMFLOAT3* positions, size_t positionStride,
+		const uint32* indices, size_t indexCount, DirectX::FXMMATRIX world);
+
+	// Rasterizes the queued occluders. With a pool, tiles are rasterized in parallel.
+	void RasterizeOccluders(ThreadPool* pool = nullptr);
+
+	// False when the world space box is completely hidden behind rasterized occluders.
+	bool IsVisible(const DirectX::BoundingBox& worldBounds)const;
+
+	///<summary>
+	/// Removes the indices of hidden boxes from indices (e.g. the output of
+	/// FrustumCuller::Cull), keeping the order of the rest.
+	///</summary>
+	void FilterVisible(const DirectX::BoundingBox* worldBounds, std::vector<uint32>& indices, ThreadPool* pool = nullptr)const;
+
+	// Occluder hull matching a box, built with GeometryGenerator::CreateBox.
+	static GeometryGenerator::MeshData CreateBoxOccluder(const DirectX::BoundingBox& bounds);
+
+	// Depth of pixel (x, y); 1.0 where nothing was rasterized.
+	float GetDepth(uint32 x, uint32 y)const;
+
+private:
+	struct ScreenTriangle
+	{
+		float X[3];
+		float Y[3];
+		float Z[3];
+		int MinX, MinY, MaxX, MaxY; // Inclusive pixel bounds, clamped to the screen.
+	};
+
+	void RasterizeTile(uint32 tile);
+	void RasterizeTriangle(const ScreenTriangle& tri, uint32 tile);
+
+	float* GetTileDepth(uint32 tile) { return &mDepth[tile * TileWidth * TileHeight]; }
+	const float* GetTileDepth(uint32 tile)const { return &mDepth[tile * TileWidth * TileHeight]; }
+
+private:
+	uint32 mWidth = 0;
+	uint32 mHeight = 0;
+	uint32 mTilesX = 0;
+	uint32 mTilesY = 0;
+
+	DirectX::XMFLOAT4X4 mViewProj;
+
+	std::vector<float> mDepth;        // Tile after tile, rows inside a tile.
+	std::vector<float> mTileMaxDepth; // Farthest depth stored in each tile.
+
+	std::vector<ScreenTriangle> mTriangles;
+	std::vector<std::vector<uint32>> mTileBins; // Triangles overlapping each tile.
+};
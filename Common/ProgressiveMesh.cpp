@@ -0,0 +1,477 @@
+//***************************************************************************************
+// ProgressiveMesh.cpp
+//***************************************************************************************
+
+#include "ProgressiveMesh.h"
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	struct EdgeCandidate
+	{
+		float Length;
+		uint32 From;
+		uint32 To;
+
+		bool operator>(const EdgeCandidate& rhs)const { return Length > rhs.Length; }
+	};
+
+	struct Collapse
+	{
+		uint32 From;
+		uint32 To;
+
+		// Removed triangles with their corners as they were at collapse time.
+		std::vector<uint32> RemovedTriangles;
+		std::vector<uint32> RemovedCorners;
+
+		// Corner locations (triangle * 3 + corner) moved from From to To.
+		std::vector<uint32> MovedCorners;
+	};
+
+	// Index merges closer than this (64 bytes) are uploaded as one range.
+	const uint32 MergeGap = 16;
+
+	void RemoveValue(std::vector<uint32>& v, uint32 value)
+	{
+		auto it = std::find(v.begin(), v.end(), value);
+		if (it != v.end())
+		{
+			*it = v.back();
+			v.pop_back();
+		}
+	}
+
+	float EdgeLength(const std::vector<GeometryGenerator::Vertex>& vertices, uint32 a, uint32 b)
+	{
+		XMVECTOR pa = XMLoadFloat3(&vertices[a].Position);
+		XMVECTOR pb = XMLoadFloat3(&vertices[b].Position);
+		return XMVectorGetX(XMVector3Length(pb - pa));
+	}
+
+	XMVECTOR TriangleNormal(const std::vector<GeometryGenerator::Vertex>& vertices, uint32 i0, uint32 i1, uint32 i2)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[i0].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[i1].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[i2].Position);
+		return XMVector3Cross(p1 - p0, p2 - p0);
+	}
+}
+
+void ProgressiveMesh::Build(const GeometryGenerator::MeshData& meshData, uint32 baseTriangleCount)
+{
+	const std::vector<GeometryGenerator::Vertex>& vertices = meshData.Vertices;
+	const uint32 vertexCount = (uint32)vertices.size();
+	const uint32 triangleCount = (uint32)meshData.Indices32.size() / 3;
+
+	std::vector<uint32> corners(meshData.Indices32.begin(), meshData.Indices32.begin() + triangleCount * 3);
+
+	std::vector<std::vector<uint32>> vertexTriangles(vertexCount);
+	for (uint32 t = 0; t < triangleCount; ++t)
+	{
+		for (uint32 k = 0; k < 3; ++k)
+			vertexTriangles[corners[t * 3 + k]].push_back(t);
+	}
+
+	std::vector<bool> locked(vertexCount, false);
+
+	// Vertices sharing a position sit on a UV / normal seam.
+	{
+		std::vector<uint32> order(vertexCount);
+		for (uint32 i = 0; i < vertexCount; ++i)
+			order[i] = i;
+
+		// Compared as floats, so -0 and 0 are the same position (mirrored geometry).
+		auto positionLess = [&vertices](uint32 a, uint32 b)
+		{
+			const XMFLOAT3& pa = vertices[a].Position;
+			const XMFLOAT3& pb = vertices[b].Position;
+			if (pa.x != pb.x)
+				return pa.x < pb.x;
+			if (pa.y != pb.y)
+				return pa.y < pb.y;
+			return pa.z < pb.z;
+		};
+		std::sort(order.begin(), order.end(), positionLess);
+
+		for (uint32 i = 1; i < vertexCount; ++i)
+		{
+			if (!positionLess(order[i - 1], order[i]))
+				locked[order[i - 1]] = locked[order[i]] = true;
+		}
+	}
+
+	// Boundary and non-manifold edges, and triangles that are already degenerate.
+	{
+		std::unordered_map<std::uint64_t, uint32> edgeUse;
+		for (uint32 t = 0; t < triangleCount; ++t)
+		{
+			for (uint32 k = 0; k < 3; ++k)
+			{
+				uint32 a = corners[t * 3 + k];
+				uint32 b = corners[t * 3 + (k + 1) % 3];
+				if (a == b)
+				{
+					locked[a] = true;
+					continue;
+				}
+
+				std::uint64_t key = ((std::uint64_t)std::min(a, b) << 32) | std::max(a, b);
+				++edgeUse[key];
+			}
+		}
+
+		for (auto& e : edgeUse)
+		{
+			if (e.second != 2)
+				locked[(uint32)(e.first >> 32)] = locked[(uint32)e.first] = true;
+		}
+	}
+
+	std::priority_queue<EdgeCandidate, std::vector<EdgeCandidate>, std::greater<EdgeCandidate>> candidates;
+	auto pushEdge = [&](uint32 a, uint32 b)
+	{
+		float length = EdgeLength(vertices, a, b);
+		if (!locked[a])
+			candidates.push({ length, a, b });
+		if (!locked[b])
+			candidates.push({ length, b, a });
+	};
+
+	for (uint32 t = 0; t < triangleCount; ++t)
+	{
+		for (uint32 k = 0; k < 3; ++k)
+			pushEdge(corners[t * 3 + k], corners[t * 3 + (k + 1) % 3]);
+	}
+
+	std::vector<bool> vertexAlive(vertexCount, true);
+	std::vector<bool> triangleAlive(triangleCount, true);
+	uint32 aliveTriangles = triangleCount;
+
+	auto contains = [&corners](uint32 t, uint32 v)
+	{
+		return corners[t * 3 + 0] == v || corners[t * 3 + 1] == v || corners[t * 3 + 2] == v;
+	};
+
+	auto gatherNeighbours = [&](uint32 v, std::vector<uint32>& out)
+	{
+		out.clear();
+		for (uint32 t : vertexTriangles[v])
+		{
+			for (uint32 k = 0; k < 3; ++k)
+			{
+				if (corners[t * 3 + k] != v)
+					out.push_back(corners[t * 3 + k]);
+			}
+		}
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	};
+
+	std::vector<uint32> neighboursFrom, neighboursTo, common, opposite;
+
+	// Moving from onto to must keep the surface manifold and not fold any triangle over.
+	auto canCollapse = [&](uint32 from, uint32 to)
+	{
+		opposite.clear();
+		for (uint32 t : vertexTriangles[from])
+		{
+			if (!contains(t, to))
+				continue;
+
+			for (uint32 k = 0; k < 3; ++k)
+			{
+				uint32 c = corners[t * 3 + k];
+				if (c != from && c != to)
+					opposite.push_back(c);
+			}
+		}
+
+		// The edge no longer exists.
+		if (opposite.empty())
+			return false;
+
+		// Link condition: the only shared neighbours are the ones across the edge.
+		gatherNeighbours(from, neighboursFrom);
+		gatherNeighbours(to, neighboursTo);
+
+		common.clear();
+		std::set_intersection(neighboursFrom.begin(), neighboursFrom.end(),
+			neighboursTo.begin(), neighboursTo.end(), std::back_inserter(common));
+
+		std::sort(opposite.begin(), opposite.end());
+		opposite.erase(std::unique(opposite.begin(), opposite.end()), opposite.end());
+
+		if (common.size() != opposite.size())
+			return false;
+
+		for (uint32 t : vertexTriangles[from])
+		{
+			if (contains(t, to))
+				continue;
+
+			uint32 c[3] = { corners[t * 3 + 0], corners[t * 3 + 1], corners[t * 3 + 2] };
+			XMVECTOR before = TriangleNormal(vertices, c[0], c[1], c[2]);
+			for (uint32 k = 0; k < 3; ++k)
+			{
+				if (c[k] == from)
+					c[k] = to;
+			}
+			XMVECTOR after = TriangleNormal(vertices, c[0], c[1], c[2]);
+
+			if (XMVectorGetX(XMVector3Dot(before, after)) <= 0.0f)
+				return false;
+		}
+
+		return true;
+	};
+
+	std::vector<Collapse> collapses;
+
+	while (aliveTriangles > baseTriangleCount && !candidates.empty())
+	{
+		EdgeCandidate e = candidates.top();
+		candidates.pop();
+
+		uint32 from = e.From;
+		uint32 to = e.To;
+		if (!vertexAlive[from] || !vertexAlive[to] || !canCollapse(from, to))
+			continue;
+
+		Collapse collapse;
+		collapse.From = from;
+		collapse.To = to;
+
+		std::vector<uint32> fromTriangles;
+		fromTriangles.swap(vertexTriangles[from]);
+
+		for (uint32 t : fromTriangles)
+		{
+			if (contains(t, to))
+			{
+				collapse.RemovedTriangles.push_back(t);
+				for (uint32 k = 0; k < 3; ++k)
+				{
+					uint32 c = corners[t * 3 + k];
+					collapse.RemovedCorners.push_back(c);
+					if (c != from)
+						RemoveValue(vertexTriangles[c], t);
+				}
+
+				triangleAlive[t] = false;
+				--aliveTriangles;
+			}
+			else
+			{
+				for (uint32 k = 0; k < 3; ++k)
+				{
+					if (corners[t * 3 + k] == from)
+					{
+						corners[t * 3 + k] = to;
+						collapse.MovedCorners.push_back(t * 3 + k);
+					}
+				}
+				vertexTriangles[to].push_back(t);
+
+				// The moved triangles connect to with new neighbours.
+				for (uint32 k = 0; k < 3; ++k)
+				{
+					uint32 c = corners[t * 3 + k];
+					if (c != to)
+						pushEdge(to, c);
+				}
+			}
+		}
+
+		vertexAlive[from] = false;
+		collapses.push_back(std::move(collapse));
+	}
+
+	// Stream order: surviving vertices first, then one per split (last collapse first).
+	std::vector<uint32> streamVertex(vertexCount);
+	uint32 nextVertex = 0;
+	for (uint32 i = 0; i < vertexCount; ++i)
+	{
+		if (vertexAlive[i])
+			streamVertex[i] = nextVertex++;
+	}
+	mBaseVertexCount = nextVertex;
+
+	for (auto it = collapses.rbegin(); it != collapses.rend(); ++it)
+		streamVertex[it->From] = nextVertex++;
+
+	mVertices.resize(vertexCount);
+	for (uint32 i = 0; i < vertexCount; ++i)
+		mVertices[streamVertex[i]] = vertices[i];
+
+	std::vector<uint32> streamTriangle(triangleCount);
+	uint32 nextTriangle = 0;
+
+	mIndices.clear();
+	mIndices.reserve(triangleCount * 3);
+	for (uint32 t = 0; t < triangleCount; ++t)
+	{
+		if (!triangleAlive[t])
+			continue;
+
+		streamTriangle[t] = nextTriangle++;
+		for (uint32 k = 0; k < 3; ++k)
+			mIndices.push_back(streamVertex[corners[t * 3 + k]]);
+	}
+	mBaseIndexCount = (uint32)mIndices.size();
+
+	mSplits.clear();
+	mPatches.clear();
+	mSplits.reserve(collapses.size());
+
+	for (auto it = collapses.rbegin(); it != collapses.rend(); ++it)
+	{
+		VertexSplit split;
+		split.Vertex = streamVertex[it->From];
+		split.ParentVertex = streamVertex[it->To];
+		split.FirstTriangle = nextTriangle;
+		split.TriangleCount = (uint32)it->RemovedTriangles.size();
+		split.FirstPatch = (uint32)mPatches.size();
+		split.PatchCount = (uint32)it->MovedCorners.size();
+
+		for (size_t i = 0; i < it->RemovedTriangles.size(); ++i)
+		{
+			streamTriangle[it->RemovedTriangles[i]] = nextTriangle++;
+			for (uint32 k = 0; k < 3; ++k)
+				mIndices.push_back(streamVertex[it->RemovedCorners[i * 3 + k]]);
+		}
+
+		// Every moved corner belongs to a triangle that is resident by now.
+		for (uint32 corner : it->MovedCorners)
+			mPatches.push_back(streamTriangle[corner / 3] * 3 + corner % 3);
+
+		mSplits.push_back(split);
+	}
+}
+
+size_t ProgressiveMesh::GetSplitByteSize(const VertexSplit& split)
+{
+	return sizeof(GeometryGenerator::Vertex) +
+		(split.TriangleCount * 3 + split.PatchCount) * sizeof(uint32);
+}
+
+void ProgressiveMesh::ExtractMeshData(uint32 splitCount, GeometryGenerator::MeshData& meshData)const
+{
+	splitCount = std::min(splitCount, GetSplitCount());
+
+	uint32 vertexCount = mBaseVertexCount + splitCount;
+	uint32 indexCount = splitCount > 0 ?
+		(mSplits[splitCount - 1].FirstTriangle + mSplits[splitCount - 1].TriangleCount) * 3 : mBaseIndexCount;
+
+	meshData.Vertices.assign(mVertices.begin(), mVertices.begin() + vertexCount);
+	meshData.Indices32.assign(mIndices.begin(), mIndices.begin() + indexCount);
+
+	for (uint32 i = 0; i < splitCount; ++i)
+	{
+		const VertexSplit& split = mSplits[i];
+		for (uint32 p = 0; p < split.PatchCount; ++p)
+			meshData.Indices32[mPatches[split.FirstPatch + p]] = split.Vertex;
+	}
+}
+
+ProgressiveMeshStreamer::ProgressiveMeshStreamer(const ProgressiveMesh& mesh) :
+	mMesh(mesh)
+{
+	Reset();
+}
+
+void ProgressiveMeshStreamer::Reset()
+{
+	mIndices = mMesh.GetIndices();
+
+	mSplitCount = 0;
+	mVertexCount = mMesh.GetBaseVertexCount();
+	mIndexCount = mMesh.GetBaseIndexCount();
+
+	mDirtyVertexBegin = 0;
+	mDirtyVertexEnd = mVertexCount;
+	mDirtyIndexBegin = 0;
+	mDirtyIndexEnd = mIndexCount;
+	mDirtyPatches.clear();
+}
+
+ProgressiveMeshStreamer::uint32 ProgressiveMeshStreamer::Advance(size_t byteBudget)
+{
+	const std::vector<ProgressiveMesh::VertexSplit>& splits = mMesh.GetSplits();
+	const std::vector<uint32>& patches = mMesh.GetPatches();
+
+	if (mDirtyVertexBegin == mDirtyVertexEnd)
+		mDirtyVertexBegin = mDirtyVertexEnd = mVertexCount;
+	if (mDirtyIndexBegin == mDirtyIndexEnd)
+		mDirtyIndexBegin = mDirtyIndexEnd = mIndexCount;
+
+	uint32 applied = 0;
+	size_t used = 0;
+
+	while (mSplitCount < splits.size())
+	{
+		const ProgressiveMesh::VertexSplit& split = splits[mSplitCount];
+
+		size_t byteSize = ProgressiveMesh::GetSplitByteSize(split);
+		if (applied > 0 && used + byteSize > byteBudget)
+			break;
+
+		for (uint32 p = 0; p < split.PatchCount; ++p)
+		{
+			uint32 location = patches[split.FirstPatch + p];
+			mIndices[location] = split.Vertex;
+			mDirtyPatches.push_back(location);
+		}
+
+		mVertexCount = split.Vertex + 1;
+		mIndexCount = (split.FirstTriangle + split.TriangleCount) * 3;
+
+		++mSplitCount;
+		++applied;
+		used += byteSize;
+	}
+
+	mDirtyVertexEnd = mVertexCount;
+	mDirtyIndexEnd = mIndexCount;
+
+	return applied;
+}
+
+void ProgressiveMeshStreamer::TakeDirtyRanges(Range& vertices, std::vector<Range>& indices)
+{
+	vertices.First = mDirtyVertexBegin;
+	vertices.Count = mDirtyVertexEnd - mDirtyVertexBegin;
+
+	// Appended indices are one range; patches only touch indices resident before them.
+	std::sort(mDirtyPatches.begin(), mDirtyPatches.end());
+
+	indices.clear();
+	for (uint32 location : mDirtyPatches)
+	{
+		if (location >= mDirtyIndexBegin && location < mDirtyIndexEnd)
+			continue;
+
+		if (!indices.empty() && location < indices.back().First + indices.back().Count + MergeGap)
+			indices.back().Count = std::max(indices.back().Count, location + 1 - indices.back().First);
+		else
+			indices.push_back({ location, 1 });
+	}
+
+	if (mDirtyIndexEnd > mDirtyIndexBegin)
+	{
+		if (!indices.empty() && mDirtyIndexBegin < indices.back().First + indices.back().Count + MergeGap)
+			indices.back().Count = mDirtyIndexEnd - indices.back().First;
+		else
+			indices.push_back({ mDirtyIndexBegin, mDirtyIndexEnd - mDirtyIndexBegin });
+	}
+
+	mDirtyPatches.clear();
+	mDirtyVertexBegin = mDirtyVertexEnd = mVertexCount;
+	mDirtyIndexBegin = mDirtyIndexEnd = mIndexCount;
+}
@@ -0,0 +1,137 @@
+//***************************************************************************************
+// ProgressiveMesh.h
+//
+// Progressive representation of a MeshData: a coarse base mesh plus an ordered list of
+// vertex splits that refine it back to the original triangles.
+//
+// The base is made by half-edge collapses (a vertex moves onto a neighbour, so no new
+// vertex data is invented), shortest edges first. Seam, boundary and non-manifold
+// vertices never move, so UV seams do not crack. Vertices and triangles are stored in
+// stream order: split i adds vertex GetBaseVertexCount() + i and appends its triangles
+// to the index buffer, so the resident part of both buffers is always a prefix and can
+// be drawn as is. Besides appending, a split re-points a few already resident index
+// entries (the corners that had been moved onto the parent vertex) at the new vertex.
+//
+// ProgressiveMeshStreamer applies splits within a byte budget per frame and reports the
+// vertex / index ranges that need to be copied to the GPU.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "GeometryGenerator.h"
+
+class ProgressiveMesh
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	struct VertexSplit
+	{
+		uint32 Vertex = 0;       // Vertex added by this split.
+		uint32 ParentVertex = 0; // Vertex it had been collapsed onto.
+
+		// Triangles appended to the index buffer, starting at triangle FirstTriangle.
+		uint32 FirstTriangle = 0;
+		uint32 TriangleCount = 0;
+
+		// Index buffer locations that change to Vertex (range in GetPatches()).
+		uint32 FirstPatch = 0;
+		uint32 PatchCount = 0;
+	};
+
+	///<summary>
+	/// Simplifies meshData until it has at most baseTriangleCount triangles (or no more
+	/// edges can collapse without folding triangles or changing the topology).
+	///</summary>
+	void Build(const GeometryGenerator::MeshData& meshData, uint32 baseTriangleCount);
+
+	uint32 GetBaseVertexCount()const { return mBaseVertexCount; }
+	uint32 GetBaseIndexCount()const { return mBaseIndexCount; }
+	uint32 GetVertexCount()const { return (uint32)mVertices.size(); }
+	uint32 GetIndexCount()const { return (uint32)mIndices.size(); }
+	uint32 GetSplitCount()const { return (uint32)mSplits.size(); }
+
+	// All vertices in stream order.
+	const std::vector<GeometryGenerator::Vertex>& GetVertices()const { return mVertices; }
+
+	// Index buffer contents as each triangle is first appended, before any patches.
+	const std::vector<uint32>& GetIndices()const { return mIndices; }
+
+	const std::vector<VertexSplit>& GetSplits()const { return mSplits; }
+	const std::vector<uint32>& GetPatches()const { return mPatches; }
+
+	// Bytes a split adds to the GPU buffers (vertex, appended and patched indices).
+	static size_t GetSplitByteSize(const VertexSplit& split);
+
+	// Builds the mesh as it looks after the first splitCount splits.
+	void ExtractMeshData(uint32 splitCount, GeometryGenerator::MeshData& meshData)const;
+
+private:
+	std::vector<GeometryGenerator::Vertex> mVertices;
+	std::vector<uint32> mIndices;
+	std::vector<VertexSplit> mSplits;
+	std::vector<uint32> mPatches;
+
+	uint32 mBaseVertexCount = 0;
+	uint32 mBaseIndexCount = 0;
+};
+
+class ProgressiveMeshStreamer
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	struct Range
+	{
+		uint32 First = 0;
+		uint32 Count = 0;
+	};
+
+	// The mesh must outlive the streamer.
+	explicit ProgressiveMeshStreamer(const ProgressiveMesh& mesh);
+
+	// Back to the base mesh. The whole base is reported dirty.
+	void Reset();
+
+	///<summary>
+	/// Applies whole splits until byteBudget is used up. At least one split is applied
+	/// if any remain, so a small budget still makes progress. Returns the number applied.
+	///</summary>
+	uint32 Advance(size_t byteBudget);
+
+	///<summary>
+	/// Returns the vertices (in GetVertices()) and indices (in GetIndices()) changed since
+	/// the last call, in elements. Nearby index changes are merged into one range.
+	///</summary>
+	void TakeDirtyRanges(Range& vertices, std::vector<Range>& indices);
+
+	bool IsComplete()const { return mSplitCount == mMesh.GetSplitCount(); }
+
+	uint32 GetSplitCount()const { return mSplitCount; }
+	uint32 GetResidentVertexCount()const { return mVertexCount; }
+	uint32 GetResidentIndexCount()const { return mIndexCount; }
+
+	// Size GPU buffers with the mesh's full GetVertexCount() / GetIndexCount().
+	const GeometryGenerator::Vertex* GetVertices()const { return mMesh.GetVertices().data(); }
+	const uint32* GetIndices()const { return mIndices.data(); }
+
+private:
+	const ProgressiveMesh& mMesh;
+
+	// CPU copy of the index buffer with the applied patches.
+	std::vector<uint32> mIndices;
+
+	uint32 mSplitCount = 0;
+	uint32 mVertexCount = 0;
+	uint32 mIndexCount = 0;
+
+	uint32 mDirtyVertexBegin = 0;
+	uint32 mDirtyVertexEnd = 0;
+	uint32 mDirtyIndexBegin = 0;
+	uint32 mDirtyIndexEnd = 0;
+	std::vector<uint32> mDirtyPatches;
+};
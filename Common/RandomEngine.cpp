@@ -0,0 +1,296 @@
+//***************************************************************************************
+// RandomEngine.cpp
+//***************************************************************************************
+
+#include "RandomEngine.h"
+#include <atomic>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RANDOM_ENGINE_AVX2
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RANDOM_ENGINE_SSE2
+#endif
+
+namespace
+{
+	using uint32 = RandomEngine::uint32;
+	using uint64 = RandomEngine::uint64;
+
+	// Elements generated and converted together by the Fill functions.
+	const size_t FillChunkSize = 1024;
+
+	// 2^-24: the top 24 bits of a draw make a float in [0, 1).
+	const float FloatScale = 1.0f / 16777216.0f;
+
+	uint64 SplitMix64(uint64& x)
+	{
+		uint64 z = (x += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	uint32 Rotl(uint32 x, int k)
+	{
+		return (x << k) | (x >> (32 - k));
+	}
+
+	// Generates blockCount * 8 values; value j of block b goes to out[b * 8 + j]. The lane
+	// state is loaded unaligned: engines may live in containers or on the heap, where
+	// C++14 does not honor extended alignment.
+	void GenerateLanes(uint32 lanes[4][8], uint32* out, size_t blockCount)
+	{
+#if defined(RANDOM_ENGINE_AVX2)
+		__m256i s0 = _mm256_loadu_si256((const __m256i*)lanes[0]);
+		__m256i s1 = _mm256_loadu_si256((const __m256i*)lanes[1]);
+		__m256i s2 = _mm256_loadu_si256((const __m256i*)lanes[2]);
+		__m256i s3 = _mm256_loadu_si256((const __m256i*)lanes[3]);
+
+		for (size_t b = 0; b < blockCount; ++b)
+		{
+			// rotl(s1 * 5, 7) * 9 with shifts and adds.
+			__m256i x = _mm256_add_epi32(_mm256_slli_epi32(s1, 2), s1);
+			x = _mm256_or_si256(_mm256_slli_epi32(x, 7), _mm256_srli_epi32(x, 25));
+			x = _mm256_add_epi32(_mm256_slli_epi32(x, 3), x);
+			_mm256_storeu_si256((__m256i*)(out + b * 8), x);
+
+			__m256i t = _mm256_slli_epi32(s1, 9);
+			s2 = _mm256_xor_si256(s2, s0);
+			s3 = _mm256_xor_si256(s3, s1);
+			s1 = _mm256_xor_si256(s1, s2);
+			s0 = _mm256_xor_si256(s0, s3);
+			s2 = _mm256_xor_si256(s2, t);
+			s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+		}
+
+		_mm256_storeu_si256((__m256i*)lanes[0], s0);
+		_mm256_storeu_si256((__m256i*)lanes[1], s1);
+		_mm256_storeu_si256((__m256i*)lanes[2], s2);
+		_mm256_storeu_si256((__m256i*)lanes[3], s3);
+#elif defined(RANDOM_ENGINE_SSE2)
+		// Lanes 0-3 and 4-7 as two independent groups.
+		for (int g = 0; g < 2; ++g)
+		{
+			__m128i s0 = _mm_loadu_si128((const __m128i*)(lanes[0] + g * 4));
+			__m128i s1 = _mm_loadu_si128((const __m128i*)(lanes[1] + g * 4));
+			__m128i s2 = _mm_loadu_si128((const __m128i*)(lanes[2] + g * 4));
+			__m128i s3 = _mm_loadu_si128((const __m128i*)(lanes[3] + g * 4));
+
+			for (size_t b = 0; b < blockCount; ++b)
+			{
+				__m128i x = _mm_add_epi32(_mm_slli_epi32(s1, 2), s1);
+				x = _mm_or_si128(_mm_slli_epi32(x, 7), _mm_srli_epi32(x, 25));
+				x = _mm_add_epi32(_mm_slli_epi32(x, 3), x);
+				_mm_storeu_si128((__m128i*)(out + b * 8 + g * 4), x);
+
+				__m128i t = _mm_slli_epi32(s1, 9);
+				s2 = _mm_xor_si128(s2, s0);
+				s3 = _mm_xor_si128(s3, s1);
+				s1 = _mm_xor_si128(s1, s2);
+				s0 = _mm_xor_si128(s0, s3);
+				s2 = _mm_xor_si128(s2, t);
+				s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+			}
+
+			_mm_storeu_si128((__m128i*)(lanes[0] + g * 4), s0);
+			_mm_storeu_si128((__m128i*)(lanes[1] + g * 4), s1);
+			_mm_storeu_si128((__m128i*)(lanes[2] + g * 4), s2);
+			_mm_storeu_si128((__m128i*)(lanes[3] + g * 4), s3);
+		}
+#else
+		for (size_t b = 0; b < blockCount; ++b)
+		{
+			for (int i = 0; i < 8; ++i)
+			{
+				uint32* s[4] = { &lanes[0][i], &lanes[1][i], &lanes[2][i], &lanes[3][i] };
+				out[b * 8 + i] = Rotl(*s[1] * 5, 7) * 9;
+
+				uint32 t = *s[1] << 9;
+				*s[2] ^= *s[0];
+				*s[3] ^= *s[1];
+				*s[1] ^= *s[2];
+				*s[0] ^= *s[3];
+				*s[2] ^= t;
+				*s[3] = Rotl(*s[3], 11);
+			}
+		}
+#endif
+	}
+
+	// In place: bits -> float in [a, b).
+	void BitsToFloats(uint32* data, size_t count, float a, float b)
+	{
+		float scale = (b - a) * FloatScale;
+		size_t i = 0;
+
+#if defined(RANDOM_ENGINE_AVX2) || defined(RANDOM_ENGINE_SSE2)
+		__m128 vScale = _mm_set1_ps(scale);
+		__m128 vOffset = _mm_set1_ps(a);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i bits = _mm_loadu_si128((const __m128i*)(data + i));
+			__m128 f = _mm_cvtepi32_ps(_mm_srli_epi32(bits, 8));
+			f = _mm_add_ps(_mm_mul_ps(f, vScale), vOffset);
+			_mm_storeu_ps((float*)(data + i), f);
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			float f = (float)(data[i] >> 8) * scale + a;
+			std::memcpy(&data[i], &f, sizeof(float));
+		}
+	}
+
+	std::atomic<uint64> gThreadCounter(0);
+}
+
+RandomEngine::RandomEngine(uint64 seed)
+{
+	Seed(seed);
+}
+
+RandomEngine::RandomEngine(uint64 seed, uint64 stream)
+{
+	uint64 x = stream;
+	Seed(seed ^ SplitMix64(x));
+}
+
+void RandomEngine::Seed(uint64 seed)
+{
+	uint64 x = seed;
+
+	uint64 a = SplitMix64(x);
+	uint64 b = SplitMix64(x);
+	mState[0] = (uint32)a;
+	mState[1] = (uint32)(a >> 32);
+	mState[2] = (uint32)b;
+	mState[3] = (uint32)(b >> 32);
+
+	for (int i = 0; i < LaneCount; ++i)
+	{
+		a = SplitMix64(x);
+		b = SplitMix64(x);
+		mLanes[0][i] = (uint32)a;
+		mLanes[1][i] = (uint32)(a >> 32);
+		mLanes[2][i] = (uint32)b;
+		mLanes[3][i] = (uint32)(b >> 32);
+	}
+}
+
+RandomEngine RandomEngine::Split()
+{
+	return RandomEngine(NextUInt64());
+}
+
+RandomEngine::uint32 RandomEngine::NextUInt()
+{
+	uint32 result = Rotl(mState[1] * 5, 7) * 9;
+	uint32 t = mState[1] << 9;
+
+	mState[2] ^= mState[0];
+	mState[3] ^= mState[1];
+	mState[1] ^= mState[2];
+	mState[0] ^= mState[3];
+	mState[2] ^= t;
+	mState[3] = Rotl(mState[3], 11);
+
+	return result;
+}
+
+RandomEngine::uint64 RandomEngine::NextUInt64()
+{
+	uint64 hi = NextUInt();
+	return (hi << 32) | NextUInt();
+}
+
+float RandomEngine::NextFloat()
+{
+	return (float)(NextUInt() >> 8) * FloatScale;
+}
+
+int RandomEngine::NextInt(int a, int b)
+{
+	uint32 range = (uint32)b - (uint32)a + 1;
+
+	// [INT_MIN, INT_MAX] wraps to 0: every value is valid.
+	if (range == 0)
+		return (int)NextUInt();
+
+	return (int)((uint32)a + NextBounded(range));
+}
+
+RandomEngine::uint32 RandomEngine::NextBounded(uint32 range)
+{
+	// Lemire's multiply-shift with rejection of the short interval.
+	uint64 m = (uint64)NextUInt() * range;
+	uint32 low = (uint32)m;
+
+	if (low < range)
+	{
+		uint32 threshold = (0u - range) % range;
+		while (low < threshold)
+		{
+			m = (uint64)NextUInt() * range;
+			low = (uint32)m;
+		}
+	}
+
+	return (uint32)(m >> 32);
+}
+
+void RandomEngine::FillUInts(uint32* out, size_t count)
+{
+	size_t blockCount = count / LaneCount;
+	GenerateLanes(mLanes, out, blockCount);
+
+	size_t done = blockCount * LaneCount;
+	if (done < count)
+	{
+		uint32 tail[LaneCount];
+		GenerateLanes(mLanes, tail, 1);
+		std::memcpy(out + done, tail, (count - done) * sizeof(uint32));
+	}
+}
+
+void RandomEngine::FillFloats(float* out, size_t count, float a, float b)
+{
+	// Chunked so the bits are still in cache when they are converted.
+	uint32* bits = reinterpret_cast<uint32*>(out);
+	for (size_t first = 0; first < count; first += FillChunkSize)
+	{
+		size_t n = count - first < FillChunkSize ? count - first : FillChunkSize;
+		FillUInts(bits + first, n);
+		BitsToFloats(bits + first, n, a, b);
+	}
+}
+
+void RandomEngine::FillInts(int* out, size_t count, int a, int b)
+{
+	uint32* bits = reinterpret_cast<uint32*>(out);
+	FillUInts(bits, count);
+
+	uint32 range = (uint32)b - (uint32)a + 1;
+	if (range == 0)
+		return;
+
+	uint32 threshold = (0u - range) % range;
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64 m = (uint64)bits[i] * range;
+
+		// Rejected draws (probability range / 2^32) are redrawn from the scalar stream.
+		while ((uint32)m < threshold)
+			m = (uint64)NextUInt() * range;
+
+		out[i] = (int)((uint32)a + (uint32)(m >> 32));
+	}
+}
+
+RandomEngine& RandomEngine::ThreadLocal()
+{
+	thread_local RandomEngine engine(DefaultSeed, gThreadCounter.fetch_add(1));
+	return engine;
+}
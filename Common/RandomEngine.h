@@ -0,0 +1,75 @@
+//***************************************************************************************
+// RandomEngine.h
+//
+// xoshiro128** pseudo random generator. One engine per thread (ThreadLocal()) backs the
+// MathHelper random functions, so they need no locking.
+//
+// Besides the scalar stream every engine carries 8 independent lanes for the bulk Fill
+// functions, which are generated 8 at a time with SSE2 / AVX2. The output of an engine
+// only depends on its seed, never on the instruction set or thread, so procedural
+// content generated with RandomEngine(seed, taskIndex) is reproducible. When the result
+// must not depend on how the work is split into tasks, use CounterRandom instead.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class RandomEngine
+{
+public:
+
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	static const uint64 DefaultSeed = 0x853c49e6748fea9bull;
+
+	explicit RandomEngine(uint64 seed = DefaultSeed);
+
+	// Engine for one stream (e.g. a task or tile index) of a seed.
+	RandomEngine(uint64 seed, uint64 stream);
+
+	void Seed(uint64 seed);
+
+	// Returns a new engine seeded from this one's output; both can be used independently.
+	RandomEngine Split();
+
+	uint32 NextUInt();
+	uint64 NextUInt64();
+
+	// Returns a float in [0, 1) with 24 random bits.
+	float NextFloat();
+
+	// Returns a float in [a, b).
+	float NextFloat(float a, float b) { return a + NextFloat() * (b - a); }
+
+	// Returns an int in [a, b] without modulo bias.
+	int NextInt(int a, int b);
+
+	// Returns a uint in [0, range) without modulo bias.
+	uint32 NextBounded(uint32 range);
+
+	///<summary>
+	/// Bulk versions of NextUInt / NextFloat / NextInt that draw from the 8 SIMD lanes.
+	/// They do not advance the scalar stream (except for the rare rejected NextInt draw).
+	///</summary>
+	void FillUInts(uint32* out, size_t count);
+	void FillFloats(float* out, size_t count, float a = 0.0f, float b = 1.0f);
+	void FillInts(int* out, size_t count, int a, int b);
+
+	///<summary>
+	/// Per-thread engine. Threads get streams in the order they first use it, which
+	/// depends on scheduling, so the values a ThreadPool worker draws are not
+	/// reproducible. Use RandomEngine(seed, taskIndex) or CounterRandom for that.
+	///</summary>
+	static RandomEngine& ThreadLocal();
+
+private:
+	static const int LaneCount = 8;
+
+	uint32 mState[4];
+
+	// State word k of lane i is mLanes[k][i].
+	uint32 mLanes[4][LaneCount];
+};
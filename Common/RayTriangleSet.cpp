@@ -0,0 +1,427 @@
+//***************************************************************************************
+// RayTriangleSet.cpp
+//***************************************************************************************
+
+#include "RayTriangleSet.h"
+#include <DirectXCollision.h>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	// Same epsilon as DirectX::TriangleTests::Intersects uses for parallel rays.
+	const float RayEpsilon = 1e-20f;
+
+	const size_t TriangleAlignment = 8;
+
+	// Ray packet in SoA form. Unused lanes get a zero direction and a negative
+	// max distance so they never report a hit, and a clear Active mask.
+	struct alignas(32) RayPacketSoA
+	{
+		float OX[8], OY[8], OZ[8];
+		float DX[8], DY[8], DZ[8];
+		float MaxT[8];
+		std::uint32_t Active[8];
+
+		void Load(const RayTriangleSet::Ray* rays, size_t count, size_t width)
+		{
+			for (size_t i = 0; i < width; ++i)
+			{
+				if (i < count)
+				{
+					OX[i] = rays[i].Origin.x;    OY[i] = rays[i].Origin.y;    OZ[i] = rays[i].Origin.z;
+					DX[i] = rays[i].Direction.x; DY[i] = rays[i].Direction.y; DZ[i] = rays[i].Direction.z;
+					MaxT[i] = rays[i].MaxDistance;
+					Active[i] = 0xffffffff;
+				}
+				else
+				{
+					OX[i] = OY[i] = OZ[i] = 0.0f;
+					DX[i] = DY[i] = DZ[i] = 0.0f;
+					MaxT[i] = -1.0f;
+					Active[i] = 0;
+				}
+			}
+		}
+	};
+}
+
+RayTriangleSet::RayTriangleSet(const GeometryGenerator::MeshData& meshData)
+{
+	Build(meshData);
+}
+
+void RayTriangleSet::Build(const GeometryGenerator::MeshData& meshData)
+{
+	// Without vertices no index can be resolved, so there are no triangles either.
+	if (meshData.Vertices.empty())
+	{
+		Build(nullptr, sizeof(GeometryGenerator::Vertex), nullptr, 0);
+		return;
+	}
+
+	Build(&meshData.Vertices[0].Position, sizeof(GeometryGenerator::Vertex),
+		meshData.Indices32.data(), meshData.Indices32.size());
+}
+
+void RayTriangleSet::Build(const XMFLOAT3* positions, size_t positionStride, const uint32* indices, size_t indexCount)
+{
+	mTriangleCount = (uint32)(indexCount / 3);
+
+	size_t paddedCount = (mTriangleCount + TriangleAlignment - 1) / TriangleAlignment * TriangleAlignment;
+
+	for (std::vector<float>* a : { &mV0X, &mV0Y, &mV0Z, &mE1X, &mE1Y, &mE1Z, &mE2X, &mE2Y, &mE2Z })
+		a->assign(paddedCount, 0.0f);
+
+	const char* base = reinterpret_cast<const char*>(positions);
+	for (uint32 i = 0; i < mTriangleCount; ++i)
+	{
+		const XMFLOAT3& p0 = *reinterpret_cast<const XMFLOAT3*>(base + indices[i * 3 + 0] * positionStride);
+		const XMFLOAT3& p1 = *reinterpret_cast<const XMFLOAT3*>(base + indices[i * 3 + 1] * positionStride);
+		const XMFLOAT3& p2 = *reinterpret_cast<const XMFLOAT3*>(base + indices[i * 3 + 2] * positionStride);
+
+		mV0X[i] = p0.x;        mV0Y[i] = p0.y;        mV0Z[i] = p0.z;
+		mE1X[i] = p1.x - p0.x; mE1Y[i] = p1.y - p0.y; mE1Z[i] = p1.z - p0.z;
+		mE2X[i] = p2.x - p0.x; mE2Y[i] = p2.y - p0.y; mE2Z[i] = p2.z - p0.z;
+	}
+}
+
+void RayTriangleSet::Intersect(const Ray* rays, size_t rayCount, Hit* hits)const
+{
+	IntersectPacket8(rays, rayCount, hits, false);
+}
+
+void RayTriangleSet::Occluded(const Ray* rays, size_t rayCount, bool* occluded)const
+{
+	Hit hits[8];
+	for (size_t i = 0; i < rayCount; i += 8)
+	{
+		size_t count = std::min<size_t>(8, rayCount - i);
+		IntersectPacket8(rays + i, count, hits, true);
+
+		for (size_t j = 0; j < count; ++j)
+			occluded[i + j] = hits[j].Triangle != InvalidTriangle;
+	}
+}
+
+void RayTriangleSet::IntersectSingle(const Ray* rays, size_t rayCount, Hit* hits)const
+{
+	for (size_t i = 0; i < rayCount; ++i)
+		hits[i] = IntersectOne(rays[i]);
+}
+
+void RayTriangleSet::IntersectPacket4(const Ray* rays, size_t rayCount, Hit* hits)const
+{
+	IntersectPacket4(rays, rayCount, hits, false);
+}
+
+void RayTriangleSet::IntersectPacket8(const Ray* rays, size_t rayCount, Hit* hits)const
+{
+	IntersectPacket8(rays, rayCount, hits, false);
+}
+
+void RayTriangleSet::IntersectReference(const Ray* rays, size_t rayCount, Hit* hits)const
+{
+	for (size_t r = 0; r < rayCount; ++r)
+	{
+		XMVECTOR origin = XMLoadFloat3(&rays[r].Origin);
+		XMVECTOR direction = XMLoadFloat3(&rays[r].Direction);
+
+		Hit hit;
+		hit.Distance = rays[r].MaxDistance;
+
+		for (uint32 i = 0; i < mTriangleCount; ++i)
+		{
+			XMVECTOR v0 = XMVectorSet(mV0X[i], mV0Y[i], mV0Z[i], 0.0f);
+			XMVECTOR v1 = v0 + XMVectorSet(mE1X[i], mE1Y[i], mE1Z[i], 0.0f);
+			XMVECTOR v2 = v0 + XMVectorSet(mE2X[i], mE2Y[i], mE2Z[i], 0.0f);
+
+			float dist;
+			if (TriangleTests::Intersects(origin, direction, v0, v1, v2, dist) && dist < hit.Distance)
+			{
+				hit.Distance = dist;
+				hit.Triangle = i;
+			}
+		}
+
+		if (hit.Triangle == InvalidTriangle)
+			hit.Distance = FLT_MAX;
+
+		hits[r] = hit;
+	}
+}
+
+RayTriangleSet::Hit RayTriangleSet::IntersectOne(const Ray& ray)const
+{
+	// Moller-Trumbore with the ray broadcast and 4 triangles in the lanes.
+	XMVECTOR ox = XMVectorReplicate(ray.Origin.x);
+	XMVECTOR oy = XMVectorReplicate(ray.Origin.y);
+	XMVECTOR oz = XMVectorReplicate(ray.Origin.z);
+	XMVECTOR dx = XMVectorReplicate(ray.Direction.x);
+	XMVECTOR dy = XMVectorReplicate(ray.Direction.y);
+	XMVECTOR dz = XMVectorReplicate(ray.Direction.z);
+
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR eps = XMVectorReplicate(RayEpsilon);
+
+	// Each lane keeps the integer bits of the first index of the 4 triangle block it
+	// last hit in (the lane is the offset into the block), so any count is exact.
+	XMVECTOR bestT = XMVectorReplicate(ray.MaxDistance);
+	XMVECTOR bestBlock = XMVectorReplicateInt(InvalidTriangle);
+
+	for (uint32 i = 0; i < mTriangleCount; i += 4)
+	{
+		XMVECTOR e1x = XMLoadFloat4((const XMFLOAT4*)&mE1X[i]);
+		XMVECTOR e1y = XMLoadFloat4((const XMFLOAT4*)&mE1Y[i]);
+		XMVECTOR e1z = XMLoadFloat4((const XMFLOAT4*)&mE1Z[i]);
+		XMVECTOR e2x = XMLoadFloat4((const XMFLOAT4*)&mE2X[i]);
+		XMVECTOR e2y = XMLoadFloat4((const XMFLOAT4*)&mE2Y[i]);
+		XMVECTOR e2z = XMLoadFloat4((const XMFLOAT4*)&mE2Z[i]);
+
+		// pvec = D x e2
+		XMVECTOR px = dy * e2z - dz * e2y;
+		XMVECTOR py = dz * e2x - dx * e2z;
+		XMVECTOR pz = dx * e2y - dy * e2x;
+
+		XMVECTOR det = e1x * px + e1y * py + e1z * pz;
+		XMVECTOR invDet = XMVectorReciprocal(det);
+
+		// tvec = O - v0
+		XMVECTOR tx = ox - XMLoadFloat4((const XMFLOAT4*)&mV0X[i]);
+		XMVECTOR ty = oy - XMLoadFloat4((const XMFLOAT4*)&mV0Y[i]);
+		XMVECTOR tz = oz - XMLoadFloat4((const XMFLOAT4*)&mV0Z[i]);
+
+		XMVECTOR u = (tx * px + ty * py + tz * pz) * invDet;
+
+		// qvec = tvec x e1
+		XMVECTOR qx = ty * e1z - tz * e1y;
+		XMVECTOR qy = tz * e1x - tx * e1z;
+		XMVECTOR qz = tx * e1y - ty * e1x;
+
+		XMVECTOR v = (dx * qx + dy * qy + dz * qz) * invDet;
+		XMVECTOR t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+		XMVECTOR mask = XMVectorGreater(XMVectorAbs(det), eps);
+		mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(u, zero));
+		mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(v, zero));
+		mask = XMVectorAndInt(mask, XMVectorLessOrEqual(u + v, one));
+		mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(t, zero));
+		mask = XMVectorAndInt(mask, XMVectorLess(t, bestT));
+
+		bestT = XMVectorSelect(bestT, t, mask);
+		bestBlock = XMVectorSelect(bestBlock, XMVectorReplicateInt(i), mask);
+	}
+
+	// Reduce the 4 lanes to the closest hit.
+	XMFLOAT4 t4;
+	uint32 block[4];
+	XMStoreFloat4(&t4, bestT);
+	XMStoreInt4(block, bestBlock);
+
+	const float* t = &t4.x;
+
+	Hit hit;
+	for (uint32 lane = 0; lane < 4; ++lane)
+	{
+		if (block[lane] != InvalidTriangle && t[lane] < hit.Distance)
+		{
+			hit.Distance = t[lane];
+			hit.Triangle = block[lane] + lane;
+		}
+	}
+
+	return hit;
+}
+
+void RayTriangleSet::IntersectPacket4(const Ray* rays, size_t rayCount, Hit* hits, bool anyHit)const
+{
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR eps = XMVectorReplicate(RayEpsilon);
+
+	RayPacketSoA packet;
+
+	for (size_t r = 0; r < rayCount; r += 4)
+	{
+		size_t count = std::min<size_t>(4, rayCount - r);
+		packet.Load(rays + r, count, 4);
+
+		// Moller-Trumbore with 4 rays in the lanes and each triangle broadcast.
+		XMVECTOR ox = XMLoadFloat4A((const XMFLOAT4A*)packet.OX);
+		XMVECTOR oy = XMLoadFloat4A((const XMFLOAT4A*)packet.OY);
+		XMVECTOR oz = XMLoadFloat4A((const XMFLOAT4A*)packet.OZ);
+		XMVECTOR dx = XMLoadFloat4A((const XMFLOAT4A*)packet.DX);
+		XMVECTOR dy = XMLoadFloat4A((const XMFLOAT4A*)packet.DY);
+		XMVECTOR dz = XMLoadFloat4A((const XMFLOAT4A*)packet.DZ);
+
+		// Triangle indices are kept as integer bits in the lanes. Inactive lanes start
+		// out blocked, so a partial packet can still stop early.
+		XMVECTOR bestT = XMLoadFloat4A((const XMFLOAT4A*)packet.MaxT);
+		XMVECTOR bestIndex = XMVectorReplicateInt(InvalidTriangle);
+		XMVECTOR hitMask = XMVectorEqualInt(XMLoadInt4A(packet.Active), XMVectorFalseInt());
+
+		for (uint32 i = 0; i < mTriangleCount; ++i)
+		{
+			XMVECTOR e1x = XMVectorReplicatePtr(&mE1X[i]);
+			XMVECTOR e1y = XMVectorReplicatePtr(&mE1Y[i]);
+			XMVECTOR e1z = XMVectorReplicatePtr(&mE1Z[i]);
+			XMVECTOR e2x = XMVectorReplicatePtr(&mE2X[i]);
+			XMVECTOR e2y = XMVectorReplicatePtr(&mE2Y[i]);
+			XMVECTOR e2z = XMVectorReplicatePtr(&mE2Z[i]);
+
+			XMVECTOR px = dy * e2z - dz * e2y;
+			XMVECTOR py = dz * e2x - dx * e2z;
+			XMVECTOR pz = dx * e2y - dy * e2x;
+
+			XMVECTOR det = e1x * px + e1y * py + e1z * pz;
+			XMVECTOR invDet = XMVectorReciprocal(det);
+
+			XMVECTOR tx = ox - XMVectorReplicatePtr(&mV0X[i]);
+			XMVECTOR ty = oy - XMVectorReplicatePtr(&mV0Y[i]);
+			XMVECTOR tz = oz - XMVectorReplicatePtr(&mV0Z[i]);
+
+			XMVECTOR u = (tx * px + ty * py + tz * pz) * invDet;
+
+			XMVECTOR qx = ty * e1z - tz * e1y;
+			XMVECTOR qy = tz * e1x - tx * e1z;
+			XMVECTOR qz = tx * e1y - ty * e1x;
+
+			XMVECTOR v = (dx * qx + dy * qy + dz * qz) * invDet;
+			XMVECTOR t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+			XMVECTOR mask = XMVectorGreater(XMVectorAbs(det), eps);
+			mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(u, zero));
+			mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(v, zero));
+			mask = XMVectorAndInt(mask, XMVectorLessOrEqual(u + v, one));
+			mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(t, zero));
+			mask = XMVectorAndInt(mask, XMVectorLess(t, bestT));
+
+			bestT = XMVectorSelect(bestT, t, mask);
+			bestIndex = XMVectorSelect(bestIndex, XMVectorReplicateInt(i), mask);
+
+			if (anyHit)
+			{
+				// A blocked lane stops looking for closer hits.
+				hitMask = XMVectorOrInt(hitMask, mask);
+				bestT = XMVectorSelect(bestT, XMVectorReplicate(-1.0f), hitMask);
+
+				if (XMVector4EqualInt(hitMask, XMVectorTrueInt()))
+					break;
+			}
+		}
+
+		XMFLOAT4A t4;
+		alignas(16) uint32 index[4];
+		XMStoreFloat4A(&t4, bestT);
+		XMStoreInt4A(index, bestIndex);
+
+		const float* t = &t4.x;
+		for (size_t lane = 0; lane < count; ++lane)
+		{
+			Hit& hit = hits[r + lane];
+			hit.Triangle = index[lane];
+			hit.Distance = index[lane] != InvalidTriangle && !anyHit ? t[lane] : FLT_MAX;
+		}
+	}
+}
+
+void RayTriangleSet::IntersectPacket8(const Ray* rays, size_t rayCount, Hit* hits, bool anyHit)const
+{
+#if defined(__AVX2__)
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 eps = _mm256_set1_ps(RayEpsilon);
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	const __m256 allLanes = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+	RayPacketSoA packet;
+
+	for (size_t r = 0; r < rayCount; r += 8)
+	{
+		size_t count = std::min<size_t>(8, rayCount - r);
+		packet.Load(rays + r, count, 8);
+
+		__m256 ox = _mm256_load_ps(packet.OX);
+		__m256 oy = _mm256_load_ps(packet.OY);
+		__m256 oz = _mm256_load_ps(packet.OZ);
+		__m256 dx = _mm256_load_ps(packet.DX);
+		__m256 dy = _mm256_load_ps(packet.DY);
+		__m256 dz = _mm256_load_ps(packet.DZ);
+
+		// Triangle indices are kept as integer bits in the lanes. Inactive lanes start
+		// out blocked, so a partial packet can still stop early.
+		__m256 bestT = _mm256_load_ps(packet.MaxT);
+		__m256 bestIndex = _mm256_castsi256_ps(_mm256_set1_epi32((int)InvalidTriangle));
+		__m256 hitMask = _mm256_andnot_ps(_mm256_load_ps(reinterpret_cast<const float*>(packet.Active)), allLanes);
+
+		for (uint32 i = 0; i < mTriangleCount; ++i)
+		{
+			__m256 e1x = _mm256_broadcast_ss(&mE1X[i]);
+			__m256 e1y = _mm256_broadcast_ss(&mE1Y[i]);
+			__m256 e1z = _mm256_broadcast_ss(&mE1Z[i]);
+			__m256 e2x = _mm256_broadcast_ss(&mE2X[i]);
+			__m256 e2y = _mm256_broadcast_ss(&mE2Y[i]);
+			__m256 e2z = _mm256_broadcast_ss(&mE2Z[i]);
+
+			__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+			__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+			__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+
+			__m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+			__m256 invDet = _mm256_div_ps(one, det);
+
+			__m256 tx = _mm256_sub_ps(ox, _mm256_broadcast_ss(&mV0X[i]));
+			__m256 ty = _mm256_sub_ps(oy, _mm256_broadcast_ss(&mV0Y[i]));
+			__m256 tz = _mm256_sub_ps(oz, _mm256_broadcast_ss(&mV0Z[i]));
+
+			__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)), _mm256_mul_ps(tz, pz)), invDet);
+
+			__m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+			__m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+			__m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+
+			__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), invDet);
+			__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), invDet);
+
+			__m256 mask = _mm256_cmp_ps(_mm256_andnot_ps(signMask, det), eps, _CMP_GT_OQ);
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, zero, _CMP_GE_OQ));
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, bestT, _CMP_LT_OQ));
+
+			bestT = _mm256_blendv_ps(bestT, t, mask);
+			bestIndex = _mm256_blendv_ps(bestIndex, _mm256_castsi256_ps(_mm256_set1_epi32((int)i)), mask);
+
+			if (anyHit)
+			{
+				hitMask = _mm256_or_ps(hitMask, mask);
+				bestT = _mm256_blendv_ps(bestT, _mm256_set1_ps(-1.0f), hitMask);
+
+				if (_mm256_testc_ps(hitMask, allLanes))
+					break;
+			}
+		}
+
+		alignas(32) float t[8];
+		alignas(32) uint32 index[8];
+		_mm256_store_ps(t, bestT);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(index), _mm256_castps_si256(bestIndex));
+
+		for (size_t lane = 0; lane < count; ++lane)
+		{
+			Hit& hit = hits[r + lane];
+			hit.Triangle = index[lane];
+			hit.Distance = index[lane] != InvalidTriangle && !anyHit ? t[lane] : FLT_MAX;
+		}
+	}
+#else
+	// Without AVX2 an 8-ray packet is two XMVECTOR packets.
+	IntersectPacket4(rays, rayCount, hits, anyHit);
+#endif
+}
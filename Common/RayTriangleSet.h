@@ -0,0 +1,77 @@
+//***************************************************************************************
+// RayTriangleSet.h
+//
+// Batched ray queries against a triangle soup built from GeometryGenerator::MeshData.
+// Triangles are stored in SoA form (v0, edge1, edge2) so that rays can be tested
+// 4 at a time (XMVECTOR lanes) or 8 at a time (AVX2 lanes) per triangle.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+#include "GeometryGenerator.h"
+
+class RayTriangleSet
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	static const uint32 InvalidTriangle = 0xffffffff;
+
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Origin = { 0.0f, 0.0f, 0.0f };
+
+		// Must be unit length, like DirectX::TriangleTests::Intersects expects.
+		DirectX::XMFLOAT3 Direction = { 0.0f, 0.0f, 1.0f };
+
+		// Hits farther than this are ignored.
+		float MaxDistance = FLT_MAX;
+	};
+
+	struct Hit
+	{
+		float Distance = FLT_MAX;
+		uint32 Triangle = InvalidTriangle;
+	};
+
+	RayTriangleSet() = default;
+	explicit RayTriangleSet(const GeometryGenerator::MeshData& meshData);
+
+	void Build(const GeometryGenerator::MeshData& meshData);
+
+	// positionStride is the byte distance between two positions, e.g. sizeof(GeometryGenerator::Vertex).
+	void Build(const DirectX::XMFLOAT3* positions, size_t positionStride, const uint32* indices, size_t indexCount);
+
+	uint32 GetTriangleCount()const { return mTriangleCount; }
+
+	// Closest hit of each ray. The best packet width for the target is used.
+	void Intersect(const Ray* rays, size_t rayCount, Hit* hits)const;
+
+	// Any hit of each ray within Ray::MaxDistance (visibility / occlusion queries).
+	// Packets stop walking triangles once every lane is blocked.
+	void Occluded(const Ray* rays, size_t rayCount, bool* occluded)const;
+
+	// Explicit query modes, mostly for comparing throughput.
+	void IntersectSingle(const Ray* rays, size_t rayCount, Hit* hits)const;
+	void IntersectPacket4(const Ray* rays, size_t rayCount, Hit* hits)const;
+	void IntersectPacket8(const Ray* rays, size_t rayCount, Hit* hits)const;
+	void IntersectReference(const Ray* rays, size_t rayCount, Hit* hits)const;
+
+private:
+	Hit IntersectOne(const Ray& ray)const;
+	void IntersectPacket4(const Ray* rays, size_t rayCount, Hit* hits, bool anyHit)const;
+	void IntersectPacket8(const Ray* rays, size_t rayCount, Hit* hits, bool anyHit)const;
+
+private:
+	uint32 mTriangleCount = 0;
+
+	// Padded to a multiple of 8 with degenerate triangles (zero edges never hit).
+	std::vector<float> mV0X, mV0Y, mV0Z;
+	std::vector<float> mE1X, mE1Y, mE1Z;
+	std::vector<float> mE2X, mE2Y, mE2Z;
+};
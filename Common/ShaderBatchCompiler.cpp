@@ -0,0 +1,137 @@
+//***************************************************************************************
+// ShaderBatchCompiler.cpp
+//***************************************************************************************
+
+#include "ShaderBatchCompiler.h"
+#include "StringUtil.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+namespace
+{
+	double ElapsedMilliseconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	void AppendLengthPrefixed(std::string& key, const std::string& s)
+	{
+		key += std::to_string(s.size());
+		key += ':';
+		key += s;
+	}
+}
+
+ShaderBatchCompiler::Report ShaderBatchCompiler::Compile(ShaderCache& cache, const std::vector<ShaderCompiler::Request>& jobs,
+	ThreadPool* pool)
+{
+	auto batchStart = std::chrono::high_resolution_clock::now();
+
+	Report report;
+	report.Jobs.resize(jobs.size());
+
+	// Map every job to the first job with the same key.
+	std::vector<uint32> uniqueJobs;
+	{
+		std::unordered_map<std::string, uint32> firstJob;
+		for (uint32 i = 0; i < (uint32)jobs.size(); ++i)
+		{
+			auto inserted = firstJob.emplace(GetJobKey(jobs[i]), i);
+			report.Jobs[i].SharedWith = inserted.first->second;
+			if (inserted.second)
+				uniqueJobs.push_back(i);
+		}
+	}
+
+	auto compileRange = [&](size_t begin, size_t end)
+	{
+		for (size_t u = begin; u < end; ++u)
+		{
+			uint32 index = uniqueJobs[u];
+			auto start = std::chrono::high_resolution_clock::now();
+
+			ShaderCache::Result result = cache.Compile(jobs[index]);
+
+			JobResult& job = report.Jobs[index];
+			job.Succeeded = SUCCEEDED(result.Status);
+			job.FromCache = result.FromCache;
+			job.Bytecode = std::move(result.Bytecode);
+			job.Errors = std::move(result.Errors);
+			job.Milliseconds = ElapsedMilliseconds(start);
+		}
+	};
+
+	// One job per task: compile times vary by orders of magnitude between shaders.
+	if (pool == nullptr || uniqueJobs.size() <= 1)
+		compileRange(0, uniqueJobs.size());
+	else
+		pool->ParallelFor(uniqueJobs.size(), 1, compileRange);
+
+	for (uint32 i = 0; i < (uint32)jobs.size(); ++i)
+	{
+		JobResult& job = report.Jobs[i];
+		if (job.SharedWith != i)
+		{
+			const JobResult& first = report.Jobs[job.SharedWith];
+			job.Succeeded = first.Succeeded;
+			job.FromCache = first.FromCache;
+			job.Bytecode = first.Bytecode;
+			job.Errors = first.Errors;
+			continue;
+		}
+
+		++report.UniqueJobCount;
+		if (!job.Succeeded)
+			++report.FailedJobCount;
+		else if (job.FromCache)
+			++report.CacheHitCount;
+	}
+
+	report.Milliseconds = ElapsedMilliseconds(batchStart);
+	return report;
+}
+
+std::string ShaderBatchCompiler::GetJobKey(const ShaderCompiler::Request& job)
+{
+	// Stable sort, so repeated definitions of one name keep their order (the last wins).
+	std::vector<const ShaderCompiler::Macro*> defines;
+	for (const ShaderCompiler::Macro& macro : job.Defines)
+		defines.push_back(&macro);
+	std::stable_sort(defines.begin(), defines.end(),
+		[](const ShaderCompiler::Macro* a, const ShaderCompiler::Macro* b) { return a->Name < b->Name; });
+
+	std::string key;
+	key.append((const char*)job.Filename.data(), job.Filename.size() * sizeof(wchar_t));
+	key += '|';
+	AppendLengthPrefixed(key, job.EntryPoint);
+	AppendLengthPrefixed(key, job.Target);
+	key += std::to_string(job.Flags);
+	for (const ShaderCompiler::Macro* macro : defines)
+	{
+		AppendLengthPrefixed(key, macro->Name);
+		AppendLengthPrefixed(key, macro->Definition);
+	}
+	return key;
+}
+
+std::string ShaderBatchCompiler::Report::GetErrorSummary(const std::vector<ShaderCompiler::Request>& jobs)const
+{
+	std::string summary;
+	for (uint32 i = 0; i < (uint32)Jobs.size(); ++i)
+	{
+		const JobResult& job = Jobs[i];
+		if (job.Succeeded || job.SharedWith != i)
+			continue;
+
+		summary += StringUtil::ToNarrow(jobs[i].Filename) + " (" + jobs[i].EntryPoint + ", " + jobs[i].Target;
+		for (const ShaderCompiler::Macro& macro : jobs[i].Defines)
+			summary += ", " + macro.Name + "=" + macro.Definition;
+		summary += "):\n" + job.Errors;
+		if (!job.Errors.empty() && job.Errors.back() != '\n')
+			summary += '\n';
+	}
+	return summary;
+}
@@ -0,0 +1,56 @@
+//***************************************************************************************
+// ShaderBatchCompiler.h
+//
+// Compiles a list of shader jobs (typically every define permutation of an effect)
+// across ThreadPool. Identical jobs are compiled once and share the bytecode. Each job
+// reports its own success, compiler output and time instead of the batch stopping at
+// the first error, so one run lists every broken permutation.
+//***************************************************************************************
+
+#pragma once
+
+#include "ShaderCache.h"
+
+class ThreadPool;
+
+class ShaderBatchCompiler
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	struct JobResult
+	{
+		bool Succeeded = false;
+		bool FromCache = false;
+		uint32 SharedWith = 0; // Index of the first identical job (its own index if unique).
+		std::shared_ptr<const std::vector<uint8>> Bytecode;
+		std::string Errors;
+		double Milliseconds = 0.0; // Preprocess + lookup + compile; 0 for duplicates.
+	};
+
+	struct Report
+	{
+		std::vector<JobResult> Jobs; // In job order.
+		uint32 UniqueJobCount = 0;
+		uint32 FailedJobCount = 0;
+		uint32 CacheHitCount = 0;
+		double Milliseconds = 0.0;   // Wall clock for the batch.
+
+		bool Succeeded()const { return FailedJobCount == 0; }
+
+		// Compiler output of every failed unique job, prefixed with its file and entry point.
+		std::string GetErrorSummary(const std::vector<ShaderCompiler::Request>& jobs)const;
+	};
+
+	///<summary>
+	/// Compiles jobs through cache, one unique job per ThreadPool task (serially when
+	/// pool is null). Jobs are identical when their file, entry point, target, flags and
+	/// set of defines match; define order does not matter.
+	///</summary>
+	static Report Compile(ShaderCache& cache, const std::vector<ShaderCompiler::Request>& jobs, ThreadPool* pool = nullptr);
+
+	// Key identifying jobs that must produce the same bytecode.
+	static std::string GetJobKey(const ShaderCompiler::Request& job);
+};
@@ -0,0 +1,228 @@
+//***************************************************************************************
+// ShaderCache.cpp
+//***************************************************************************************
+
+#include "ShaderCache.h"
+#include "AsyncFileIO.h"
+#include "StringUtil.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+const ShaderCache::uint32 ShaderCache::FormatVersion;
+
+namespace
+{
+	const std::uint32_t EntryMagic = 0x43444853; // 'SHDC'
+
+	struct EntryHeader
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+		std::uint64_t Key;
+		std::uint64_t Size;
+		std::uint64_t Checksum; // Of the bytecode, to reject torn or corrupted files.
+	};
+
+	// Length prefixed, so ("ab", "c") and ("a", "bc") hash differently.
+	std::uint64_t HashString(std::uint64_t hash, const std::string& s)
+	{
+		std::uint64_t length = s.size();
+		hash = StringUtil::Fnv1a(hash, &length, sizeof(length));
+		return StringUtil::Fnv1a(hash, s.data(), s.size());
+	}
+
+	FILE* OpenForWrite(const std::wstring& filename)
+	{
+#if defined(_WIN32)
+		return _wfopen(filename.c_str(), L"wb");
+#else
+		return fopen(StringUtil::ToNarrow(filename).c_str(), "wb");
+#endif
+	}
+
+	bool MoveIntoPlace(const std::wstring& from, const std::wstring& to)
+	{
+#if defined(_WIN32)
+		return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return rename(StringUtil::ToNarrow(from).c_str(), StringUtil::ToNarrow(to).c_str()) == 0;
+#endif
+	}
+
+	unsigned long CurrentProcessId()
+	{
+#if defined(_WIN32)
+		return GetCurrentProcessId();
+#else
+		return (unsigned long)getpid();
+#endif
+	}
+
+	void DeleteFileQuietly(const std::wstring& filename)
+	{
+#if defined(_WIN32)
+		DeleteFileW(filename.c_str());
+#else
+		unlink(StringUtil::ToNarrow(filename).c_str());
+#endif
+	}
+}
+
+ShaderCache::ShaderCache(std::shared_ptr<ShaderCompiler> compiler, const std::wstring& directory) :
+	mCompiler(std::move(compiler)),
+	mDirectory(directory)
+{
+}
+
+ShaderCache::Result ShaderCache::Compile(const ShaderCompiler::Request& request)
+{
+	Result result;
+
+	std::string source;
+	result.Status = mCompiler->Preprocess(request, source, result.Includes, result.Errors);
+	if (FAILED(result.Status))
+		return result;
+
+	result.Key = ComputeKey(request, source, mCompiler->GetIdentity());
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto it = mEntries.find(result.Key);
+		if (it != mEntries.end())
+		{
+			result.Status = S_OK;
+			result.FromCache = true;
+			result.Bytecode = it->second;
+			return result;
+		}
+	}
+
+	auto bytecode = std::make_shared<std::vector<uint8>>();
+	if (LoadEntry(result.Key, *bytecode))
+	{
+		result.FromCache = true;
+	}
+	else
+	{
+		result.Status = mCompiler->Compile(request, source, *bytecode, result.Errors);
+		if (FAILED(result.Status))
+			return result;
+
+		StoreEntry(result.Key, *bytecode);
+	}
+
+	result.Status = S_OK;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		// Another thread may have stored the same key meanwhile; keep the first.
+		result.Bytecode = mEntries.emplace(result.Key, std::move(bytecode)).first->second;
+	}
+
+	return result;
+}
+
+ShaderCache::uint64 ShaderCache::ComputeKey(const ShaderCompiler::Request& request, const std::string& preprocessedSource,
+	const std::string& compilerIdentity)
+{
+	uint64 hash = StringUtil::Fnv1aSeed;
+	hash = StringUtil::Fnv1a(hash, &FormatVersion, sizeof(FormatVersion));
+	hash = HashString(hash, compilerIdentity);
+	hash = HashString(hash, preprocessedSource);
+
+	uint64 defineCount = request.Defines.size();
+	hash = StringUtil::Fnv1a(hash, &defineCount, sizeof(defineCount));
+	for (const ShaderCompiler::Macro& macro : request.Defines)
+	{
+		hash = HashString(hash, macro.Name);
+		hash = HashString(hash, macro.Definition);
+	}
+
+	hash = HashString(hash, request.EntryPoint);
+	hash = HashString(hash, request.Target);
+	hash = StringUtil::Fnv1a(hash, &request.Flags, sizeof(request.Flags));
+
+	return hash;
+}
+
+std::wstring ShaderCache::GetEntryFilename(uint64 key)const
+{
+	std::wostringstream name;
+	name << std::hex << std::setw(16) << std::setfill(L'0') << key << L".cso";
+
+	if (mDirectory.empty())
+		return name.str();
+	if (mDirectory.back() == L'/' || mDirectory.back() == L'\\')
+		return mDirectory + name.str();
+	return mDirectory + L"/" + name.str();
+}
+
+size_t ShaderCache::GetMemoryEntryCount()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEntries.size();
+}
+
+void ShaderCache::ClearMemory()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mEntries.clear();
+}
+
+bool ShaderCache::LoadEntry(uint64 key, std::vector<uint8>& bytecode)const
+{
+	if (mDirectory.empty())
+		return false;
+
+	AsyncFileIO::Result file = AsyncFileIO::ReadWholeFile(GetEntryFilename(key));
+	if (FAILED(file.Status) || file.Data.size() < sizeof(EntryHeader))
+		return false;
+
+	EntryHeader header;
+	std::memcpy(&header, file.Data.data(), sizeof(header));
+
+	const uint8* data = file.Data.data() + sizeof(header);
+	if (header.Magic != EntryMagic || header.Version != FormatVersion || header.Key != key ||
+		header.Size != file.Data.size() - sizeof(header) || header.Checksum != StringUtil::Fnv1a(StringUtil::Fnv1aSeed, data, (size_t)header.Size))
+	{
+		return false;
+	}
+
+	bytecode.assign(data, data + header.Size);
+	return true;
+}
+
+void ShaderCache::StoreEntry(uint64 key, const std::vector<uint8>& bytecode)const
+{
+	if (mDirectory.empty())
+		return;
+
+	EntryHeader header;
+	header.Magic = EntryMagic;
+	header.Version = FormatVersion;
+	header.Key = key;
+	header.Size = bytecode.size();
+	header.Checksum = StringUtil::Fnv1a(StringUtil::Fnv1aSeed, bytecode.data(), bytecode.size());
+
+	// Write a private file and rename it into place, so readers (other threads or
+	// processes) never see a partial entry. Failures just leave the entry uncached.
+	static std::atomic<std::uint32_t> tempCounter{ 0 };
+	std::wstring filename = GetEntryFilename(key);
+	std::wstring tempFilename = filename + L"." + std::to_wstring(CurrentProcessId()) + L"." + std::to_wstring(tempCounter++) + L".tmp";
+
+	FILE* file = OpenForWrite(tempFilename);
+	if (file == nullptr)
+		return;
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		(bytecode.empty() || fwrite(bytecode.data(), bytecode.size(), 1, file) == 1);
+	written = fclose(file) == 0 && written;
+
+	if (!written || !MoveIntoPlace(tempFilename, filename))
+		DeleteFileQuietly(tempFilename);
+}
@@ -0,0 +1,124 @@
+//***************************************************************************************
+// ShaderCache.h
+//
+// Content addressed cache of compiled shaders. Every request is preprocessed (cheap
+// next to compiling) and keyed by a hash of the preprocessed source, which contains
+// every file reached through #include, plus the defines, entry point, target, flags
+// and compiler identity. A key that is already in memory or in the cache directory
+// returns the stored bytecode without running the compiler, so editing a shader or any
+// header it includes misses, and nothing else does.
+//
+// The compiler is a backend interface: D3DShaderCompiler on Windows, or a stand-in
+// (e.g. a scripted fake or an external tool) elsewhere.
+//***************************************************************************************
+
+#pragma once
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <wsl/winadapter.h>
+#endif
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ShaderCompiler
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	struct Macro
+	{
+		std::string Name;
+		std::string Definition;
+	};
+
+	struct Request
+	{
+		std::wstring Filename;
+		std::vector<Macro> Defines;
+		std::string EntryPoint;
+		std::string Target;
+		uint32 Flags = 0; // D3DCOMPILE_* flags.
+	};
+
+	virtual ~ShaderCompiler() = default;
+
+	// Changes whenever the same source could compile to different bytecode.
+	virtual std::string GetIdentity()const = 0;
+
+	///<summary>
+	/// Expands the includes and macros of request.Filename into source and lists every
+	/// file opened through #include in includes (resolved paths, first open order).
+	/// Returns a failure code with a message in errors on failure. Must be thread safe.
+	///</summary>
+	virtual HRESULT Preprocess(const Request& request, std::string& source, std::vector<std::wstring>& includes,
+		std::string& errors) = 0;
+
+	// Compiles source (Preprocess() output for request). Must be thread safe.
+	virtual HRESULT Compile(const Request& request, const std::string& source, std::vector<uint8>& bytecode,
+		std::string& errors) = 0;
+};
+
+class ShaderCache
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Bump when the key or the entry file layout changes.
+	static const uint32 FormatVersion = 1;
+
+	struct Result
+	{
+		HRESULT Status = E_FAIL; // The backend's code when preprocessing or compiling fails.
+		bool FromCache = false; // Found in memory or on disk; the compiler did not run.
+		uint64 Key = 0;
+		std::shared_ptr<const std::vector<uint8>> Bytecode;
+		std::vector<std::wstring> Includes;
+		std::string Errors;    // Preprocessor or compiler output (warnings on success).
+	};
+
+	///<summary>
+	/// Entries are written to directory (which must exist) as <key>.cso files. An empty
+	/// directory keeps the cache in memory only.
+	///</summary>
+	ShaderCache(std::shared_ptr<ShaderCompiler> compiler, const std::wstring& directory);
+
+	ShaderCache(const ShaderCache& rhs) = delete;
+	ShaderCache& operator=(const ShaderCache& rhs) = delete;
+
+	// Thread safe; concurrent misses on the same key may both compile.
+	Result Compile(const ShaderCompiler::Request& request);
+
+	static uint64 ComputeKey(const ShaderCompiler::Request& request, const std::string& preprocessedSource,
+		const std::string& compilerIdentity);
+
+	ShaderCompiler& GetCompiler() { return *mCompiler; }
+	const std::wstring& GetDirectory()const { return mDirectory; }
+	std::wstring GetEntryFilename(uint64 key)const;
+
+	size_t GetMemoryEntryCount();
+
+	// Drops the in-memory entries; files in the directory are kept.
+	void ClearMemory();
+
+private:
+	bool LoadEntry(uint64 key, std::vector<uint8>& bytecode)const;
+	void StoreEntry(uint64 key, const std::vector<uint8>& bytecode)const;
+
+private:
+	std::shared_ptr<ShaderCompiler> mCompiler;
+	std::wstring mDirectory;
+
+	std::mutex mMutex;
+	std::unordered_map<uint64, std::shared_ptr<const std::vector<uint8>>> mEntries;
+};
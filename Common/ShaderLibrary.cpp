@@ -0,0 +1,231 @@
+//***************************************************************************************
+// ShaderLibrary.cpp
+//***************************************************************************************
+
+#include "ShaderLibrary.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+
+ShaderLibrary::ShaderLibrary(std::shared_ptr<ShaderCache> cache, ThreadPool* pool, uint32 pollMilliseconds) :
+	mCache(std::move(cache)),
+	mPool(pool),
+	mWatcher(pollMilliseconds)
+{
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+	StopWatching();
+}
+
+ShaderLibrary::Handle ShaderLibrary::Add(const ShaderCompiler::Request& request, std::string* errors)
+{
+	// Taken before the compiler reads anything, so edits made during the compile are seen.
+	FileWatcher::uint64 readStart = FileWatcher::Now();
+	ShaderCache::Result result = mCache->Compile(request);
+
+	Handle handle;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		handle = (Handle)mEntries.size();
+		mEntries.emplace_back(new Entry());
+		mEntries.back()->Request = request;
+	}
+
+	{
+		// Keeps a rebuild triggered meanwhile from being overwritten by this older result.
+		std::lock_guard<std::mutex> rebuildLock(mRebuildMutex);
+		Apply(handle, result, readStart);
+	}
+
+	if (errors != nullptr)
+		*errors = result.Errors;
+
+	return handle;
+}
+
+std::shared_ptr<const ShaderLibrary::Shader> ShaderLibrary::Get(Handle handle)const
+{
+	return std::atomic_load(&GetEntry(handle).Current);
+}
+
+const ShaderCompiler::Request& ShaderLibrary::GetRequest(Handle handle)const
+{
+	return GetEntry(handle).Request;
+}
+
+std::vector<std::wstring> ShaderLibrary::GetDependencies(Handle handle)
+{
+	Entry& entry = GetEntry(handle);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	return entry.Dependencies;
+}
+
+std::vector<ShaderLibrary::Handle> ShaderLibrary::GetDependents(const std::wstring& filename)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	std::vector<Handle> handles;
+	auto it = mDependents.find(filename);
+	if (it != mDependents.end())
+		handles.assign(it->second.begin(), it->second.end());
+
+	std::sort(handles.begin(), handles.end());
+	return handles;
+}
+
+void ShaderLibrary::SetRebuildCallback(RebuildCallback onRebuild)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mOnRebuild = std::move(onRebuild);
+}
+
+std::vector<ShaderLibrary::Handle> ShaderLibrary::Rebuild(const std::vector<std::wstring>& changedFiles)
+{
+	std::unique_lock<std::mutex> rebuildLock(mRebuildMutex);
+
+	// Walk the reverse edges: every shader that read one of the files.
+	std::vector<Handle> handles;
+	std::vector<const ShaderCompiler::Request*> requests;
+	RebuildCallback onRebuild;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (const std::wstring& filename : changedFiles)
+		{
+			auto it = mDependents.find(filename);
+			if (it != mDependents.end())
+				handles.insert(handles.end(), it->second.begin(), it->second.end());
+		}
+
+		std::sort(handles.begin(), handles.end());
+		handles.erase(std::unique(handles.begin(), handles.end()), handles.end());
+
+		for (Handle handle : handles)
+			requests.push_back(&mEntries[handle]->Request);
+		onRebuild = mOnRebuild;
+	}
+
+	// Requests are immutable once added, so they are read without the lock.
+	FileWatcher::uint64 readStart = FileWatcher::Now();
+	std::vector<ShaderCache::Result> results(handles.size());
+	auto compileRange = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			results[i] = mCache->Compile(*requests[i]);
+	};
+
+	if (mPool == nullptr || handles.size() <= 1)
+		compileRange(0, handles.size());
+	else
+		mPool->ParallelFor(handles.size(), 1, compileRange);
+
+	for (size_t i = 0; i < handles.size(); ++i)
+		Apply(handles[i], results[i], readStart);
+
+	// The callback may call back into the library (Get, Add, even Rebuild).
+	rebuildLock.unlock();
+
+	if (onRebuild)
+	{
+		for (size_t i = 0; i < handles.size(); ++i)
+			onRebuild(handles[i], results[i]);
+	}
+
+	return handles;
+}
+
+void ShaderLibrary::StartWatching()
+{
+	mWatcher.Start([this](const std::vector<std::wstring>& changedFiles) { Rebuild(changedFiles); });
+}
+
+void ShaderLibrary::StopWatching()
+{
+	mWatcher.Stop();
+}
+
+ShaderLibrary::Entry& ShaderLibrary::GetEntry(Handle handle)const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	assert(handle < mEntries.size());
+	return *mEntries[handle];
+}
+
+bool ShaderLibrary::Apply(Handle handle, const ShaderCache::Result& result, FileWatcher::uint64 readStart)
+{
+	Entry& entry = GetEntry(handle);
+
+	std::vector<std::wstring> dependencies;
+	std::vector<std::wstring> unused;
+	dependencies.push_back(entry.Request.Filename);
+	for (const std::wstring& include : result.Includes)
+	{
+		if (std::find(dependencies.begin(), dependencies.end(), include) == dependencies.end())
+			dependencies.push_back(include);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		// A failed compile may have stopped before reaching every include; keep the
+		// old edges too so fixing any of those files still triggers a rebuild.
+		if (FAILED(result.Status))
+		{
+			for (const std::wstring& dependency : entry.Dependencies)
+			{
+				if (std::find(dependencies.begin(), dependencies.end(), dependency) == dependencies.end())
+					dependencies.push_back(dependency);
+			}
+		}
+
+		for (const std::wstring& dependency : entry.Dependencies)
+		{
+			auto it = mDependents.find(dependency);
+			if (it != mDependents.end())
+			{
+				it->second.erase(handle);
+				if (it->second.empty())
+					mDependents.erase(it);
+			}
+		}
+
+		for (const std::wstring& dependency : dependencies)
+			mDependents[dependency].insert(handle);
+
+		// Old edges no shader has any more.
+		for (const std::wstring& dependency : entry.Dependencies)
+		{
+			if (mDependents.find(dependency) == mDependents.end())
+				unused.push_back(dependency);
+		}
+
+		entry.Dependencies = dependencies;
+	}
+
+	// Apply() calls are serialized, so no other call can rewatch these in between.
+	for (const std::wstring& dependency : unused)
+		mWatcher.Unwatch(dependency);
+
+	// Files already watched keep their stamps, so changes made during this rebuild are
+	// still seen by the next check. New ones written since readStart are reported too.
+	for (const std::wstring& dependency : dependencies)
+		mWatcher.Watch(dependency, readStart);
+
+	if (FAILED(result.Status))
+		return false;
+
+	std::shared_ptr<const Shader> current = std::atomic_load(&entry.Current);
+	if (current != nullptr && current->Key == result.Key)
+		return false; // Saved without a change that reaches the compiler.
+
+	auto shader = std::make_shared<Shader>();
+	shader->Bytecode = result.Bytecode;
+	shader->Key = result.Key;
+	shader->Version = current != nullptr ? current->Version + 1 : 1;
+
+	std::atomic_store(&entry.Current, std::shared_ptr<const Shader>(std::move(shader)));
+	++mGeneration;
+	return true;
+}
@@ -0,0 +1,117 @@
+//***************************************************************************************
+// ShaderLibrary.h
+//
+// Compiled shaders that follow their sources. Each shader added records the include
+// dependency graph from its last compile (source file plus every file it reached
+// through #include), and a FileWatcher tracks those files. When some change, only the
+// shaders that depend on them are recompiled, on the watcher thread with the compiles
+// spread over ThreadPool, and each new bytecode is swapped in atomically.
+//
+// Get() never waits for a rebuild: readers keep the bytecode they loaded alive, and a
+// shader that fails to recompile keeps its previous bytecode (the errors are reported
+// through the rebuild callback). GetGeneration() changes after every swap, so the
+// renderer can cheaply decide when to recreate its pipeline states.
+//***************************************************************************************
+
+#pragma once
+
+#include "FileWatcher.h"
+#include "ShaderCache.h"
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+class ThreadPool;
+
+class ShaderLibrary
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	using Handle = uint32;
+
+	struct Shader
+	{
+		std::shared_ptr<const std::vector<uint8>> Bytecode;
+		uint64 Key = 0;       // ShaderCache key of the source it was compiled from.
+		uint32 Version = 0;   // 1 for the first compile, incremented on every swap.
+	};
+
+	// Runs on the rebuilding thread once per recompiled shader (also when it failed),
+	// after the new bytecode is swapped in and without any of the library's locks held.
+	using RebuildCallback = std::function<void(Handle handle, const ShaderCache::Result& result)>;
+
+	ShaderLibrary(std::shared_ptr<ShaderCache> cache, ThreadPool* pool = nullptr, uint32 pollMilliseconds = 500);
+	~ShaderLibrary();
+
+	ShaderLibrary(const ShaderLibrary& rhs) = delete;
+	ShaderLibrary& operator=(const ShaderLibrary& rhs) = delete;
+
+	///<summary>
+	/// Compiles request now and tracks it from then on. The handle is valid even if the
+	/// compile failed (Get() returns null until a rebuild succeeds); errors receives the
+	/// compiler output.
+	///</summary>
+	Handle Add(const ShaderCompiler::Request& request, std::string* errors = nullptr);
+
+	// Latest successfully compiled bytecode; null if there is none. Does not wait for rebuilds.
+	std::shared_ptr<const Shader> Get(Handle handle)const;
+
+	const ShaderCompiler::Request& GetRequest(Handle handle)const;
+
+	// Source file and includes of the last compile attempt.
+	std::vector<std::wstring> GetDependencies(Handle handle);
+
+	// Shaders whose last compile read filename.
+	std::vector<Handle> GetDependents(const std::wstring& filename);
+
+	uint32 GetGeneration()const { return mGeneration.load(); }
+
+	void SetRebuildCallback(RebuildCallback onRebuild);
+
+	///<summary>
+	/// Recompiles the shaders depending on any of changedFiles on the calling thread
+	/// (with the compiles spread over the pool) and swaps in the results that changed.
+	/// Returns the rebuilt handles. The watcher calls this itself; call it directly to
+	/// rebuild on demand.
+	///</summary>
+	std::vector<Handle> Rebuild(const std::vector<std::wstring>& changedFiles);
+
+	// Background rebuilds when watched files change.
+	void StartWatching();
+	void StopWatching();
+
+private:
+	struct Entry
+	{
+		ShaderCompiler::Request Request;
+		std::vector<std::wstring> Dependencies;
+		std::shared_ptr<const Shader> Current; // std::atomic_load / atomic_store only.
+	};
+
+	Entry& GetEntry(Handle handle)const;
+
+	// Records the result's dependencies, watches them as read after readStart and swaps
+	// in its bytecode if it is new. Returns true if it swapped.
+	bool Apply(Handle handle, const ShaderCache::Result& result, FileWatcher::uint64 readStart);
+
+private:
+	std::shared_ptr<ShaderCache> mCache;
+	ThreadPool* mPool = nullptr;
+
+	mutable std::mutex mMutex;
+	std::vector<std::unique_ptr<Entry>> mEntries;
+	std::unordered_map<std::wstring, std::unordered_set<Handle>> mDependents;
+	RebuildCallback mOnRebuild;
+
+	// Serializes Apply() calls (Add, watcher and direct rebuilds).
+	std::mutex mRebuildMutex;
+
+	std::atomic<uint32> mGeneration{ 0 };
+
+	FileWatcher mWatcher;
+};
@@ -0,0 +1,220 @@
+//***************************************************************************************
+// SphericalHarmonics.cpp
+//***************************************************************************************
+
+#include "SphericalHarmonics.h"
+#include "MathHelper.h"
+#include "ThreadPool.h"
+#include "DDSTextureLoader.h"
+#include "d3dUtil.h"
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+const SphericalHarmonics::uint32 SphericalHarmonics::CoefficientCount;
+
+namespace
+{
+	// Face rows per projection chunk. Chunks, not threads, own the partial sums, so
+	// the sum order (and the result) is the same for any pool.
+	const size_t RowsPerChunk = 16;
+
+	// Basis normalization constants.
+	const float K0 = 0.282094792f; // 1 / (2 sqrt(pi))
+	const float K1 = 0.488602512f; // sqrt(3) / (2 sqrt(pi))
+	const float K2 = 1.092548431f; // sqrt(15) / (2 sqrt(pi))
+	const float K3 = 0.315391565f; // sqrt(5) / (4 sqrt(pi))
+	const float K4 = 0.546274215f; // sqrt(15) / (4 sqrt(pi))
+
+	// Clamped cosine convolution per band divided by pi (Lambert): 1, 2/3, 1/4.
+	const float LambertBand[3] = { 1.0f, 2.0f / 3.0f, 0.25f };
+
+	// Solid angle of the face region [0, x] x [0, y] seen from the cube center, up to
+	// sign; texel solid angles are differences of its corner values.
+	inline double AreaElement(double x, double y)
+	{
+		return atan2(x * y, sqrt(x * x + y * y + 1.0));
+	}
+
+	struct Accumulator
+	{
+		double Sum[SphericalHarmonics::CoefficientCount][3] = {};
+	};
+}
+
+void SphericalHarmonics::EvaluateBasis(FXMVECTOR direction, float basis[CoefficientCount])
+{
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, direction);
+
+	basis[0] = K0;
+	basis[1] = K1 * d.y;
+	basis[2] = K1 * d.z;
+	basis[3] = K1 * d.x;
+	basis[4] = K2 * d.x * d.y;
+	basis[5] = K2 * d.y * d.z;
+	basis[6] = K3 * (3.0f * d.z * d.z - 1.0f);
+	basis[7] = K2 * d.x * d.z;
+	basis[8] = K4 * (d.x * d.x - d.y * d.y);
+}
+
+SphericalHarmonics::SH9 SphericalHarmonics::ProjectCubeMap(const float* texels, uint32 faceSize, ThreadPool* pool)
+{
+	assert(texels != nullptr && faceSize > 0);
+
+	const size_t size = faceSize;
+	const size_t rowCount = 6 * size;
+	const size_t chunkCount = (rowCount + RowsPerChunk - 1) / RowsPerChunk;
+
+	// Texel edge and center coordinates along a face axis, in [-1, 1].
+	std::vector<double> edges(size + 1);
+	std::vector<float> centers(size);
+	for (size_t i = 0; i <= size; ++i)
+		edges[i] = 2.0 * i / size - 1.0;
+	for (size_t i = 0; i < size; ++i)
+		centers[i] = (float)(0.5 * (edges[i] + edges[i + 1]));
+
+	std::vector<Accumulator> partials(chunkCount);
+
+	auto projectChunks = [&](size_t begin, size_t end)
+	{
+		std::vector<double> top(size + 1), bottom(size + 1);
+		float basis[CoefficientCount];
+
+		for (size_t chunk = begin; chunk < end; ++chunk)
+		{
+			Accumulator& acc = partials[chunk];
+			size_t lastRow = (chunk + 1) * RowsPerChunk < rowCount ? (chunk + 1) * RowsPerChunk : rowCount;
+
+			for (size_t r = chunk * RowsPerChunk; r < lastRow; ++r)
+			{
+				size_t face = r / size, row = r % size;
+
+				// Corner area elements along this row's top and bottom edges; the same
+				// for every face.
+				for (size_t i = 0; i <= size; ++i)
+				{
+					top[i] = AreaElement(edges[i], edges[row]);
+					bottom[i] = AreaElement(edges[i], edges[row + 1]);
+				}
+
+				float rowSum[CoefficientCount][3] = {};
+				const float* texel = texels + r * size * 4;
+				for (size_t column = 0; column < size; ++column, texel += 4)
+				{
+					float solidAngle = (float)fabs(bottom[column + 1] - bottom[column] - top[column + 1] + top[column]);
+
+					XMVECTOR dir = XMVector3Normalize(MathHelper::CubeFaceDirection((int)face, centers[column], centers[row]));
+					EvaluateBasis(dir, basis);
+
+					for (uint32 i = 0; i < CoefficientCount; ++i)
+					{
+						float w = basis[i] * solidAngle;
+						rowSum[i][0] += w * texel[0];
+						rowSum[i][1] += w * texel[1];
+						rowSum[i][2] += w * texel[2];
+					}
+				}
+
+				for (uint32 i = 0; i < CoefficientCount; ++i)
+				{
+					acc.Sum[i][0] += rowSum[i][0];
+					acc.Sum[i][1] += rowSum[i][1];
+					acc.Sum[i][2] += rowSum[i][2];
+				}
+			}
+		}
+	};
+
+	if (pool == nullptr || chunkCount <= 1)
+		projectChunks(0, chunkCount);
+	else
+		pool->ParallelFor(chunkCount, 1, projectChunks);
+
+	double total[CoefficientCount][3] = {};
+	for (const Accumulator& acc : partials)
+	{
+		for (uint32 i = 0; i < CoefficientCount; ++i)
+		{
+			total[i][0] += acc.Sum[i][0];
+			total[i][1] += acc.Sum[i][1];
+			total[i][2] += acc.Sum[i][2];
+		}
+	}
+
+	SH9 sh;
+	for (uint32 i = 0; i < CoefficientCount; ++i)
+		sh.Coeffs[i] = XMFLOAT3((float)total[i][0], (float)total[i][1], (float)total[i][2]);
+
+	return sh;
+}
+
+SphericalHarmonics::SH9 SphericalHarmonics::ProjectCubeMapFromFile(const std::wstring& filename, ThreadPool* pool)
+{
+	std::vector<float> texels;
+	size_t faceSize = 0;
+	ThrowIfFailed(DirectX::LoadDDSCubeMapFromFile(filename.c_str(), texels, &faceSize));
+
+	return ProjectCubeMap(texels.data(), (uint32)faceSize, pool);
+}
+
+void SphericalHarmonics::AddDirectionalLight(SH9& sh, const XMFLOAT3& direction, const XMFLOAT3& strength)
+{
+	// A delta of radiance pi * Strength toward the light; after the 1/pi of the
+	// Lambert convolution that is Strength * max(n.l, 0).
+	float basis[CoefficientCount];
+	EvaluateBasis(XMVector3Normalize(XMVectorNegate(XMLoadFloat3(&direction))), basis);
+
+	XMVECTOR s = XMVectorScale(XMLoadFloat3(&strength), XM_PI);
+	for (uint32 i = 0; i < CoefficientCount; ++i)
+		XMStoreFloat3(&sh.Coeffs[i], XMVectorMultiplyAdd(s, XMVectorReplicate(basis[i]), XMLoadFloat3(&sh.Coeffs[i])));
+}
+
+void SphericalHarmonics::Scale(SH9& sh, float s)
+{
+	for (uint32 i = 0; i < CoefficientCount; ++i)
+		XMStoreFloat3(&sh.Coeffs[i], XMVectorScale(XMLoadFloat3(&sh.Coeffs[i]), s));
+}
+
+SphericalHarmonics::IrradianceConstants SphericalHarmonics::ToIrradianceConstants(const SH9& radiance)
+{
+	// c[i] = convolved coefficient; the shader's value is sum(c[i] * Y_i(n)) with the
+	// basis polynomials expanded into the A/B/C dot products.
+	float c[CoefficientCount][3];
+	for (uint32 i = 0; i < CoefficientCount; ++i)
+	{
+		float band = LambertBand[i == 0 ? 0 : (i < 4 ? 1 : 2)];
+		c[i][0] = radiance.Coeffs[i].x * band;
+		c[i][1] = radiance.Coeffs[i].y * band;
+		c[i][2] = radiance.Coeffs[i].z * band;
+	}
+
+	IrradianceConstants constants;
+	XMFLOAT4* a[3] = { &constants.Ar, &constants.Ag, &constants.Ab };
+	XMFLOAT4* b[3] = { &constants.Br, &constants.Bg, &constants.Bb };
+	for (int ch = 0; ch < 3; ++ch)
+	{
+		*a[ch] = XMFLOAT4(K1 * c[3][ch], K1 * c[1][ch], K1 * c[2][ch], K0 * c[0][ch] - K3 * c[6][ch]);
+		*b[ch] = XMFLOAT4(K2 * c[4][ch], K2 * c[5][ch], 3.0f * K3 * c[6][ch], K2 * c[7][ch]);
+	}
+	constants.C = XMFLOAT4(K4 * c[8][0], K4 * c[8][1], K4 * c[8][2], 0.0f);
+
+	return constants;
+}
+
+XMVECTOR SphericalHarmonics::EvaluateIrradiance(const IrradianceConstants& constants, FXMVECTOR normal)
+{
+	XMVECTOR n1 = XMVectorSetW(normal, 1.0f);
+	XMVECTOR n2 = XMVectorMultiply(XMVectorSwizzle<0, 1, 2, 2>(normal), XMVectorSwizzle<1, 2, 2, 0>(normal));
+
+	float r = XMVectorGetX(XMVector4Dot(XMLoadFloat4(&constants.Ar), n1)) + XMVectorGetX(XMVector4Dot(XMLoadFloat4(&constants.Br), n2));
+	float g = XMVectorGetX(XMVector4Dot(XMLoadFloat4(&constants.Ag), n1)) + XMVectorGetX(XMVector4Dot(XMLoadFloat4(&constants.Bg), n2));
+	float b = XMVectorGetX(XMVector4Dot(XMLoadFloat4(&constants.Ab), n1)) + XMVectorGetX(XMVector4Dot(XMLoadFloat4(&constants.Bb), n2));
+
+	float x = XMVectorGetX(normal), y = XMVectorGetY(normal);
+	XMVECTOR e = XMVectorMultiplyAdd(XMLoadFloat4(&constants.C), XMVectorReplicate(x * x - y * y), XMVectorSet(r, g, b, 0.0f));
+
+	return XMVectorMax(e, XMVectorZero());
+}
@@ -0,0 +1,86 @@
+//***************************************************************************************
+// SphericalHarmonics.h
+//
+// Projects an environment cubemap onto 9 spherical harmonic coefficients per color
+// channel (bands 0-2) and turns them into a small constant block for diffuse ambient
+// lighting: one SH evaluation per pixel instead of several fill lights out of
+// MaxLights. Band-limited to 9 coefficients, the cosine convolved irradiance is
+// within a few percent of the exact result for typical skies (Ramamoorthi and
+// Hanrahan, "An Efficient Representation for Irradiance Environment Maps").
+//
+// Units follow the lighting shader: a uniform sky of radiance L gives ambient L (so
+// ambient = result * DiffuseAlbedo like gAmbientLight), and AddDirectionalLight
+// adds a light's Strength * max(dot(n, -Direction), 0) like a directional Light entry
+// (smoothed by the band limit, which is fine for fill lights).
+//
+// HLSL evaluation of IrradianceConstants (n normalized):
+//
+//     float3 ShIrradiance(float3 n)
+//     {
+//         float4 n1 = float4(n, 1.0f);
+//         float4 n2 = n.xyzz * n.yzzx;
+//         float3 e;
+//         e.r = dot(gShAr, n1) + dot(gShBr, n2);
+//         e.g = dot(gShAg, n1) + dot(gShBg, n2);
+//         e.b = dot(gShAb, n1) + dot(gShBb, n2);
+//         return max(e + gShC.rgb * (n.x * n.x - n.y * n.y), 0.0f);
+//     }
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+
+class ThreadPool;
+
+class SphericalHarmonics
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	static const uint32 CoefficientCount = 9;
+
+	// RGB radiance coefficients for the real SH basis, in the order of EvaluateBasis.
+	struct SH9
+	{
+		DirectX::XMFLOAT3 Coeffs[CoefficientCount] = {};
+	};
+
+	///<summary>
+	/// Cosine convolved SH9 folded into 7 float4 (112 bytes, vs. 48 per Light) for the
+	/// shader at the top of this file. Lay it out in a cbuffer as-is.
+	///</summary>
+	struct IrradianceConstants
+	{
+		DirectX::XMFLOAT4 Ar, Ag, Ab; // Bands 0 and 1: dot(A, float4(n, 1)).
+		DirectX::XMFLOAT4 Br, Bg, Bb; // Band 2 except x^2 - y^2: dot(B, n.xyzz * n.yzzx).
+		DirectX::XMFLOAT4 C;          // rgb * (n.x^2 - n.y^2).
+	};
+
+	// The 9 basis functions Y00, Y1-1, Y10, Y11, Y2-2, Y2-1, Y20, Y21, Y22 at a unit direction.
+	static void EvaluateBasis(DirectX::FXMVECTOR direction, float basis[CoefficientCount]);
+
+	///<summary>
+	/// Integrates the cubemap (6 * faceSize * faceSize RGBA32F texels laid out as by
+	/// DirectX::LoadDDSCubeMapFromFile) against the basis, weighting each texel by its
+	/// exact solid angle. Face rows are split over pool; the result does not depend on
+	/// the thread count.
+	///</summary>
+	static SH9 ProjectCubeMap(const float* texels, uint32 faceSize, ThreadPool* pool = nullptr);
+
+	// Decodes a DDS cubemap (LoadDDSCubeMapFromFile) and projects it. Throws DxException.
+	static SH9 ProjectCubeMapFromFile(const std::wstring& filename, ThreadPool* pool = nullptr);
+
+	// Folds a directional light (Light::Direction is the direction it travels) into sh.
+	static void AddDirectionalLight(SH9& sh, const DirectX::XMFLOAT3& direction, const DirectX::XMFLOAT3& strength);
+
+	static void Scale(SH9& sh, float s);
+
+	static IrradianceConstants ToIrradianceConstants(const SH9& radiance);
+
+	// CPU version of the HLSL above.
+	static DirectX::XMVECTOR EvaluateIrradiance(const IrradianceConstants& constants, DirectX::FXMVECTOR normal);
+};
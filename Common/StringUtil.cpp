@@ -0,0 +1,42 @@
+//***************************************************************************************
+// StringUtil.cpp
+//***************************************************************************************
+
+#include "StringUtil.h"
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <cstdlib>
+#endif
+
+const StringUtil::uint64 StringUtil::Fnv1aSeed;
+
+std::string StringUtil::ToNarrow(const std::wstring& s)
+{
+#if defined(_WIN32)
+	int length = WideCharToMultiByte(CP_ACP, 0, s.c_str(), -1, nullptr, 0, nullptr, nullptr);
+	if (length <= 1)
+		return std::string();
+
+	std::string narrow(length, '\0');
+	WideCharToMultiByte(CP_ACP, 0, s.c_str(), -1, &narrow[0], length, nullptr, nullptr);
+	narrow.resize(length - 1);
+	return narrow;
+#else
+	std::string narrow(s.size() * MB_CUR_MAX + 1, '\0');
+	size_t length = std::wcstombs(&narrow[0], s.c_str(), narrow.size());
+	narrow.resize(length == (size_t)-1 ? 0 : length);
+	return narrow;
+#endif
+}
+
+StringUtil::uint64 StringUtil::Fnv1a(uint64 hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
@@ -0,0 +1,33 @@
+//***************************************************************************************
+// StringUtil.h
+//
+// Portable string and hashing helpers shared by the file, cache and shader code.
+// d3dUtil.h includes this; code that must also build without Windows includes it
+// directly.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class StringUtil
+{
+public:
+
+	using uint64 = std::uint64_t;
+
+	// Starting value for Fnv1a.
+	static const uint64 Fnv1aSeed = 0xcbf29ce484222325ull;
+
+	///<summary>
+	/// s in the narrow encoding the C runtime file functions expect: the ANSI code page
+	/// on Windows, the current locale elsewhere. Characters the ANSI code page lacks
+	/// become '?'; elsewhere a string that cannot be converted returns empty.
+	///</summary>
+	static std::string ToNarrow(const std::wstring& s);
+
+	// 64 bit FNV-1a of size bytes, continuing from hash (Fnv1aSeed for a new hash).
+	static uint64 Fnv1a(uint64 hash, const void* data, size_t size);
+};
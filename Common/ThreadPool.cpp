@@ -0,0 +1,150 @@
+//***************************************************************************************
+// ThreadPool.cpp
+//***************************************************************************************
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(uint32 threadCount)
+{
+	if (threadCount == 0)
+	{
+		uint32 hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (uint32 i = 0; i < threadCount; ++i)
+		mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeUp.notify_all();
+
+	for (std::thread& worker : mWorkers)
+		worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push_back(std::move(task));
+	}
+	mWakeUp.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& func)
+{
+	if (count == 0)
+		return;
+
+	grainSize = std::max<size_t>(grainSize, 1);
+	size_t chunkCount = (count + grainSize - 1) / grainSize;
+
+	if (chunkCount == 1)
+	{
+		func(0, count);
+		return;
+	}
+
+	// Helpers may start after the caller has already finished every chunk,
+	// so the shared state outlives this call.
+	struct Job
+	{
+		std::function<void(size_t, size_t)> Func;
+		size_t Count = 0;
+		size_t GrainSize = 0;
+		size_t ChunkCount = 0;
+		std::atomic<size_t> NextChunk{ 0 };
+		std::atomic<size_t> DoneChunks{ 0 };
+		std::mutex DoneMutex;
+		std::condition_variable Done;
+
+		// First exception thrown by Func; the chunks after it are skipped.
+		std::atomic<bool> Failed{ false };
+		std::exception_ptr Exception;
+
+		void Run()
+		{
+			size_t finished = 0;
+			for (size_t chunk = NextChunk++; chunk < ChunkCount; chunk = NextChunk++)
+			{
+				if (!Failed)
+				{
+					try
+					{
+						size_t begin = chunk * GrainSize;
+						Func(begin, std::min(begin + GrainSize, Count));
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(DoneMutex);
+						if (!Failed)
+						{
+							Exception = std::current_exception();
+							Failed = true;
+						}
+					}
+				}
+				++finished;
+			}
+
+			if (finished != 0 && (DoneChunks += finished) == ChunkCount)
+			{
+				std::lock_guard<std::mutex> lock(DoneMutex);
+				Done.notify_all();
+			}
+		}
+	};
+
+	auto job = std::make_shared<Job>();
+	job->Func = func;
+	job->Count = count;
+	job->GrainSize = grainSize;
+	job->ChunkCount = chunkCount;
+
+	size_t helperCount = std::min<size_t>(mWorkers.size(), chunkCount - 1);
+	for (size_t i = 0; i < helperCount; ++i)
+		Submit([job]() { job->Run(); });
+
+	job->Run();
+
+	std::unique_lock<std::mutex> lock(job->DoneMutex);
+	job->Done.wait(lock, [&job]() { return job->DoneChunks == job->ChunkCount; });
+
+	if (job->Exception)
+		std::rethrow_exception(job->Exception);
+}
+
+ThreadPool& ThreadPool::Default()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeUp.wait(lock, [this]() { return mQuit || !mTasks.empty(); });
+
+			if (mQuit && mTasks.empty())
+				return;
+
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,59 @@
+//***************************************************************************************
+// ThreadPool.h
+//
+// Persistent worker threads for data-parallel CPU work (culling, mesh processing, baking).
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	// threadCount = 0 creates one worker per hardware thread minus the calling thread.
+	explicit ThreadPool(uint32 threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+
+	// Workers plus the thread that calls ParallelFor.
+	uint32 GetConcurrency()const { return (uint32)mWorkers.size() + 1; }
+
+	// Queues a task; it runs on some worker thread later.
+	void Submit(std::function<void()> task);
+
+	///<summary>
+	/// Splits [0, count) into chunks [k*grainSize, min((k+1)*grainSize, count)) and runs
+	/// func(begin, end) for each chunk across the workers and the calling thread.
+	/// Chunk boundaries only depend on count and grainSize, so begin / grainSize can be
+	/// used to index per-chunk outputs. Returns when every chunk has finished.
+	/// If func throws, the chunks that have not started are skipped and the first
+	/// exception is rethrown on the calling thread once the running chunks are done.
+	///</summary>
+	void ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& func);
+
+	// Shared pool used when callers do not supply their own.
+	static ThreadPool& Default();
+
+private:
+	void WorkerLoop();
+
+private:
+	std::vector<std::thread> mWorkers;
+	std::deque<std::function<void()>> mTasks;
+	std::mutex mMutex;
+	std::condition_variable mWakeUp;
+	bool mQuit = false;
+};
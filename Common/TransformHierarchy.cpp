@@ -0,0 +1,326 @@
+//***************************************************************************************
+// TransformHierarchy.cpp
+//***************************************************************************************
+
+#include "TransformHierarchy.h"
+#include "MatrixBatch.h"
+#include "ThreadPool.h"
+#include <cassert>
+
+using namespace DirectX;
+
+namespace
+{
+	// Slots per ParallelFor chunk.
+	const size_t UpdateGrainSize = 1024;
+}
+
+const TransformHierarchy::NodeId TransformHierarchy::InvalidNode;
+const TransformHierarchy::uint32 TransformHierarchy::InvalidSlot;
+
+TransformHierarchy::TransformHierarchy(int numFrameResources)
+	: mNumFrameResources(numFrameResources)
+{
+}
+
+XMFLOAT4X4 TransformHierarchy::Identity()
+{
+	XMFLOAT4X4 I;
+	XMStoreFloat4x4(&I, XMMatrixIdentity());
+	return I;
+}
+
+TransformHierarchy::NodeId TransformHierarchy::CreateNode(NodeId parent, const XMFLOAT4X4& local)
+{
+	assert(parent == InvalidNode || IsAlive(parent));
+
+	NodeId node;
+	if (!mFreeNodes.empty())
+	{
+		node = mFreeNodes.back();
+		mFreeNodes.pop_back();
+	}
+	else
+	{
+		node = (NodeId)mNodes.size();
+		mNodes.emplace_back();
+	}
+
+	Node& n = mNodes[node];
+	n.Parent = parent;
+	n.Alive = true;
+	n.NumFramesDirty = 0;
+	n.Slot = (uint32)mLocal.size();
+
+	// Appended until the next RebuildOrder() moves it to its depth.
+	mLocal.push_back(local);
+	mWorld.push_back(local);
+	mParentSlot.push_back(InvalidSlot);
+	mFirstChild.push_back(0);
+	mChildCount.push_back(0);
+	mDepth.push_back(0);
+	mNodeOfSlot.push_back(node);
+
+	++mAliveCount;
+	mOrderDirty = true;
+	MarkDirty(node);
+
+	return node;
+}
+
+void TransformHierarchy::DestroyNode(NodeId node)
+{
+	assert(IsAlive(node));
+
+	mNodes[node].Alive = false;
+	mNodes[node].NumFramesDirty = 0;
+	--mAliveCount;
+	mOrderDirty = true;
+}
+
+bool TransformHierarchy::SetParent(NodeId node, NodeId parent)
+{
+	assert(IsAlive(node) && (parent == InvalidNode || IsAlive(parent)));
+
+	for (NodeId p = parent; p != InvalidNode; p = mNodes[p].Parent)
+	{
+		if (p == node)
+			return false;
+	}
+
+	if (mNodes[node].Parent != parent)
+	{
+		mNodes[node].Parent = parent;
+		mOrderDirty = true;
+		MarkDirty(node);
+	}
+
+	return true;
+}
+
+void TransformHierarchy::SetLocal(NodeId node, FXMMATRIX local)
+{
+	assert(IsAlive(node));
+
+	XMStoreFloat4x4(&mLocal[mNodes[node].Slot], local);
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetLocal(NodeId node, const XMFLOAT4X4& local)
+{
+	assert(IsAlive(node));
+
+	mLocal[mNodes[node].Slot] = local;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::MarkDirty(NodeId node)
+{
+	if (!mNodes[node].LocalDirty)
+	{
+		mNodes[node].LocalDirty = true;
+		mDirtyNodes.push_back(node);
+	}
+}
+
+void TransformHierarchy::RebuildOrder()
+{
+	// Children of every node (counting sort on the parent); roots under parent index n.
+	const uint32 n = (uint32)mNodes.size();
+	std::vector<uint32> childStart(n + 2, 0);
+	for (NodeId node = 0; node < n; ++node)
+	{
+		if (mNodes[node].Alive)
+			++childStart[(mNodes[node].Parent == InvalidNode ? n : mNodes[node].Parent) + 1];
+	}
+	for (uint32 i = 0; i <= n; ++i)
+		childStart[i + 1] += childStart[i];
+
+	std::vector<NodeId> children(childStart[n + 1]);
+	std::vector<uint32> fill(childStart.begin(), childStart.end() - 1);
+	for (NodeId node = 0; node < n; ++node)
+	{
+		if (mNodes[node].Alive)
+			children[fill[mNodes[node].Parent == InvalidNode ? n : mNodes[node].Parent]++] = node;
+	}
+
+	// Breadth first from the roots. Nodes under a destroyed node are never reached and
+	// are released with it.
+	std::vector<NodeId> order(children.begin() + childStart[n], children.end());
+	order.reserve(children.size());
+
+	std::vector<XMFLOAT4X4> local, world;
+	std::vector<uint32> parentSlot, firstChild, childCount, depth;
+	local.reserve(order.capacity());
+	world.reserve(order.capacity());
+	parentSlot.assign(order.size(), InvalidSlot);
+	depth.assign(order.size(), 0);
+
+	mLevelStart.clear();
+	for (uint32 slot = 0; slot < order.size(); ++slot)
+	{
+		NodeId node = order[slot];
+		Node& nd = mNodes[node];
+
+		if (depth[slot] == mLevelStart.size())
+			mLevelStart.push_back(slot);
+
+		local.push_back(mLocal[nd.Slot]);
+		world.push_back(mWorld[nd.Slot]);
+
+		firstChild.push_back((uint32)order.size());
+		childCount.push_back(childStart[node + 1] - childStart[node]);
+		for (uint32 c = childStart[node]; c < childStart[node + 1]; ++c)
+		{
+			order.push_back(children[c]);
+			parentSlot.push_back(slot);
+			depth.push_back(depth[slot] + 1);
+		}
+	}
+	mLevelStart.push_back((uint32)order.size());
+
+	// Release everything that was not reached.
+	std::vector<uint8> reached(n, 0);
+	for (NodeId node : order)
+		reached[node] = 1;
+	for (NodeId node = 0; node < n; ++node)
+	{
+		Node& nd = mNodes[node];
+		if (nd.Slot == InvalidSlot || reached[node])
+			continue;
+
+		if (nd.Alive)
+			--mAliveCount;
+		nd.Alive = false;
+		nd.Slot = InvalidSlot;
+		nd.NumFramesDirty = 0;
+		mFreeNodes.push_back(node);
+	}
+
+	for (uint32 slot = 0; slot < order.size(); ++slot)
+		mNodes[order[slot]].Slot = slot;
+
+	mLocal.swap(local);
+	mWorld.swap(world);
+	mParentSlot.swap(parentSlot);
+	mFirstChild.swap(firstChild);
+	mChildCount.swap(childCount);
+	mDepth.swap(depth);
+	mNodeOfSlot.swap(order);
+
+	mOrderDirty = false;
+}
+
+TransformHierarchy::uint32 TransformHierarchy::Update(ThreadPool* pool)
+{
+	if (mOrderDirty)
+		RebuildOrder();
+
+	mUpdated.resize(mLocal.size(), 0);
+	mLevelSlots.resize(GetDepthCount());
+
+	// Explicitly dirty nodes by depth.
+	for (std::vector<uint32>& slots : mLevelSlots)
+		slots.clear();
+	for (NodeId node : mDirtyNodes)
+	{
+		Node& nd = mNodes[node];
+		nd.LocalDirty = false;
+		if (nd.Alive)
+			mLevelSlots[mDepth[nd.Slot]].push_back(nd.Slot);
+	}
+	mDirtyNodes.clear();
+
+	uint32 updatedCount = 0;
+	for (uint32 d = 0; d < GetDepthCount(); ++d)
+	{
+		std::vector<uint32>& slots = mLevelSlots[d];
+
+		// Whole sibling ranges below every node recomputed one level up; explicit nodes
+		// whose parent was recomputed are already in them.
+		if (d > 0)
+		{
+			std::vector<uint32> level;
+			for (uint32 slot : slots)
+			{
+				if (!mUpdated[mParentSlot[slot]])
+					level.push_back(slot);
+			}
+			for (uint32 parent : mLevelSlots[d - 1])
+			{
+				for (uint32 c = 0; c < mChildCount[parent]; ++c)
+					level.push_back(mFirstChild[parent] + c);
+			}
+			slots.swap(level);
+		}
+
+		auto updateRange = [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				uint32 slot = slots[i];
+				uint32 parent = mParentSlot[slot];
+
+				XMMATRIX W = XMLoadFloat4x4(&mLocal[slot]);
+				if (parent != InvalidSlot)
+					W = XMMatrixMultiply(W, XMLoadFloat4x4(&mWorld[parent]));
+
+				XMStoreFloat4x4(&mWorld[slot], W);
+				mUpdated[slot] = 1;
+			}
+		};
+
+		if (pool == nullptr || slots.size() <= UpdateGrainSize)
+			updateRange(0, slots.size());
+		else
+			pool->ParallelFor(slots.size(), UpdateGrainSize, updateRange);
+
+		updatedCount += (uint32)slots.size();
+	}
+
+	// Restart the NumFramesDirty count of every changed node and clear the scratch flags.
+	for (const std::vector<uint32>& slots : mLevelSlots)
+	{
+		for (uint32 slot : slots)
+		{
+			mUpdated[slot] = 0;
+
+			Node& nd = mNodes[mNodeOfSlot[slot]];
+			nd.NumFramesDirty = mNumFrameResources;
+			if (!nd.InChangedList)
+			{
+				nd.InChangedList = true;
+				mChangedNodes.push_back(mNodeOfSlot[slot]);
+			}
+		}
+	}
+
+	return updatedCount;
+}
+
+void TransformHierarchy::CollectChanged(std::vector<NodeId>& changed)
+{
+	size_t kept = 0;
+	for (NodeId node : mChangedNodes)
+	{
+		Node& nd = mNodes[node];
+		if (nd.Alive && nd.NumFramesDirty > 0)
+		{
+			changed.push_back(node);
+			--nd.NumFramesDirty;
+		}
+
+		if (nd.Alive && nd.NumFramesDirty > 0)
+			mChangedNodes[kept++] = node;
+		else
+			nd.InChangedList = false;
+	}
+	mChangedNodes.resize(kept);
+}
+
+void TransformHierarchy::GatherWorlds(const NodeId* nodes, size_t count, MatrixSoA& out) const
+{
+	out.Resize(count);
+	for (size_t i = 0; i < count; ++i)
+		out.Set(i, GetWorld(nodes[i]));
+}
@@ -0,0 +1,120 @@
+//***************************************************************************************
+// TransformHierarchy.h
+//
+// Parent / child transforms stored data oriented: local and world matrices, parents
+// and child ranges live in parallel arrays sorted by depth (breadth first, so siblings
+// are contiguous and every parent comes before its children). Update() recomputes
+// world = local * parentWorld only for nodes whose local changed and their subtrees,
+// one depth level at a time, each level's sibling ranges split over the ThreadPool.
+//
+// Nodes whose world changed stay in the changed list for numFrameResources frames,
+// like Material::NumFramesDirty, so every frame resource's object constants get updated.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+class MatrixSoA;
+class ThreadPool;
+
+class TransformHierarchy
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using NodeId = uint32;
+
+	static const NodeId InvalidNode = 0xffffffff;
+
+	explicit TransformHierarchy(int numFrameResources);
+
+	// Ids are reused after a node is destroyed and an Update() has run.
+	NodeId CreateNode(NodeId parent = InvalidNode, const DirectX::XMFLOAT4X4& local = Identity());
+
+	// Destroys node and its whole subtree (the subtree's ids are released at the next Update()).
+	void DestroyNode(NodeId node);
+
+	// Keeps the local transform. Returns false (and changes nothing) if parent is in node's subtree.
+	bool SetParent(NodeId node, NodeId parent);
+
+	void SetLocal(NodeId node, DirectX::FXMMATRIX local);
+	void SetLocal(NodeId node, const DirectX::XMFLOAT4X4& local);
+
+	bool IsAlive(NodeId node) const { return node < mNodes.size() && mNodes[node].Alive; }
+	NodeId GetParent(NodeId node) const { return mNodes[node].Parent; }
+	const DirectX::XMFLOAT4X4& GetLocal(NodeId node) const { return mLocal[mNodes[node].Slot]; }
+
+	// World transform as of the last Update().
+	const DirectX::XMFLOAT4X4& GetWorld(NodeId node) const { return mWorld[mNodes[node].Slot]; }
+
+	uint32 GetNodeCount() const { return mAliveCount; }
+	uint32 GetDepthCount() const { return mLevelStart.empty() ? 0 : (uint32)mLevelStart.size() - 1; }
+
+	///<summary>
+	/// Recomputes the world transform of every node whose local transform or parent
+	/// changed since the last Update(), and of their descendants. Returns how many world
+	/// transforms were recomputed.
+	///</summary>
+	uint32 Update(ThreadPool* pool = nullptr);
+
+	///<summary>
+	/// Call once per frame after Update(): appends the nodes whose object constants are
+	/// stale in the current frame resource (world changed in one of the last
+	/// numFrameResources frames) and counts their NumFramesDirty down.
+	///</summary>
+	void CollectChanged(std::vector<NodeId>& changed);
+
+	// out[i] = GetWorld(nodes[i]), e.g. for MatrixBatch::WriteObjectConstants.
+	void GatherWorlds(const NodeId* nodes, size_t count, MatrixSoA& out) const;
+
+private:
+	static const uint32 InvalidSlot = 0xffffffff;
+
+	static DirectX::XMFLOAT4X4 Identity();
+
+	struct Node
+	{
+		NodeId Parent = InvalidNode;
+		uint32 Slot = InvalidSlot;
+		int NumFramesDirty = 0;
+		bool Alive = false;
+		bool LocalDirty = false; // In mDirtyNodes.
+		bool InChangedList = false;
+	};
+
+	void MarkDirty(NodeId node);
+	void RebuildOrder();
+
+private:
+	int mNumFrameResources;
+
+	// Indexed by NodeId.
+	std::vector<Node> mNodes;
+	std::vector<NodeId> mFreeNodes;
+	uint32 mAliveCount = 0;
+
+	// Indexed by slot, depth sorted once the order is rebuilt. Created nodes are
+	// appended and destroyed ones left in place until then.
+	std::vector<DirectX::XMFLOAT4X4> mLocal;
+	std::vector<DirectX::XMFLOAT4X4> mWorld;
+	std::vector<uint32> mParentSlot;
+	std::vector<uint32> mFirstChild;
+	std::vector<uint32> mChildCount;
+	std::vector<uint32> mDepth;
+	std::vector<NodeId> mNodeOfSlot;
+
+	// Slots [mLevelStart[d], mLevelStart[d + 1]) have depth d.
+	std::vector<uint32> mLevelStart;
+	bool mOrderDirty = false;
+
+	std::vector<NodeId> mDirtyNodes;
+	std::vector<NodeId> mChangedNodes;
+
+	// Update() scratch: slots recomputed per level, and 1 for slots recomputed this Update().
+	std::vector<std::vector<uint32>> mLevelSlots;
+	std::vector<uint8> mUpdated;
+};
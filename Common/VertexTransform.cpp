@@ -0,0 +1,250 @@
+//***************************************************************************************
+// VertexTransform.cpp
+//***************************************************************************************
+
+#include "VertexTransform.h"
+#include "MathHelper.h"
+#include "ThreadPool.h"
+#include <cassert>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	// Vertices per ParallelFor chunk.
+	const size_t TransformGrainSize = 4096;
+
+	// Vertices copied and transformed together, so the three attribute passes hit L1/L2.
+	const size_t TransformBlockSize = 512;
+
+	const size_t VertexStride = sizeof(GeometryGenerator::Vertex);
+
+	void Renormalize(GeometryGenerator::Vertex* v, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			XMStoreFloat3(&v[i].Normal, XMVector3Normalize(XMLoadFloat3(&v[i].Normal)));
+			XMStoreFloat3(&v[i].TangentU, XMVector3Normalize(XMLoadFloat3(&v[i].TangentU)));
+		}
+	}
+
+	// Blends the bone matrices once, so each attribute is transformed by the result;
+	// by linearity this equals the weighted sum of the per-bone transforms.
+	XMMATRIX BlendBones(const VertexTransform::SkinWeights& sw, const XMFLOAT4X4* boneTransforms, size_t boneCount)
+	{
+		float w[4] = { sw.BoneWeights.x, sw.BoneWeights.y, sw.BoneWeights.z, 0.0f };
+		w[3] = 1.0f - w[0] - w[1] - w[2];
+
+		assert(sw.BoneIndices[0] < boneCount);
+		XMMATRIX M = XMLoadFloat4x4(&boneTransforms[sw.BoneIndices[0]]);
+		XMVECTOR w0 = XMVectorReplicate(w[0]);
+		M.r[0] = XMVectorMultiply(M.r[0], w0);
+		M.r[1] = XMVectorMultiply(M.r[1], w0);
+		M.r[2] = XMVectorMultiply(M.r[2], w0);
+		M.r[3] = XMVectorMultiply(M.r[3], w0);
+
+		for (int j = 1; j < 4; ++j)
+		{
+			assert(sw.BoneIndices[j] < boneCount);
+			XMMATRIX B = XMLoadFloat4x4(&boneTransforms[sw.BoneIndices[j]]);
+			XMVECTOR wj = XMVectorReplicate(w[j]);
+			M.r[0] = XMVectorMultiplyAdd(B.r[0], wj, M.r[0]);
+			M.r[1] = XMVectorMultiplyAdd(B.r[1], wj, M.r[1]);
+			M.r[2] = XMVectorMultiplyAdd(B.r[2], wj, M.r[2]);
+			M.r[3] = XMVectorMultiplyAdd(B.r[3], wj, M.r[3]);
+		}
+
+		(void)boneCount;
+		return M;
+	}
+
+	// x, y and z of four vertices.
+	struct SoAVector3
+	{
+		XMVECTOR X;
+		XMVECTOR Y;
+		XMVECTOR Z;
+	};
+
+	// first points at an attribute of the first of four consecutive vertices.
+	SoAVector3 LoadSoA(const XMFLOAT3* first)
+	{
+		const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(first);
+		XMMATRIX m = XMMatrixTranspose(XMMATRIX(
+			XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(p)),
+			XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(p + VertexStride)),
+			XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(p + 2 * VertexStride)),
+			XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(p + 3 * VertexStride))));
+		return { m.r[0], m.r[1], m.r[2] };
+	}
+
+	void StoreSoA(XMFLOAT3* first, const SoAVector3& v)
+	{
+		std::uint8_t* p = reinterpret_cast<std::uint8_t*>(first);
+		XMMATRIX m = XMMatrixTranspose(XMMATRIX(v.X, v.Y, v.Z, XMVectorZero()));
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(p), m.r[0]);
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(p + VertexStride), m.r[1]);
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(p + 2 * VertexStride), m.r[2]);
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(p + 3 * VertexStride), m.r[3]);
+	}
+
+	// v * M for four vertices, with T[r].r[c] holding element (r, c) of each M.
+	SoAVector3 TransformSoA(const SoAVector3& v, const XMMATRIX* T, bool point)
+	{
+		SoAVector3 result;
+		XMVECTOR* out[3] = { &result.X, &result.Y, &result.Z };
+		for (int c = 0; c < 3; ++c)
+		{
+			XMVECTOR r = point ? T[3].r[c] : XMVectorZero();
+			r = XMVectorMultiplyAdd(v.X, T[0].r[c], r);
+			r = XMVectorMultiplyAdd(v.Y, T[1].r[c], r);
+			r = XMVectorMultiplyAdd(v.Z, T[2].r[c], r);
+			*out[c] = r;
+		}
+		return result;
+	}
+
+	// Like XMVector3Normalize, zero length vectors stay zero.
+	SoAVector3 NormalizeSoA(const SoAVector3& v)
+	{
+		XMVECTOR lengthSq = XMVectorMultiply(v.X, v.X);
+		lengthSq = XMVectorMultiplyAdd(v.Y, v.Y, lengthSq);
+		lengthSq = XMVectorMultiplyAdd(v.Z, v.Z, lengthSq);
+
+		XMVECTOR scale = XMVectorReciprocalSqrt(lengthSq);
+		scale = XMVectorSelect(scale, XMVectorZero(), XMVectorEqual(lengthSq, XMVectorZero()));
+
+		return { XMVectorMultiply(v.X, scale), XMVectorMultiply(v.Y, scale), XMVectorMultiply(v.Z, scale) };
+	}
+}
+
+void VertexTransform::Transform(const GeometryGenerator::Vertex* src, GeometryGenerator::Vertex* dst, size_t count,
+	FXMMATRIX world, ThreadPool* pool)
+{
+	XMMATRIX W = world;
+	XMMATRIX normalMatrix = MathHelper::InverseTranspose(W);
+
+	if (pool == nullptr || count <= TransformGrainSize)
+	{
+		TransformRange(src, dst, count, W, normalMatrix);
+		return;
+	}
+
+	pool->ParallelFor(count, TransformGrainSize, [&](size_t begin, size_t end)
+	{
+		TransformRange(src + begin, dst + begin, end - begin, W, normalMatrix);
+	});
+}
+
+void VertexTransform::Transform(const GeometryGenerator::MeshData& src, GeometryGenerator::MeshData& dst,
+	FXMMATRIX world, ThreadPool* pool)
+{
+	if (&src != &dst)
+	{
+		dst.Vertices.resize(src.Vertices.size());
+		dst.Indices32 = src.Indices32;
+	}
+
+	Transform(src.Vertices.data(), dst.Vertices.data(), src.Vertices.size(), world, pool);
+}
+
+void VertexTransform::TransformPositions(const GeometryGenerator::Vertex* src, size_t count,
+	FXMMATRIX world, XMFLOAT3* dstPositions, ThreadPool* pool)
+{
+	XMMATRIX W = world;
+
+	auto transformRange = [&](size_t begin, size_t end)
+	{
+		XMVector3TransformCoordStream(dstPositions + begin, sizeof(XMFLOAT3),
+			&src[begin].Position, VertexStride, end - begin, W);
+	};
+
+	if (pool == nullptr || count <= TransformGrainSize)
+		transformRange(0, count);
+	else
+		pool->ParallelFor(count, TransformGrainSize, transformRange);
+}
+
+void VertexTransform::Skin(const GeometryGenerator::Vertex* src, const SkinWeights* weights, GeometryGenerator::Vertex* dst,
+	size_t count, const XMFLOAT4X4* boneTransforms, size_t boneCount, ThreadPool* pool)
+{
+	if (pool == nullptr || count <= TransformGrainSize)
+	{
+		SkinRange(src, weights, dst, count, boneTransforms, boneCount);
+		return;
+	}
+
+	pool->ParallelFor(count, TransformGrainSize, [&](size_t begin, size_t end)
+	{
+		SkinRange(src + begin, weights + begin, dst + begin, end - begin, boneTransforms, boneCount);
+	});
+}
+
+void VertexTransform::TransformRange(const GeometryGenerator::Vertex* src, GeometryGenerator::Vertex* dst, size_t count,
+	FXMMATRIX world, CXMMATRIX normalMatrix)
+{
+	for (size_t first = 0; first < count; first += TransformBlockSize)
+	{
+		size_t n = count - first < TransformBlockSize ? count - first : TransformBlockSize;
+		GeometryGenerator::Vertex* v = dst + first;
+
+		// Copy first (TexC comes along), then transform each attribute in place.
+		if (src != dst)
+			std::memcpy(v, src + first, n * VertexStride);
+
+		XMVector3TransformCoordStream(&v->Position, VertexStride, &v->Position, VertexStride, n, world);
+		XMVector3TransformNormalStream(&v->Normal, VertexStride, &v->Normal, VertexStride, n, normalMatrix);
+		XMVector3TransformNormalStream(&v->TangentU, VertexStride, &v->TangentU, VertexStride, n, world);
+
+		Renormalize(v, n);
+	}
+}
+
+void VertexTransform::SkinRange(const GeometryGenerator::Vertex* src, const SkinWeights* weights, GeometryGenerator::Vertex* dst,
+	size_t count, const XMFLOAT4X4* boneTransforms, size_t boneCount)
+{
+	size_t i = 0;
+
+	// Four vertices at a time in SoA form: every vector holds one component of four
+	// vertices, so each transform is 9-12 multiply-adds for all four and the
+	// normalizations share one reciprocal square root.
+	for (; i + 4 <= count; i += 4)
+	{
+		XMMATRIX M[4];
+		for (int k = 0; k < 4; ++k)
+			M[k] = BlendBones(weights[i + k], boneTransforms, boneCount);
+
+		// Rows r of the four blended matrices, transposed: T[r].r[c] = M[0..3](r, c).
+		XMMATRIX T[4];
+		for (int r = 0; r < 4; ++r)
+			T[r] = XMMatrixTranspose(XMMATRIX(M[0].r[r], M[1].r[r], M[2].r[r], M[3].r[r]));
+
+		SoAVector3 pos = LoadSoA(&src[i].Position);
+		SoAVector3 normal = LoadSoA(&src[i].Normal);
+		SoAVector3 tangent = LoadSoA(&src[i].TangentU);
+
+		XMFLOAT2 texC[4] = { src[i].TexC, src[i + 1].TexC, src[i + 2].TexC, src[i + 3].TexC };
+
+		StoreSoA(&dst[i].Position, TransformSoA(pos, T, true));
+		StoreSoA(&dst[i].Normal, NormalizeSoA(TransformSoA(normal, T, false)));
+		StoreSoA(&dst[i].TangentU, NormalizeSoA(TransformSoA(tangent, T, false)));
+
+		for (int k = 0; k < 4; ++k)
+			dst[i + k].TexC = texC[k];
+	}
+
+	for (; i < count; ++i)
+	{
+		XMMATRIX M = BlendBones(weights[i], boneTransforms, boneCount);
+
+		XMVECTOR pos = XMVector3Transform(XMLoadFloat3(&src[i].Position), M);
+		XMVECTOR normal = XMVector3TransformNormal(XMLoadFloat3(&src[i].Normal), M);
+		XMVECTOR tangent = XMVector3TransformNormal(XMLoadFloat3(&src[i].TangentU), M);
+
+		XMStoreFloat3(&dst[i].Position, pos);
+		XMStoreFloat3(&dst[i].Normal, XMVector3Normalize(normal));
+		XMStoreFloat3(&dst[i].TangentU, XMVector3Normalize(tangent));
+		dst[i].TexC = src[i].TexC;
+	}
+}
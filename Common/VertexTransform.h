@@ -0,0 +1,65 @@
+//***************************************************************************************
+// VertexTransform.h
+//
+// Batched CPU transforms of GeometryGenerator::Vertex streams, for physics proxies and
+// baked (pre-transformed) instances. Positions, normals and tangents are transformed
+// with the DirectXMath stream functions straight over the interleaved Vertex stride
+// instead of one XMVector3Transform per vertex per attribute.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include "GeometryGenerator.h"
+
+class ThreadPool;
+
+class VertexTransform
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	// Same layout as the skinning part of a skinned vertex: the 4th weight is
+	// 1 - (x + y + z).
+	struct SkinWeights
+	{
+		DirectX::XMFLOAT3 BoneWeights = { 1.0f, 0.0f, 0.0f };
+		uint8 BoneIndices[4] = { 0, 0, 0, 0 };
+	};
+
+	///<summary>
+	/// dst[i] = src[i] with Position transformed as a point by world, Normal by the
+	/// inverse-transpose of world and TangentU as a direction by world. Normals and
+	/// tangents are renormalized so scaled worlds still give unit vectors.
+	/// src and dst may be the same array.
+	///</summary>
+	static void Transform(const GeometryGenerator::Vertex* src, GeometryGenerator::Vertex* dst, size_t count,
+		DirectX::FXMMATRIX world, ThreadPool* pool = nullptr);
+
+	// Transforms every vertex of src into dst and copies the indices.
+	static void Transform(const GeometryGenerator::MeshData& src, GeometryGenerator::MeshData& dst,
+		DirectX::FXMMATRIX world, ThreadPool* pool = nullptr);
+
+	// Transforms positions only, into a tightly packed array (e.g. a physics proxy).
+	static void TransformPositions(const GeometryGenerator::Vertex* src, size_t count,
+		DirectX::FXMMATRIX world, DirectX::XMFLOAT3* dstPositions, ThreadPool* pool = nullptr);
+
+	///<summary>
+	/// Linear blend skinning with up to 4 bones per vertex: each attribute is the weighted
+	/// sum of the attribute transformed by every influencing bone (normals and tangents
+	/// by the bone's upper 3x3, so bones must not scale non-uniformly). Every bone index
+	/// must be less than boneCount. src and dst may be the same array.
+	///</summary>
+	static void Skin(const GeometryGenerator::Vertex* src, const SkinWeights* weights, GeometryGenerator::Vertex* dst,
+		size_t count, const DirectX::XMFLOAT4X4* boneTransforms, size_t boneCount, ThreadPool* pool = nullptr);
+
+private:
+	static void TransformRange(const GeometryGenerator::Vertex* src, GeometryGenerator::Vertex* dst, size_t count,
+		DirectX::FXMMATRIX world, DirectX::CXMMATRIX normalMatrix);
+
+	static void SkinRange(const GeometryGenerator::Vertex* src, const SkinWeights* weights, GeometryGenerator::Vertex* dst,
+		size_t count, const DirectX::XMFLOAT4X4* boneTransforms, size_t boneCount);
+};
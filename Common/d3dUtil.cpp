@@ -1,9 +1,20 @@
 #include "d3dUtil.h"
+#include "MappedFileBlob.h"
+#include "D3DShaderCompiler.h"
+#include "ThreadPool.h"
 #include <comdef.h>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+	// Accessed with std::atomic_load / atomic_store.
+	std::shared_ptr<ShaderCache> gShaderCache;
+}
+
 DxException::DxException(HRESULT hr, const std::wstring& functionName, const std::wstring & fileName, const int lineNumber) :
 	ErrorCode(hr),
 	FunctionName(functionName),
@@ -19,19 +30,83 @@ bool d3dUtil::IsKeyDown(int vkeyCode)
 
 Microsoft::WRL::ComPtr<ID3DBlob> d3dUtil::LoadBinary(const std::wstring & filename)
 {
-	std::fstream fin(filename, std::ios::binary);
+	// Mapped, not read: the blob is the file's pages, loaded when first touched.
+	ComPtr<ID3DBlob> blob;
+	ThrowIfFailed(MappedFileBlob::Create(filename, blob.GetAddressOf()));
 
-	fin.seekg(0, std::ios_base::end);
-	std::ifstream::pos_type size = (int)fin.tellg(); // bytesize of file
-	fin.seekg(0, std::ios_base::beg);
+	return blob;
+}
 
-	ComPtr<ID3DBlob> blob;
-	ThrowIfFailed(D3DCreateBlob(size, blob.GetAddressOf()));
+std::future<Microsoft::WRL::ComPtr<ID3DBlob>> d3dUtil::LoadBinaryAsync(const std::wstring& filename,
+	AsyncFileIO::Priority priority, AsyncFileIO* io)
+{
+	if (io == nullptr)
+		io = &AsyncFileIO::Default();
 
-	fin.read((char*)blob->GetBufferPointer(), size);
-	fin.close();
+	auto promise = std::make_shared<std::promise<ComPtr<ID3DBlob>>>();
+	std::future<ComPtr<ID3DBlob>> future = promise->get_future();
 
-	return blob;
+	io->Submit(priority, [filename, promise]()
+	{
+		try
+		{
+			ComPtr<ID3DBlob> blob;
+			ThrowIfFailed(MappedFileBlob::Create(filename, blob.GetAddressOf(), true));
+			promise->set_value(blob);
+		}
+		catch (...)
+		{
+			promise->set_exception(std::current_exception());
+		}
+	});
+
+	return future;
+}
+
+void d3dUtil::LoadTextures(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+	Texture* const* textures, size_t count, AsyncFileIO* io)
+{
+	if (io == nullptr)
+		io = &AsyncFileIO::Default();
+
+	// Shared with the I/O threads, which may still be finishing reads if this throws.
+	struct Completions
+	{
+		std::mutex Mutex;
+		std::condition_variable Ready;
+		std::deque<std::pair<size_t, AsyncFileIO::Result>> Results;
+	};
+	auto completions = std::make_shared<Completions>();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		io->Read(textures[i]->Filename, AsyncFileIO::Priority::Normal, [completions, i](AsyncFileIO::Result& result)
+		{
+			{
+				std::lock_guard<std::mutex> lock(completions->Mutex);
+				completions->Results.emplace_back(i, std::move(result));
+			}
+			completions->Ready.notify_one();
+		});
+	}
+
+	for (size_t done = 0; done < count; ++done)
+	{
+		std::pair<size_t, AsyncFileIO::Result> completed;
+		{
+			std::unique_lock<std::mutex> lock(completions->Mutex);
+			completions->Ready.wait(lock, [&completions]() { return !completions->Results.empty(); });
+			completed = std::move(completions->Results.front());
+			completions->Results.pop_front();
+		}
+
+		Texture* texture = textures[completed.first];
+		const AsyncFileIO::Result& result = completed.second;
+
+		ThrowIfFailed(result.Status);
+		ThrowIfFailed(DirectX::CreateDDSTextureFromMemory12(device, cmdList, result.Data.data(), result.Data.size(),
+			texture->Resource, texture->UploadHeap));
+	}
 }
 
 Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefalutBuffer(
@@ -85,19 +160,87 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefalutBuffer(
 	return defalutBffer;
 }
 
+Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateUploadBuffer(
+	ID3D12Device* device,
+	UINT64 byteSize,
+	void** mappedData)
+{
+	ComPtr<ID3D12Resource> uploadBuffer;
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(uploadBuffer.GetAddressOf())));
+
+	// The CPU never reads this memory, so an empty read range is passed.
+	CD3DX12_RANGE readRange(0, 0);
+	ThrowIfFailed(uploadBuffer->Map(0, &readRange, mappedData));
+
+	return uploadBuffer;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBufferFromUpload(
+	ID3D12Device* device,
+	ID3D12GraphicsCommandList* cmdList,
+	ID3D12Resource* uploadBuffer,
+	UINT64 uploadOffset,
+	UINT64 byteSize)
+{
+	ComPtr<ID3D12Resource> defaultBuffer;
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+
+	// Unlike CreateDefalutBuffer there is no UpdateSubresources memcpy:
+	// the data is already in the upload heap, so only the GPU copy remains.
+	cmdList->CopyBufferRegion(defaultBuffer.Get(), 0, uploadBuffer, uploadOffset, byteSize);
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+
+	return defaultBuffer;
+}
+
 Microsoft::WRL::ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	const std::wstring& filename,
 	const D3D_SHADER_MACRO* defines,
 	const std::string& entrypoint,
 	const std::string& target)
 {
-	UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)  
-	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
+	UINT compileFlags = GetShaderCompileFlags();
 
 	HRESULT hr = S_OK;
 
+	std::shared_ptr<ShaderCache> cache = GetShaderCache();
+	if (cache != nullptr)
+	{
+		ShaderCompiler::Request request;
+		request.Filename = filename;
+		for (const D3D_SHADER_MACRO* define = defines; define != nullptr && define->Name != nullptr; ++define)
+			request.Defines.push_back({ define->Name, define->Definition != nullptr ? define->Definition : "" });
+		request.EntryPoint = entrypoint;
+		request.Target = target;
+		request.Flags = compileFlags;
+
+		ShaderCache::Result result = cache->Compile(request);
+		if (!result.Errors.empty())
+			OutputDebugStringA(result.Errors.c_str());
+
+		ThrowIfFailed(result.Status);
+
+		ComPtr<ID3DBlob> byteCode;
+		ThrowIfFailed(D3DCreateBlob(result.Bytecode->size(), byteCode.GetAddressOf()));
+		memcpy(byteCode->GetBufferPointer(), result.Bytecode->data(), result.Bytecode->size());
+		return byteCode;
+	}
+
 	ComPtr<ID3DBlob> byteCode = nullptr;
 	ComPtr<ID3DBlob> errors;
 	hr = D3DCompileFromFile(filename.c_str(), defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
@@ -111,6 +254,34 @@ Microsoft::WRL::ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	return byteCode;
 }
 
+void d3dUtil::SetShaderCache(std::shared_ptr<ShaderCache> cache)
+{
+	std::atomic_store(&gShaderCache, std::move(cache));
+}
+
+std::shared_ptr<ShaderCache> d3dUtil::GetShaderCache()
+{
+	return std::atomic_load(&gShaderCache);
+}
+
+UINT d3dUtil::GetShaderCompileFlags()
+{
+	UINT compileFlags = 0;
+#if defined(DEBUG) || defined(_DEBUG)  
+	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+	return compileFlags;
+}
+
+ShaderBatchCompiler::Report d3dUtil::CompileShaders(const std::vector<ShaderCompiler::Request>& jobs, ThreadPool* pool)
+{
+	std::shared_ptr<ShaderCache> cache = GetShaderCache();
+	if (cache == nullptr)
+		cache = std::make_shared<ShaderCache>(std::make_shared<D3DShaderCompiler>(), L"");
+
+	return ShaderBatchCompiler::Compile(*cache, jobs, pool != nullptr ? pool : &ThreadPool::Default());
+}
+
 std::wstring DxException::ToString() const
 {
 	// error code   ϴ.
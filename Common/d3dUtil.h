@@ -24,6 +24,7 @@
 #include <cstdint>
 #include <fstream>
 #include <sstream> // string stream
+#include <future>
 #include <cassert> // return error message in source file.
 
 // Ʒ   includeϱ ؼ
@@ -32,6 +33,9 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
+#include "AsyncFileIO.h"
+#include "ShaderBatchCompiler.h"
+#include "StringUtil.h"
 
 extern const int gNumFrameResources;
 
@@ -66,6 +70,9 @@ inline std::wstring AnsiToWString(const std::string& str)
 	return std::wstring(buffer);
 }
 
+struct Texture;
+class ThreadPool;
+
 class d3dUtil
 {
 public:
@@ -89,8 +96,23 @@ public:
 		return (byteSize + 255) & ~255;
 	}
 
+	// Blob over the copy-on-write mapped file (MappedFileBlob); throws DxException on failure.
 	static Microsoft::WRL::ComPtr<ID3DBlob> LoadBinary(const std::wstring& filename);
 
+	// Maps and pages in filename on an I/O thread (AsyncFileIO::Default() when io is null).
+	// get() returns the blob or rethrows the DxException.
+	static std::future<Microsoft::WRL::ComPtr<ID3DBlob>> LoadBinaryAsync(const std::wstring& filename,
+		AsyncFileIO::Priority priority = AsyncFileIO::Priority::Normal, AsyncFileIO* io = nullptr);
+
+	///<summary>
+	/// Loads the DDS file of each texture into its Resource, recording the upload on cmdList
+	/// (UploadHeap must live until it executes). Every read is queued on io up front; the
+	/// textures are created on the calling thread in the order the reads complete.
+	/// Throws DxException if a file cannot be read or created.
+	///</summary>
+	static void LoadTextures(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+		Texture* const* textures, size_t count, AsyncFileIO* io = nullptr);
+
 	static Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefalutBuffer(
 		ID3D12Device* device,
 		ID3D12GraphicsCommandList* cmdList,
@@ -98,11 +120,45 @@ public:
 		UINT64 byteSize,
 		Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
 
+	// Creates a persistently mapped upload buffer. Data written through *mappedData
+	// (e.g. by a MeshStreamWriter) can be copied with CreateDefaultBufferFromUpload
+	// without first staging it in an ID3DBlob.
+	static Microsoft::WRL::ComPtr<ID3D12Resource> CreateUploadBuffer(
+		ID3D12Device* device,
+		UINT64 byteSize,
+		void** mappedData);
+
+	// Records a copy of byteSize bytes at uploadOffset of an already filled upload buffer
+	// into a new default buffer. The upload buffer must stay alive until the copy executes.
+	static Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBufferFromUpload(
+		ID3D12Device* device,
+		ID3D12GraphicsCommandList* cmdList,
+		ID3D12Resource* uploadBuffer,
+		UINT64 uploadOffset,
+		UINT64 byteSize);
+
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
 		const std::string& entrypoint,
 		const std::string& target);
+
+	// Routes CompileShader through cache, which skips the compiler for sources it has
+	// already compiled (see ShaderCache). nullptr compiles every call directly.
+	static void SetShaderCache(std::shared_ptr<ShaderCache> cache);
+	static std::shared_ptr<ShaderCache> GetShaderCache();
+
+	// D3DCOMPILE_* flags CompileShader uses for this build configuration.
+	static UINT GetShaderCompileFlags();
+
+	///<summary>
+	/// Compiles every job across pool (see ShaderBatchCompiler) through the shader cache,
+	/// or a memory-only one when none is set. nullptr uses ThreadPool::Default(); call
+	/// ShaderBatchCompiler::Compile without a pool to compile on this thread only.
+	/// Does not throw on compile errors: check the report, e.g.
+	/// OutputDebugStringA(report.GetErrorSummary(jobs).c_str()).
+	///</summary>
+	static ShaderBatchCompiler::Report CompileShaders(const std::vector<ShaderCompiler::Request>& jobs, ThreadPool* pool = nullptr);
 };
 
 class DxException
@@ -0,0 +1,338 @@
+//***************************************************************************************
+// Benchmarks.cpp
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "FormatConversion.h"
+#include "FrustumCuller.h"
+#include "GeometryGenerator.h"
+#include "MathHelper.h"
+#include "MatrixBatch.h"
+#include "MeshCodec.h"
+#include "Noise.h"
+#include "RayTriangleSet.h"
+#include "ThreadPool.h"
+#include "VertexTransform.h"
+#include <DirectXCollision.h>
+#include <DirectXPackedVector.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	template<typename T>
+	double MeasureSeconds(T&& func)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		func();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		return std::chrono::duration<double>(end - start).count();
+	}
+
+	// Items per second, in millions.
+	double MillionsPerSecond(double items, double seconds)
+	{
+		return seconds > 0.0 ? items / seconds * 1e-6 : 0.0;
+	}
+
+	void BenchmarkRayTriangleSet(const GeometryGenerator::MeshData& meshData, uint32 rayCount)
+	{
+		RayTriangleSet set(meshData);
+
+		BoundingBox bounds;
+		BoundingBox::CreateFromPoints(bounds, meshData.Vertices.size(),
+			meshData.Vertices.empty() ? nullptr : &meshData.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+
+		XMVECTOR center = XMLoadFloat3(&bounds.Center);
+		XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+		float shellRadius = 2.0f * XMVectorGetX(XMVector3Length(extents));
+
+		// Rays start on a shell around the mesh and aim at random points inside its bounds.
+		std::vector<RayTriangleSet::Ray> rays(rayCount);
+		for (RayTriangleSet::Ray& ray : rays)
+		{
+			XMVECTOR origin = center + shellRadius * MathHelper::RandUnitVector();
+			XMVECTOR target = center + extents * XMVectorSet(
+				MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), 0.0f);
+
+			XMStoreFloat3(&ray.Origin, origin);
+			XMStoreFloat3(&ray.Direction, XMVector3Normalize(target - origin));
+		}
+
+		std::vector<RayTriangleSet::Hit> hits(rayCount);
+
+		std::printf("RayTriangleSet, %u triangles, million rays/s:\n", set.GetTriangleCount());
+		std::printf("  TriangleTests::Intersects %8.3f\n", MillionsPerSecond(rayCount,
+			MeasureSeconds([&] { set.IntersectReference(rays.data(), rays.size(), hits.data()); })));
+		std::printf("  IntersectSingle           %8.3f\n", MillionsPerSecond(rayCount,
+			MeasureSeconds([&] { set.IntersectSingle(rays.data(), rays.size(), hits.data()); })));
+		std::printf("  IntersectPacket4          %8.3f\n", MillionsPerSecond(rayCount,
+			MeasureSeconds([&] { set.IntersectPacket4(rays.data(), rays.size(), hits.data()); })));
+		std::printf("  IntersectPacket8          %8.3f\n", MillionsPerSecond(rayCount,
+			MeasureSeconds([&] { set.IntersectPacket8(rays.data(), rays.size(), hits.data()); })));
+	}
+
+	void BenchmarkFrustumCuller(uint32 itemCount)
+	{
+		// Camera at the origin looking down +z; boxes scattered in a cube around it.
+		BoundingFrustum frustum;
+		BoundingFrustum::CreateFromMatrix(frustum, XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f));
+
+		std::vector<BoundingBox> boxes(itemCount);
+		FrustumCuller culler;
+		culler.Reserve(itemCount);
+
+		for (BoundingBox& box : boxes)
+		{
+			box.Center = XMFLOAT3(MathHelper::RandF(-1000.0f, 1000.0f), MathHelper::RandF(-1000.0f, 1000.0f), MathHelper::RandF(-1000.0f, 1000.0f));
+			box.Extents = XMFLOAT3(MathHelper::RandF(0.5f, 10.0f), MathHelper::RandF(0.5f, 10.0f), MathHelper::RandF(0.5f, 10.0f));
+			culler.Add(box);
+		}
+
+		std::vector<uint32> visible;
+		visible.reserve(itemCount);
+
+		double scalarSeconds = MeasureSeconds([&]
+		{
+			visible.clear();
+			for (uint32 i = 0; i < itemCount; ++i)
+			{
+				if (frustum.Contains(boxes[i]) != DISJOINT)
+					visible.push_back(i);
+			}
+		});
+
+		double batchedSeconds = MeasureSeconds([&] { culler.Cull(frustum, visible); });
+		double parallelSeconds = MeasureSeconds([&] { culler.Cull(frustum, visible, &ThreadPool::Default()); });
+
+		std::printf("FrustumCuller, %u boxes (%u visible), ms per cull:\n", itemCount, (uint32)visible.size());
+		std::printf("  BoundingFrustum::Contains %8.3f\n", scalarSeconds * 1000.0);
+		std::printf("  Cull                      %8.3f\n", batchedSeconds * 1000.0);
+		std::printf("  Cull on ThreadPool        %8.3f\n", parallelSeconds * 1000.0);
+	}
+
+	void BenchmarkMeshCodec(const GeometryGenerator::MeshData& meshData, uint32 iterations)
+	{
+		size_t rawBytes = meshData.Vertices.size() * sizeof(GeometryGenerator::Vertex) + meshData.Indices32.size() * sizeof(uint32);
+
+		std::vector<uint8> encoded;
+		double encodeSeconds = MeasureSeconds([&]
+		{
+			for (uint32 i = 0; i < iterations; ++i)
+				encoded = MeshCodec::Encode(meshData);
+		});
+
+		GeometryGenerator::MeshData decoded;
+		double decodeSeconds = MeasureSeconds([&]
+		{
+			for (uint32 i = 0; i < iterations; ++i)
+				MeshCodec::Decode(encoded.data(), encoded.size(), decoded);
+		});
+
+		double megabytes = (double)rawBytes * iterations / (1024.0 * 1024.0);
+		std::printf("MeshCodec, %zu -> %zu bytes (%.2f:1):\n", rawBytes, encoded.size(), (double)rawBytes / encoded.size());
+		std::printf("  Encode MB/s               %8.1f\n", encodeSeconds > 0.0 ? megabytes / encodeSeconds : 0.0);
+		std::printf("  Decode MB/s               %8.1f\n", decodeSeconds > 0.0 ? megabytes / decodeSeconds : 0.0);
+	}
+
+	void BenchmarkVertexTransform(uint32 vertexCount)
+	{
+		GeometryGenerator geoGen;
+		uint32 slices = (uint32)sqrtf((float)vertexCount) + 1;
+		GeometryGenerator::MeshData sphere = geoGen.CreateSphere(1.0f, slices, slices);
+
+		const size_t count = sphere.Vertices.size();
+		const GeometryGenerator::Vertex* src = sphere.Vertices.data();
+		std::vector<GeometryGenerator::Vertex> dst(count);
+
+		XMMATRIX world = XMMatrixScaling(2.0f, 0.5f, 1.0f) * XMMatrixRotationY(0.3f) * XMMatrixTranslation(10.0f, 0.0f, -4.0f);
+
+		const int boneCount = 64;
+		std::vector<XMFLOAT4X4> bones(boneCount);
+		for (XMFLOAT4X4& bone : bones)
+		{
+			XMStoreFloat4x4(&bone, XMMatrixRotationRollPitchYaw(MathHelper::RandF(), MathHelper::RandF(), MathHelper::RandF()) *
+				XMMatrixTranslation(MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f)));
+		}
+
+		std::vector<VertexTransform::SkinWeights> weights(count);
+		for (VertexTransform::SkinWeights& sw : weights)
+		{
+			float a = MathHelper::RandF(), b = MathHelper::RandF(), c = MathHelper::RandF(), d = MathHelper::RandF();
+			float sum = a + b + c + d;
+			sw.BoneWeights = XMFLOAT3(a / sum, b / sum, c / sum);
+			for (int j = 0; j < 4; ++j)
+				sw.BoneIndices[j] = (uint8)MathHelper::Rand(0, boneCount - 1);
+		}
+
+		double perVertexSeconds = MeasureSeconds([&]
+		{
+			XMMATRIX normalMatrix = MathHelper::InverseTranspose(world);
+			for (size_t i = 0; i < count; ++i)
+			{
+				XMStoreFloat3(&dst[i].Position, XMVector3TransformCoord(XMLoadFloat3(&src[i].Position), world));
+				XMStoreFloat3(&dst[i].Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&src[i].Normal), normalMatrix)));
+				XMStoreFloat3(&dst[i].TangentU, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&src[i].TangentU), world)));
+				dst[i].TexC = src[i].TexC;
+			}
+		});
+
+		std::printf("VertexTransform, %zu vertices, million vertices/s:\n", count);
+		std::printf("  XMVector3Transform*       %8.3f\n", MillionsPerSecond((double)count, perVertexSeconds));
+		std::printf("  Transform                 %8.3f\n", MillionsPerSecond((double)count,
+			MeasureSeconds([&] { VertexTransform::Transform(src, dst.data(), count, world); })));
+		std::printf("  Transform on ThreadPool   %8.3f\n", MillionsPerSecond((double)count,
+			MeasureSeconds([&] { VertexTransform::Transform(src, dst.data(), count, world, &ThreadPool::Default()); })));
+		std::printf("  Skin on ThreadPool        %8.3f\n", MillionsPerSecond((double)count,
+			MeasureSeconds([&] { VertexTransform::Skin(src, weights.data(), dst.data(), count, bones.data(), bones.size(), &ThreadPool::Default()); })));
+	}
+
+	void BenchmarkMatrixBatch(uint32 objectCount)
+	{
+		std::vector<XMFLOAT4X4> worlds(objectCount), results(objectCount);
+		for (XMFLOAT4X4& world : worlds)
+		{
+			XMStoreFloat4x4(&world,
+				XMMatrixScaling(MathHelper::RandF(0.5f, 2.0f), MathHelper::RandF(0.5f, 2.0f), MathHelper::RandF(0.5f, 2.0f)) *
+				XMMatrixRotationRollPitchYaw(MathHelper::RandF(0.0f, XM_2PI), MathHelper::RandF(0.0f, XM_2PI), MathHelper::RandF(0.0f, XM_2PI)) *
+				XMMatrixTranslation(MathHelper::RandF(-100.0f, 100.0f), MathHelper::RandF(-100.0f, 100.0f), MathHelper::RandF(-100.0f, 100.0f)));
+		}
+
+		MatrixSoA worldSoA(objectCount), resultSoA(objectCount);
+		worldSoA.Load(worlds.data(), objectCount);
+
+		XMMATRIX viewProj = XMMatrixLookAtLH(XMVectorSet(0.0f, 50.0f, -200.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) *
+			XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 1000.0f);
+
+		// World, WorldInvTranspose and WorldViewProj in a 256 byte constant buffer element.
+		MatrixBatch::ObjectConstantsLayout layout;
+		layout.WorldOffset = 0;
+		layout.WorldInvTransposeOffset = sizeof(XMFLOAT4X4);
+		layout.WorldViewProjOffset = 2 * sizeof(XMFLOAT4X4);
+		std::vector<uint8> staging(objectCount * layout.Stride);
+
+		double perObjectInverseSeconds = MeasureSeconds([&]
+		{
+			for (uint32 i = 0; i < objectCount; ++i)
+				XMStoreFloat4x4(&results[i], MathHelper::InverseTranspose(XMLoadFloat4x4(&worlds[i])));
+		});
+
+		double batchInverseSeconds = MeasureSeconds([&] { MatrixBatch::InverseTransposeAffine(worldSoA, resultSoA); });
+
+		double perObjectConstantsSeconds = MeasureSeconds([&]
+		{
+			for (uint32 i = 0; i < objectCount; ++i)
+			{
+				XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+				XMFLOAT4X4* dst = reinterpret_cast<XMFLOAT4X4*>(staging.data() + i * layout.Stride);
+				XMStoreFloat4x4(dst + 0, XMMatrixTranspose(world));
+				XMStoreFloat4x4(dst + 1, XMMatrixTranspose(MathHelper::InverseTranspose(world)));
+				XMStoreFloat4x4(dst + 2, XMMatrixTranspose(world * viewProj));
+			}
+		});
+
+		double batchConstantsSeconds = MeasureSeconds([&] { MatrixBatch::WriteObjectConstants(worldSoA, viewProj, layout, staging.data()); });
+
+		std::printf("MatrixBatch, %u objects, million objects/s:\n", objectCount);
+		std::printf("  MathHelper::InverseTranspose %8.3f\n", MillionsPerSecond(objectCount, perObjectInverseSeconds));
+		std::printf("  InverseTransposeAffine       %8.3f\n", MillionsPerSecond(objectCount, batchInverseSeconds));
+		std::printf("  Per object constants         %8.3f\n", MillionsPerSecond(objectCount, perObjectConstantsSeconds));
+		std::printf("  WriteObjectConstants         %8.3f\n", MillionsPerSecond(objectCount, batchConstantsSeconds));
+	}
+
+	void BenchmarkFormatConversion(uint32 elementCount)
+	{
+		// Multiple of 4 for the XMStore*N4 loops.
+		elementCount = (elementCount + 3) & ~3u;
+
+		std::vector<float> src(elementCount);
+		for (float& f : src)
+			f = MathHelper::RandF(-1.2f, 1.2f);
+
+		std::vector<FormatConversion::uint16> halves(elementCount);
+		std::vector<FormatConversion::int16> snorms(elementCount);
+		std::vector<FormatConversion::uint8> unorms(elementCount);
+
+		std::printf("FormatConversion, %u floats, million elements/s:\n", elementCount);
+
+		std::printf("  XMConvertFloatToHalf      %8.1f\n", MillionsPerSecond(elementCount, MeasureSeconds([&]
+		{
+			for (uint32 i = 0; i < elementCount; ++i)
+				halves[i] = XMConvertFloatToHalf(src[i]);
+		})));
+		std::printf("  FloatToHalf               %8.1f\n", MillionsPerSecond(elementCount,
+			MeasureSeconds([&] { FormatConversion::FloatToHalf(src.data(), halves.data(), elementCount); })));
+
+		std::printf("  XMStoreShortN4            %8.1f\n", MillionsPerSecond(elementCount, MeasureSeconds([&]
+		{
+			for (uint32 i = 0; i < elementCount; i += 4)
+				XMStoreShortN4(reinterpret_cast<XMSHORTN4*>(&snorms[i]), XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&src[i])));
+		})));
+		std::printf("  FloatToSnorm16            %8.1f\n", MillionsPerSecond(elementCount,
+			MeasureSeconds([&] { FormatConversion::FloatToSnorm16(src.data(), snorms.data(), elementCount); })));
+
+		std::printf("  XMStoreUByteN4            %8.1f\n", MillionsPerSecond(elementCount, MeasureSeconds([&]
+		{
+			for (uint32 i = 0; i < elementCount; i += 4)
+				XMStoreUByteN4(reinterpret_cast<XMUBYTEN4*>(&unorms[i]), XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&src[i])));
+		})));
+		std::printf("  FloatToUnorm8             %8.1f\n", MillionsPerSecond(elementCount,
+			MeasureSeconds([&] { FormatConversion::FloatToUnorm8(src.data(), unorms.data(), elementCount); })));
+
+		// About elementCount / 8 vertices.
+		GeometryGenerator geoGen;
+		uint32 slices = (uint32)sqrtf(elementCount / 8.0f) + 1;
+		GeometryGenerator::MeshData sphere = geoGen.CreateSphere(1.0f, slices, slices);
+		std::vector<FormatConversion::PackedVertex> packed(sphere.Vertices.size());
+
+		std::printf("  PackVertices (vertices)   %8.1f\n", MillionsPerSecond((double)packed.size(),
+			MeasureSeconds([&] { FormatConversion::PackVertices(sphere.Vertices.data(), packed.data(), packed.size()); })));
+	}
+
+	void BenchmarkNoise(uint32 size)
+	{
+		Noise noise(1);
+		std::vector<float> heights((size_t)size * size);
+		XMFLOAT2 origin(0.0f, 0.0f);
+		XMFLOAT2 spacing(1.0f / 256.0f, 1.0f / 256.0f);
+
+		double singleSeconds = MeasureSeconds([&]
+		{
+			for (uint32 row = 0; row < size; ++row)
+			{
+				for (uint32 column = 0; column < size; ++column)
+					heights[(size_t)row * size + column] = noise.Sample(column * spacing.x, row * spacing.y);
+			}
+		});
+
+		double batchSeconds = MeasureSeconds([&] { noise.Fill2D(heights.data(), size, size, origin, spacing); });
+		double parallelSeconds = MeasureSeconds([&] { noise.Fill2D(heights.data(), size, size, origin, spacing, &ThreadPool::Default()); });
+
+		std::printf("Noise, %ux%u heightmap, ms:\n", size, size);
+		std::printf("  Sample per texel          %8.1f\n", singleSeconds * 1000.0);
+		std::printf("  Fill2D                    %8.1f\n", batchSeconds * 1000.0);
+		std::printf("  Fill2D on ThreadPool      %8.1f\n", parallelSeconds * 1000.0);
+	}
+}
+
+void RunBenchmarks()
+{
+	GeometryGenerator geoGen;
+
+	BenchmarkRayTriangleSet(geoGen.CreateGeosphere(1.0f, 3), 1 << 16);
+	BenchmarkFrustumCuller(100000);
+	BenchmarkMeshCodec(geoGen.CreateSphere(1.0f, 256, 256), 10);
+	BenchmarkVertexTransform(1 << 18);
+	BenchmarkMatrixBatch(1 << 16);
+	BenchmarkFormatConversion(1 << 22);
+	BenchmarkNoise(4096);
+}
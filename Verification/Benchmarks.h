@@ -0,0 +1,11 @@
+//***************************************************************************************
+// Benchmarks.h
+//
+// Throughput of the batched CPU paths in Common next to the per-element code they
+// replace. Timings only; correctness is checked by the rest of the project.
+//***************************************************************************************
+
+#pragma once
+
+// Runs every benchmark and prints the results.
+void RunBenchmarks();
@@ -0,0 +1,1157 @@
+//***************************************************************************************
+// main.cpp
+//
+// Console checks for the CPU side of Common: known-answer vectors, round trips and
+// agreement between the scalar, SIMD and multithreaded paths. Prints each failed check
+// and returns the number of failures, so it can gate a build step. Run with -benchmark
+// to time the batched paths against the per-element code instead.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+#include "CounterRandom.h"
+#include "FastMath.h"
+#include "FileWatcher.h"
+#include "FormatConversion.h"
+#include "FrustumCuller.h"
+#include "GeometryGenerator.h"
+#include "LowDiscrepancy.h"
+#include "MathHelper.h"
+#include "MatrixBatch.h"
+#include "MeshCodec.h"
+#include "MeshStreamWriter.h"
+#include "Noise.h"
+#include "OcclusionCuller.h"
+#include "ProgressiveMesh.h"
+#include "RandomEngine.h"
+#include "RayTriangleSet.h"
+#include "ShaderCache.h"
+#include "ShaderLibrary.h"
+#include "StringUtil.h"
+#include "ThreadPool.h"
+#include "TransformHierarchy.h"
+#include "VertexTransform.h"
+#include <DirectXCollision.h>
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(_WIN32)
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	int gCheckCount = 0;
+	int gFailureCount = 0;
+
+	void Check(bool passed, const char* name)
+	{
+		++gCheckCount;
+		if (!passed)
+		{
+			++gFailureCount;
+			std::printf("FAILED: %s\n", name);
+		}
+	}
+
+	bool SameBits(const void* a, const void* b, size_t byteSize)
+	{
+		return std::memcmp(a, b, byteSize) == 0;
+	}
+
+	bool NearlyEqual(const XMFLOAT4X4& a, const XMFLOAT4X4& b, float tolerance)
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				if (std::fabs(a.m[r][c] - b.m[r][c]) > tolerance * std::max(1.0f, std::fabs(b.m[r][c])))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	std::vector<GeometryGenerator::MeshData> CreateTestMeshes()
+	{
+		GeometryGenerator geoGen;
+
+		std::vector<GeometryGenerator::MeshData> meshes;
+		meshes.push_back(geoGen.CreateBox(1.0f, 2.0f, 3.0f, 2));
+		meshes.push_back(geoGen.CreateSphere(1.0f, 20, 20));
+		meshes.push_back(geoGen.CreateGeosphere(1.0f, 3));
+		meshes.push_back(geoGen.CreateCylinder(1.0f, 0.5f, 3.0f, 20, 20));
+		meshes.push_back(geoGen.CreateGrid(10.0f, 10.0f, 33, 17));
+		return meshes;
+	}
+
+	void CreateDirectoryQuietly(const std::string& directory)
+	{
+#if defined(_WIN32)
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+
+	void RemoveDirectoryQuietly(const std::string& directory)
+	{
+#if defined(_WIN32)
+		_rmdir(directory.c_str());
+#else
+		rmdir(directory.c_str());
+#endif
+	}
+
+	// Overwrites filename with its first byteCount bytes, the last one flipped when flip is set.
+	void DamageFile(const std::string& filename, size_t byteCount, bool flip)
+	{
+		std::vector<char> data;
+		if (FILE* file = std::fopen(filename.c_str(), "rb"))
+		{
+			data.resize(byteCount);
+			data.resize(std::fread(data.data(), 1, byteCount, file));
+			std::fclose(file);
+		}
+
+		if (flip && !data.empty())
+			data.back() ^= 0x5a;
+
+		if (FILE* file = std::fopen(filename.c_str(), "wb"))
+		{
+			std::fwrite(data.data(), 1, data.size(), file);
+			std::fclose(file);
+		}
+	}
+
+	bool ReadTextFile(const std::string& filename, std::string& text)
+	{
+		FILE* file = std::fopen(filename.c_str(), "rb");
+		if (file == nullptr)
+			return false;
+
+		char buffer[4096];
+		text.clear();
+		for (size_t n; (n = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+			text.append(buffer, n);
+		std::fclose(file);
+		return true;
+	}
+
+	void WriteTextFile(const std::string& filename, const std::string& text)
+	{
+		if (FILE* file = std::fopen(filename.c_str(), "wb"))
+		{
+			std::fwrite(text.data(), 1, text.size(), file);
+			std::fclose(file);
+		}
+	}
+
+	// Moves a file's write time into the past, as if it had been saved long ago.
+	void BackdateFile(const std::string& filename, int seconds)
+	{
+#if defined(_WIN32)
+		_utimbuf times;
+		times.actime = times.modtime = std::time(nullptr) - seconds;
+		_utime(filename.c_str(), &times);
+#else
+		utimbuf times;
+		times.actime = times.modtime = std::time(nullptr) - seconds;
+		utime(filename.c_str(), &times);
+#endif
+	}
+
+	// ShaderCompiler stand-in. Files live in memory (or on disk with ReadFromDisk),
+	// #include "name" lines are expanded from them, and the bytecode is the expanded source.
+	class FakeShaderCompiler : public ShaderCompiler
+	{
+	public:
+		std::map<std::wstring, std::string> Files;
+		bool ReadFromDisk = false;
+		std::atomic<int> CompileCount{ 0 };
+
+		std::string GetIdentity()const override
+		{
+			return "fake";
+		}
+
+		HRESULT Preprocess(const Request& request, std::string& source, std::vector<std::wstring>& includes,
+			std::string& errors) override
+		{
+			return Expand(request.Filename, source, includes, errors) ? S_OK : E_FAIL;
+		}
+
+		HRESULT Compile(const Request& request, const std::string& source, std::vector<uint8>& bytecode,
+			std::string& errors) override
+		{
+			++CompileCount;
+			if (source.find("error") != std::string::npos)
+			{
+				errors += "fake: error in source\n";
+				return E_FAIL;
+			}
+
+			bytecode.assign(source.begin(), source.end());
+			return S_OK;
+		}
+
+	private:
+		bool Expand(const std::wstring& filename, std::string& source, std::vector<std::wstring>& includes,
+			std::string& errors)const
+		{
+			std::string text;
+			auto file = Files.find(filename);
+			if (file != Files.end())
+				text = file->second;
+			else if (!ReadFromDisk || !ReadTextFile(StringUtil::ToNarrow(filename), text))
+			{
+				errors += StringUtil::ToNarrow(filename) + ": error: cannot open file\n";
+				return false;
+			}
+
+			const std::string include = "#include \"";
+			size_t start = 0;
+			while (start < text.size())
+			{
+				size_t end = text.find('\n', start);
+				end = end == std::string::npos ? text.size() : end + 1;
+
+				std::string line = text.substr(start, end - start);
+				if (line.compare(0, include.size(), include) == 0)
+				{
+					std::string name = line.substr(include.size(), line.find('"', include.size()) - include.size());
+					std::wstring wideName(name.begin(), name.end());
+					includes.push_back(wideName);
+					if (!Expand(wideName, source, includes, errors))
+						return false;
+				}
+				else
+				{
+					source += line;
+				}
+				start = end;
+			}
+			return true;
+		}
+	};
+
+	void VerifyThreadPool()
+	{
+		ThreadPool& pool = ThreadPool::Default();
+
+		std::vector<std::atomic<int>> visits(1000);
+		for (std::atomic<int>& v : visits)
+			v = 0;
+		pool.ParallelFor(visits.size(), 7, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+				++visits[i];
+		});
+		Check(std::all_of(visits.begin(), visits.end(), [](const std::atomic<int>& v) { return v == 1; }),
+			"ThreadPool: ParallelFor runs every index once");
+
+		std::string message;
+		try
+		{
+			pool.ParallelFor(1000, 7, [](size_t begin, size_t end)
+			{
+				if (begin <= 500 && 500 < end)
+					throw std::runtime_error("chunk 71");
+			});
+		}
+		catch (const std::runtime_error& e)
+		{
+			message = e.what();
+		}
+		Check(message == "chunk 71", "ThreadPool: ParallelFor rethrows a chunk's exception on the caller");
+
+		std::atomic<size_t> sum{ 0 };
+		pool.ParallelFor(100, 1, [&](size_t begin, size_t end) { sum += end - begin; });
+		Check(sum == 100, "ThreadPool: usable after an exception");
+	}
+
+	void VerifyCounterRandom()
+	{
+		// Philox4x32-10 known-answer vectors (Random123 kat_vectors): counter, key, output.
+		struct Vector { uint32 Counter[4]; uint32 Key[2]; uint32 Output[4]; };
+		const Vector vectors[] =
+		{
+			{ { 0x00000000, 0x00000000, 0x00000000, 0x00000000 }, { 0x00000000, 0x00000000 },
+			  { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+			{ { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff }, { 0xffffffff, 0xffffffff },
+			  { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+			{ { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }, { 0xa4093822, 0x299f31d0 },
+			  { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } },
+		};
+
+		for (const Vector& v : vectors)
+		{
+			// The seed is the key and counter (block, index) is (Counter[0..1], Counter[2..3]).
+			CounterRandom random(((uint64)v.Key[1] << 32) | v.Key[0]);
+
+			uint32 block[4];
+			random.GenerateBlock(((uint64)v.Counter[3] << 32) | v.Counter[2], ((uint64)v.Counter[1] << 32) | v.Counter[0], block);
+			Check(SameBits(block, v.Output, sizeof(block)), "CounterRandom: Philox4x32-10 known answer");
+		}
+
+		// Bulk and stream draws are the same values as the per item function, on any pool.
+		CounterRandom random(0x0123456789abcdefull);
+		const size_t count = 10007;
+		const uint64 firstIndex = 0xfffffff0ull; // Crosses the 32 bit boundary of the index.
+
+		std::vector<uint32> serial(count), parallel(count);
+		random.FillUInts(firstIndex, 5, serial.data(), count);
+		random.FillUInts(firstIndex, 5, parallel.data(), count, &ThreadPool::Default());
+
+		bool matches = true;
+		for (size_t i = 0; i < count; ++i)
+			matches = matches && serial[i] == random.UInt(firstIndex + i, 5);
+		Check(matches, "CounterRandom: FillUInts matches UInt");
+		Check(serial == parallel, "CounterRandom: FillUInts does not depend on the pool");
+
+		CounterRandom::Stream stream = random.GetStream(42);
+		std::vector<uint32> streamDraws(37);
+		stream.FillUInts(streamDraws.data(), streamDraws.size());
+
+		matches = true;
+		for (uint32 d = 0; d < (uint32)streamDraws.size(); ++d)
+			matches = matches && streamDraws[d] == random.UInt(42, d);
+		Check(matches, "CounterRandom: stream draw k is UInt(index, k)");
+	}
+
+	void VerifyMeshCodec()
+	{
+		for (const GeometryGenerator::MeshData& mesh : CreateTestMeshes())
+		{
+			std::vector<MeshCodec::uint8> encoded = MeshCodec::Encode(mesh);
+
+			GeometryGenerator::MeshData decoded;
+			bool decodedOk = MeshCodec::Decode(encoded.data(), encoded.size(), decoded);
+			Check(decodedOk, "MeshCodec: decodes its own output");
+			Check(decodedOk && decoded.Indices32 == mesh.Indices32, "MeshCodec: indices round trip");
+			Check(decodedOk && decoded.Vertices.size() == mesh.Vertices.size() &&
+				SameBits(decoded.Vertices.data(), mesh.Vertices.data(), mesh.Vertices.size() * sizeof(GeometryGenerator::Vertex)),
+				"MeshCodec: vertices round trip bit for bit");
+
+			GeometryGenerator::MeshData truncated;
+			Check(!MeshCodec::Decode(encoded.data(), encoded.size() / 2, truncated), "MeshCodec: rejects truncated data");
+		}
+
+		// Header: magic, 0 vertices, 2^31 indices, followed by a few index bytes.
+		const MeshCodec::uint8 tooManyIndices[] = { 0x4D, 0x53, 0x48, 0x31, 0, 0, 0, 0, 0, 0, 0, 0x80, 0, 0, 0 };
+		GeometryGenerator::MeshData rejected;
+		Check(!MeshCodec::Decode(tooManyIndices, sizeof(tooManyIndices), rejected) && rejected.Indices32.empty(),
+			"MeshCodec: rejects more indices than bytes before allocating");
+	}
+
+	void VerifyFormatConversion()
+	{
+		// Every half that is not a NaN survives half -> float -> half.
+		std::vector<FormatConversion::uint16> halves, roundTrip;
+		for (uint32 h = 0; h <= 0xffff; ++h)
+		{
+			if ((h & 0x7c00) != 0x7c00 || (h & 0x03ff) == 0)
+				halves.push_back((FormatConversion::uint16)h);
+		}
+
+		std::vector<float> floats(halves.size());
+		roundTrip.resize(halves.size());
+		FormatConversion::HalfToFloat(halves.data(), floats.data(), halves.size());
+		FormatConversion::FloatToHalf(floats.data(), roundTrip.data(), floats.size());
+		Check(halves == roundTrip, "FormatConversion: half -> float -> half round trip");
+
+		// Rounding matches XMConvertFloatToHalf, including values between two halves.
+		RandomEngine engine(7);
+		std::vector<float> src(65536);
+		engine.FillFloats(src.data(), src.size(), -70000.0f, 70000.0f);
+		for (size_t i = 0; i < 4096; ++i)
+			src[i] *= 1.0f / 65536.0f; // Small values and denormal halves.
+
+		std::vector<FormatConversion::uint16> bulk(src.size());
+		FormatConversion::FloatToHalf(src.data(), bulk.data(), src.size());
+
+		bool matches = true;
+		for (size_t i = 0; i < src.size(); ++i)
+			matches = matches && bulk[i] == XMConvertFloatToHalf(src[i]);
+		Check(matches, "FormatConversion: FloatToHalf matches XMConvertFloatToHalf");
+
+		// Every snorm16 / unorm8 code survives code -> float -> code; -32768 reads as -1.
+		std::vector<FormatConversion::int16> snorms, snormsBack;
+		for (int s = -32768; s <= 32767; ++s)
+			snorms.push_back((FormatConversion::int16)s);
+
+		floats.resize(snorms.size());
+		snormsBack.resize(snorms.size());
+		FormatConversion::Snorm16ToFloat(snorms.data(), floats.data(), snorms.size());
+		FormatConversion::FloatToSnorm16(floats.data(), snormsBack.data(), floats.size());
+		Check(floats[0] == -1.0f && snormsBack[0] == -32767, "FormatConversion: -32768 reads back as -1");
+		Check(std::equal(snorms.begin() + 1, snorms.end(), snormsBack.begin() + 1), "FormatConversion: snorm16 round trip");
+
+		std::vector<FormatConversion::uint8> unorms(256), unormsBack(256);
+		for (uint32 u = 0; u < 256; ++u)
+			unorms[u] = (FormatConversion::uint8)u;
+
+		floats.resize(unorms.size());
+		FormatConversion::Unorm8ToFloat(unorms.data(), floats.data(), unorms.size());
+		FormatConversion::FloatToUnorm8(floats.data(), unormsBack.data(), floats.size());
+		Check(unorms == unormsBack, "FormatConversion: unorm8 round trip");
+
+		const float outOfRange[4] = { -2.0f, 2.0f, -1.0f, 1.0f };
+		FormatConversion::int16 clampedSnorms[4];
+		FormatConversion::uint8 clampedUnorms[4];
+		FormatConversion::FloatToSnorm16(outOfRange, clampedSnorms, 4);
+		FormatConversion::FloatToUnorm8(outOfRange, clampedUnorms, 4);
+		Check(clampedSnorms[0] == -32767 && clampedSnorms[1] == 32767 && clampedSnorms[2] == -32767 && clampedSnorms[3] == 32767,
+			"FormatConversion: snorm16 clamps to [-1, 1]");
+		Check(clampedUnorms[0] == 0 && clampedUnorms[1] == 255 && clampedUnorms[2] == 0 && clampedUnorms[3] == 255,
+			"FormatConversion: unorm8 clamps to [0, 1]");
+	}
+
+	void VerifyNoise()
+	{
+		const size_t count = 4099; // Not a multiple of any lane count.
+		std::vector<float> x(count), y(count), z(count), batch2(count), batch3(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			x[i] = -37.1f + i * 0.0173f;
+			y[i] = 11.3f - i * 0.0291f;
+			z[i] = -3.0f + i * 0.007f;
+		}
+
+		for (int basis = 0; basis < 3; ++basis)
+		{
+			for (int sum = 0; sum < 3; ++sum)
+			{
+				Noise::Desc desc;
+				desc.Type = (Noise::Basis)basis;
+				desc.Sum = (Noise::Fractal)sum;
+				Noise noise(7, desc);
+
+				noise.Sample(x.data(), y.data(), batch2.data(), count);
+				noise.Sample(x.data(), y.data(), z.data(), batch3.data(), count);
+
+				bool matches = true;
+				for (size_t i = 0; i < count; ++i)
+				{
+					float single2 = noise.Sample(x[i], y[i]);
+					float single3 = noise.Sample(x[i], y[i], z[i]);
+					matches = matches && SameBits(&single2, &batch2[i], sizeof(float)) && SameBits(&single3, &batch3[i], sizeof(float));
+				}
+				Check(matches, "Noise: single samples match the batches bit for bit");
+
+				const uint32 width = 257, height = 129;
+				std::vector<float> serial(width * height), parallel(width * height);
+				noise.Fill2D(serial.data(), width, height, XMFLOAT2(-5.0f, 3.0f), XMFLOAT2(0.05f, 0.07f));
+				noise.Fill2D(parallel.data(), width, height, XMFLOAT2(-5.0f, 3.0f), XMFLOAT2(0.05f, 0.07f), &ThreadPool::Default());
+				Check(SameBits(serial.data(), parallel.data(), serial.size() * sizeof(float)), "Noise: Fill2D does not depend on the pool");
+			}
+		}
+	}
+
+	void VerifyFastMath()
+	{
+		// The bounds documented in FastMath.h, with 10% headroom for other instruction sets.
+		FastMath::ErrorReport error = FastMath::MeasureMaxError();
+		Check(error.SinCos <= 1.1 * 9.2e-8, "FastMath: SinCos error bound");
+		Check(error.Atan2 <= 1.1 * 2.8e-7, "FastMath: Atan2 error bound");
+		Check(error.ACos <= 1.1 * 3.0e-7, "FastMath: ACos error bound");
+		Check(error.ExpRelative <= 1.1 * 1.2e-7, "FastMath: Exp error bound");
+		Check(error.Log <= 1.1 * 7.9e-8, "FastMath: Log error bound");
+
+		const float pi = 3.14159265f;
+		float y[4] = { 0.0f, -0.0f, 0.0f, -0.0f };
+		float x[4] = { -0.0f, -0.0f, 0.0f, 0.0f };
+		float angles[4];
+		FastMath::Atan2(y, x, angles, 4);
+		Check(angles[0] == pi && angles[1] == -pi && angles[2] == 0.0f && !std::signbit(angles[2]) && std::signbit(angles[3]),
+			"FastMath: Atan2 follows atan2 on signed zeros");
+
+		float logIn[3] = { std::numeric_limits<float>::quiet_NaN(), -1.0f, 0.0f };
+		float logOut[3];
+		FastMath::Log(logIn, logOut, 3);
+		Check(std::isnan(logOut[0]) && std::isnan(logOut[1]) && logOut[2] == -std::numeric_limits<float>::infinity(),
+			"FastMath: Log of NaN, negative and zero");
+	}
+
+	void VerifyLowDiscrepancy()
+	{
+		Check(LowDiscrepancy::Halton(1, 2) == 0.5f && LowDiscrepancy::Halton(2, 2) == 0.25f &&
+			LowDiscrepancy::Halton(3, 2) == 0.75f && LowDiscrepancy::Halton(6, 2) == 0.375f,
+			"LowDiscrepancy: Halton base 2 is the van der Corput sequence");
+		Check(std::fabs(LowDiscrepancy::Halton(1, 3) - 1.0f / 3.0f) < 1e-7f && std::fabs(LowDiscrepancy::Halton(5, 3) - 7.0f / 9.0f) < 1e-7f,
+			"LowDiscrepancy: Halton base 3");
+
+		// Unscrambled Sobol: dimension 0 is van der Corput, dimension 1 the first Joe-Kuo one
+		// (direction numbers 1/2, 3/4, 5/8), both indexed directly rather than in Gray code order.
+		const float dimension1[8] = { 0.0f, 0.5f, 0.75f, 0.25f, 0.625f, 0.125f, 0.375f, 0.875f };
+		bool matches = true;
+		for (uint32 i = 0; i < 8; ++i)
+		{
+			matches = matches && LowDiscrepancy::Sobol(i, 0) == LowDiscrepancy::Halton(i, 2);
+			matches = matches && LowDiscrepancy::Sobol(i, 1) == dimension1[i];
+		}
+		Check(matches, "LowDiscrepancy: Sobol known answers");
+
+		// Every scrambled point stays in [0, 1), and the first 2^k points of dimension 0
+		// put exactly one point in each interval [j / 2^k, (j + 1) / 2^k).
+		std::vector<uint32> strata(256, 0);
+		bool inRange = true;
+		for (uint32 i = 0; i < 256; ++i)
+		{
+			float u = LowDiscrepancy::Sobol(i, 0, 1234);
+			inRange = inRange && u >= 0.0f && u < 1.0f;
+			if (u >= 0.0f && u < 1.0f)
+				++strata[(size_t)(u * 256.0f)];
+		}
+		Check(inRange, "LowDiscrepancy: scrambled Sobol stays in [0, 1)");
+		Check(std::count(strata.begin(), strata.end(), 1u) == 256, "LowDiscrepancy: scrambled Sobol stratifies");
+	}
+
+	void VerifyRayTriangleSet()
+	{
+		RandomEngine engine(3);
+
+		for (const GeometryGenerator::MeshData& mesh : CreateTestMeshes())
+		{
+			RayTriangleSet set(mesh);
+
+			// Rays from a shell of radius 8 toward points near the origin; the meshes are at most
+			// 5 units across, so most rays hit and some miss.
+			std::vector<RayTriangleSet::Ray> rays(1003);
+			for (RayTriangleSet::Ray& ray : rays)
+			{
+				XMVECTOR origin = XMVector3Normalize(XMVectorSet(engine.NextFloat(-1.0f, 1.0f), engine.NextFloat(-1.0f, 1.0f),
+					engine.NextFloat(-1.0f, 1.0f), 0.0f)) * 8.0f;
+				XMVECTOR target = XMVectorSet(engine.NextFloat(-3.0f, 3.0f), engine.NextFloat(-3.0f, 3.0f), engine.NextFloat(-3.0f, 3.0f), 0.0f);
+
+				XMStoreFloat3(&ray.Origin, origin);
+				XMStoreFloat3(&ray.Direction, XMVector3Normalize(target - origin));
+			}
+
+			std::vector<RayTriangleSet::Hit> reference(rays.size()), single(rays.size()), packet4(rays.size()), packet8(rays.size());
+			set.IntersectReference(rays.data(), rays.size(), reference.data());
+			set.IntersectSingle(rays.data(), rays.size(), single.data());
+			set.IntersectPacket4(rays.data(), rays.size(), packet4.data());
+			set.IntersectPacket8(rays.data(), rays.size(), packet8.data());
+
+			std::unique_ptr<bool[]> occluded(new bool[rays.size()]);
+			set.Occluded(rays.data(), rays.size(), occluded.get());
+
+			// Distances may differ in the last bits; a ray through a shared edge may report
+			// either triangle, so only hit / miss and distance are compared.
+			bool matches = true, occlusionMatches = true;
+			for (size_t i = 0; i < rays.size(); ++i)
+			{
+				bool hit = reference[i].Triangle != RayTriangleSet::InvalidTriangle;
+				for (const RayTriangleSet::Hit* h : { &single[i], &packet4[i], &packet8[i] })
+				{
+					matches = matches && (h->Triangle != RayTriangleSet::InvalidTriangle) == hit;
+					matches = matches && (!hit || std::fabs(h->Distance - reference[i].Distance) <= 1e-4f);
+				}
+				occlusionMatches = occlusionMatches && occluded[i] == hit;
+			}
+			Check(matches, "RayTriangleSet: every query mode matches the reference");
+			Check(occlusionMatches, "RayTriangleSet: Occluded matches Intersect");
+		}
+	}
+
+	void VerifyOcclusionCuller()
+	{
+		// Camera at the origin looking down +z; a wall at z = 10 covers the whole screen.
+		XMMATRIX viewProj = XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 1000.0f);
+		BoundingBox wall(XMFLOAT3(0.0f, 0.0f, 10.0f), XMFLOAT3(100.0f, 100.0f, 0.5f));
+		BoundingBox hidden(XMFLOAT3(1.0f, -1.0f, 50.0f), XMFLOAT3(2.0f, 2.0f, 2.0f));
+		BoundingBox inFront(XMFLOAT3(0.0f, 0.0f, 5.0f), XMFLOAT3(0.5f, 0.5f, 0.5f));
+
+		OcclusionCuller culler;
+		culler.BeginFrame(viewProj);
+		Check(culler.IsVisible(hidden), "OcclusionCuller: boxes are visible without occluders");
+
+		culler.AddOccluder(OcclusionCuller::CreateBoxOccluder(wall), XMMatrixIdentity());
+		culler.RasterizeOccluders();
+		Check(!culler.IsVisible(hidden), "OcclusionCuller: a box behind a full-screen occluder is hidden");
+		Check(culler.IsVisible(inFront), "OcclusionCuller: a box in front of the occluder is visible");
+
+		std::vector<BoundingBox> boxes = { hidden, inFront, hidden };
+		std::vector<uint32> indices = { 0, 1, 2 };
+		culler.FilterVisible(boxes.data(), indices);
+		Check(indices.size() == 1 && indices[0] == 1, "OcclusionCuller: FilterVisible keeps only the visible boxes");
+
+		// A half-screen occluder, rasterized serially and on the pool.
+		BoundingBox leftWall(XMFLOAT3(-50.0f, 0.0f, 10.0f), XMFLOAT3(50.0f, 100.0f, 0.5f));
+		std::vector<float> serialDepth;
+		for (ThreadPool* pool : { (ThreadPool*)nullptr, &ThreadPool::Default() })
+		{
+			culler.BeginFrame(viewProj);
+			culler.AddOccluder(OcclusionCuller::CreateBoxOccluder(leftWall), XMMatrixIdentity());
+			culler.RasterizeOccluders(pool);
+
+			std::vector<float> depth;
+			for (uint32 y = 0; y < culler.GetHeight(); ++y)
+				for (uint32 x = 0; x < culler.GetWidth(); ++x)
+					depth.push_back(culler.GetDepth(x, y));
+
+			if (pool == nullptr)
+				serialDepth = depth;
+			else
+				Check(depth == serialDepth, "OcclusionCuller: rasterizing on the pool matches serial");
+		}
+		Check(culler.GetDepth(0, culler.GetHeight() / 2) < 1.0f && culler.GetDepth(culler.GetWidth() - 1, culler.GetHeight() / 2) == 1.0f,
+			"OcclusionCuller: a half-screen occluder covers one side");
+
+		// Occluders queued before a resolution change are dropped, not rasterized stretched.
+		culler.BeginFrame(viewProj);
+		culler.AddOccluder(OcclusionCuller::CreateBoxOccluder(wall), XMMatrixIdentity());
+		culler.SetResolution(640, 384);
+		culler.RasterizeOccluders();
+		Check(culler.GetWidth() == 640 && culler.IsVisible(hidden), "OcclusionCuller: SetResolution drops queued occluders");
+	}
+
+	void VerifyMatrixBatch()
+	{
+		RandomEngine engine(9);
+
+		// Not a multiple of 8, so the last block is partial.
+		const size_t count = 29;
+		std::vector<XMFLOAT4X4> worlds(count), expected(count);
+		MatrixSoA soa(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			XMMATRIX world = XMMatrixScaling(engine.NextFloat(0.5f, 2.0f), engine.NextFloat(0.5f, 2.0f), engine.NextFloat(0.5f, 2.0f)) *
+				XMMatrixRotationRollPitchYaw(engine.NextFloat(0.0f, XM_2PI), engine.NextFloat(0.0f, XM_2PI), engine.NextFloat(0.0f, XM_2PI)) *
+				XMMatrixTranslation(engine.NextFloat(-100.0f, 100.0f), engine.NextFloat(-100.0f, 100.0f), engine.NextFloat(-100.0f, 100.0f));
+
+			XMStoreFloat4x4(&worlds[i], world);
+			XMStoreFloat4x4(&expected[i], MathHelper::InverseTranspose(world));
+			soa.Set(i, world);
+		}
+
+		MatrixSoA inverseTransposes;
+		MatrixBatch::InverseTransposeAffine(soa, inverseTransposes);
+
+		std::vector<XMFLOAT4X4> inPlace = worlds;
+		MatrixBatch::InverseTransposeAffine(inPlace.data(), inPlace.data(), count);
+
+		bool soaMatches = true, aosMatches = true;
+		for (size_t i = 0; i < count; ++i)
+		{
+			XMFLOAT4X4 m;
+			inverseTransposes.Get(i, m);
+			soaMatches = soaMatches && NearlyEqual(m, expected[i], 1e-4f);
+			aosMatches = aosMatches && NearlyEqual(inPlace[i], expected[i], 1e-4f);
+		}
+		Check(soaMatches, "MatrixBatch: InverseTransposeAffine matches MathHelper::InverseTranspose");
+		Check(aosMatches, "MatrixBatch: AoS InverseTransposeAffine matches in place");
+
+		// Objects 5 .. 24 into a buffer that starts at object 5, with a guard object after it.
+		const size_t first = 5, written = 20;
+		XMMATRIX viewProj = XMMatrixLookAtLH(XMVectorSet(0.0f, 50.0f, -200.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) *
+			XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 1000.0f);
+
+		MatrixBatch::ObjectConstantsLayout layout;
+		layout.WorldInvTransposeOffset = sizeof(XMFLOAT4X4);
+		layout.WorldViewProjOffset = 2 * sizeof(XMFLOAT4X4);
+		std::vector<std::uint8_t> staging((written + 1) * layout.Stride, 0xcd);
+		MatrixBatch::WriteObjectConstants(soa, viewProj, layout, staging.data(), first, written);
+
+		bool constantsMatch = true;
+		for (size_t i = 0; i < written; ++i)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&worlds[first + i]);
+			XMFLOAT4X4 expectedConstants[3];
+			XMStoreFloat4x4(&expectedConstants[0], XMMatrixTranspose(world));
+			XMStoreFloat4x4(&expectedConstants[1], XMMatrixTranspose(XMLoadFloat4x4(&expected[first + i])));
+			XMStoreFloat4x4(&expectedConstants[2], XMMatrixTranspose(world * viewProj));
+
+			XMFLOAT4X4 constants[3];
+			std::memcpy(constants, staging.data() + i * layout.Stride, sizeof(constants));
+			for (int k = 0; k < 3; ++k)
+				constantsMatch = constantsMatch && NearlyEqual(constants[k], expectedConstants[k], 1e-4f);
+		}
+		Check(constantsMatch, "MatrixBatch: WriteObjectConstants matches the per-object math");
+		Check(std::all_of(staging.end() - layout.Stride, staging.end(), [](std::uint8_t b) { return b == 0xcd; }),
+			"MatrixBatch: WriteObjectConstants stays inside its range");
+	}
+
+	void VerifyTransformHierarchy()
+	{
+		const int numFrameResources = 3;
+		TransformHierarchy hierarchy(numFrameResources);
+
+		XMFLOAT4X4 offset;
+		XMStoreFloat4x4(&offset, XMMatrixTranslation(1.0f, 0.0f, 0.0f));
+		TransformHierarchy::NodeId parent = hierarchy.CreateNode();
+		TransformHierarchy::NodeId child = hierarchy.CreateNode(parent, offset);
+		TransformHierarchy::NodeId grandchild = hierarchy.CreateNode(child, offset);
+		TransformHierarchy::NodeId other = hierarchy.CreateNode();
+
+		hierarchy.Update();
+		std::vector<TransformHierarchy::NodeId> changed;
+		for (int frame = 0; frame < numFrameResources; ++frame)
+			hierarchy.CollectChanged(changed);
+
+		hierarchy.SetLocal(parent, XMMatrixTranslation(0.0f, 5.0f, 0.0f));
+		uint32 updated = hierarchy.Update(&ThreadPool::Default());
+
+		const XMFLOAT4X4& childWorld = hierarchy.GetWorld(child);
+		const XMFLOAT4X4& grandchildWorld = hierarchy.GetWorld(grandchild);
+		Check(updated == 3 && childWorld._41 == 1.0f && childWorld._42 == 5.0f &&
+			grandchildWorld._41 == 2.0f && grandchildWorld._42 == 5.0f && hierarchy.GetWorld(other)._42 == 0.0f,
+			"TransformHierarchy: moving a parent updates its descendants' worlds");
+
+		const std::vector<TransformHierarchy::NodeId> expected = { parent, child, grandchild };
+		bool dirtyEachFrame = true;
+		for (int frame = 0; frame < numFrameResources; ++frame)
+		{
+			changed.clear();
+			hierarchy.CollectChanged(changed);
+			std::sort(changed.begin(), changed.end());
+			dirtyEachFrame = dirtyEachFrame && changed == expected;
+		}
+		changed.clear();
+		hierarchy.CollectChanged(changed);
+		Check(dirtyEachFrame && changed.empty(),
+			"TransformHierarchy: changed nodes stay dirty for NumFrameResources frames");
+	}
+
+	void VerifyMeshStreamWriter()
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 2.0f, 3.0f, 0);
+		GeometryGenerator::MeshData sphere = geoGen.CreateSphere(1.0f, 20, 20);
+
+		// 16 byte aligned destinations; vertices are 44 bytes, so a Flush after the box
+		// leaves the stream between 16 byte boundaries.
+		size_t vertexCount = box.Vertices.size() + sphere.Vertices.size();
+		size_t indexCount = box.Indices32.size() + sphere.Indices32.size();
+		std::vector<XMFLOAT4A> vertexMemory(vertexCount * sizeof(GeometryGenerator::Vertex) / sizeof(XMFLOAT4A) + 1);
+		std::vector<XMFLOAT4A> indexMemory(indexCount * sizeof(std::uint16_t) / sizeof(XMFLOAT4A) + 1);
+
+		MeshStreamWriter writer(vertexMemory.data(), vertexCount, indexMemory.data(), indexCount);
+		bool pushed = writer.PushMesh(box);
+		writer.Finish();
+		pushed = writer.PushMesh(sphere) && pushed;
+		writer.Finish();
+
+		std::vector<GeometryGenerator::Vertex> expectedVertices = box.Vertices;
+		expectedVertices.insert(expectedVertices.end(), sphere.Vertices.begin(), sphere.Vertices.end());
+		std::vector<std::uint16_t> expectedIndices = box.GetIndices16();
+		std::vector<std::uint16_t> sphereIndices = sphere.GetIndices16();
+		expectedIndices.insert(expectedIndices.end(), sphereIndices.begin(), sphereIndices.end());
+
+		Check(pushed && writer.GetVertexByteSize() == expectedVertices.size() * sizeof(GeometryGenerator::Vertex) &&
+			SameBits(vertexMemory.data(), expectedVertices.data(), writer.GetVertexByteSize()) &&
+			SameBits(indexMemory.data(), expectedIndices.data(), writer.GetIndexByteSize()),
+			"MeshStreamWriter: writing after Finish continues where it stopped");
+
+		GeometryGenerator::MeshData large;
+		large.Vertices.resize(3);
+		large.Indices32 = { 0, 1, 0x10000 };
+		MeshStreamWriter writer16(vertexMemory.data(), vertexCount, indexMemory.data(), indexCount);
+		Check(!writer16.PushMesh(large) && writer16.GetVertexCount() == 0 && writer16.GetIndexCount() == 0,
+			"MeshStreamWriter: 16 bit writers reject 32 bit index data");
+	}
+
+	void VerifyProgressiveMesh()
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData mesh = geoGen.CreateGrid(2.0f, 2.0f, 5, 5);
+		const uint32 center = 2 * 5 + 2;
+
+		// A separate triangle touching the grid's center vertex, written with -0 like a
+		// mirrored half would be. The center sits on that seam, so it must not move.
+		GeometryGenerator::Vertex seam[3];
+		seam[0].Position = XMFLOAT3(-0.0f, 0.0f, -0.0f);
+		seam[1].Position = XMFLOAT3(-0.5f, 1.0f, 0.0f);
+		seam[2].Position = XMFLOAT3(0.5f, 1.0f, 0.0f);
+		for (GeometryGenerator::Vertex& v : seam)
+		{
+			v.TexC = XMFLOAT2(9.0f, 9.0f);
+			mesh.Indices32.push_back((uint32)mesh.Vertices.size());
+			mesh.Vertices.push_back(v);
+		}
+
+		ProgressiveMesh pm;
+		pm.Build(mesh, 0);
+
+		GeometryGenerator::MeshData base;
+		pm.ExtractMeshData(0, base);
+
+		bool centerKept = false;
+		for (uint32 index : base.Indices32)
+			centerKept = centerKept || SameBits(&base.Vertices[index], &mesh.Vertices[center], sizeof(GeometryGenerator::Vertex));
+		Check(base.Indices32.size() < mesh.Indices32.size() && centerKept,
+			"ProgressiveMesh: vertices on a seam written with -0 stay in the base mesh");
+
+		// Every vertex is distinct, so the refined triangles map back to the originals.
+		GeometryGenerator::MeshData full;
+		pm.ExtractMeshData(pm.GetSplitCount(), full);
+
+		auto canonicalTriangles = [&mesh](const GeometryGenerator::MeshData& data)
+		{
+			std::vector<std::vector<uint32>> triangles;
+			for (size_t t = 0; t + 2 < data.Indices32.size(); t += 3)
+			{
+				std::vector<uint32> triangle;
+				for (size_t k = 0; k < 3; ++k)
+				{
+					const GeometryGenerator::Vertex& v = data.Vertices[data.Indices32[t + k]];
+					for (uint32 i = 0; i < (uint32)mesh.Vertices.size(); ++i)
+					{
+						if (SameBits(&v, &mesh.Vertices[i], sizeof(v)))
+							triangle.push_back(i);
+					}
+				}
+				if (triangle.size() == 3)
+					std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+				triangles.push_back(triangle);
+			}
+			std::sort(triangles.begin(), triangles.end());
+			return triangles;
+		};
+
+		Check(pm.GetVertexCount() == mesh.Vertices.size() && canonicalTriangles(full) == canonicalTriangles(mesh),
+			"ProgressiveMesh: applying every split restores the original triangles");
+	}
+
+	void VerifyVertexTransform()
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData sphere = geoGen.CreateSphere(1.0f, 10, 8);
+
+		// Not a multiple of 4, so the SoA blocks and the per-vertex tail both run.
+		const size_t count = 4 * 9 + 3;
+		std::vector<GeometryGenerator::Vertex> src(sphere.Vertices.begin(), sphere.Vertices.begin() + count);
+
+		std::vector<XMFLOAT4X4> bones(5);
+		for (size_t b = 0; b < bones.size(); ++b)
+		{
+			XMStoreFloat4x4(&bones[b], XMMatrixRotationRollPitchYaw(0.3f * b, 0.7f, -0.2f * b) *
+				XMMatrixTranslation((float)b, 1.0f, -2.0f));
+		}
+
+		std::vector<VertexTransform::SkinWeights> weights(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			weights[i].BoneWeights = XMFLOAT3(0.5f, 0.25f, 0.125f);
+			for (int j = 0; j < 4; ++j)
+				weights[i].BoneIndices[j] = (std::uint8_t)((i + j) % bones.size());
+		}
+
+		std::vector<GeometryGenerator::Vertex> skinned(count);
+		VertexTransform::Skin(src.data(), weights.data(), skinned.data(), count, bones.data(), bones.size());
+
+		std::vector<GeometryGenerator::Vertex> inPlace = src;
+		VertexTransform::Skin(inPlace.data(), weights.data(), inPlace.data(), count, bones.data(), bones.size());
+
+		auto nearlyEqual = [](const XMFLOAT3& a, FXMVECTOR b)
+		{
+			XMFLOAT3 v;
+			XMStoreFloat3(&v, b);
+			return std::fabs(a.x - v.x) < 1e-4f && std::fabs(a.y - v.y) < 1e-4f && std::fabs(a.z - v.z) < 1e-4f;
+		};
+
+		bool matches = true;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float w[4] = { 0.5f, 0.25f, 0.125f, 0.125f };
+			XMVECTOR pos = XMVectorZero(), normal = XMVectorZero(), tangent = XMVectorZero();
+			for (int j = 0; j < 4; ++j)
+			{
+				XMMATRIX B = XMLoadFloat4x4(&bones[weights[i].BoneIndices[j]]);
+				XMVECTOR wj = XMVectorReplicate(w[j]);
+				pos = XMVectorMultiplyAdd(XMVector3TransformCoord(XMLoadFloat3(&src[i].Position), B), wj, pos);
+				normal = XMVectorMultiplyAdd(XMVector3TransformNormal(XMLoadFloat3(&src[i].Normal), B), wj, normal);
+				tangent = XMVectorMultiplyAdd(XMVector3TransformNormal(XMLoadFloat3(&src[i].TangentU), B), wj, tangent);
+			}
+			normal = XMVector3Normalize(normal);
+			tangent = XMVector3Normalize(tangent);
+
+			for (const GeometryGenerator::Vertex& v : { skinned[i], inPlace[i] })
+			{
+				matches = matches && nearlyEqual(v.Position, pos) && nearlyEqual(v.Normal, normal) &&
+					nearlyEqual(v.TangentU, tangent) && v.TexC.x == src[i].TexC.x && v.TexC.y == src[i].TexC.y;
+			}
+		}
+		Check(matches, "VertexTransform: Skin matches the weighted sum of bone transforms");
+	}
+
+	void VerifyShaderCache()
+	{
+		const std::string directory = "ShaderCacheCheck";
+		CreateDirectoryQuietly(directory);
+
+		auto compiler = std::make_shared<FakeShaderCompiler>();
+		compiler->Files[L"shader.hlsl"] = "#include \"common.hlsli\"\nfloat4 PS() : SV_Target { return Color; }\n";
+		compiler->Files[L"common.hlsli"] = "static const float4 Color = 1;\n";
+		compiler->Files[L"broken.hlsl"] = "error\n";
+
+		ShaderCache cache(compiler, std::wstring(directory.begin(), directory.end()));
+		std::vector<ShaderCache::uint64> keys;
+
+		ShaderCompiler::Request request;
+		request.Filename = L"shader.hlsl";
+		request.EntryPoint = "PS";
+		request.Target = "ps_5_0";
+
+		ShaderCache::Result first = cache.Compile(request);
+		keys.push_back(first.Key);
+		Check(SUCCEEDED(first.Status) && !first.FromCache && compiler->CompileCount == 1, "ShaderCache: first request compiles");
+		Check(first.Includes.size() == 1 && first.Includes[0] == L"common.hlsli", "ShaderCache: includes are reported");
+
+		ShaderCache::Result second = cache.Compile(request);
+		Check(SUCCEEDED(second.Status) && second.FromCache && compiler->CompileCount == 1 && second.Bytecode == first.Bytecode,
+			"ShaderCache: second request is served from memory");
+
+		cache.ClearMemory();
+		ShaderCache::Result fromDisk = cache.Compile(request);
+		Check(SUCCEEDED(fromDisk.Status) && fromDisk.FromCache && compiler->CompileCount == 1 && *fromDisk.Bytecode == *first.Bytecode,
+			"ShaderCache: entries are found on disk after ClearMemory");
+
+		// Damaged entries are recompiled; each recompile writes a good entry again.
+		std::string entryFilename = StringUtil::ToNarrow(cache.GetEntryFilename(first.Key));
+		size_t entrySize = 0;
+		if (FILE* file = std::fopen(entryFilename.c_str(), "rb"))
+		{
+			std::fseek(file, 0, SEEK_END);
+			entrySize = (size_t)std::ftell(file);
+			std::fclose(file);
+		}
+
+		DamageFile(entryFilename, entrySize, true);
+		cache.ClearMemory();
+		ShaderCache::Result corrupt = cache.Compile(request);
+		Check(SUCCEEDED(corrupt.Status) && !corrupt.FromCache && compiler->CompileCount == 2 && *corrupt.Bytecode == *first.Bytecode,
+			"ShaderCache: a corrupt entry is rejected");
+
+		DamageFile(entryFilename, entrySize - 1, false);
+		cache.ClearMemory();
+		ShaderCache::Result torn = cache.Compile(request);
+		Check(SUCCEEDED(torn.Status) && !torn.FromCache && compiler->CompileCount == 3 && *torn.Bytecode == *first.Bytecode,
+			"ShaderCache: a torn entry is rejected");
+
+		compiler->Files[L"common.hlsli"] = "static const float4 Color = 0.5;\n";
+		ShaderCache::Result edited = cache.Compile(request);
+		keys.push_back(edited.Key);
+		Check(SUCCEEDED(edited.Status) && !edited.FromCache && edited.Key != first.Key && compiler->CompileCount == 4,
+			"ShaderCache: editing an include changes the key");
+
+		request.Defines = { { "A", "1" }, { "B", "1" } };
+		ShaderCache::Result definesAB = cache.Compile(request);
+		request.Defines = { { "B", "1" }, { "A", "1" } };
+		ShaderCache::Result definesBA = cache.Compile(request);
+		request.Defines = { { "A", "2" }, { "B", "1" } };
+		ShaderCache::Result definesA2 = cache.Compile(request);
+		keys.push_back(definesAB.Key);
+		keys.push_back(definesBA.Key);
+		keys.push_back(definesA2.Key);
+		Check(definesAB.Key != edited.Key && definesAB.Key != definesBA.Key && definesAB.Key != definesA2.Key &&
+			!definesBA.FromCache && !definesA2.FromCache, "ShaderCache: define order and values change the key");
+
+		request.Defines.clear();
+		request.Filename = L"broken.hlsl";
+		ShaderCache::Result broken = cache.Compile(request);
+		request.Filename = L"missing.hlsl";
+		ShaderCache::Result missing = cache.Compile(request);
+		Check(FAILED(broken.Status) && !broken.Errors.empty() && broken.Bytecode == nullptr &&
+			FAILED(missing.Status) && !missing.Errors.empty(), "ShaderCache: failures carry the backend's status and messages");
+
+		for (ShaderCache::uint64 key : keys)
+			std::remove(StringUtil::ToNarrow(cache.GetEntryFilename(key)).c_str());
+		RemoveDirectoryQuietly(directory);
+	}
+
+	void VerifyFileWatcher()
+	{
+		const std::string directories[2] = { "FileWatcherCheckA", "FileWatcherCheckB" };
+		const std::wstring files[3] = { L"FileWatcherCheckA/1.txt", L"FileWatcherCheckA/2.txt", L"FileWatcherCheckB/1.txt" };
+		for (const std::string& directory : directories)
+			CreateDirectoryQuietly(directory);
+
+		FileWatcher watcher;
+		for (const std::wstring& file : files)
+			watcher.Watch(file);
+		watcher.Watch(files[0]);
+		size_t bothWatched = watcher.GetDirectoryCount();
+
+		watcher.Unwatch(files[2]);
+		size_t afterB = watcher.GetDirectoryCount();
+		watcher.Unwatch(files[0]);
+		size_t afterOneOfA = watcher.GetDirectoryCount();
+		watcher.Unwatch(files[1]);
+		watcher.Unwatch(files[1]);
+		Check(bothWatched == 2 && afterB == 1 && afterOneOfA == 1 && watcher.GetDirectoryCount() == 0,
+			"FileWatcher: a directory is unwatched with its last file");
+
+		for (const std::string& directory : directories)
+			RemoveDirectoryQuietly(directory);
+	}
+
+	void VerifyShaderLibrary()
+	{
+		const std::string directory = "ShaderLibraryCheck";
+		const std::string sharedInclude = directory + "/shared.hlsli";
+		const std::string otherInclude = directory + "/other.hlsli";
+		const std::string shaderFiles[2] = { directory + "/a.hlsl", directory + "/b.hlsl" };
+
+		CreateDirectoryQuietly(directory);
+		WriteTextFile(sharedInclude, "static const float4 Color = 1;\n");
+		WriteTextFile(otherInclude, "static const float4 Other = 1;\n");
+		WriteTextFile(shaderFiles[0], "#include \"" + sharedInclude + "\"\nfloat4 PS() : SV_Target { return Color; }\n");
+		WriteTextFile(shaderFiles[1], "#include \"" + otherInclude + "\"\nfloat4 PS() : SV_Target { return Other; }\n");
+
+		// Old enough that adding the shaders does not count as a change in flight.
+		for (const std::string& filename : { sharedInclude, otherInclude, shaderFiles[0], shaderFiles[1] })
+			BackdateFile(filename, 60);
+
+		auto compiler = std::make_shared<FakeShaderCompiler>();
+		compiler->ReadFromDisk = true;
+		auto cache = std::make_shared<ShaderCache>(compiler, L"");
+
+		ShaderLibrary library(cache, &ThreadPool::Default(), 10);
+
+		ShaderLibrary::Handle handles[2];
+		for (int i = 0; i < 2; ++i)
+		{
+			ShaderCompiler::Request request;
+			request.Filename = std::wstring(shaderFiles[i].begin(), shaderFiles[i].end());
+			request.EntryPoint = "PS";
+			request.Target = "ps_5_0";
+			handles[i] = library.Add(request);
+		}
+
+		std::mutex mutex;
+		std::vector<ShaderLibrary::Handle> rebuilt;
+		bool reentered = false;
+		library.SetRebuildCallback([&](ShaderLibrary::Handle handle, const ShaderCache::Result& result)
+		{
+			// No library lock is held here, so even a nested rebuild must not deadlock.
+			bool nested = library.Rebuild(std::vector<std::wstring>()).empty();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			rebuilt.push_back(handle);
+			reentered = nested;
+		});
+
+		library.StartWatching();
+		WriteTextFile(sharedInclude, "static const float4 Color = 0.5;\n");
+
+		for (int wait = 0; wait < 500; ++wait)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!rebuilt.empty())
+					break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		// Give a wrong extra rebuild the chance to show up.
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		library.StopWatching();
+
+		std::shared_ptr<const ShaderLibrary::Shader> a = library.Get(handles[0]);
+		std::shared_ptr<const ShaderLibrary::Shader> b = library.Get(handles[1]);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			Check(rebuilt.size() == 1 && rebuilt[0] == handles[0] && reentered &&
+				a != nullptr && a->Version == 2 && b != nullptr && b->Version == 1,
+				"ShaderLibrary: editing an include rebuilds only its dependents");
+		}
+
+		for (const std::string& filename : { sharedInclude, otherInclude, shaderFiles[0], shaderFiles[1] })
+			std::remove(filename.c_str());
+		RemoveDirectoryQuietly(directory);
+	}
+
+	void VerifyFrustumCuller()
+	{
+		// Camera at the origin looking down +z.
+		BoundingFrustum frustum;
+		BoundingFrustum::CreateFromMatrix(frustum, XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 1000.0f));
+
+		RandomEngine engine(5);
+		std::vector<BoundingBox> boxes(20011);
+		FrustumCuller culler;
+		for (BoundingBox& box : boxes)
+		{
+			box.Center = XMFLOAT3(engine.NextFloat(-1000.0f, 1000.0f), engine.NextFloat(-1000.0f, 1000.0f), engine.NextFloat(-1000.0f, 1000.0f));
+			box.Extents = XMFLOAT3(engine.NextFloat(0.5f, 10.0f), engine.NextFloat(0.5f, 10.0f), engine.NextFloat(0.5f, 10.0f));
+			culler.Add(box);
+		}
+
+		std::vector<FrustumCuller::uint32> serial, parallel;
+		culler.Cull(frustum, serial);
+		culler.Cull(frustum, parallel, &ThreadPool::Default());
+		Check(serial == parallel, "FrustumCuller: Cull does not depend on the pool");
+
+		// The plane test is conservative: it may keep a box outside near a corner, but
+		// never drops one the frustum touches.
+		std::vector<bool> visible(boxes.size(), false);
+		for (FrustumCuller::uint32 index : serial)
+			visible[index] = true;
+
+		bool conservative = true;
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			if (frustum.Contains(boxes[i]) != DISJOINT)
+				conservative = conservative && visible[i];
+		}
+		Check(conservative, "FrustumCuller: keeps every box BoundingFrustum::Contains keeps");
+		Check(std::is_sorted(serial.begin(), serial.end()), "FrustumCuller: visible indices ascend");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::strcmp(argv[1], "-benchmark") == 0)
+	{
+		RunBenchmarks();
+		return 0;
+	}
+
+	VerifyThreadPool();
+	VerifyCounterRandom();
+	VerifyMeshCodec();
+	VerifyFormatConversion();
+	VerifyNoise();
+	VerifyFastMath();
+	VerifyLowDiscrepancy();
+	VerifyRayTriangleSet();
+	VerifyFrustumCuller();
+	VerifyOcclusionCuller();
+	VerifyMatrixBatch();
+	VerifyTransformHierarchy();
+	VerifyMeshStreamWriter();
+	VerifyProgressiveMesh();
+	VerifyVertexTransform();
+	VerifyShaderCache();
+	VerifyFileWatcher();
+	VerifyShaderLibrary();
+
+	std::printf("%d of %d checks passed.\n", gCheckCount - gFailureCount, gCheckCount);
+	return gFailureCount;
+}